@@ -0,0 +1,544 @@
+/* gtd-append-log.c
+ *
+ * Copyright (C) 2015 Georges Basile Stavracas Neto <georges.stavracas@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gtd-append-log.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <glib/gi18n.h>
+#include <glib/gstdio.h>
+#include <unistd.h>
+
+/*
+ * An append-only file of records, one per line. The fields of a record
+ * are escaped with g_strescape() and separated by tabs, so records never
+ * contain raw tabs or newlines.
+ *
+ * Appended records are buffered and written in batches, with a single
+ * fsync() per batch. When most of the records in the file are dead, the
+ * owner is asked to write the live ones, which atomically replace the
+ * file.
+ */
+
+/* Milliseconds to wait before writing a batch of records */
+#define FLUSH_INTERVAL                   500
+
+/* Minimum number of records in the file before it is compacted */
+#define COMPACT_THRESHOLD                64
+
+typedef struct
+{
+  gchar                  *filename;
+  gint                    fd;
+
+  /* Records not written yet */
+  GString                *buffer;
+  guint                   n_buffered;
+  guint                   flush_timeout_id;
+
+  /* Number of records in the file, and how many of them are live */
+  guint                   n_records;
+  guint                   n_live;
+
+  /* Whether the file ends with a torn record */
+  gboolean                torn;
+
+  GtdAppendLogCompactFunc compact_func;
+  gpointer                compact_data;
+} GtdAppendLogPrivate;
+
+struct _GtdAppendLog
+{
+  GObject                 parent;
+
+  /*<private>*/
+  GtdAppendLogPrivate    *priv;
+};
+
+G_DEFINE_TYPE_WITH_PRIVATE (GtdAppendLog, gtd_append_log, G_TYPE_OBJECT)
+
+static gboolean
+gtd_append_log__open (GtdAppendLog *log)
+{
+  GtdAppendLogPrivate *priv = log->priv;
+
+  if (priv->fd >= 0)
+    return TRUE;
+
+  priv->fd = g_open (priv->filename, O_WRONLY | O_APPEND | O_CREAT, 0600);
+
+  if (priv->fd < 0)
+    {
+      g_warning ("%s: %s (%s): %s",
+                 G_STRFUNC,
+                 _("Error opening file"),
+                 priv->filename,
+                 g_strerror (errno));
+
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
+static void
+gtd_append_log__close (GtdAppendLog *log)
+{
+  GtdAppendLogPrivate *priv = log->priv;
+
+  if (priv->fd >= 0)
+    {
+      close (priv->fd);
+      priv->fd = -1;
+    }
+}
+
+static void
+gtd_append_log__compact (GtdAppendLog *log)
+{
+  GtdAppendLogPrivate *priv = log->priv;
+  GError *error = NULL;
+  GString *contents;
+
+  contents = g_string_new ("");
+
+  priv->compact_func (log, contents, priv->compact_data);
+
+  gtd_append_log__close (log);
+
+  if (g_file_set_contents (priv->filename, contents->str, contents->len, &error))
+    {
+      priv->n_records = priv->n_live;
+      priv->torn = FALSE;
+    }
+  else
+    {
+      g_warning ("%s: %s (%s): %s",
+                 G_STRFUNC,
+                 _("Error compacting file"),
+                 priv->filename,
+                 error->message);
+
+      g_clear_error (&error);
+    }
+
+  g_string_free (contents, TRUE);
+}
+
+static gboolean
+gtd_append_log__flush_timeout_cb (GtdAppendLog *log)
+{
+  log->priv->flush_timeout_id = 0;
+
+  gtd_append_log_flush (log);
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+gtd_append_log_finalize (GObject *object)
+{
+  GtdAppendLog *self = (GtdAppendLog *)object;
+  GtdAppendLogPrivate *priv = gtd_append_log_get_instance_private (self);
+
+  /* Don't lose the records of the current batch */
+  gtd_append_log_flush (self);
+  gtd_append_log__close (self);
+
+  g_string_free (priv->buffer, TRUE);
+  g_free (priv->filename);
+
+  G_OBJECT_CLASS (gtd_append_log_parent_class)->finalize (object);
+}
+
+static void
+gtd_append_log_class_init (GtdAppendLogClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->finalize = gtd_append_log_finalize;
+}
+
+static void
+gtd_append_log_init (GtdAppendLog *self)
+{
+  self->priv = gtd_append_log_get_instance_private (self);
+
+  self->priv->fd = -1;
+  self->priv->buffer = g_string_new ("");
+}
+
+/**
+ * gtd_append_log_new:
+ * @filename: the path of the log file
+ *
+ * Creates a new #GtdAppendLog writing to @filename. The parent
+ * directories of @filename are created if needed.
+ *
+ * Returns: (transfer full): a new #GtdAppendLog
+ */
+GtdAppendLog*
+gtd_append_log_new (const gchar *filename)
+{
+  GtdAppendLog *self;
+  gchar *dirname;
+
+  g_return_val_if_fail (filename, NULL);
+
+  self = g_object_new (GTD_TYPE_APPEND_LOG, NULL);
+  self->priv->filename = g_strdup (filename);
+
+  dirname = g_path_get_dirname (filename);
+  g_mkdir_with_parents (dirname, 0700);
+  g_free (dirname);
+
+  return self;
+}
+
+/**
+ * gtd_append_log_get_filename:
+ * @log: a #GtdAppendLog
+ *
+ * Retrieves the path of the file of @log.
+ *
+ * Returns: (transfer none): the filename of @log
+ */
+const gchar*
+gtd_append_log_get_filename (GtdAppendLog *log)
+{
+  g_return_val_if_fail (GTD_IS_APPEND_LOG (log), NULL);
+
+  return log->priv->filename;
+}
+
+/**
+ * gtd_append_log_read:
+ * @log: a #GtdAppendLog
+ * @func: the function to call for each record
+ * @user_data: user data for @func
+ *
+ * Reads the records stored in @log, in the order they were appended.
+ * A torn record at the end of the file, left by a crash, is skipped.
+ *
+ * Returns:
+ */
+void
+gtd_append_log_read (GtdAppendLog         *log,
+                     GtdAppendLogReadFunc  func,
+                     gpointer              user_data)
+{
+  GtdAppendLogPrivate *priv;
+  GError *error = NULL;
+  gchar *contents;
+  gchar *line;
+  gsize length;
+
+  g_return_if_fail (GTD_IS_APPEND_LOG (log));
+  g_return_if_fail (func);
+
+  priv = log->priv;
+
+  if (!g_file_get_contents (priv->filename, &contents, &length, &error))
+    {
+      if (!g_error_matches (error, G_FILE_ERROR, G_FILE_ERROR_NOENT))
+        {
+          g_warning ("%s: %s (%s): %s",
+                     G_STRFUNC,
+                     _("Error reading file"),
+                     priv->filename,
+                     error->message);
+        }
+
+      g_clear_error (&error);
+      return;
+    }
+
+  priv->torn = length > 0 && contents[length - 1] != '\n';
+  line = contents;
+
+  while (*line != '\0')
+    {
+      gchar **fields;
+      gchar *end;
+      guint n_fields;
+      guint i;
+
+      /* Split the lines in place */
+      for (end = line; *end != '\0' && *end != '\n'; end++)
+        ;
+
+      /* The torn record */
+      if (*end == '\0')
+        break;
+
+      *end = '\0';
+
+      fields = g_strsplit (line, "\t", -1);
+      n_fields = g_strv_length (fields);
+
+      for (i = 0; i < n_fields; i++)
+        {
+          gchar *field = g_strcompress (fields[i]);
+
+          g_free (fields[i]);
+          fields[i] = field;
+        }
+
+      func (fields, n_fields, user_data);
+
+      priv->n_records++;
+
+      g_strfreev (fields);
+
+      line = end + 1;
+    }
+
+  g_free (contents);
+}
+
+/**
+ * gtd_append_log_format_record:
+ * @buffer: the buffer to write to
+ * @fields: (array length=n_fields): the fields of the record
+ * @n_fields: the number of fields
+ *
+ * Writes a record made of @fields to @buffer. %NULL fields are
+ * written as empty strings.
+ *
+ * Returns:
+ */
+void
+gtd_append_log_format_record (GString             *buffer,
+                              const gchar * const *fields,
+                              guint                n_fields)
+{
+  guint i;
+
+  for (i = 0; i < n_fields; i++)
+    {
+      gchar *escaped;
+
+      escaped = g_strescape (fields[i] ? fields[i] : "", NULL);
+
+      if (i > 0)
+        g_string_append_c (buffer, '\t');
+
+      g_string_append (buffer, escaped);
+
+      g_free (escaped);
+    }
+
+  g_string_append_c (buffer, '\n');
+}
+
+/**
+ * gtd_append_log_append:
+ * @log: a #GtdAppendLog
+ * @fields: (array length=n_fields): the fields of the record
+ * @n_fields: the number of fields
+ *
+ * Appends a record to @log. The record is written to disk with the
+ * next batch.
+ *
+ * Returns:
+ */
+void
+gtd_append_log_append (GtdAppendLog        *log,
+                       const gchar * const *fields,
+                       guint                n_fields)
+{
+  GtdAppendLogPrivate *priv;
+
+  g_return_if_fail (GTD_IS_APPEND_LOG (log));
+
+  priv = log->priv;
+
+  gtd_append_log_format_record (priv->buffer, fields, n_fields);
+  priv->n_buffered++;
+
+  if (priv->flush_timeout_id == 0)
+    {
+      priv->flush_timeout_id = g_timeout_add (FLUSH_INTERVAL,
+                                              (GSourceFunc) gtd_append_log__flush_timeout_cb,
+                                              log);
+    }
+}
+
+/**
+ * gtd_append_log_set_compact_func:
+ * @log: a #GtdAppendLog
+ * @func: (nullable): the function writing the live records
+ * @user_data: user data for @func
+ *
+ * Sets the function used to compact @log. Without it, @log
+ * is never compacted.
+ *
+ * Returns:
+ */
+void
+gtd_append_log_set_compact_func (GtdAppendLog            *log,
+                                 GtdAppendLogCompactFunc  func,
+                                 gpointer                 user_data)
+{
+  g_return_if_fail (GTD_IS_APPEND_LOG (log));
+
+  log->priv->compact_func = func;
+  log->priv->compact_data = user_data;
+}
+
+/**
+ * gtd_append_log_set_n_live:
+ * @log: a #GtdAppendLog
+ * @n_live: the number of live records
+ *
+ * Tells @log how many of its records are still live, which
+ * decides when it is compacted.
+ *
+ * Returns:
+ */
+void
+gtd_append_log_set_n_live (GtdAppendLog *log,
+                           guint         n_live)
+{
+  g_return_if_fail (GTD_IS_APPEND_LOG (log));
+
+  log->priv->n_live = n_live;
+}
+
+/**
+ * gtd_append_log_flush:
+ * @log: a #GtdAppendLog
+ *
+ * Writes the buffered records of @log to disk, and compacts the
+ * file when most of its records are dead. The file is created even
+ * when there is nothing to write.
+ *
+ * Returns:
+ */
+void
+gtd_append_log_flush (GtdAppendLog *log)
+{
+  GtdAppendLogPrivate *priv;
+  gsize written;
+
+  g_return_if_fail (GTD_IS_APPEND_LOG (log));
+
+  priv = log->priv;
+
+  if (priv->flush_timeout_id > 0)
+    {
+      g_source_remove (priv->flush_timeout_id);
+      priv->flush_timeout_id = 0;
+    }
+
+  /* Nothing to write, but the file has to exist */
+  if (priv->buffer->len == 0)
+    {
+      gtd_append_log__open (log);
+      return;
+    }
+
+  /* When most records are dead, rewriting the file is cheaper */
+  if (priv->compact_func &&
+      priv->n_records + priv->n_buffered > COMPACT_THRESHOLD &&
+      priv->n_records + priv->n_buffered > 2 * priv->n_live)
+    {
+      gtd_append_log__compact (log);
+
+      g_string_truncate (priv->buffer, 0);
+      priv->n_buffered = 0;
+      return;
+    }
+
+  if (!gtd_append_log__open (log))
+    return;
+
+  /* Terminate the torn record, so it doesn't swallow the next one */
+  if (priv->torn)
+    {
+      g_string_prepend_c (priv->buffer, '\n');
+      priv->torn = FALSE;
+    }
+
+  written = 0;
+
+  while (written < priv->buffer->len)
+    {
+      gssize n;
+
+      n = write (priv->fd, priv->buffer->str + written, priv->buffer->len - written);
+
+      if (n < 0)
+        {
+          if (errno == EINTR)
+            continue;
+
+          g_warning ("%s: %s (%s): %s",
+                     G_STRFUNC,
+                     _("Error writing file"),
+                     priv->filename,
+                     g_strerror (errno));
+
+          break;
+        }
+
+      written += n;
+    }
+
+  /* One sync for the whole batch */
+  fsync (priv->fd);
+
+  if (written == priv->buffer->len)
+    {
+      priv->n_records += priv->n_buffered;
+      priv->n_buffered = 0;
+    }
+
+  g_string_erase (priv->buffer, 0, written);
+}
+
+/**
+ * gtd_append_log_delete:
+ * @log: a #GtdAppendLog
+ *
+ * Discards the buffered records of @log and deletes its file.
+ *
+ * Returns:
+ */
+void
+gtd_append_log_delete (GtdAppendLog *log)
+{
+  GtdAppendLogPrivate *priv;
+
+  g_return_if_fail (GTD_IS_APPEND_LOG (log));
+
+  priv = log->priv;
+
+  if (priv->flush_timeout_id > 0)
+    {
+      g_source_remove (priv->flush_timeout_id);
+      priv->flush_timeout_id = 0;
+    }
+
+  g_string_truncate (priv->buffer, 0);
+  priv->n_buffered = 0;
+  priv->n_records = 0;
+
+  gtd_append_log__close (log);
+  g_unlink (priv->filename);
+}
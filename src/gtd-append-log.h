@@ -0,0 +1,86 @@
+/* gtd-append-log.h
+ *
+ * Copyright (C) 2015 Georges Basile Stavracas Neto <georges.stavracas@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef GTD_APPEND_LOG_H
+#define GTD_APPEND_LOG_H
+
+#include "gtd-types.h"
+
+#include <glib-object.h>
+
+G_BEGIN_DECLS
+
+#define GTD_TYPE_APPEND_LOG (gtd_append_log_get_type())
+
+G_DECLARE_FINAL_TYPE (GtdAppendLog, gtd_append_log, GTD, APPEND_LOG, GObject)
+
+/**
+ * GtdAppendLogReadFunc:
+ * @fields: (array length=n_fields): the unescaped fields of the record
+ * @n_fields: the number of fields
+ * @user_data: user data
+ *
+ * Called for each record when reading a #GtdAppendLog.
+ */
+typedef void (*GtdAppendLogReadFunc)    (gchar                 **fields,
+                                         guint                   n_fields,
+                                         gpointer                user_data);
+
+/**
+ * GtdAppendLogCompactFunc:
+ * @log: a #GtdAppendLog
+ * @contents: the buffer to write the live records to
+ * @user_data: user data
+ *
+ * Called when @log is compacted. Implementations write every live
+ * record to @contents with gtd_append_log_format_record().
+ */
+typedef void (*GtdAppendLogCompactFunc) (GtdAppendLog           *log,
+                                         GString                *contents,
+                                         gpointer                user_data);
+
+GtdAppendLog*           gtd_append_log_new                      (const gchar            *filename);
+
+const gchar*            gtd_append_log_get_filename             (GtdAppendLog           *log);
+
+void                    gtd_append_log_read                     (GtdAppendLog           *log,
+                                                                 GtdAppendLogReadFunc    func,
+                                                                 gpointer                user_data);
+
+void                    gtd_append_log_append                   (GtdAppendLog           *log,
+                                                                 const gchar * const    *fields,
+                                                                 guint                   n_fields);
+
+void                    gtd_append_log_format_record            (GString                *buffer,
+                                                                 const gchar * const    *fields,
+                                                                 guint                   n_fields);
+
+void                    gtd_append_log_set_compact_func         (GtdAppendLog           *log,
+                                                                 GtdAppendLogCompactFunc func,
+                                                                 gpointer                user_data);
+
+void                    gtd_append_log_set_n_live               (GtdAppendLog           *log,
+                                                                 guint                   n_live);
+
+void                    gtd_append_log_flush                    (GtdAppendLog           *log);
+
+void                    gtd_append_log_delete                   (GtdAppendLog           *log);
+
+G_END_DECLS
+
+#endif /* GTD_APPEND_LOG_H */
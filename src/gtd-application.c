@@ -21,8 +21,11 @@
 #endif
 
 #include "gtd-application.h"
+#include "gtd-command-line.h"
+#include "gtd-dbus-service.h"
 #include "gtd-initial-setup-window.h"
 #include "gtd-manager.h"
+#include "gtd-shell-search-provider.h"
 #include "gtd-window.h"
 
 #include <glib.h>
@@ -30,13 +33,27 @@
 #include <gio/gio.h>
 #include <glib/gi18n.h>
 
+#ifdef HAVE_MALLOC_TRIM
+#include <malloc.h>
+#endif
+
+/* Seconds in the background before the hidden window is dropped */
+#define TRIM_TIMEOUT                     300
+
 typedef struct
 {
-  GtkCssProvider *provider;
-  GtdManager     *manager;
+  GtkCssProvider         *provider;
+  GtdManager             *manager;
 
-  GtkWidget      *window;
-  GtkWidget      *initial_setup;
+  GtkWidget              *window;
+  GtkWidget              *initial_setup;
+
+  GtdDBusService         *dbus_service;
+  GtdShellSearchProvider *search_provider;
+
+  /* background service */
+  gboolean                in_background;
+  guint                   trim_timeout_id;
 } GtdApplicationPrivate;
 
 struct _GtdApplication
@@ -110,6 +127,82 @@ gtd_application_show_about (GSimpleAction *simple,
   g_date_time_unref (date);
 }
 
+static void
+gtd_application__run_in_background (GtdApplication *application,
+                                    gboolean        in_background)
+{
+  GtdApplicationPrivate *priv = application->priv;
+
+  if (priv->in_background == in_background)
+    return;
+
+  priv->in_background = in_background;
+
+  /* The hold keeps the application alive without any window */
+  if (in_background)
+    g_application_hold (G_APPLICATION (application));
+  else
+    g_application_release (G_APPLICATION (application));
+}
+
+static void
+gtd_application__stop_trim_timeout (GtdApplication *application)
+{
+  GtdApplicationPrivate *priv = application->priv;
+
+  if (priv->trim_timeout_id > 0)
+    {
+      g_source_remove (priv->trim_timeout_id);
+      priv->trim_timeout_id = 0;
+    }
+}
+
+static gboolean
+gtd_application__trim (GtdApplication *application)
+{
+  GtdApplicationPrivate *priv = application->priv;
+
+  priv->trim_timeout_id = 0;
+
+  g_debug ("%s: %s",
+           G_STRFUNC,
+           "Releasing memory after being idle in the background");
+
+  /* The window is cheap to rebuild compared to the model */
+  if (priv->window && !gtk_widget_get_visible (priv->window))
+    gtk_widget_destroy (priv->window);
+
+  gtd_manager_trim (priv->manager);
+
+#ifdef HAVE_MALLOC_TRIM
+  malloc_trim (0);
+#endif
+
+  return G_SOURCE_REMOVE;
+}
+
+static gboolean
+gtd_application__window_delete_event (GtkWidget      *window,
+                                      GdkEvent       *event,
+                                      GtdApplication *application)
+{
+  GtdApplicationPrivate *priv = application->priv;
+
+  if (!priv->in_background)
+    return GDK_EVENT_PROPAGATE;
+
+  /* Keep the window around, so reopening it is instant */
+  gtk_widget_hide (window);
+
+  gtd_application__stop_trim_timeout (application);
+
+  priv->trim_timeout_id = g_timeout_add_seconds (TRIM_TIMEOUT,
+                                                 (GSourceFunc) gtd_application__trim,
+                                                 application);
+
+  return GDK_EVENT_STOP;
+}
+
 static void
 gtd_application_quit (GSimpleAction *simple,
                       GVariant      *parameter,
@@ -117,7 +210,11 @@ gtd_application_quit (GSimpleAction *simple,
 {
   GtdApplicationPrivate *priv = GTD_APPLICATION (user_data)->priv;
 
-  gtk_widget_destroy (priv->window);
+  gtd_application__stop_trim_timeout (GTD_APPLICATION (user_data));
+  gtd_application__run_in_background (GTD_APPLICATION (user_data), FALSE);
+
+  if (priv->window)
+    gtk_widget_destroy (priv->window);
 }
 
 GtdApplication *
@@ -127,7 +224,7 @@ gtd_application_new (void)
 
   return g_object_new (GTD_TYPE_APPLICATION,
                        "application-id", "org.gnome.Todo",
-                       "flags", G_APPLICATION_FLAGS_NONE,
+                       "flags", G_APPLICATION_HANDLES_COMMAND_LINE,
                        NULL);
 }
 
@@ -140,10 +237,21 @@ run_window (GtdApplication *application)
 
   priv = application->priv;
 
+  gtd_application__stop_trim_timeout (application);
+
   if (!priv->window)
-    priv->window = gtd_window_new (GTD_APPLICATION (application));
+    {
+      priv->window = gtd_window_new (GTD_APPLICATION (application));
+
+      g_signal_connect (priv->window,
+                        "delete-event",
+                        G_CALLBACK (gtd_application__window_delete_event),
+                        application);
+
+      g_object_add_weak_pointer (G_OBJECT (priv->window), (gpointer*) &priv->window);
+    }
 
-  gtk_widget_show (priv->window);
+  gtk_window_present (GTK_WINDOW (priv->window));
 }
 
 static void
@@ -230,9 +338,92 @@ gtd_application_activate (GApplication *application)
     run_window (GTD_APPLICATION (application));
 }
 
+static gint
+gtd_application_command_line (GApplication            *application,
+                              GApplicationCommandLine *command_line)
+{
+  GtdApplicationPrivate *priv = GTD_APPLICATION (application)->priv;
+  GVariantDict *options;
+
+  options = g_application_command_line_get_options_dict (command_line);
+
+  /* Start as a service that only shows the window when activated again */
+  if (g_variant_dict_contains (options, "background"))
+    {
+      gtd_application__run_in_background (GTD_APPLICATION (application), TRUE);
+      return 0;
+    }
+
+  /* Commands run headless, without creating any window */
+  if (!gtd_command_line_handle (application, priv->manager, command_line))
+    g_application_activate (application);
+
+  return 0;
+}
+
+static gboolean
+gtd_application_dbus_register (GApplication     *application,
+                               GDBusConnection  *connection,
+                               const gchar      *object_path,
+                               GError          **error)
+{
+  GtdApplicationPrivate *priv = GTD_APPLICATION (application)->priv;
+  gchar *search_provider_path;
+  gboolean success;
+
+  if (!G_APPLICATION_CLASS (gtd_application_parent_class)->dbus_register (application,
+                                                                         connection,
+                                                                         object_path,
+                                                                         error))
+    {
+      return FALSE;
+    }
+
+  /* batch task operations for external tools */
+  if (!priv->dbus_service)
+    priv->dbus_service = gtd_dbus_service_new (GTD_APPLICATION (application));
+
+  if (!gtd_dbus_service_register (priv->dbus_service, connection, object_path, error))
+    return FALSE;
+
+  /* GNOME Shell search */
+  if (!priv->search_provider)
+    priv->search_provider = gtd_shell_search_provider_new (GTD_APPLICATION (application));
+
+  search_provider_path = g_strconcat (object_path, "/SearchProvider", NULL);
+  success = gtd_shell_search_provider_register (priv->search_provider, connection, search_provider_path, error);
+
+  g_free (search_provider_path);
+
+  return success;
+}
+
+static void
+gtd_application_dbus_unregister (GApplication    *application,
+                                 GDBusConnection *connection,
+                                 const gchar     *object_path)
+{
+  GtdApplicationPrivate *priv = GTD_APPLICATION (application)->priv;
+
+  if (priv->dbus_service)
+    gtd_dbus_service_unregister (priv->dbus_service);
+
+  if (priv->search_provider)
+    gtd_shell_search_provider_unregister (priv->search_provider);
+
+  G_APPLICATION_CLASS (gtd_application_parent_class)->dbus_unregister (application,
+                                                                     connection,
+                                                                     object_path);
+}
+
 static void
 gtd_application_finalize (GObject *object)
 {
+  GtdApplicationPrivate *priv = GTD_APPLICATION (object)->priv;
+
+  g_clear_object (&priv->dbus_service);
+  g_clear_object (&priv->search_provider);
+
   G_OBJECT_CLASS (gtd_application_parent_class)->finalize (object);
 }
 
@@ -254,6 +445,23 @@ gtd_application_startup (GApplication *application)
                                    application);
 
   G_APPLICATION_CLASS (gtd_application_parent_class)->startup (application);
+
+  /* keep the model warm after the last window is closed */
+  if (gtd_manager_get_run_in_background (priv->manager))
+    gtd_application__run_in_background (GTD_APPLICATION (application), TRUE);
+}
+
+static void
+gtd_application_shutdown (GApplication *application)
+{
+  GtdApplicationPrivate *priv = GTD_APPLICATION (application)->priv;
+
+  gtd_application__stop_trim_timeout (GTD_APPLICATION (application));
+
+  /* abort pending backend operations */
+  gtd_manager_cancel (priv->manager);
+
+  G_APPLICATION_CLASS (gtd_application_parent_class)->shutdown (application);
 }
 
 static void
@@ -265,6 +473,10 @@ gtd_application_class_init (GtdApplicationClass *klass)
   object_class->finalize = gtd_application_finalize;
 
   application_class->activate = gtd_application_activate;
+  application_class->command_line = gtd_application_command_line;
+  application_class->dbus_register = gtd_application_dbus_register;
+  application_class->dbus_unregister = gtd_application_dbus_unregister;
+  application_class->shutdown = gtd_application_shutdown;
   application_class->startup = gtd_application_startup;
 }
 
@@ -274,6 +486,8 @@ gtd_application_init (GtdApplication *self)
   GtdApplicationPrivate *priv = gtd_application_get_instance_private (self);
 
   self->priv = priv;
+
+  g_application_add_main_option_entries (G_APPLICATION (self), gtd_command_line_get_options ());
 }
 
 GtdManager*
@@ -0,0 +1,152 @@
+/* gtd-cancellable.c
+ *
+ * Copyright (C) 2015 Georges Basile Stavracas Neto <georges.stavracas@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gtd-cancellable.h"
+
+typedef struct
+{
+  GCancellable          *parent;
+  gulong                 parent_cancelled_id;
+
+  guint                  timeout_id;
+  gboolean               timed_out;
+} GtdCancellablePrivate;
+
+struct _GtdCancellable
+{
+  GCancellable           parent;
+
+  /*<private>*/
+  GtdCancellablePrivate *priv;
+};
+
+G_DEFINE_TYPE_WITH_PRIVATE (GtdCancellable, gtd_cancellable, G_TYPE_CANCELLABLE)
+
+static void
+gtd_cancellable__parent_cancelled_cb (GCancellable   *parent,
+                                      GtdCancellable *self)
+{
+  g_cancellable_cancel (G_CANCELLABLE (self));
+}
+
+static gboolean
+gtd_cancellable__timeout_cb (GtdCancellable *self)
+{
+  self->priv->timeout_id = 0;
+  self->priv->timed_out = TRUE;
+
+  g_cancellable_cancel (G_CANCELLABLE (self));
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+gtd_cancellable_dispose (GObject *object)
+{
+  GtdCancellable *self = (GtdCancellable *)object;
+  GtdCancellablePrivate *priv = gtd_cancellable_get_instance_private (self);
+
+  if (priv->timeout_id > 0)
+    {
+      g_source_remove (priv->timeout_id);
+      priv->timeout_id = 0;
+    }
+
+  if (priv->parent)
+    {
+      g_cancellable_disconnect (priv->parent, priv->parent_cancelled_id);
+      priv->parent_cancelled_id = 0;
+
+      g_clear_object (&priv->parent);
+    }
+
+  G_OBJECT_CLASS (gtd_cancellable_parent_class)->dispose (object);
+}
+
+static void
+gtd_cancellable_class_init (GtdCancellableClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->dispose = gtd_cancellable_dispose;
+}
+
+static void
+gtd_cancellable_init (GtdCancellable *self)
+{
+  self->priv = gtd_cancellable_get_instance_private (self);
+}
+
+/**
+ * gtd_cancellable_new:
+ * @parent: (nullable): the parent #GCancellable, or %NULL
+ * @timeout: the deadline of the operation in seconds, or 0
+ *
+ * Creates a new #GCancellable that is cancelled when @parent is
+ * cancelled, or when @timeout seconds elapse. This allows building
+ * a hierarchy of cancellables, where cancelling a node cancels every
+ * operation below it.
+ *
+ * Returns: (transfer full): a new #GCancellable
+ */
+GCancellable*
+gtd_cancellable_new (GCancellable *parent,
+                     guint         timeout)
+{
+  GtdCancellable *self;
+
+  self = g_object_new (GTD_TYPE_CANCELLABLE, NULL);
+
+  if (parent)
+    {
+      self->priv->parent = g_object_ref (parent);
+      self->priv->parent_cancelled_id = g_cancellable_connect (parent,
+                                                               G_CALLBACK (gtd_cancellable__parent_cancelled_cb),
+                                                               self,
+                                                               NULL);
+    }
+
+  if (timeout > 0 && !g_cancellable_is_cancelled (G_CANCELLABLE (self)))
+    {
+      self->priv->timeout_id = g_timeout_add_seconds (timeout,
+                                                      (GSourceFunc) gtd_cancellable__timeout_cb,
+                                                      self);
+    }
+
+  return G_CANCELLABLE (self);
+}
+
+/**
+ * gtd_cancellable_get_timed_out:
+ * @cancellable: a #GCancellable
+ *
+ * Checks whether @cancellable was cancelled because its deadline
+ * elapsed, rather than by its parent.
+ *
+ * Returns: %TRUE if the deadline of @cancellable elapsed, %FALSE otherwise
+ */
+gboolean
+gtd_cancellable_get_timed_out (GCancellable *cancellable)
+{
+  g_return_val_if_fail (G_IS_CANCELLABLE (cancellable), FALSE);
+
+  if (!GTD_IS_CANCELLABLE (cancellable))
+    return FALSE;
+
+  return GTD_CANCELLABLE (cancellable)->priv->timed_out;
+}
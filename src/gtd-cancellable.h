@@ -0,0 +1,39 @@
+/* gtd-cancellable.h
+ *
+ * Copyright (C) 2015 Georges Basile Stavracas Neto <georges.stavracas@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef GTD_CANCELLABLE_H
+#define GTD_CANCELLABLE_H
+
+#include "gtd-types.h"
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+#define GTD_TYPE_CANCELLABLE (gtd_cancellable_get_type())
+
+G_DECLARE_FINAL_TYPE (GtdCancellable, gtd_cancellable, GTD, CANCELLABLE, GCancellable)
+
+GCancellable*           gtd_cancellable_new                     (GCancellable           *parent,
+                                                                 guint                   timeout);
+
+gboolean                gtd_cancellable_get_timed_out           (GCancellable           *cancellable);
+
+G_END_DECLS
+
+#endif /* GTD_CANCELLABLE_H */
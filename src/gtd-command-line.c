@@ -0,0 +1,468 @@
+/* gtd-command-line.c
+ *
+ * Copyright (C) 2015 Georges Basile Stavracas Neto <georges.stavracas@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gtd-command-line.h"
+#include "gtd-exporter.h"
+#include "gtd-manager.h"
+#include "gtd-task.h"
+#include "gtd-task-list.h"
+
+#include <glib/gi18n.h>
+#include <stdlib.h>
+
+/*
+ * Command-line requests are served by the primary instance, so when
+ * To Do is already running they reuse the lists it has in memory.
+ * Otherwise, the primary instance is started without any window and
+ * quits as soon as the request is done.
+ */
+
+/* Give up waiting for unresponsive sources after this many seconds */
+#define LOAD_TIMEOUT                     60
+
+typedef struct
+{
+  GApplication            *application;
+  GtdManager              *manager;
+  GApplicationCommandLine *command_line;
+
+  gchar                   *list_name;
+  gchar                   *title;
+  gchar                   *format;
+
+  /* The list the command runs on, kept loaded meanwhile */
+  GtdTaskList             *held_list;
+
+  /* Objects we wait to be ready */
+  GList                   *waiting;
+  guint                    timeout_id;
+} CommandData;
+
+static const GOptionEntry gtd_command_line_options[] = {
+  { "list",   'l', 0, G_OPTION_ARG_STRING, NULL, N_("Show the tasks of a list, or the list to add a task to"), N_("LIST") },
+  { "add",    'a', 0, G_OPTION_ARG_STRING, NULL, N_("Add a task with the given title"), N_("TITLE") },
+  { "format", 'f', 0, G_OPTION_ARG_STRING, NULL, N_("Output format: text, json, csv or ics"), N_("FORMAT") },
+  { "background", 'b', 0, G_OPTION_ARG_NONE, NULL, N_("Start in the background, without showing a window"), NULL },
+  { NULL }
+};
+
+static void          gtd_command_line__try_run                   (CommandData           *data);
+
+static void
+command_data_free (CommandData *data)
+{
+  g_application_release (data->application);
+
+  if (data->held_list)
+    {
+      gtd_manager_release_task_list (data->manager, data->held_list);
+      g_object_unref (data->held_list);
+    }
+
+  g_clear_object (&data->command_line);
+  g_free (data->list_name);
+  g_free (data->title);
+  g_free (data->format);
+  g_free (data);
+}
+
+static void
+gtd_command_line__finish (CommandData *data,
+                          gint         exit_status)
+{
+  if (data->timeout_id > 0)
+    g_source_remove (data->timeout_id);
+
+  g_application_command_line_set_exit_status (data->command_line, exit_status);
+
+  command_data_free (data);
+}
+
+static void
+gtd_command_line__task_created (GtdTask     *task,
+                                GParamSpec  *pspec,
+                                CommandData *data)
+{
+  if (!gtd_object_get_ready (GTD_OBJECT (task)))
+    return;
+
+  g_signal_handlers_disconnect_by_func (task,
+                                        gtd_command_line__task_created,
+                                        data);
+
+  g_application_command_line_print (data->command_line,
+                                    "%s\n",
+                                    gtd_object_get_uid (GTD_OBJECT (task)));
+
+  gtd_command_line__finish (data, EXIT_SUCCESS);
+}
+
+static void
+gtd_command_line__add_task (CommandData *data,
+                            GtdTaskList *list)
+{
+  GtdTask *task;
+
+  if (list == gtd_manager_get_today_list (data->manager) ||
+      list == gtd_manager_get_scheduled_list (data->manager))
+    {
+      g_application_command_line_printerr (data->command_line,
+                                           _("Tasks can't be added to “%s”\n"),
+                                           gtd_task_list_get_name (list));
+
+      gtd_command_line__finish (data, EXIT_FAILURE);
+      return;
+    }
+
+  task = gtd_task_new (NULL);
+  gtd_task_set_title (task, data->title);
+  gtd_task_set_list (task, list);
+
+  gtd_task_list_save_task (list, task);
+
+  gtd_manager_create_task (data->manager, task);
+
+  /* Wait for the backend to store it before the instance can quit */
+  g_signal_connect (task,
+                    "notify::ready",
+                    G_CALLBACK (gtd_command_line__task_created),
+                    data);
+
+  gtd_command_line__task_created (task, NULL, data);
+}
+
+static void
+gtd_command_line__print_text (CommandData *data,
+                              GtdTaskList *list)
+{
+  GString *buffer;
+  GList *tasks;
+  GList *l;
+
+  buffer = g_string_new (NULL);
+  tasks = gtd_task_list_get_tasks (list);
+
+  for (l = tasks; l != NULL; l = l->next)
+    {
+      GDateTime *due_date;
+
+      g_string_append (buffer, gtd_task_get_complete (l->data) ? "[x] " : "[ ] ");
+      g_string_append (buffer, gtd_task_get_title (l->data));
+
+      due_date = gtd_task_get_due_date (l->data);
+
+      if (due_date)
+        {
+          gchar *str;
+
+          str = g_date_time_format (due_date, "%x");
+          g_string_append_printf (buffer, " (%s)", str);
+
+          g_date_time_unref (due_date);
+          g_free (str);
+        }
+
+      g_string_append_c (buffer, '\n');
+    }
+
+  g_application_command_line_print (data->command_line, "%s", buffer->str);
+
+  g_string_free (buffer, TRUE);
+  g_list_free (tasks);
+}
+
+static gboolean
+gtd_command_line__print_export (CommandData      *data,
+                                GtdTaskList      *list,
+                                GtdExportFormat   format)
+{
+  GOutputStream *stream;
+  GtdExporter *exporter;
+  gboolean success;
+  GError *error;
+
+  error = NULL;
+  exporter = gtd_exporter_new (format);
+  stream = g_memory_output_stream_new_resizable ();
+
+  gtd_exporter_add_list (exporter, list);
+
+  success = gtd_exporter_export_sync (exporter, stream, NULL, &error);
+
+  if (success)
+    {
+      g_application_command_line_print (data->command_line,
+                                        "%.*s",
+                                        (gint) g_memory_output_stream_get_data_size (G_MEMORY_OUTPUT_STREAM (stream)),
+                                        (gchar*) g_memory_output_stream_get_data (G_MEMORY_OUTPUT_STREAM (stream)));
+    }
+  else
+    {
+      g_application_command_line_printerr (data->command_line, "%s\n", error->message);
+      g_error_free (error);
+    }
+
+  g_object_unref (exporter);
+  g_object_unref (stream);
+
+  return success;
+}
+
+static void
+gtd_command_line__run (CommandData *data)
+{
+  GtdTaskList *list;
+  gboolean success;
+
+  list = gtd_manager_find_task_list (data->manager, data->list_name);
+
+  if (!list)
+    {
+      g_application_command_line_printerr (data->command_line,
+                                           _("No task list named “%s”\n"),
+                                           data->list_name);
+
+      gtd_command_line__finish (data, EXIT_FAILURE);
+      return;
+    }
+
+  if (data->title)
+    {
+      gtd_command_line__add_task (data, list);
+      return;
+    }
+
+  if (!data->format || g_strcmp0 (data->format, "text") == 0)
+    {
+      /* Completed tasks may be frozen */
+      gtd_manager_hold_completed (data->manager, list);
+
+      gtd_command_line__print_text (data, list);
+      success = TRUE;
+
+      gtd_manager_release_completed (data->manager, list);
+    }
+  else if (g_strcmp0 (data->format, "json") == 0)
+    {
+      success = gtd_command_line__print_export (data, list, GTD_EXPORT_FORMAT_JSON_LINES);
+    }
+  else if (g_strcmp0 (data->format, "csv") == 0)
+    {
+      success = gtd_command_line__print_export (data, list, GTD_EXPORT_FORMAT_CSV);
+    }
+  else if (g_strcmp0 (data->format, "ics") == 0)
+    {
+      success = gtd_command_line__print_export (data, list, GTD_EXPORT_FORMAT_ICALENDAR);
+    }
+  else
+    {
+      g_application_command_line_printerr (data->command_line,
+                                           _("Unknown format “%s”\n"),
+                                           data->format);
+      success = FALSE;
+    }
+
+  gtd_command_line__finish (data, success ? EXIT_SUCCESS : EXIT_FAILURE);
+}
+
+static void
+gtd_command_line__ready_changed (GtdObject   *object,
+                                 GParamSpec  *pspec,
+                                 CommandData *data)
+{
+  GList *l;
+
+  if (!gtd_object_get_ready (object))
+    return;
+
+  for (l = data->waiting; l != NULL; l = l->next)
+    {
+      g_signal_handlers_disconnect_by_func (l->data,
+                                            gtd_command_line__ready_changed,
+                                            data);
+    }
+
+  g_clear_pointer (&data->waiting, g_list_free);
+
+  gtd_command_line__try_run (data);
+}
+
+static gboolean
+gtd_command_line__load_timeout (CommandData *data)
+{
+  GList *l;
+
+  data->timeout_id = 0;
+
+  for (l = data->waiting; l != NULL; l = l->next)
+    {
+      g_signal_handlers_disconnect_by_func (l->data,
+                                            gtd_command_line__ready_changed,
+                                            data);
+    }
+
+  g_clear_pointer (&data->waiting, g_list_free);
+
+  g_debug ("%s: %s",
+           G_STRFUNC,
+           "Timed out waiting for task lists to load");
+
+  gtd_command_line__run (data);
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+gtd_command_line__wait_for (CommandData *data,
+                            GtdObject   *object)
+{
+  data->waiting = g_list_prepend (data->waiting, object);
+
+  g_signal_connect (object,
+                    "notify::ready",
+                    G_CALLBACK (gtd_command_line__ready_changed),
+                    data);
+}
+
+static void
+gtd_command_line__try_run (CommandData *data)
+{
+  GList *lists;
+  GList *l;
+
+  /* First, wait for every source to be connected... */
+  if (!gtd_object_get_ready (GTD_OBJECT (data->manager)))
+    {
+      gtd_command_line__wait_for (data, GTD_OBJECT (data->manager));
+      return;
+    }
+
+  /* ... then for their tasks to be fetched */
+  lists = gtd_manager_get_task_lists (data->manager);
+
+  for (l = lists; l != NULL; l = l->next)
+    {
+      if (!gtd_object_get_ready (l->data))
+        gtd_command_line__wait_for (data, l->data);
+    }
+
+  g_list_free (lists);
+
+  if (data->waiting)
+    return;
+
+  /* ... and for the list to be reloaded, if it was evicted */
+  if (!data->held_list)
+    {
+      data->held_list = gtd_manager_find_task_list (data->manager, data->list_name);
+
+      if (data->held_list)
+        {
+          g_object_ref (data->held_list);
+          gtd_manager_hold_task_list (data->manager, data->held_list);
+
+          if (!gtd_object_get_ready (GTD_OBJECT (data->held_list)))
+            {
+              gtd_command_line__wait_for (data, GTD_OBJECT (data->held_list));
+              return;
+            }
+        }
+    }
+
+  if (data->timeout_id > 0)
+    {
+      g_source_remove (data->timeout_id);
+      data->timeout_id = 0;
+    }
+
+  gtd_command_line__run (data);
+}
+
+/**
+ * gtd_command_line_get_options:
+ *
+ * Retrieves the options that make To Do run a command instead of
+ * showing its window.
+ *
+ * Returns: (transfer none): a %NULL-terminated array of #GOptionEntry
+ */
+const GOptionEntry*
+gtd_command_line_get_options (void)
+{
+  return gtd_command_line_options;
+}
+
+/**
+ * gtd_command_line_handle:
+ * @application: the running #GApplication
+ * @manager: the #GtdManager of @application
+ * @command_line: the #GApplicationCommandLine to handle
+ *
+ * Runs the command given in @command_line against @manager, if any.
+ * The output is printed to the terminal that invoked the command,
+ * and @application is held until the command finishes.
+ *
+ * Returns: %TRUE if @command_line had a command, %FALSE if the window
+ * should be shown instead
+ */
+gboolean
+gtd_command_line_handle (GApplication            *application,
+                         GtdManager              *manager,
+                         GApplicationCommandLine *command_line)
+{
+  GVariantDict *options;
+  CommandData *data;
+
+  g_return_val_if_fail (G_IS_APPLICATION (application), FALSE);
+  g_return_val_if_fail (GTD_IS_MANAGER (manager), FALSE);
+  g_return_val_if_fail (G_IS_APPLICATION_COMMAND_LINE (command_line), FALSE);
+
+  options = g_application_command_line_get_options_dict (command_line);
+
+  if (!g_variant_dict_contains (options, "list") &&
+      !g_variant_dict_contains (options, "add"))
+    {
+      return FALSE;
+    }
+
+  data = g_new0 (CommandData, 1);
+  data->application = application;
+  data->manager = manager;
+  data->command_line = g_object_ref (command_line);
+
+  g_variant_dict_lookup (options, "list", "s", &data->list_name);
+  g_variant_dict_lookup (options, "add", "s", &data->title);
+  g_variant_dict_lookup (options, "format", "s", &data->format);
+
+  g_application_hold (application);
+
+  if (!data->list_name)
+    {
+      g_application_command_line_printerr (command_line, "%s\n", _("A task list must be given with --list"));
+      gtd_command_line__finish (data, EXIT_FAILURE);
+      return TRUE;
+    }
+
+  data->timeout_id = g_timeout_add_seconds (LOAD_TIMEOUT,
+                                            (GSourceFunc) gtd_command_line__load_timeout,
+                                            data);
+
+  gtd_command_line__try_run (data);
+
+  return TRUE;
+}
@@ -0,0 +1,380 @@
+/* gtd-date.c
+ *
+ * Copyright (C) 2015 Georges Basile Stavracas Neto <georges.stavracas@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gtd-date.h"
+
+/*
+ * Due dates come either as plain dates, or as date-times in UTC, in
+ * local (floating) time, or in a zone named by a TZID. Resolving a
+ * TZID goes through libical's zone database, so resolved zones are
+ * cached by TZID, and the code paths that only need to know the day
+ * a date falls on work on icaltimetype copies, without allocating.
+ *
+ * TZIDs libical doesn't know, like the ones Exchange and Outlook
+ * write, are defined by a VTIMEZONE of the calendar, and are looked
+ * up through the calendar's client. The client keeps the zones it
+ * fetched, so each of them is only fetched once.
+ *
+ * Days are julian day numbers, as in #GDate, with 0 meaning no date.
+ */
+
+G_LOCK_DEFINE_STATIC (zones);
+
+/* TZID → builtin icaltimezone, or NULL when it's not a builtin zone */
+static GHashTable *zones = NULL;
+
+/* TZIDs that calendars failed to resolve */
+static GHashTable *unresolved = NULL;
+
+static icaltimezone *local_zone = NULL;
+static GTimeZone *local_tz = NULL;
+
+/* Must be called with the zones lock held */
+static void
+gtd_date__ensure_local (void)
+{
+  if (local_tz)
+    return;
+
+  local_zone = e_cal_util_get_system_timezone ();
+  local_tz = g_time_zone_new_local ();
+
+  zones = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  unresolved = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+}
+
+static icaltimezone*
+gtd_date__get_local_zone (void)
+{
+  G_LOCK (zones);
+  gtd_date__ensure_local ();
+  G_UNLOCK (zones);
+
+  return local_zone;
+}
+
+static GTimeZone*
+gtd_date__get_local_tz (void)
+{
+  G_LOCK (zones);
+  gtd_date__ensure_local ();
+  G_UNLOCK (zones);
+
+  return local_tz;
+}
+
+/*
+ * Resolves @tzid through the VTIMEZONEs of the calendar of @client.
+ * The zone belongs to @client.
+ */
+static icaltimezone*
+gtd_date__get_calendar_zone (ECalClient  *client,
+                             const gchar *tzid)
+{
+  icaltimezone *zone;
+  GError *error = NULL;
+  gboolean failed;
+
+  zone = e_timezone_cache_get_timezone (E_TIMEZONE_CACHE (client), tzid);
+
+  if (zone)
+    return zone;
+
+  G_LOCK (zones);
+  failed = g_hash_table_contains (unresolved, tzid);
+  G_UNLOCK (zones);
+
+  if (failed)
+    return NULL;
+
+  /* Only happens once per zone, the client keeps it afterwards */
+  if (!e_cal_client_get_timezone_sync (client, tzid, &zone, NULL, &error))
+    {
+      g_debug ("%s: unknown timezone %s, using local time: %s", G_STRFUNC, tzid, error->message);
+
+      G_LOCK (zones);
+      g_hash_table_add (unresolved, g_strdup (tzid));
+      G_UNLOCK (zones);
+
+      g_clear_error (&error);
+
+      return NULL;
+    }
+
+  return zone;
+}
+
+/*
+ * Returns the zone @itt is in, or %NULL if it's a date or floating
+ * time, which are both in local time already.
+ */
+static icaltimezone*
+gtd_date__get_zone (const icaltimetype *itt,
+                    const gchar        *tzid,
+                    ECalClient         *client)
+{
+  icaltimezone *zone;
+  gpointer value;
+
+  if (itt->is_date)
+    return NULL;
+
+  if (itt->is_utc || g_strcmp0 (tzid, "UTC") == 0)
+    return icaltimezone_get_utc_timezone ();
+
+  if (!tzid)
+    return NULL;
+
+  G_LOCK (zones);
+
+  gtd_date__ensure_local ();
+
+  if (!g_hash_table_lookup_extended (zones, tzid, NULL, &value))
+    {
+      value = icaltimezone_get_builtin_timezone_from_tzid (tzid);
+
+      if (!value)
+        value = icaltimezone_get_builtin_timezone (tzid);
+
+      if (!value)
+        g_debug ("%s: timezone %s is not a builtin one", G_STRFUNC, tzid);
+
+      g_hash_table_insert (zones, g_strdup (tzid), value);
+    }
+
+  G_UNLOCK (zones);
+
+  zone = value;
+
+  /* Otherwise, it may be defined by the calendar */
+  if (!zone && client)
+    zone = gtd_date__get_calendar_zone (client, tzid);
+
+  return zone;
+}
+
+/* Converts @itt in place to local time */
+static void
+gtd_date__to_local (icaltimetype *itt,
+                    const gchar  *tzid,
+                    ECalClient   *client)
+{
+  icaltimezone *zone;
+
+  zone = gtd_date__get_zone (itt, tzid, client);
+
+  if (!zone)
+    return;
+
+  icaltimezone_convert_time (itt, zone, gtd_date__get_local_zone ());
+}
+
+static guint32
+gtd_date__get_julian (gint year,
+                      gint month,
+                      gint day)
+{
+  GDate date;
+
+  if (!g_date_valid_dmy (day, month, year))
+    return 0;
+
+  g_date_clear (&date, 1);
+  g_date_set_dmy (&date, day, month, year);
+
+  return g_date_get_julian (&date);
+}
+
+/**
+ * gtd_date_get_today:
+ *
+ * Retrieves the day number of today, in local time.
+ *
+ * Returns: the day number of today
+ */
+guint32
+gtd_date_get_today (void)
+{
+  GDateTime *now;
+  guint32 today;
+
+  now = g_date_time_new_now_local ();
+  today = gtd_date_get_day_from_date_time (now);
+
+  g_date_time_unref (now);
+
+  return today;
+}
+
+/**
+ * gtd_date_get_day:
+ * @itt: an #icaltimetype
+ * @tzid: (nullable): the TZID parameter of @itt
+ * @client: (nullable): the client of the calendar @itt comes from, to
+ * resolve TZIDs defined by the calendar
+ *
+ * Retrieves the day number of the local day @itt falls on.
+ *
+ * Returns: the day number of @itt, or 0 if @itt is not a valid date
+ */
+guint32
+gtd_date_get_day (const icaltimetype *itt,
+                  const gchar        *tzid,
+                  ECalClient         *client)
+{
+  icaltimetype local;
+
+  if (!itt || icaltime_is_null_time (*itt))
+    return 0;
+
+  local = *itt;
+
+  gtd_date__to_local (&local, tzid, client);
+
+  return gtd_date__get_julian (local.year, local.month, local.day);
+}
+
+/**
+ * gtd_date_get_day_from_date_time:
+ * @dt: a #GDateTime
+ *
+ * Retrieves the day number of the day @dt falls on, in the
+ * timezone of @dt.
+ *
+ * Returns: the day number of @dt
+ */
+guint32
+gtd_date_get_day_from_date_time (GDateTime *dt)
+{
+  gint year, month, day;
+
+  g_return_val_if_fail (dt, 0);
+
+  g_date_time_get_ymd (dt, &year, &month, &day);
+
+  return gtd_date__get_julian (year, month, day);
+}
+
+/**
+ * gtd_date_get_time:
+ * @itt: an #icaltimetype
+ * @tzid: (nullable): the TZID parameter of @itt
+ * @client: (nullable): the client of the calendar @itt comes from
+ *
+ * Retrieves the UNIX time of @itt. Dates and floating times are
+ * taken as local time, dates at midnight.
+ *
+ * Returns: the UNIX time of @itt, or 0 if @itt is not a valid date
+ */
+gint64
+gtd_date_get_time (const icaltimetype *itt,
+                   const gchar        *tzid,
+                   ECalClient         *client)
+{
+  icaltimezone *zone;
+
+  if (!itt || icaltime_is_null_time (*itt))
+    return 0;
+
+  zone = gtd_date__get_zone (itt, tzid, client);
+
+  if (!zone)
+    zone = gtd_date__get_local_zone ();
+
+  return icaltime_as_timet_with_zone (*itt, zone);
+}
+
+/**
+ * gtd_date_to_date_time:
+ * @itt: (nullable): an #icaltimetype
+ * @tzid: (nullable): the TZID parameter of @itt
+ * @client: (nullable): the client of the calendar @itt comes from
+ *
+ * Converts @itt to a #GDateTime in local time. Dates become
+ * local midnight of the same day.
+ *
+ * Returns: (transfer full) (nullable): a #GDateTime, or %NULL if
+ * @itt is not a valid date
+ */
+GDateTime*
+gtd_date_to_date_time (const icaltimetype *itt,
+                       const gchar        *tzid,
+                       ECalClient         *client)
+{
+  icaltimetype local;
+
+  if (!itt || icaltime_is_null_time (*itt))
+    return NULL;
+
+  local = *itt;
+
+  gtd_date__to_local (&local, tzid, client);
+
+  if (!g_date_valid_dmy (local.day, local.month, local.year))
+    return NULL;
+
+  return g_date_time_new (gtd_date__get_local_tz (),
+                          local.year,
+                          local.month,
+                          local.day,
+                          local.is_date ? 0 : local.hour,
+                          local.is_date ? 0 : local.minute,
+                          local.is_date ? 0 : local.second);
+}
+
+/**
+ * gtd_date_from_date_time:
+ * @dt: a #GDateTime
+ * @is_date: whether only the day of @dt matters
+ * @itt: (out): return location for the converted time
+ *
+ * Converts @dt to an #icaltimetype. If @is_date is %TRUE, @dt
+ * becomes a plain date of the same day, in the timezone of @dt;
+ * otherwise, it becomes a date-time in UTC, even at midnight.
+ *
+ * Returns:
+ */
+void
+gtd_date_from_date_time (GDateTime    *dt,
+                         gboolean      is_date,
+                         icaltimetype *itt)
+{
+  GDateTime *utc;
+
+  g_return_if_fail (dt);
+  g_return_if_fail (itt);
+
+  *itt = icaltime_null_time ();
+
+  if (is_date)
+    {
+      g_date_time_get_ymd (dt, &itt->year, &itt->month, &itt->day);
+      itt->is_date = 1;
+      return;
+    }
+
+  utc = g_date_time_to_utc (dt);
+
+  g_date_time_get_ymd (utc, &itt->year, &itt->month, &itt->day);
+  itt->hour = g_date_time_get_hour (utc);
+  itt->minute = g_date_time_get_minute (utc);
+  itt->second = g_date_time_get_second (utc);
+  itt->is_utc = 1;
+
+  g_date_time_unref (utc);
+}
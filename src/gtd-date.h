@@ -0,0 +1,49 @@
+/* gtd-date.h
+ *
+ * Copyright (C) 2015 Georges Basile Stavracas Neto <georges.stavracas@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef GTD_DATE_H
+#define GTD_DATE_H
+
+#include <glib.h>
+#include <libecal/libecal.h>
+
+G_BEGIN_DECLS
+
+guint32                 gtd_date_get_today                      (void);
+
+guint32                 gtd_date_get_day                        (const icaltimetype     *itt,
+                                                                 const gchar            *tzid,
+                                                                 ECalClient             *client);
+
+guint32                 gtd_date_get_day_from_date_time         (GDateTime              *dt);
+
+gint64                  gtd_date_get_time                       (const icaltimetype     *itt,
+                                                                 const gchar            *tzid,
+                                                                 ECalClient             *client);
+
+GDateTime*              gtd_date_to_date_time                   (const icaltimetype     *itt,
+                                                                 const gchar            *tzid,
+                                                                 ECalClient             *client);
+
+void                    gtd_date_from_date_time                 (GDateTime              *dt,
+                                                                 gboolean                is_date,
+                                                                 icaltimetype           *itt);
+
+G_END_DECLS
+
+#endif /* GTD_DATE_H */
@@ -0,0 +1,872 @@
+/* gtd-dbus-service.c
+ *
+ * Copyright (C) 2015 Georges Basile Stavracas Neto <georges.stavracas@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gtd-application.h"
+#include "gtd-dbus-service.h"
+#include "gtd-manager.h"
+#include "gtd-task.h"
+#include "gtd-task-list.h"
+
+#include <glib/gi18n.h>
+
+/*
+ * The org.gnome.Todo.Tasks interface is served from the in-memory
+ * model of GtdManager, so external tools see the same lists the
+ * window does, and their changes go through the same write paths.
+ *
+ * Tasks are sent over the bus as (ssssbix) tuples:
+ *
+ *   uid, list name, title, description, complete, priority, due date
+ *
+ * where the due date is a UNIX timestamp, or 0 when unset. Query
+ * results are streamed to the caller as QueryResults signals, each
+ * carrying at most the requested number of tasks.
+ */
+
+#define TASKS_INTERFACE                  "org.gnome.Todo.Tasks"
+#define DEFAULT_BATCH_SIZE               200
+
+static const gchar introspection_xml[] =
+  "<node>"
+  "  <interface name='org.gnome.Todo.Tasks'>"
+  "    <method name='CreateTasks'>"
+  "      <arg type='s' name='list' direction='in'/>"
+  "      <arg type='a(ssix)' name='tasks' direction='in'/>"
+  "      <arg type='as' name='uids' direction='out'/>"
+  "    </method>"
+  "    <method name='UpdateTasks'>"
+  "      <arg type='a(sa{sv})' name='changes' direction='in'/>"
+  "      <arg type='u' name='n_updated' direction='out'/>"
+  "    </method>"
+  "    <method name='CompleteTasks'>"
+  "      <arg type='as' name='uids' direction='in'/>"
+  "      <arg type='b' name='complete' direction='in'/>"
+  "      <arg type='u' name='n_updated' direction='out'/>"
+  "    </method>"
+  "    <method name='DeleteTasks'>"
+  "      <arg type='as' name='uids' direction='in'/>"
+  "      <arg type='u' name='n_deleted' direction='out'/>"
+  "    </method>"
+  "    <method name='Query'>"
+  "      <arg type='s' name='list' direction='in'/>"
+  "      <arg type='s' name='search' direction='in'/>"
+  "      <arg type='u' name='batch_size' direction='in'/>"
+  "      <arg type='t' name='query_id' direction='out'/>"
+  "      <arg type='u' name='n_results' direction='out'/>"
+  "    </method>"
+  "    <signal name='QueryResults'>"
+  "      <arg type='t' name='query_id'/>"
+  "      <arg type='a(ssssbix)' name='tasks'/>"
+  "      <arg type='b' name='done'/>"
+  "    </signal>"
+  "  </interface>"
+  "</node>";
+
+typedef struct
+{
+  GtdApplication       *application;
+
+  GDBusConnection      *connection;
+  gchar                *object_path;
+  guint                 registration_id;
+
+  /* Queries still streaming results */
+  GList                *queries;
+  guint64               next_query_id;
+} GtdDBusServicePrivate;
+
+struct _GtdDBusService
+{
+  GObject                parent;
+
+  /*<private>*/
+  GtdDBusServicePrivate *priv;
+};
+
+typedef struct
+{
+  GtdDBusService        *service;
+  GDBusMethodInvocation *invocation;
+  GPtrArray             *tasks;
+  guint                  pending;
+} CreateData;
+
+typedef struct
+{
+  GtdDBusService        *service;
+  gchar                 *sender;
+  guint64                query_id;
+  GPtrArray             *tasks;
+  guint                  position;
+  guint                  batch_size;
+  guint                  idle_id;
+} QueryData;
+
+typedef struct
+{
+  GtdDBusService        *service;
+  GDBusMethodInvocation *invocation;
+  GList                 *lists;
+  guint                  pending;
+} PendingCall;
+
+G_DEFINE_TYPE_WITH_PRIVATE (GtdDBusService, gtd_dbus_service, G_TYPE_OBJECT)
+
+static GDBusNodeInfo *introspection_data = NULL;
+
+static void
+query_data_free (QueryData *data)
+{
+  if (data->idle_id > 0)
+    g_source_remove (data->idle_id);
+
+  g_ptr_array_unref (data->tasks);
+  g_free (data->sender);
+  g_free (data);
+}
+
+static GVariant*
+gtd_dbus_service__serialize_task (GtdTask *task)
+{
+  GDateTime *due_date;
+  GtdTaskList *list;
+  GVariant *variant;
+  gint64 due;
+
+  list = gtd_task_get_list (task);
+  due_date = gtd_task_get_due_date (task);
+  due = due_date ? g_date_time_to_unix (due_date) : 0;
+
+  variant = g_variant_new ("(ssssbix)",
+                           gtd_object_get_uid (GTD_OBJECT (task)),
+                           list ? gtd_task_list_get_name (list) : "",
+                           gtd_task_get_title (task) ? gtd_task_get_title (task) : "",
+                           gtd_task_get_description (task) ? gtd_task_get_description (task) : "",
+                           gtd_task_get_complete (task),
+                           gtd_task_get_priority (task),
+                           due);
+
+  g_clear_pointer (&due_date, g_date_time_unref);
+
+  return variant;
+}
+
+static GDateTime*
+gtd_dbus_service__parse_due_date (gint64 due)
+{
+  return due > 0 ? g_date_time_new_from_unix_local (due) : NULL;
+}
+
+/*
+ * Indexes every loaded task by UID, so a batch of N changes costs
+ * a single pass over the model instead of N.
+ */
+static GHashTable*
+gtd_dbus_service__index_tasks (GtdManager *manager)
+{
+  GHashTable *index;
+  GList *lists;
+  GList *l;
+
+  index = g_hash_table_new (g_str_hash, g_str_equal);
+  lists = gtd_manager_get_task_lists (manager);
+
+  for (l = lists; l != NULL; l = l->next)
+    {
+      GList *tasks;
+      GList *t;
+
+      tasks = gtd_task_list_get_tasks (l->data);
+
+      for (t = tasks; t != NULL; t = t->next)
+        g_hash_table_insert (index, (gpointer) gtd_object_get_uid (t->data), t->data);
+
+      g_list_free (tasks);
+    }
+
+  g_list_free (lists);
+
+  return index;
+}
+
+static gboolean
+gtd_dbus_service__task_matches (GtdTask     *task,
+                                const gchar *search)
+{
+  gboolean matches;
+  gchar *haystack;
+
+  if (!search || *search == '\0')
+    return TRUE;
+
+  haystack = g_utf8_casefold (gtd_task_get_title (task) ? gtd_task_get_title (task) : "", -1);
+  matches = g_strstr_len (haystack, -1, search) != NULL;
+  g_free (haystack);
+
+  if (!matches && gtd_task_get_description (task))
+    {
+      haystack = g_utf8_casefold (gtd_task_get_description (task), -1);
+      matches = g_strstr_len (haystack, -1, search) != NULL;
+      g_free (haystack);
+    }
+
+  return matches;
+}
+
+static void
+gtd_dbus_service__create_finish (CreateData *data)
+{
+  GVariantBuilder builder;
+  guint i;
+
+  g_variant_builder_init (&builder, G_VARIANT_TYPE ("as"));
+
+  /* UIDs are read now, since the backend may have changed them */
+  for (i = 0; i < data->tasks->len; i++)
+    g_variant_builder_add (&builder, "s", gtd_object_get_uid (g_ptr_array_index (data->tasks, i)));
+
+  g_dbus_method_invocation_return_value (data->invocation, g_variant_new ("(as)", &builder));
+
+  g_application_release (G_APPLICATION (data->service->priv->application));
+
+  g_ptr_array_unref (data->tasks);
+  g_free (data);
+}
+
+static void
+gtd_dbus_service__task_created (GtdTask    *task,
+                                GParamSpec *pspec,
+                                CreateData *data)
+{
+  if (!gtd_object_get_ready (GTD_OBJECT (task)))
+    return;
+
+  g_signal_handlers_disconnect_by_func (task,
+                                        gtd_dbus_service__task_created,
+                                        data);
+
+  if (--data->pending == 0)
+    gtd_dbus_service__create_finish (data);
+}
+
+static void
+gtd_dbus_service__create_tasks (GtdDBusService        *service,
+                                GtdManager            *manager,
+                                GVariant              *parameters,
+                                GDBusMethodInvocation *invocation)
+{
+  const gchar *list_name;
+  const gchar *description;
+  const gchar *title;
+  GVariantIter *iter;
+  GtdTaskList *list;
+  CreateData *data;
+  gint64 due;
+  gint priority;
+  guint i;
+
+  g_variant_get (parameters, "(&sa(ssix))", &list_name, &iter);
+
+  list = gtd_manager_find_task_list (manager, list_name);
+
+  if (!list ||
+      list == gtd_manager_get_today_list (manager) ||
+      list == gtd_manager_get_scheduled_list (manager))
+    {
+      g_dbus_method_invocation_return_error (invocation,
+                                             G_DBUS_ERROR,
+                                             G_DBUS_ERROR_INVALID_ARGS,
+                                             _("Tasks can't be added to “%s”"),
+                                             list_name);
+      g_variant_iter_free (iter);
+      return;
+    }
+
+  data = g_new0 (CreateData, 1);
+  data->service = service;
+  data->invocation = invocation;
+  data->tasks = g_ptr_array_new_with_free_func (g_object_unref);
+
+  while (g_variant_iter_next (iter, "(&s&six)", &title, &description, &priority, &due))
+    {
+      GDateTime *due_date;
+      GtdTask *task;
+
+      task = gtd_task_new (NULL);
+
+      gtd_task_begin_changes (task);
+
+      gtd_task_set_title (task, title);
+      gtd_task_set_priority (task, priority);
+
+      if (*description != '\0')
+        gtd_task_set_description (task, description);
+
+      due_date = gtd_dbus_service__parse_due_date (due);
+
+      if (due_date)
+        {
+          gtd_task_set_due_date (task, due_date);
+          g_date_time_unref (due_date);
+        }
+
+      gtd_task_set_list (task, list);
+
+      gtd_task_commit_changes (task);
+
+      gtd_task_list_save_task (list, task);
+
+      g_ptr_array_add (data->tasks, g_object_ref (task));
+    }
+
+  g_variant_iter_free (iter);
+
+  /* Reply once the backend stored every task */
+  g_application_hold (G_APPLICATION (service->priv->application));
+
+  data->pending = data->tasks->len + 1;
+
+  for (i = 0; i < data->tasks->len; i++)
+    {
+      GtdTask *task = g_ptr_array_index (data->tasks, i);
+
+      g_signal_connect (task,
+                        "notify::ready",
+                        G_CALLBACK (gtd_dbus_service__task_created),
+                        data);
+
+      gtd_manager_create_task (manager, task);
+      gtd_dbus_service__task_created (task, NULL, data);
+    }
+
+  if (--data->pending == 0)
+    gtd_dbus_service__create_finish (data);
+}
+
+static void
+gtd_dbus_service__update_tasks (GtdDBusService        *service,
+                                GtdManager            *manager,
+                                GVariant              *parameters,
+                                GDBusMethodInvocation *invocation)
+{
+  GHashTable *index;
+  GVariantIter *iter;
+  GVariantIter *changes;
+  const gchar *uid;
+  guint n_updated;
+
+  index = gtd_dbus_service__index_tasks (manager);
+  n_updated = 0;
+
+  g_variant_get (parameters, "(a(sa{sv}))", &iter);
+
+  while (g_variant_iter_next (iter, "(&sa{sv})", &uid, &changes))
+    {
+      const gchar *key;
+      GVariant *value;
+      GtdTask *task;
+
+      task = g_hash_table_lookup (index, uid);
+
+      if (!task)
+        {
+          g_variant_iter_free (changes);
+          continue;
+        }
+
+      /* Report every change of the task at once */
+      gtd_task_begin_changes (task);
+
+      while (g_variant_iter_next (changes, "{&sv}", &key, &value))
+        {
+          if (g_strcmp0 (key, "title") == 0 && g_variant_is_of_type (value, G_VARIANT_TYPE_STRING))
+            {
+              gtd_task_set_title (task, g_variant_get_string (value, NULL));
+            }
+          else if (g_strcmp0 (key, "description") == 0 && g_variant_is_of_type (value, G_VARIANT_TYPE_STRING))
+            {
+              gtd_task_set_description (task, g_variant_get_string (value, NULL));
+            }
+          else if (g_strcmp0 (key, "priority") == 0 && g_variant_is_of_type (value, G_VARIANT_TYPE_INT32))
+            {
+              gtd_task_set_priority (task, g_variant_get_int32 (value));
+            }
+          else if (g_strcmp0 (key, "complete") == 0 && g_variant_is_of_type (value, G_VARIANT_TYPE_BOOLEAN))
+            {
+              gtd_task_set_complete (task, g_variant_get_boolean (value));
+            }
+          else if (g_strcmp0 (key, "due-date") == 0 && g_variant_is_of_type (value, G_VARIANT_TYPE_INT64))
+            {
+              GDateTime *due_date;
+
+              due_date = gtd_dbus_service__parse_due_date (g_variant_get_int64 (value));
+              gtd_task_set_due_date (task, due_date);
+              g_clear_pointer (&due_date, g_date_time_unref);
+            }
+
+          g_variant_unref (value);
+        }
+
+      gtd_task_commit_changes (task);
+
+      g_variant_iter_free (changes);
+
+      gtd_manager_update_task (manager, task);
+      n_updated++;
+    }
+
+  g_variant_iter_free (iter);
+  g_hash_table_destroy (index);
+
+  g_dbus_method_invocation_return_value (invocation, g_variant_new ("(u)", n_updated));
+}
+
+static void
+gtd_dbus_service__complete_tasks (GtdDBusService        *service,
+                                  GtdManager            *manager,
+                                  GVariant              *parameters,
+                                  GDBusMethodInvocation *invocation)
+{
+  GHashTable *index;
+  GVariantIter *iter;
+  const gchar *uid;
+  gboolean complete;
+  guint n_updated;
+
+  index = gtd_dbus_service__index_tasks (manager);
+  n_updated = 0;
+
+  g_variant_get (parameters, "(asb)", &iter, &complete);
+
+  while (g_variant_iter_next (iter, "&s", &uid))
+    {
+      GtdTask *task;
+
+      task = g_hash_table_lookup (index, uid);
+
+      if (!task || gtd_task_get_complete (task) == complete)
+        continue;
+
+      gtd_task_set_complete (task, complete);
+      gtd_manager_update_task (manager, task);
+      n_updated++;
+    }
+
+  g_variant_iter_free (iter);
+  g_hash_table_destroy (index);
+
+  g_dbus_method_invocation_return_value (invocation, g_variant_new ("(u)", n_updated));
+}
+
+static void
+gtd_dbus_service__delete_tasks (GtdDBusService        *service,
+                                GtdManager            *manager,
+                                GVariant              *parameters,
+                                GDBusMethodInvocation *invocation)
+{
+  GHashTable *index;
+  GVariantIter *iter;
+  const gchar *uid;
+  GList *tasks;
+  guint n_deleted;
+
+  index = gtd_dbus_service__index_tasks (manager);
+  tasks = NULL;
+  n_deleted = 0;
+
+  g_variant_get (parameters, "(as)", &iter);
+
+  while (g_variant_iter_next (iter, "&s", &uid))
+    {
+      GtdTask *task;
+
+      task = g_hash_table_lookup (index, uid);
+
+      if (!task)
+        continue;
+
+      /* Don't look it up again if the UID is repeated */
+      g_hash_table_remove (index, uid);
+
+      gtd_task_list_remove_task (gtd_task_get_list (task), task);
+
+      tasks = g_list_prepend (tasks, task);
+      n_deleted++;
+    }
+
+  /* A single request for each source */
+  gtd_manager_remove_tasks (manager, tasks);
+
+  g_list_free (tasks);
+  g_variant_iter_free (iter);
+  g_hash_table_destroy (index);
+
+  g_dbus_method_invocation_return_value (invocation, g_variant_new ("(u)", n_deleted));
+}
+
+static gboolean
+gtd_dbus_service__send_query_results (QueryData *data)
+{
+  GtdDBusServicePrivate *priv = data->service->priv;
+  GVariantBuilder builder;
+  gboolean done;
+  guint end;
+
+  end = MIN (data->position + data->batch_size, data->tasks->len);
+
+  g_variant_builder_init (&builder, G_VARIANT_TYPE ("a(ssssbix)"));
+
+  for (; data->position < end; data->position++)
+    {
+      g_variant_builder_add_value (&builder,
+                                   gtd_dbus_service__serialize_task (g_ptr_array_index (data->tasks, data->position)));
+    }
+
+  done = data->position >= data->tasks->len;
+
+  /* Results only go to the caller */
+  g_dbus_connection_emit_signal (priv->connection,
+                                 data->sender,
+                                 priv->object_path,
+                                 TASKS_INTERFACE,
+                                 "QueryResults",
+                                 g_variant_new ("(ta(ssssbix)b)", data->query_id, &builder, done),
+                                 NULL);
+
+  if (!done)
+    return G_SOURCE_CONTINUE;
+
+  data->idle_id = 0;
+  priv->queries = g_list_remove (priv->queries, data);
+  query_data_free (data);
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+gtd_dbus_service__query (GtdDBusService        *service,
+                         GtdManager            *manager,
+                         GVariant              *parameters,
+                         GDBusMethodInvocation *invocation)
+{
+  GtdDBusServicePrivate *priv = service->priv;
+  const gchar *list_name;
+  const gchar *search;
+  QueryData *data;
+  GList *lists;
+  GList *l;
+  gchar *folded_search;
+  guint batch_size;
+
+  g_variant_get (parameters, "(&s&su)", &list_name, &search, &batch_size);
+
+  /* An empty list name queries every list */
+  if (*list_name != '\0')
+    {
+      GtdTaskList *list;
+
+      list = gtd_manager_find_task_list (manager, list_name);
+
+      if (!list)
+        {
+          g_dbus_method_invocation_return_error (invocation,
+                                                 G_DBUS_ERROR,
+                                                 G_DBUS_ERROR_INVALID_ARGS,
+                                                 _("No task list named “%s”"),
+                                                 list_name);
+          return;
+        }
+
+      lists = g_list_prepend (NULL, list);
+    }
+  else
+    {
+      lists = gtd_manager_get_task_lists (manager);
+    }
+
+  data = g_new0 (QueryData, 1);
+  data->service = service;
+  data->sender = g_strdup (g_dbus_method_invocation_get_sender (invocation));
+  data->query_id = ++priv->next_query_id;
+  data->batch_size = batch_size > 0 ? batch_size : DEFAULT_BATCH_SIZE;
+  data->tasks = g_ptr_array_new_with_free_func (g_object_unref);
+
+  folded_search = g_utf8_casefold (search, -1);
+
+  /* The matches are collected now, and serialized as they are sent */
+  for (l = lists; l != NULL; l = l->next)
+    {
+      GList *tasks;
+      GList *t;
+
+      tasks = gtd_task_list_get_tasks (l->data);
+
+      for (t = tasks; t != NULL; t = t->next)
+        {
+          if (gtd_dbus_service__task_matches (t->data, folded_search))
+            g_ptr_array_add (data->tasks, g_object_ref (t->data));
+        }
+
+      g_list_free (tasks);
+    }
+
+  g_list_free (lists);
+  g_free (folded_search);
+
+  g_dbus_method_invocation_return_value (invocation,
+                                         g_variant_new ("(tu)", data->query_id, data->tasks->len));
+
+  priv->queries = g_list_prepend (priv->queries, data);
+  data->idle_id = g_idle_add ((GSourceFunc) gtd_dbus_service__send_query_results, data);
+}
+
+static void
+gtd_dbus_service__dispatch (PendingCall *call)
+{
+  GDBusMethodInvocation *invocation;
+  GtdDBusService *service;
+  const gchar *method_name;
+  GtdManager *manager;
+  GVariant *parameters;
+  GList *l;
+
+  service = call->service;
+  invocation = call->invocation;
+  manager = gtd_application_get_manager (service->priv->application);
+  method_name = g_dbus_method_invocation_get_method_name (invocation);
+  parameters = g_dbus_method_invocation_get_parameters (invocation);
+
+  /* Calls may look at completed tasks, which may be frozen */
+  gtd_manager_hold_completed (manager, NULL);
+
+  if (g_strcmp0 (method_name, "CreateTasks") == 0)
+    gtd_dbus_service__create_tasks (service, manager, parameters, invocation);
+  else if (g_strcmp0 (method_name, "UpdateTasks") == 0)
+    gtd_dbus_service__update_tasks (service, manager, parameters, invocation);
+  else if (g_strcmp0 (method_name, "CompleteTasks") == 0)
+    gtd_dbus_service__complete_tasks (service, manager, parameters, invocation);
+  else if (g_strcmp0 (method_name, "DeleteTasks") == 0)
+    gtd_dbus_service__delete_tasks (service, manager, parameters, invocation);
+  else if (g_strcmp0 (method_name, "Query") == 0)
+    gtd_dbus_service__query (service, manager, parameters, invocation);
+  else
+    g_assert_not_reached ();
+
+  gtd_manager_release_completed (manager, NULL);
+
+  for (l = call->lists; l != NULL; l = l->next)
+    gtd_manager_release_task_list (manager, l->data);
+
+  g_application_release (G_APPLICATION (service->priv->application));
+
+  g_list_free_full (call->lists, g_object_unref);
+  g_free (call);
+}
+
+static void
+gtd_dbus_service__list_ready (GtdTaskList *list,
+                              GParamSpec  *pspec,
+                              PendingCall *call)
+{
+  if (!gtd_object_get_ready (GTD_OBJECT (list)))
+    return;
+
+  g_signal_handlers_disconnect_by_func (list,
+                                        gtd_dbus_service__list_ready,
+                                        call);
+
+  if (--call->pending == 0)
+    gtd_dbus_service__dispatch (call);
+}
+
+static void
+gtd_dbus_service__method_call (GDBusConnection       *connection,
+                               const gchar           *sender,
+                               const gchar           *object_path,
+                               const gchar           *interface_name,
+                               const gchar           *method_name,
+                               GVariant              *parameters,
+                               GDBusMethodInvocation *invocation,
+                               gpointer               user_data)
+{
+  GtdDBusService *service;
+  PendingCall *call;
+  GtdManager *manager;
+  GList *l;
+
+  service = GTD_DBUS_SERVICE (user_data);
+  manager = gtd_application_get_manager (service->priv->application);
+
+  g_debug ("%s: %s: %s",
+           G_STRFUNC,
+           "Handling D-Bus call",
+           method_name);
+
+  g_application_hold (G_APPLICATION (service->priv->application));
+
+  call = g_new0 (PendingCall, 1);
+  call->service = service;
+  call->invocation = invocation;
+  call->lists = gtd_manager_get_task_lists (manager);
+
+  /* Evicted lists are reloaded before the call runs */
+  for (l = call->lists; l != NULL; l = l->next)
+    {
+      g_object_ref (l->data);
+      gtd_manager_hold_task_list (manager, l->data);
+
+      if (gtd_object_get_ready (l->data))
+        continue;
+
+      call->pending++;
+
+      g_signal_connect (l->data,
+                        "notify::ready",
+                        G_CALLBACK (gtd_dbus_service__list_ready),
+                        call);
+    }
+
+  if (call->pending == 0)
+    gtd_dbus_service__dispatch (call);
+}
+
+static const GDBusInterfaceVTable interface_vtable = {
+  gtd_dbus_service__method_call,
+  NULL,
+  NULL
+};
+
+static void
+gtd_dbus_service_finalize (GObject *object)
+{
+  GtdDBusService *self = (GtdDBusService *)object;
+
+  gtd_dbus_service_unregister (self);
+
+  G_OBJECT_CLASS (gtd_dbus_service_parent_class)->finalize (object);
+}
+
+static void
+gtd_dbus_service_class_init (GtdDBusServiceClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->finalize = gtd_dbus_service_finalize;
+
+  introspection_data = g_dbus_node_info_new_for_xml (introspection_xml, NULL);
+  g_assert (introspection_data != NULL);
+}
+
+static void
+gtd_dbus_service_init (GtdDBusService *self)
+{
+  self->priv = gtd_dbus_service_get_instance_private (self);
+}
+
+/**
+ * gtd_dbus_service_new:
+ * @application: the #GtdApplication whose tasks are served
+ *
+ * Creates a new #GtdDBusService.
+ *
+ * Returns: (transfer full): a new #GtdDBusService
+ */
+GtdDBusService*
+gtd_dbus_service_new (GtdApplication *application)
+{
+  GtdDBusService *self;
+
+  g_return_val_if_fail (GTD_IS_APPLICATION (application), NULL);
+
+  self = g_object_new (GTD_TYPE_DBUS_SERVICE, NULL);
+  self->priv->application = application;
+
+  return self;
+}
+
+/**
+ * gtd_dbus_service_register:
+ * @service: a #GtdDBusService
+ * @connection: the #GDBusConnection to export the interface on
+ * @object_path: the object path to export the interface at
+ * @error: (nullable): return location for a #GError, or %NULL
+ *
+ * Exports the org.gnome.Todo.Tasks interface of @service.
+ *
+ * Returns: %TRUE if the interface was exported, %FALSE otherwise
+ */
+gboolean
+gtd_dbus_service_register (GtdDBusService   *service,
+                           GDBusConnection  *connection,
+                           const gchar      *object_path,
+                           GError          **error)
+{
+  GtdDBusServicePrivate *priv;
+
+  g_return_val_if_fail (GTD_IS_DBUS_SERVICE (service), FALSE);
+  g_return_val_if_fail (G_IS_DBUS_CONNECTION (connection), FALSE);
+  g_return_val_if_fail (service->priv->registration_id == 0, FALSE);
+
+  priv = service->priv;
+  priv->registration_id = g_dbus_connection_register_object (connection,
+                                                             object_path,
+                                                             introspection_data->interfaces[0],
+                                                             &interface_vtable,
+                                                             service,
+                                                             NULL,
+                                                             error);
+
+  if (priv->registration_id == 0)
+    return FALSE;
+
+  priv->connection = g_object_ref (connection);
+  priv->object_path = g_strdup (object_path);
+
+  return TRUE;
+}
+
+/**
+ * gtd_dbus_service_unregister:
+ * @service: a #GtdDBusService
+ *
+ * Stops exporting the interface of @service, and stops streaming
+ * the results of pending queries.
+ *
+ * Returns:
+ */
+void
+gtd_dbus_service_unregister (GtdDBusService *service)
+{
+  GtdDBusServicePrivate *priv;
+
+  g_return_if_fail (GTD_IS_DBUS_SERVICE (service));
+
+  priv = service->priv;
+
+  g_list_free_full (priv->queries, (GDestroyNotify) query_data_free);
+  priv->queries = NULL;
+
+  if (priv->registration_id > 0)
+    {
+      g_dbus_connection_unregister_object (priv->connection, priv->registration_id);
+      priv->registration_id = 0;
+    }
+
+  g_clear_object (&priv->connection);
+  g_clear_pointer (&priv->object_path, g_free);
+}
@@ -0,0 +1,43 @@
+/* gtd-dbus-service.h
+ *
+ * Copyright (C) 2015 Georges Basile Stavracas Neto <georges.stavracas@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef GTD_DBUS_SERVICE_H
+#define GTD_DBUS_SERVICE_H
+
+#include "gtd-types.h"
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+#define GTD_TYPE_DBUS_SERVICE (gtd_dbus_service_get_type())
+
+G_DECLARE_FINAL_TYPE (GtdDBusService, gtd_dbus_service, GTD, DBUS_SERVICE, GObject)
+
+GtdDBusService*         gtd_dbus_service_new                    (GtdApplication         *application);
+
+gboolean                gtd_dbus_service_register               (GtdDBusService         *service,
+                                                                 GDBusConnection        *connection,
+                                                                 const gchar            *object_path,
+                                                                 GError                **error);
+
+void                    gtd_dbus_service_unregister             (GtdDBusService         *service);
+
+G_END_DECLS
+
+#endif /* GTD_DBUS_SERVICE_H */
@@ -0,0 +1,425 @@
+/* gtd-deletion-queue.c
+ *
+ * Copyright (C) 2015 Georges Basile Stavracas Neto <georges.stavracas@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gtd-append-log.h"
+#include "gtd-deletion-queue.h"
+#include "gtd-task.h"
+#include "gtd-task-list.h"
+
+#include <libecal/libecal.h>
+
+/*
+ * Tasks removed by the user can be brought back until their removal
+ * is sent to the source. Meanwhile, they are recorded here, so that
+ * removals that never reached the source because To Do quit or
+ * crashed are finished the next time the task is loaded.
+ *
+ * The queue is stored in a #GtdAppendLog, with one record per change:
+ *
+ *   <type> \t <source uid> \t <task uid>
+ *
+ * where <type> is 'P' for a pending removal, and 'X' for a removal
+ * that was sent or undone.
+ */
+
+typedef struct
+{
+  gchar                *source_uid;
+  gchar                *task_uid;
+
+  /* %NULL for removals recovered from a previous run */
+  GtdTask              *task;
+} PendingRemoval;
+
+typedef struct
+{
+  GtdAppendLog         *log;
+
+  /* Pending removals, keyed by source and task UID */
+  GHashTable           *removals;
+} GtdDeletionQueuePrivate;
+
+struct _GtdDeletionQueue
+{
+  GObject                  parent;
+
+  /*<private>*/
+  GtdDeletionQueuePrivate *priv;
+};
+
+G_DEFINE_TYPE_WITH_PRIVATE (GtdDeletionQueue, gtd_deletion_queue, G_TYPE_OBJECT)
+
+static gchar*
+get_key (const gchar *source_uid,
+         const gchar *task_uid)
+{
+  return g_strconcat (source_uid, "\n", task_uid, NULL);
+}
+
+static void
+pending_removal_free (PendingRemoval *removal)
+{
+  g_clear_object (&removal->task);
+  g_free (removal->source_uid);
+  g_free (removal->task_uid);
+  g_free (removal);
+}
+
+static const gchar*
+gtd_deletion_queue__get_source_uid (GtdTask *task)
+{
+  return e_source_get_uid (gtd_task_list_get_source (gtd_task_get_list (task)));
+}
+
+static void
+gtd_deletion_queue__write_record (GtdDeletionQueue *queue,
+                                  gchar             type,
+                                  const gchar      *source_uid,
+                                  const gchar      *task_uid)
+{
+  const gchar *fields[3];
+  gchar type_str[2] = { type, '\0' };
+
+  fields[0] = type_str;
+  fields[1] = source_uid;
+  fields[2] = task_uid;
+
+  gtd_append_log_append (queue->priv->log, fields, G_N_ELEMENTS (fields));
+  gtd_append_log_set_n_live (queue->priv->log, g_hash_table_size (queue->priv->removals));
+}
+
+static void
+gtd_deletion_queue__read_record (gchar    **fields,
+                                 guint      n_fields,
+                                 gpointer   user_data)
+{
+  GtdDeletionQueue *queue = user_data;
+  PendingRemoval *removal;
+
+  if (n_fields != 3 || fields[0][0] == '\0' || fields[0][1] != '\0')
+    return;
+
+  switch (fields[0][0])
+    {
+    case 'P':
+      removal = g_new0 (PendingRemoval, 1);
+      removal->source_uid = g_strdup (fields[1]);
+      removal->task_uid = g_strdup (fields[2]);
+
+      g_hash_table_insert (queue->priv->removals, get_key (fields[1], fields[2]), removal);
+      break;
+
+    case 'X':
+      {
+        gchar *key;
+
+        key = get_key (fields[1], fields[2]);
+        g_hash_table_remove (queue->priv->removals, key);
+        g_free (key);
+      }
+      break;
+
+    default:
+      break;
+    }
+}
+
+static void
+gtd_deletion_queue__compact (GtdAppendLog *log,
+                             GString      *contents,
+                             gpointer      user_data)
+{
+  GtdDeletionQueue *queue = user_data;
+  GHashTableIter iter;
+  gpointer value;
+
+  g_hash_table_iter_init (&iter, queue->priv->removals);
+
+  while (g_hash_table_iter_next (&iter, NULL, &value))
+    {
+      PendingRemoval *removal = value;
+      const gchar *fields[3];
+
+      fields[0] = "P";
+      fields[1] = removal->source_uid;
+      fields[2] = removal->task_uid;
+
+      gtd_append_log_format_record (contents, fields, G_N_ELEMENTS (fields));
+    }
+}
+
+static void
+gtd_deletion_queue_finalize (GObject *object)
+{
+  GtdDeletionQueue *self = (GtdDeletionQueue *)object;
+  GtdDeletionQueuePrivate *priv = gtd_deletion_queue_get_instance_private (self);
+
+  /* The log writes the records of the current batch */
+  g_clear_object (&priv->log);
+
+  g_clear_pointer (&priv->removals, g_hash_table_destroy);
+
+  G_OBJECT_CLASS (gtd_deletion_queue_parent_class)->finalize (object);
+}
+
+static void
+gtd_deletion_queue_class_init (GtdDeletionQueueClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->finalize = gtd_deletion_queue_finalize;
+}
+
+static void
+gtd_deletion_queue_init (GtdDeletionQueue *self)
+{
+  self->priv = gtd_deletion_queue_get_instance_private (self);
+
+  self->priv->removals = g_hash_table_new_full (g_str_hash,
+                                                g_str_equal,
+                                                g_free,
+                                                (GDestroyNotify) pending_removal_free);
+}
+
+/**
+ * gtd_deletion_queue_new:
+ * @filename: the path of the queue file
+ *
+ * Creates a new #GtdDeletionQueue, loading the removals left
+ * pending by previous runs from @filename.
+ *
+ * Returns: (transfer full): a new #GtdDeletionQueue
+ */
+GtdDeletionQueue*
+gtd_deletion_queue_new (const gchar *filename)
+{
+  GtdDeletionQueue *self;
+
+  g_return_val_if_fail (filename, NULL);
+
+  self = g_object_new (GTD_TYPE_DELETION_QUEUE, NULL);
+  self->priv->log = gtd_append_log_new (filename);
+
+  gtd_append_log_read (self->priv->log, gtd_deletion_queue__read_record, self);
+  gtd_append_log_set_n_live (self->priv->log, g_hash_table_size (self->priv->removals));
+  gtd_append_log_set_compact_func (self->priv->log, gtd_deletion_queue__compact, self);
+
+  return self;
+}
+
+/**
+ * gtd_deletion_queue_add:
+ * @queue: a #GtdDeletionQueue
+ * @task: a #GtdTask
+ *
+ * Records that @task is about to be removed. @queue keeps a
+ * reference on @task until the removal is sent or undone.
+ *
+ * Returns:
+ */
+void
+gtd_deletion_queue_add (GtdDeletionQueue *queue,
+                        GtdTask          *task)
+{
+  PendingRemoval *removal;
+
+  g_return_if_fail (GTD_IS_DELETION_QUEUE (queue));
+  g_return_if_fail (GTD_IS_TASK (task));
+
+  removal = g_new0 (PendingRemoval, 1);
+  removal->source_uid = g_strdup (gtd_deletion_queue__get_source_uid (task));
+  removal->task_uid = g_strdup (gtd_object_get_uid (GTD_OBJECT (task)));
+  removal->task = g_object_ref (task);
+
+  g_hash_table_replace (queue->priv->removals,
+                        get_key (removal->source_uid, removal->task_uid),
+                        removal);
+
+  gtd_deletion_queue__write_record (queue, 'P', removal->source_uid, removal->task_uid);
+}
+
+/**
+ * gtd_deletion_queue_remove:
+ * @queue: a #GtdDeletionQueue
+ * @task: a #GtdTask
+ *
+ * Records that the removal of @task was sent or undone, and drops
+ * the reference @queue had on @task.
+ *
+ * Returns: %TRUE if the removal of @task was pending, %FALSE otherwise
+ */
+gboolean
+gtd_deletion_queue_remove (GtdDeletionQueue *queue,
+                           GtdTask          *task)
+{
+  PendingRemoval *removal;
+  gboolean pending;
+  gchar *key;
+
+  g_return_val_if_fail (GTD_IS_DELETION_QUEUE (queue), FALSE);
+  g_return_val_if_fail (GTD_IS_TASK (task), FALSE);
+
+  key = get_key (gtd_deletion_queue__get_source_uid (task), gtd_object_get_uid (GTD_OBJECT (task)));
+  removal = g_hash_table_lookup (queue->priv->removals, key);
+  pending = removal && removal->task == task;
+
+  if (pending)
+    {
+      g_hash_table_remove (queue->priv->removals, key);
+      gtd_deletion_queue__write_record (queue,
+                                        'X',
+                                        gtd_deletion_queue__get_source_uid (task),
+                                        gtd_object_get_uid (GTD_OBJECT (task)));
+    }
+
+  g_free (key);
+
+  return pending;
+}
+
+/**
+ * gtd_deletion_queue_forget:
+ * @queue: a #GtdDeletionQueue
+ * @source_uid: the UID of a source
+ * @task_uid: the UID of a task
+ *
+ * Records that the removal of the given task was sent, or that
+ * the task doesn't exist anymore.
+ *
+ * Returns:
+ */
+void
+gtd_deletion_queue_forget (GtdDeletionQueue *queue,
+                           const gchar      *source_uid,
+                           const gchar      *task_uid)
+{
+  gchar *key;
+
+  g_return_if_fail (GTD_IS_DELETION_QUEUE (queue));
+  g_return_if_fail (source_uid && task_uid);
+
+  key = get_key (source_uid, task_uid);
+
+  if (g_hash_table_remove (queue->priv->removals, key))
+    gtd_deletion_queue__write_record (queue, 'X', source_uid, task_uid);
+
+  g_free (key);
+}
+
+/**
+ * gtd_deletion_queue_contains:
+ * @queue: a #GtdDeletionQueue
+ * @source_uid: the UID of a source
+ * @task_uid: the UID of a task
+ *
+ * Checks whether the removal of the given task is pending.
+ *
+ * Returns: %TRUE if the task is about to be removed, %FALSE otherwise
+ */
+gboolean
+gtd_deletion_queue_contains (GtdDeletionQueue *queue,
+                             const gchar      *source_uid,
+                             const gchar      *task_uid)
+{
+  gboolean contains;
+  gchar *key;
+
+  g_return_val_if_fail (GTD_IS_DELETION_QUEUE (queue), FALSE);
+
+  key = get_key (source_uid, task_uid);
+  contains = g_hash_table_contains (queue->priv->removals, key);
+  g_free (key);
+
+  return contains;
+}
+
+/**
+ * gtd_deletion_queue_lookup:
+ * @queue: a #GtdDeletionQueue
+ * @source_uid: the UID of a source
+ * @task_uid: the UID of a task
+ *
+ * Retrieves the task whose removal is pending.
+ *
+ * Returns: (transfer none) (nullable): the #GtdTask, or %NULL if the
+ * removal isn't pending or was recovered from a previous run
+ */
+GtdTask*
+gtd_deletion_queue_lookup (GtdDeletionQueue *queue,
+                           const gchar      *source_uid,
+                           const gchar      *task_uid)
+{
+  PendingRemoval *removal;
+  gchar *key;
+
+  g_return_val_if_fail (GTD_IS_DELETION_QUEUE (queue), NULL);
+
+  key = get_key (source_uid, task_uid);
+  removal = g_hash_table_lookup (queue->priv->removals, key);
+  g_free (key);
+
+  return removal ? removal->task : NULL;
+}
+
+/**
+ * gtd_deletion_queue_get_tasks:
+ * @queue: a #GtdDeletionQueue
+ *
+ * Retrieves the tasks whose removal is pending, leaving out the
+ * removals recovered from previous runs.
+ *
+ * Returns: (transfer container) (element-type GtdTask): the tasks
+ */
+GList*
+gtd_deletion_queue_get_tasks (GtdDeletionQueue *queue)
+{
+  GHashTableIter iter;
+  gpointer value;
+  GList *tasks;
+
+  g_return_val_if_fail (GTD_IS_DELETION_QUEUE (queue), NULL);
+
+  tasks = NULL;
+  g_hash_table_iter_init (&iter, queue->priv->removals);
+
+  while (g_hash_table_iter_next (&iter, NULL, &value))
+    {
+      PendingRemoval *removal = value;
+
+      if (removal->task)
+        tasks = g_list_prepend (tasks, removal->task);
+    }
+
+  return tasks;
+}
+
+/**
+ * gtd_deletion_queue_flush:
+ * @queue: a #GtdDeletionQueue
+ *
+ * Writes the buffered records of @queue to disk.
+ *
+ * Returns:
+ */
+void
+gtd_deletion_queue_flush (GtdDeletionQueue *queue)
+{
+  g_return_if_fail (GTD_IS_DELETION_QUEUE (queue));
+
+  gtd_append_log_flush (queue->priv->log);
+}
@@ -0,0 +1,58 @@
+/* gtd-deletion-queue.h
+ *
+ * Copyright (C) 2015 Georges Basile Stavracas Neto <georges.stavracas@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef GTD_DELETION_QUEUE_H
+#define GTD_DELETION_QUEUE_H
+
+#include "gtd-types.h"
+
+#include <glib-object.h>
+
+G_BEGIN_DECLS
+
+#define GTD_TYPE_DELETION_QUEUE (gtd_deletion_queue_get_type())
+
+G_DECLARE_FINAL_TYPE (GtdDeletionQueue, gtd_deletion_queue, GTD, DELETION_QUEUE, GObject)
+
+GtdDeletionQueue*       gtd_deletion_queue_new                  (const gchar            *filename);
+
+void                    gtd_deletion_queue_add                  (GtdDeletionQueue       *queue,
+                                                                 GtdTask                *task);
+
+gboolean                gtd_deletion_queue_remove               (GtdDeletionQueue       *queue,
+                                                                 GtdTask                *task);
+
+void                    gtd_deletion_queue_forget               (GtdDeletionQueue       *queue,
+                                                                 const gchar            *source_uid,
+                                                                 const gchar            *task_uid);
+
+gboolean                gtd_deletion_queue_contains             (GtdDeletionQueue       *queue,
+                                                                 const gchar            *source_uid,
+                                                                 const gchar            *task_uid);
+
+GtdTask*                gtd_deletion_queue_lookup               (GtdDeletionQueue       *queue,
+                                                                 const gchar            *source_uid,
+                                                                 const gchar            *task_uid);
+
+GList*                  gtd_deletion_queue_get_tasks            (GtdDeletionQueue       *queue);
+
+void                    gtd_deletion_queue_flush                (GtdDeletionQueue       *queue);
+
+G_END_DECLS
+
+#endif /* GTD_DELETION_QUEUE_H */
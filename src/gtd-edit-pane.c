@@ -16,12 +16,28 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include "gtd-date.h"
 #include "gtd-edit-pane.h"
 #include "gtd-manager.h"
 #include "gtd-task.h"
 #include "gtd-task-list.h"
 
 #include <glib/gi18n.h>
+#include <string.h>
+
+/*
+ * The pending edits of the task being edited. Fields not in @fields
+ * are read through from the task itself, so the session only holds
+ * what the user actually touched. The notes live in the text buffer,
+ * and are only pulled out of it when the session is applied.
+ */
+typedef struct
+{
+  GtdTaskField       fields;
+
+  GDateTime         *due_date;
+  gint               priority;
+} GtdEditSession;
 
 typedef struct
 {
@@ -30,12 +46,10 @@ typedef struct
   GtkTextView       *notes_textview;
   GtkComboBoxText   *priority_combo;
 
-  /* task bindings */
-  GBinding          *notes_binding;
-  GBinding          *priority_binding;
+  GtdEditSession     session;
 
   /* flags */
-  gint               should_save_task : 1;
+  gint               syncing_notes : 1;
 
   GtdManager        *manager;
   GtdTask           *task;
@@ -69,49 +83,161 @@ static guint signals[NUM_SIGNALS] = { 0, };
 static void             gtd_edit_pane__date_selected              (GtkCalendar      *calendar,
                                                                    gpointer          user_data);
 
+static void             gtd_edit_pane__priority_changed           (GtkComboBox      *combo,
+                                                                   GtdEditPane      *pane);
+
+/* Drops the pending edits */
 static void
-gtd_edit_pane__delete_button_clicked (GtkButton *button,
-                                      gpointer   user_data)
+gtd_edit_pane__discard_session (GtdEditPane *pane)
+{
+  GtdEditSession *session = &pane->priv->session;
+
+  g_clear_pointer (&session->due_date, g_date_time_unref);
+  session->fields = GTD_TASK_FIELD_NONE;
+}
+
+/*
+ * Applies the pending edits to the task as a single change set, so
+ * the rest of the application sees one GtdTask::changed. Returns
+ * %TRUE if the task was modified and should be saved.
+ */
+static gboolean
+gtd_edit_pane__apply_session (GtdEditPane *pane)
 {
   GtdEditPanePrivate *priv;
+  GtdEditSession *session;
+  GtdTaskField fields;
 
-  g_return_if_fail (GTD_IS_EDIT_PANE (user_data));
+  priv = pane->priv;
+  session = &priv->session;
+  fields = session->fields;
 
-  priv = GTD_EDIT_PANE (user_data)->priv;
+  if (!priv->task || fields == GTD_TASK_FIELD_NONE)
+    return FALSE;
 
-  g_signal_emit (user_data, signals[REMOVE_TASK], 0, priv->task);
+  gtd_task_begin_changes (priv->task);
 
-  priv->should_save_task = FALSE;
-  gtd_edit_pane_set_task (GTD_EDIT_PANE (user_data), NULL);
+  if (fields & GTD_TASK_FIELD_DESCRIPTION)
+    {
+      GtkTextBuffer *buffer;
+      GtkTextIter start, end;
+      gchar *text;
+
+      buffer = gtk_text_view_get_buffer (priv->notes_textview);
+
+      gtk_text_buffer_get_bounds (buffer, &start, &end);
+      text = gtk_text_buffer_get_text (buffer, &start, &end, FALSE);
+
+      gtd_task_set_description (priv->task, text);
+
+      g_free (text);
+    }
+
+  /* The calendar only picks days */
+  if (fields & GTD_TASK_FIELD_DUE_DATE)
+    gtd_task_set_due_day (priv->task, session->due_date ? gtd_date_get_day_from_date_time (session->due_date) : 0);
+
+  if (fields & GTD_TASK_FIELD_PRIORITY)
+    gtd_task_set_priority (priv->task, session->priority);
+
+  /* The task now holds the edits, let the widgets follow it again */
+  gtd_edit_pane__discard_session (pane);
+
+  gtd_task_commit_changes (priv->task);
+
+  return TRUE;
 }
 
 static void
-gtd_edit_pane__close_button_clicked (GtkButton *button,
-                                     gpointer   user_data)
+gtd_edit_pane__notes_changed (GtkTextBuffer *buffer,
+                              GtdEditPane   *pane)
 {
-  GtdEditPanePrivate *priv;
+  if (pane->priv->syncing_notes || !pane->priv->task)
+    return;
 
-  g_return_if_fail (GTD_IS_EDIT_PANE (user_data));
+  pane->priv->session.fields |= GTD_TASK_FIELD_DESCRIPTION;
+}
 
-  priv = GTD_EDIT_PANE (user_data)->priv;
+/*
+ * Updates the buffer to @text, touching only the range between
+ * their common prefix and suffix. This keeps the cursor and the
+ * scroll position, and is cheap when a large note barely changed.
+ */
+static void
+gtd_edit_pane__set_notes (GtdEditPane *pane,
+                          const gchar *text)
+{
+  GtkTextBuffer *buffer;
+  GtkTextIter start, end;
+  const gchar *old_end, *new_end;
+  gchar *old_text;
+  gsize old_len, new_len;
+  gsize prefix;
 
-  g_signal_emit (user_data, signals[EDIT_FINISHED], 0, priv->task);
+  buffer = gtk_text_view_get_buffer (pane->priv->notes_textview);
 
-  priv->should_save_task = TRUE;
-  gtd_edit_pane_set_task (GTD_EDIT_PANE (user_data), NULL);
+  gtk_text_buffer_get_bounds (buffer, &start, &end);
+  old_text = gtk_text_buffer_get_text (buffer, &start, &end, FALSE);
+
+  old_len = strlen (old_text);
+  new_len = strlen (text);
+
+  /* Common prefix, backed off to a character boundary */
+  for (prefix = 0; prefix < old_len && prefix < new_len && old_text[prefix] == text[prefix]; prefix++)
+    ;
+
+  while (prefix > 0 && (old_text[prefix] & 0xC0) == 0x80)
+    prefix--;
+
+  /* Common suffix, not overlapping the prefix */
+  old_end = old_text + old_len;
+  new_end = text + new_len;
+
+  while (old_end > old_text + prefix && new_end > text + prefix && old_end[-1] == new_end[-1])
+    {
+      old_end--;
+      new_end--;
+    }
+
+  while (old_end < old_text + old_len && (*old_end & 0xC0) == 0x80)
+    {
+      old_end++;
+      new_end++;
+    }
+
+  if (old_end == old_text + prefix && new_end == text + prefix)
+    {
+      g_free (old_text);
+      return;
+    }
+
+  pane->priv->syncing_notes = TRUE;
+
+  gtk_text_buffer_get_iter_at_offset (buffer, &start, g_utf8_pointer_to_offset (old_text, old_text + prefix));
+  gtk_text_buffer_get_iter_at_offset (buffer, &end, g_utf8_pointer_to_offset (old_text, old_end));
+
+  gtk_text_buffer_delete (buffer, &start, &end);
+  gtk_text_buffer_insert (buffer, &start, text + prefix, new_end - (text + prefix));
+
+  pane->priv->syncing_notes = FALSE;
+
+  g_free (old_text);
 }
 
 static void
-gtd_edit_pane_update_date (GtdEditPane *pane)
+gtd_edit_pane__update_date (GtdEditPane *pane)
 {
   GtdEditPanePrivate *priv;
   GDateTime *dt;
   gchar *text;
 
-  g_return_if_fail (GTD_IS_EDIT_PANE (pane));
-
   priv = pane->priv;
-  dt = priv->task ? gtd_task_get_due_date (priv->task) : NULL;
+
+  if (priv->session.fields & GTD_TASK_FIELD_DUE_DATE)
+    dt = priv->session.due_date ? g_date_time_ref (priv->session.due_date) : NULL;
+  else
+    dt = priv->task ? gtd_task_get_due_date (priv->task) : NULL;
+
   text = dt ? g_date_time_format (dt, "%x") : NULL;
 
   if (dt)
@@ -135,9 +261,96 @@ gtd_edit_pane_update_date (GtdEditPane *pane)
 
   gtk_label_set_label (priv->date_label, text ? text : _("No date set"));
 
+  g_clear_pointer (&dt, g_date_time_unref);
   g_free (text);
 }
 
+static void
+gtd_edit_pane__update_priority (GtdEditPane *pane)
+{
+  GtdEditPanePrivate *priv = pane->priv;
+
+  g_signal_handlers_block_by_func (priv->priority_combo,
+                                   gtd_edit_pane__priority_changed,
+                                   pane);
+
+  gtk_combo_box_set_active (GTK_COMBO_BOX (priv->priority_combo),
+                            CLAMP (gtd_task_get_priority (priv->task), 0, 3));
+
+  g_signal_handlers_unblock_by_func (priv->priority_combo,
+                                     gtd_edit_pane__priority_changed,
+                                     pane);
+}
+
+/*
+ * Changes made to the task elsewhere are shown, unless the user
+ * already edited that field, in which case the edit wins.
+ */
+static void
+gtd_edit_pane__task_changed (GtdTask      *task,
+                             GtdTaskField  fields,
+                             GtdEditPane  *pane)
+{
+  fields &= ~pane->priv->session.fields;
+
+  if (fields & GTD_TASK_FIELD_DESCRIPTION)
+    gtd_edit_pane__set_notes (pane, gtd_task_get_description (task));
+
+  if (fields & GTD_TASK_FIELD_DUE_DATE)
+    gtd_edit_pane__update_date (pane);
+
+  if (fields & GTD_TASK_FIELD_PRIORITY)
+    gtd_edit_pane__update_priority (pane);
+}
+
+static void
+gtd_edit_pane__priority_changed (GtkComboBox *combo,
+                                 GtdEditPane *pane)
+{
+  GtdEditPanePrivate *priv = pane->priv;
+
+  if (!priv->task)
+    return;
+
+  priv->session.priority = gtk_combo_box_get_active (combo);
+  priv->session.fields |= GTD_TASK_FIELD_PRIORITY;
+}
+
+static void
+gtd_edit_pane__delete_button_clicked (GtkButton *button,
+                                      gpointer   user_data)
+{
+  GtdEditPanePrivate *priv;
+
+  g_return_if_fail (GTD_IS_EDIT_PANE (user_data));
+
+  priv = GTD_EDIT_PANE (user_data)->priv;
+
+  /* Edits to a removed task would go nowhere */
+  gtd_edit_pane__discard_session (user_data);
+
+  g_signal_emit (user_data, signals[REMOVE_TASK], 0, priv->task);
+
+  gtd_edit_pane_set_task (GTD_EDIT_PANE (user_data), NULL);
+}
+
+static void
+gtd_edit_pane__close_button_clicked (GtkButton *button,
+                                     gpointer   user_data)
+{
+  GtdEditPanePrivate *priv;
+
+  g_return_if_fail (GTD_IS_EDIT_PANE (user_data));
+
+  priv = GTD_EDIT_PANE (user_data)->priv;
+
+  gtd_edit_pane__apply_session (user_data);
+
+  g_signal_emit (user_data, signals[EDIT_FINISHED], 0, priv->task);
+
+  gtd_edit_pane_set_task (GTD_EDIT_PANE (user_data), NULL);
+}
+
 static void
 gtd_edit_pane__date_selected (GtkCalendar *calendar,
                               gpointer     user_data)
@@ -153,6 +366,9 @@ gtd_edit_pane__date_selected (GtkCalendar *calendar,
 
   priv = GTD_EDIT_PANE (user_data)->priv;
 
+  if (!priv->task)
+    return;
+
   gtk_calendar_get_date (calendar,
                          &year,
                          &month,
@@ -167,16 +383,37 @@ gtd_edit_pane__date_selected (GtkCalendar *calendar,
 
   text = g_date_time_format (new_dt, "%x");
 
-  gtd_task_set_due_date (priv->task, new_dt);
+  g_clear_pointer (&priv->session.due_date, g_date_time_unref);
+  priv->session.due_date = new_dt;
+  priv->session.fields |= GTD_TASK_FIELD_DUE_DATE;
+
   gtk_label_set_label (priv->date_label, text);
 
-  g_date_time_unref (new_dt);
   g_free (text);
 }
 
+static void
+gtd_edit_pane_dispose (GObject *object)
+{
+  GtdEditPanePrivate *priv = GTD_EDIT_PANE (object)->priv;
+
+  /* Save the pending edits when the window goes away with the pane open */
+  if (gtd_edit_pane__apply_session (GTD_EDIT_PANE (object)))
+    g_signal_emit (object, signals[EDIT_FINISHED], 0, priv->task);
+
+  G_OBJECT_CLASS (gtd_edit_pane_parent_class)->dispose (object);
+}
+
 static void
 gtd_edit_pane_finalize (GObject *object)
 {
+  GtdEditPanePrivate *priv = GTD_EDIT_PANE (object)->priv;
+
+  gtd_edit_pane__discard_session (GTD_EDIT_PANE (object));
+
+  if (priv->task)
+    g_signal_handlers_disconnect_by_func (priv->task, gtd_edit_pane__task_changed, object);
+
   G_OBJECT_CLASS (gtd_edit_pane_parent_class)->finalize (object);
 }
 
@@ -232,6 +469,7 @@ gtd_edit_pane_class_init (GtdEditPaneClass *klass)
   GObjectClass *object_class = G_OBJECT_CLASS (klass);
   GtkWidgetClass *widget_class = GTK_WIDGET_CLASS (klass);
 
+  object_class->dispose = gtd_edit_pane_dispose;
   object_class->finalize = gtd_edit_pane_finalize;
   object_class->get_property = gtd_edit_pane_get_property;
   object_class->set_property = gtd_edit_pane_set_property;
@@ -268,6 +506,7 @@ gtd_edit_pane_class_init (GtdEditPaneClass *klass)
    * GtdEditPane::edit-finished:
    *
    * Emitted when the the user finishes editing the task, i.e. the pane is closed.
+   * The pending edits are already applied to the task as a single change set.
    */
   signals[EDIT_FINISHED] = g_signal_new ("edit-finished",
                                          GTD_TYPE_EDIT_PANE,
@@ -315,6 +554,16 @@ gtd_edit_pane_init (GtdEditPane *self)
   self->priv = gtd_edit_pane_get_instance_private (self);
 
   gtk_widget_init_template (GTK_WIDGET (self));
+
+  g_signal_connect (gtk_text_view_get_buffer (self->priv->notes_textview),
+                    "changed",
+                    G_CALLBACK (gtd_edit_pane__notes_changed),
+                    self);
+
+  g_signal_connect (self->priv->priority_combo,
+                    "changed",
+                    G_CALLBACK (gtd_edit_pane__priority_changed),
+                    self);
 }
 
 GtkWidget*
@@ -401,10 +650,12 @@ gtd_edit_pane_set_task (GtdEditPane *pane,
     {
       if (priv->task)
         {
-          g_clear_pointer (&priv->notes_binding, g_binding_unbind);
-          g_clear_pointer (&priv->priority_binding, g_binding_unbind);
+          g_signal_handlers_disconnect_by_func (priv->task,
+                                                gtd_edit_pane__task_changed,
+                                                pane);
 
-          if (priv->should_save_task)
+          /* Pending edits are saved when switching to another task */
+          if (gtd_edit_pane__apply_session (pane))
             g_signal_emit (pane, signals[EDIT_FINISHED], 0, priv->task);
         }
 
@@ -413,27 +664,22 @@ gtd_edit_pane_set_task (GtdEditPane *pane,
       if (task)
         {
           /* due date */
-          gtd_edit_pane_update_date (pane);
+          gtd_edit_pane__update_date (pane);
 
           /* description */
+          priv->syncing_notes = TRUE;
           gtk_text_buffer_set_text (gtk_text_view_get_buffer (priv->notes_textview),
                                     gtd_task_get_description (task),
                                     -1);
-          priv->notes_binding = g_object_bind_property (gtk_text_view_get_buffer (priv->notes_textview),
-                                                        "text",
-                                                        task,
-                                                        "description",
-                                                        G_BINDING_BIDIRECTIONAL);
+          priv->syncing_notes = FALSE;
 
           /* priority */
-          gtk_combo_box_set_active (GTK_COMBO_BOX (priv->priority_combo), CLAMP (gtd_task_get_priority (task),
-                                                                                 0,
-                                                                                 3));
-          priv->priority_binding = g_object_bind_property (task,
-                                                           "priority",
-                                                           priv->priority_combo,
-                                                           "active",
-                                                           G_BINDING_BIDIRECTIONAL);
+          gtd_edit_pane__update_priority (pane);
+
+          g_signal_connect (task,
+                            "changed",
+                            G_CALLBACK (gtd_edit_pane__task_changed),
+                            pane);
         }
 
       g_object_notify (G_OBJECT (pane), "task");
@@ -30,6 +30,45 @@ typedef enum
   GTD_WINDOW_MODE_SELECTION
 } GtdWindowMode;
 
+typedef enum
+{
+  GTD_TASK_FIELD_NONE        = 0,
+  GTD_TASK_FIELD_COMPLETE    = 1 << 0,
+  GTD_TASK_FIELD_DESCRIPTION = 1 << 1,
+  GTD_TASK_FIELD_DUE_DATE    = 1 << 2,
+  GTD_TASK_FIELD_LIST        = 1 << 3,
+  GTD_TASK_FIELD_PRIORITY    = 1 << 4,
+  GTD_TASK_FIELD_TITLE       = 1 << 5,
+  GTD_TASK_FIELD_ALL         = 0x3F
+} GtdTaskField;
+
+typedef enum
+{
+  GTD_RULE_OP_IS_SET,
+  GTD_RULE_OP_IS_UNSET,
+  GTD_RULE_OP_EQUAL,
+  GTD_RULE_OP_NOT_EQUAL,
+  GTD_RULE_OP_LESS,
+  GTD_RULE_OP_LESS_EQUAL,
+  GTD_RULE_OP_GREATER,
+  GTD_RULE_OP_GREATER_EQUAL,
+  GTD_RULE_OP_CONTAINS
+} GtdRuleOperator;
+
+typedef enum
+{
+  GTD_JOURNAL_OPERATION_CREATE,
+  GTD_JOURNAL_OPERATION_MODIFY,
+  GTD_JOURNAL_OPERATION_REMOVE
+} GtdJournalOperation;
+
+typedef enum
+{
+  GTD_EXPORT_FORMAT_ICALENDAR,
+  GTD_EXPORT_FORMAT_JSON_LINES,
+  GTD_EXPORT_FORMAT_CSV
+} GtdExportFormat;
+
 G_END_DECLS
 
 #endif /* GTD_ENUMS_H */
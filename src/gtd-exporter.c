@@ -0,0 +1,658 @@
+/* gtd-exporter.c
+ *
+ * Copyright (C) 2015 Georges Basile Stavracas Neto <georges.stavracas@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gtd-exporter.h"
+#include "gtd-task.h"
+#include "gtd-task-list.h"
+
+#include <libecal/libecal.h>
+#include <string.h>
+
+/*
+ * Tasks are copied into plain records when they are added to the
+ * exporter, so the export itself runs in a worker thread against a
+ * snapshot that later edits don't touch. Records are serialized one
+ * at a time into a small buffer that is written out whenever it fills.
+ */
+
+#define EXPORT_BUFFER_SIZE               (64 * 1024)
+#define DATE_FORMAT                      "%Y-%m-%dT%H:%M:%S%:z"
+
+typedef struct
+{
+  gchar                *uid;
+  gchar                *list;
+  gchar                *title;
+  gchar                *description;
+  gint                  priority;
+  gboolean              complete;
+  GDateTime            *due_date;
+  GDateTime            *completion_date;
+
+  /* Only kept for iCalendar exports */
+  icalcomponent        *component;
+} TaskRecord;
+
+typedef struct
+{
+  GtdExportFormat       format;
+
+  /* The snapshot of the exported tasks */
+  GPtrArray            *records;
+  gboolean              exported;
+} GtdExporterPrivate;
+
+struct _GtdExporter
+{
+  GObject               parent;
+
+  /*<private>*/
+  GtdExporterPrivate   *priv;
+};
+
+G_DEFINE_TYPE_WITH_PRIVATE (GtdExporter, gtd_exporter, G_TYPE_OBJECT)
+
+static void
+task_record_free (TaskRecord *record)
+{
+  g_free (record->uid);
+  g_free (record->list);
+  g_free (record->title);
+  g_free (record->description);
+  g_clear_pointer (&record->due_date, g_date_time_unref);
+  g_clear_pointer (&record->completion_date, g_date_time_unref);
+  g_clear_pointer (&record->component, icalcomponent_free);
+  g_free (record);
+}
+
+static TaskRecord*
+task_record_new (GtdTask         *task,
+                 GtdExportFormat  format)
+{
+  struct icaltimetype *completed;
+  ECalComponent *component;
+  TaskRecord *record;
+
+  component = gtd_task_get_component (task);
+  completed = NULL;
+
+  record = g_new0 (TaskRecord, 1);
+  record->uid = g_strdup (gtd_object_get_uid (GTD_OBJECT (task)));
+  record->title = g_strdup (gtd_task_get_title (task));
+  record->description = g_strdup (gtd_task_get_description (task));
+  record->priority = gtd_task_get_priority (task);
+  record->complete = gtd_task_get_complete (task);
+  record->due_date = gtd_task_get_due_date (task);
+
+  if (gtd_task_get_list (task))
+    record->list = g_strdup (gtd_task_list_get_name (gtd_task_get_list (task)));
+
+  e_cal_component_get_completed (component, &completed);
+
+  if (completed)
+    {
+      record->completion_date = g_date_time_new_utc (completed->year,
+                                                     completed->month,
+                                                     completed->day,
+                                                     completed->hour,
+                                                     completed->minute,
+                                                     completed->second);
+
+      e_cal_component_free_icaltimetype (completed);
+    }
+
+  if (format == GTD_EXPORT_FORMAT_ICALENDAR)
+    record->component = icalcomponent_new_clone (e_cal_component_get_icalcomponent (component));
+
+  return record;
+}
+
+static void
+gtd_exporter__append_json_string (GString     *buffer,
+                                  const gchar *str)
+{
+  const gchar *p;
+
+  if (!str)
+    {
+      g_string_append (buffer, "null");
+      return;
+    }
+
+  g_string_append_c (buffer, '"');
+
+  for (p = str; *p != '\0'; p++)
+    {
+      switch (*p)
+        {
+        case '"':
+          g_string_append (buffer, "\\\"");
+          break;
+
+        case '\\':
+          g_string_append (buffer, "\\\\");
+          break;
+
+        case '\n':
+          g_string_append (buffer, "\\n");
+          break;
+
+        case '\r':
+          g_string_append (buffer, "\\r");
+          break;
+
+        case '\t':
+          g_string_append (buffer, "\\t");
+          break;
+
+        default:
+          if ((guchar) *p < 0x20)
+            g_string_append_printf (buffer, "\\u%04x", (guchar) *p);
+          else
+            g_string_append_c (buffer, *p);
+          break;
+        }
+    }
+
+  g_string_append_c (buffer, '"');
+}
+
+static void
+gtd_exporter__append_json_date (GString   *buffer,
+                                GDateTime *dt)
+{
+  gchar *str;
+
+  str = dt ? g_date_time_format (dt, DATE_FORMAT) : NULL;
+
+  gtd_exporter__append_json_string (buffer, str);
+
+  g_free (str);
+}
+
+static void
+gtd_exporter__append_csv_field (GString     *buffer,
+                                const gchar *str)
+{
+  const gchar *p;
+
+  if (!str)
+    return;
+
+  /* Only fields with separators, quotes or line breaks are quoted */
+  if (!strpbrk (str, ",\"\r\n"))
+    {
+      g_string_append (buffer, str);
+      return;
+    }
+
+  g_string_append_c (buffer, '"');
+
+  for (p = str; *p != '\0'; p++)
+    {
+      if (*p == '"')
+        g_string_append_c (buffer, '"');
+
+      g_string_append_c (buffer, *p);
+    }
+
+  g_string_append_c (buffer, '"');
+}
+
+static void
+gtd_exporter__append_csv_date (GString   *buffer,
+                               GDateTime *dt)
+{
+  gchar *str;
+
+  if (!dt)
+    return;
+
+  str = g_date_time_format (dt, DATE_FORMAT);
+  g_string_append (buffer, str);
+  g_free (str);
+}
+
+static void
+gtd_exporter__append_header (GtdExporter *exporter,
+                             GString     *buffer)
+{
+  switch (exporter->priv->format)
+    {
+    case GTD_EXPORT_FORMAT_ICALENDAR:
+      g_string_append (buffer,
+                       "BEGIN:VCALENDAR\r\n"
+                       "VERSION:2.0\r\n"
+                       "PRODID:-//GNOME//GNOME To Do//EN\r\n");
+      break;
+
+    case GTD_EXPORT_FORMAT_CSV:
+      g_string_append (buffer, "uid,list,title,description,priority,due-date,complete,completion-date\r\n");
+      break;
+
+    case GTD_EXPORT_FORMAT_JSON_LINES:
+    default:
+      break;
+    }
+}
+
+static void
+gtd_exporter__append_footer (GtdExporter *exporter,
+                             GString     *buffer)
+{
+  if (exporter->priv->format == GTD_EXPORT_FORMAT_ICALENDAR)
+    g_string_append (buffer, "END:VCALENDAR\r\n");
+}
+
+static void
+gtd_exporter__append_record (GtdExporter *exporter,
+                             GString     *buffer,
+                             TaskRecord  *record)
+{
+  gchar *str;
+
+  switch (exporter->priv->format)
+    {
+    case GTD_EXPORT_FORMAT_ICALENDAR:
+      str = icalcomponent_as_ical_string_r (record->component);
+      g_string_append (buffer, str);
+      g_free (str);
+      break;
+
+    case GTD_EXPORT_FORMAT_JSON_LINES:
+      g_string_append (buffer, "{\"uid\":");
+      gtd_exporter__append_json_string (buffer, record->uid);
+      g_string_append (buffer, ",\"list\":");
+      gtd_exporter__append_json_string (buffer, record->list);
+      g_string_append (buffer, ",\"title\":");
+      gtd_exporter__append_json_string (buffer, record->title);
+      g_string_append (buffer, ",\"description\":");
+      gtd_exporter__append_json_string (buffer, record->description);
+      g_string_append_printf (buffer, ",\"priority\":%d", record->priority);
+      g_string_append (buffer, ",\"due-date\":");
+      gtd_exporter__append_json_date (buffer, record->due_date);
+      g_string_append_printf (buffer, ",\"complete\":%s", record->complete ? "true" : "false");
+      g_string_append (buffer, ",\"completion-date\":");
+      gtd_exporter__append_json_date (buffer, record->completion_date);
+      g_string_append (buffer, "}\n");
+      break;
+
+    case GTD_EXPORT_FORMAT_CSV:
+      gtd_exporter__append_csv_field (buffer, record->uid);
+      g_string_append_c (buffer, ',');
+      gtd_exporter__append_csv_field (buffer, record->list);
+      g_string_append_c (buffer, ',');
+      gtd_exporter__append_csv_field (buffer, record->title);
+      g_string_append_c (buffer, ',');
+      gtd_exporter__append_csv_field (buffer, record->description);
+      g_string_append_printf (buffer, ",%d,", record->priority);
+      gtd_exporter__append_csv_date (buffer, record->due_date);
+      g_string_append (buffer, record->complete ? ",1," : ",0,");
+      gtd_exporter__append_csv_date (buffer, record->completion_date);
+      g_string_append (buffer, "\r\n");
+      break;
+
+    default:
+      g_assert_not_reached ();
+    }
+}
+
+static gboolean
+gtd_exporter__write_buffer (GOutputStream  *stream,
+                            GString        *buffer,
+                            GCancellable   *cancellable,
+                            GError        **error)
+{
+  gboolean success;
+
+  success = g_output_stream_write_all (stream,
+                                       buffer->str,
+                                       buffer->len,
+                                       NULL,
+                                       cancellable,
+                                       error);
+
+  g_string_truncate (buffer, 0);
+
+  return success;
+}
+
+static gboolean
+gtd_exporter__write_records (GtdExporter    *exporter,
+                             GOutputStream  *stream,
+                             GCancellable   *cancellable,
+                             GError        **error)
+{
+  GtdExporterPrivate *priv = exporter->priv;
+  gboolean success;
+  GString *buffer;
+  guint i;
+
+  buffer = g_string_sized_new (EXPORT_BUFFER_SIZE);
+  success = TRUE;
+
+  gtd_exporter__append_header (exporter, buffer);
+
+  for (i = 0; i < priv->records->len && success; i++)
+    {
+      if (g_cancellable_set_error_if_cancelled (cancellable, error))
+        {
+          success = FALSE;
+          break;
+        }
+
+      gtd_exporter__append_record (exporter, buffer, g_ptr_array_index (priv->records, i));
+
+      if (buffer->len >= EXPORT_BUFFER_SIZE)
+        success = gtd_exporter__write_buffer (stream, buffer, cancellable, error);
+    }
+
+  if (success)
+    {
+      gtd_exporter__append_footer (exporter, buffer);
+
+      success = gtd_exporter__write_buffer (stream, buffer, cancellable, error) &&
+                g_output_stream_flush (stream, cancellable, error);
+    }
+
+  g_string_free (buffer, TRUE);
+
+  return success;
+}
+
+static void
+gtd_exporter__export_thread (GTask        *task,
+                             gpointer      source_object,
+                             gpointer      task_data,
+                             GCancellable *cancellable)
+{
+  GError *error = NULL;
+
+  if (gtd_exporter__write_records (GTD_EXPORTER (source_object),
+                                   G_OUTPUT_STREAM (task_data),
+                                   cancellable,
+                                   &error))
+    {
+      g_task_return_boolean (task, TRUE);
+    }
+  else
+    {
+      g_task_return_error (task, error);
+    }
+}
+
+static void
+gtd_exporter_finalize (GObject *object)
+{
+  GtdExporter *self = (GtdExporter *)object;
+  GtdExporterPrivate *priv = gtd_exporter_get_instance_private (self);
+
+  g_ptr_array_unref (priv->records);
+
+  G_OBJECT_CLASS (gtd_exporter_parent_class)->finalize (object);
+}
+
+static void
+gtd_exporter_class_init (GtdExporterClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->finalize = gtd_exporter_finalize;
+}
+
+static void
+gtd_exporter_init (GtdExporter *self)
+{
+  self->priv = gtd_exporter_get_instance_private (self);
+  self->priv->records = g_ptr_array_new_with_free_func ((GDestroyNotify) task_record_free);
+}
+
+/**
+ * gtd_exporter_new:
+ * @format: the format to export to
+ *
+ * Creates a new #GtdExporter.
+ *
+ * Returns: (transfer full): a new #GtdExporter
+ */
+GtdExporter*
+gtd_exporter_new (GtdExportFormat format)
+{
+  GtdExporter *self;
+
+  self = g_object_new (GTD_TYPE_EXPORTER, NULL);
+  self->priv->format = format;
+
+  return self;
+}
+
+/**
+ * gtd_exporter_get_format:
+ * @exporter: a #GtdExporter
+ *
+ * Retrieves the format @exporter writes.
+ *
+ * Returns: the #GtdExportFormat of @exporter
+ */
+GtdExportFormat
+gtd_exporter_get_format (GtdExporter *exporter)
+{
+  g_return_val_if_fail (GTD_IS_EXPORTER (exporter), GTD_EXPORT_FORMAT_ICALENDAR);
+
+  return exporter->priv->format;
+}
+
+/**
+ * gtd_exporter_add_task:
+ * @exporter: a #GtdExporter
+ * @task: a #GtdTask
+ *
+ * Takes a snapshot of @task to be exported. Changes made to @task
+ * afterwards are not exported.
+ *
+ * Returns:
+ */
+void
+gtd_exporter_add_task (GtdExporter *exporter,
+                       GtdTask     *task)
+{
+  g_return_if_fail (GTD_IS_EXPORTER (exporter));
+  g_return_if_fail (GTD_IS_TASK (task));
+  g_return_if_fail (!exporter->priv->exported);
+
+  g_ptr_array_add (exporter->priv->records, task_record_new (task, exporter->priv->format));
+}
+
+/**
+ * gtd_exporter_add_list:
+ * @exporter: a #GtdExporter
+ * @list: a #GtdTaskList
+ *
+ * Takes a snapshot of every task of @list to be exported.
+ *
+ * Returns:
+ */
+void
+gtd_exporter_add_list (GtdExporter *exporter,
+                       GtdTaskList *list)
+{
+  GList *tasks;
+  GList *l;
+  gchar **frozen_uids;
+  guint i;
+
+  g_return_if_fail (GTD_IS_EXPORTER (exporter));
+  g_return_if_fail (GTD_IS_TASK_LIST (list));
+
+  tasks = gtd_task_list_get_tasks (list);
+
+  for (l = tasks; l != NULL; l = l->next)
+    gtd_exporter_add_task (exporter, l->data);
+
+  g_list_free (tasks);
+
+  /* Frozen tasks are read from their text, without thawing them */
+  frozen_uids = gtd_task_list_get_frozen_uids (list);
+
+  for (i = 0; frozen_uids[i] != NULL; i++)
+    {
+      ECalComponent *component;
+      GtdTask *task;
+
+      component = e_cal_component_new_from_string (gtd_task_list_get_frozen_data (list, frozen_uids[i]));
+
+      if (!component)
+        continue;
+
+      task = gtd_task_new (component);
+      gtd_task_set_list (task, list);
+
+      gtd_exporter_add_task (exporter, task);
+
+      g_object_unref (component);
+      g_object_unref (task);
+    }
+
+  g_strfreev (frozen_uids);
+}
+
+/**
+ * gtd_exporter_get_n_tasks:
+ * @exporter: a #GtdExporter
+ *
+ * Retrieves the number of tasks that @exporter writes.
+ *
+ * Returns: the number of exported tasks
+ */
+guint
+gtd_exporter_get_n_tasks (GtdExporter *exporter)
+{
+  g_return_val_if_fail (GTD_IS_EXPORTER (exporter), 0);
+
+  return exporter->priv->records->len;
+}
+
+/**
+ * gtd_exporter_export:
+ * @exporter: a #GtdExporter
+ * @stream: the #GOutputStream to write to
+ * @cancellable: (nullable): a #GCancellable, or %NULL
+ * @callback: the callback to call when the export finishes
+ * @user_data: user data for @callback
+ *
+ * Writes the tasks added to @exporter to @stream in a worker thread.
+ * @stream is flushed, but not closed. An exporter can only be used
+ * once, and no tasks can be added to it after the export starts.
+ *
+ * Returns:
+ */
+void
+gtd_exporter_export (GtdExporter         *exporter,
+                     GOutputStream       *stream,
+                     GCancellable        *cancellable,
+                     GAsyncReadyCallback  callback,
+                     gpointer             user_data)
+{
+  GTask *task;
+
+  g_return_if_fail (GTD_IS_EXPORTER (exporter));
+  g_return_if_fail (G_IS_OUTPUT_STREAM (stream));
+  g_return_if_fail (!exporter->priv->exported);
+
+  exporter->priv->exported = TRUE;
+
+  task = g_task_new (exporter, cancellable, callback, user_data);
+  g_task_set_source_tag (task, gtd_exporter_export);
+  g_task_set_task_data (task, g_object_ref (stream), g_object_unref);
+
+  g_task_run_in_thread (task, gtd_exporter__export_thread);
+
+  g_object_unref (task);
+}
+
+/**
+ * gtd_exporter_export_finish:
+ * @exporter: a #GtdExporter
+ * @result: a #GAsyncResult
+ * @error: (nullable): return location for a #GError, or %NULL
+ *
+ * Finishes an export started with gtd_exporter_export().
+ *
+ * Returns: %TRUE if the tasks were exported, %FALSE otherwise
+ */
+gboolean
+gtd_exporter_export_finish (GtdExporter   *exporter,
+                            GAsyncResult  *result,
+                            GError       **error)
+{
+  g_return_val_if_fail (GTD_IS_EXPORTER (exporter), FALSE);
+  g_return_val_if_fail (g_task_is_valid (result, exporter), FALSE);
+
+  return g_task_propagate_boolean (G_TASK (result), error);
+}
+
+/**
+ * gtd_exporter_export_sync:
+ * @exporter: a #GtdExporter
+ * @stream: the #GOutputStream to write to
+ * @cancellable: (nullable): a #GCancellable, or %NULL
+ * @error: (nullable): return location for a #GError, or %NULL
+ *
+ * Synchronous version of gtd_exporter_export(), for callers that
+ * already run outside of the main thread or write to a pipe.
+ *
+ * Returns: %TRUE if the tasks were exported, %FALSE otherwise
+ */
+gboolean
+gtd_exporter_export_sync (GtdExporter   *exporter,
+                          GOutputStream *stream,
+                          GCancellable  *cancellable,
+                          GError       **error)
+{
+  g_return_val_if_fail (GTD_IS_EXPORTER (exporter), FALSE);
+  g_return_val_if_fail (G_IS_OUTPUT_STREAM (stream), FALSE);
+  g_return_val_if_fail (!exporter->priv->exported, FALSE);
+
+  exporter->priv->exported = TRUE;
+
+  return gtd_exporter__write_records (exporter, stream, cancellable, error);
+}
+
+/**
+ * gtd_exporter_get_format_for_filename:
+ * @filename: the name of a file
+ *
+ * Guesses the export format from the extension of @filename. Files
+ * ending in .jsonl or .json are exported as JSON Lines, files ending
+ * in .csv as CSV, and everything else as iCalendar.
+ *
+ * Returns: the #GtdExportFormat for @filename
+ */
+GtdExportFormat
+gtd_exporter_get_format_for_filename (const gchar *filename)
+{
+  g_return_val_if_fail (filename, GTD_EXPORT_FORMAT_ICALENDAR);
+
+  if (g_str_has_suffix (filename, ".jsonl") || g_str_has_suffix (filename, ".json"))
+    return GTD_EXPORT_FORMAT_JSON_LINES;
+
+  if (g_str_has_suffix (filename, ".csv"))
+    return GTD_EXPORT_FORMAT_CSV;
+
+  return GTD_EXPORT_FORMAT_ICALENDAR;
+}
@@ -0,0 +1,63 @@
+/* gtd-exporter.h
+ *
+ * Copyright (C) 2015 Georges Basile Stavracas Neto <georges.stavracas@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef GTD_EXPORTER_H
+#define GTD_EXPORTER_H
+
+#include "gtd-types.h"
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+#define GTD_TYPE_EXPORTER (gtd_exporter_get_type())
+
+G_DECLARE_FINAL_TYPE (GtdExporter, gtd_exporter, GTD, EXPORTER, GObject)
+
+GtdExporter*            gtd_exporter_new                        (GtdExportFormat         format);
+
+GtdExportFormat         gtd_exporter_get_format                 (GtdExporter            *exporter);
+
+void                    gtd_exporter_add_list                   (GtdExporter            *exporter,
+                                                                 GtdTaskList            *list);
+
+void                    gtd_exporter_add_task                   (GtdExporter            *exporter,
+                                                                 GtdTask                *task);
+
+guint                   gtd_exporter_get_n_tasks                (GtdExporter            *exporter);
+
+void                    gtd_exporter_export                     (GtdExporter            *exporter,
+                                                                 GOutputStream          *stream,
+                                                                 GCancellable           *cancellable,
+                                                                 GAsyncReadyCallback     callback,
+                                                                 gpointer                user_data);
+
+gboolean                gtd_exporter_export_finish              (GtdExporter            *exporter,
+                                                                 GAsyncResult           *result,
+                                                                 GError                **error);
+
+gboolean                gtd_exporter_export_sync                (GtdExporter            *exporter,
+                                                                 GOutputStream          *stream,
+                                                                 GCancellable           *cancellable,
+                                                                 GError                **error);
+
+GtdExportFormat         gtd_exporter_get_format_for_filename    (const gchar            *filename);
+
+G_END_DECLS
+
+#endif /* GTD_EXPORTER_H */
@@ -0,0 +1,760 @@
+/* gtd-importer.c
+ *
+ * Copyright (C) 2015 Georges Basile Stavracas Neto <georges.stavracas@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gtd-importer.h"
+#include "gtd-local-store.h"
+#include "gtd-manager.h"
+#include "gtd-rule-engine.h"
+#include "gtd-task.h"
+#include "gtd-task-list.h"
+
+#include <glib/gi18n.h>
+#include <libecal/libecal.h>
+#include <string.h>
+
+/*
+ * iCalendar files are read one line at a time, and only the text of
+ * the VTODO being read is kept in memory. Parsed components are queued
+ * and sent to the backend in batches, so importing a file with thousands
+ * of tasks doesn't need thousands of round trips.
+ *
+ * The VTIMEZONEs of the file are kept too. Date-times in zones that
+ * libical doesn't know, like the ones Exchange and Outlook write, are
+ * converted to UTC with them, since the list they are imported into
+ * can't resolve those zones.
+ */
+
+#define IMPORT_BATCH_SIZE                100
+
+typedef struct
+{
+  GtdManager           *manager;
+  GtdTaskList          *list;
+
+  /* Running import */
+  GTask                *task;
+  GDataInputStream     *stream;
+  GString              *component;
+  gboolean              in_todo;
+  gboolean              in_timezone;
+  gboolean              at_eof;
+
+  /* Zones defined by the file, by TZID */
+  GHashTable           *zones;
+
+  /* UIDs already in the list, and the ones imported so far */
+  GHashTable           *uids;
+
+  /* Components waiting to be sent to the backend */
+  GSList               *batch;
+  guint                 batch_size;
+
+  guint                 n_imported;
+  guint                 n_skipped;
+} GtdImporterPrivate;
+
+struct _GtdImporter
+{
+  GObject               parent;
+
+  /*<private>*/
+  GtdImporterPrivate   *priv;
+};
+
+enum
+{
+  PROGRESS,
+  NUM_SIGNALS
+};
+
+G_DEFINE_TYPE_WITH_PRIVATE (GtdImporter, gtd_importer, G_TYPE_OBJECT)
+
+static guint signals[NUM_SIGNALS] = { 0, };
+
+static void          gtd_importer__read_next                     (GtdImporter           *importer);
+
+static void
+gtd_importer__free_zone (icaltimezone *zone)
+{
+  icaltimezone_free (zone, TRUE);
+}
+
+static void
+gtd_importer__free_batch (GtdImporter *importer)
+{
+  GtdImporterPrivate *priv = importer->priv;
+
+  g_slist_free_full (priv->batch, (GDestroyNotify) icalcomponent_free);
+  priv->batch = NULL;
+  priv->batch_size = 0;
+}
+
+static void
+gtd_importer__finish (GtdImporter *importer,
+                      GError      *error)
+{
+  GtdImporterPrivate *priv = importer->priv;
+  GTask *task;
+
+  task = priv->task;
+  priv->task = NULL;
+
+  gtd_importer__free_batch (importer);
+
+  g_clear_object (&priv->stream);
+  g_clear_pointer (&priv->uids, g_hash_table_destroy);
+  g_string_truncate (priv->component, 0);
+
+  if (error)
+    g_task_return_error (task, error);
+  else
+    g_task_return_int (task, priv->n_imported);
+
+  g_object_unref (task);
+}
+
+static void
+gtd_importer__add_task (GtdImporter   *importer,
+                        ECalComponent *component)
+{
+  GtdImporterPrivate *priv = importer->priv;
+  GtdLocalStore *store;
+  GtdTask *task;
+
+  task = gtd_task_new (component);
+  gtd_task_set_list (task, priv->list);
+
+  gtd_task_list_save_task (priv->list, task);
+
+  store = gtd_task_list_get_store (priv->list);
+
+  if (store)
+    gtd_local_store_save_task (store, task);
+
+  /* Add to the virtual lists it matches */
+  gtd_rule_engine_add_task (gtd_manager_get_rule_engine (priv->manager), task);
+
+  priv->n_imported++;
+}
+
+static void
+gtd_importer__continue (GtdImporter *importer)
+{
+  g_signal_emit (importer, signals[PROGRESS], 0);
+
+  if (importer->priv->at_eof)
+    gtd_importer__finish (importer, NULL);
+  else
+    gtd_importer__read_next (importer);
+}
+
+static void
+gtd_importer__create_objects_finished (GObject      *client,
+                                       GAsyncResult *result,
+                                       gpointer      user_data)
+{
+  GtdImporterPrivate *priv;
+  GtdImporter *importer;
+  GSList *new_uids;
+  GSList *uid;
+  GSList *l;
+  GError *error;
+
+  importer = GTD_IMPORTER (user_data);
+  priv = importer->priv;
+  new_uids = NULL;
+  error = NULL;
+
+  e_cal_client_create_objects_finish (E_CAL_CLIENT (client),
+                                      result,
+                                      &new_uids,
+                                      &error);
+
+  if (error)
+    {
+      gtd_importer__finish (importer, error);
+      g_object_unref (importer);
+      return;
+    }
+
+  for (l = priv->batch, uid = new_uids; l != NULL; l = l->next)
+    {
+      ECalComponent *component;
+
+      /* The component takes ownership of the icalcomponent */
+      component = e_cal_component_new_from_icalcomponent (l->data);
+
+      /* The backend may have assigned a new UID to the task */
+      if (uid)
+        {
+          if (uid->data)
+            e_cal_component_set_uid (component, uid->data);
+
+          uid = uid->next;
+        }
+
+      gtd_importer__add_task (importer, component);
+
+      g_object_unref (component);
+    }
+
+  g_slist_free (priv->batch);
+  priv->batch = NULL;
+  priv->batch_size = 0;
+
+  e_client_util_free_string_slist (new_uids);
+
+  gtd_importer__continue (importer);
+  g_object_unref (importer);
+}
+
+static void
+gtd_importer__flush_batch (GtdImporter *importer)
+{
+  GtdImporterPrivate *priv = importer->priv;
+  ECalClient *client;
+  GSList *l;
+
+  priv->batch = g_slist_reverse (priv->batch);
+
+  /* Local lists are written directly */
+  if (gtd_task_list_get_store (priv->list))
+    {
+      for (l = priv->batch; l != NULL; l = l->next)
+        {
+          ECalComponent *component;
+
+          component = e_cal_component_new_from_icalcomponent (l->data);
+
+          gtd_importer__add_task (importer, component);
+
+          g_object_unref (component);
+        }
+
+      g_slist_free (priv->batch);
+      priv->batch = NULL;
+      priv->batch_size = 0;
+
+      gtd_importer__continue (importer);
+      return;
+    }
+
+  client = gtd_task_list_get_client (priv->list);
+
+  if (!client)
+    {
+      gtd_importer__finish (importer,
+                            g_error_new (G_IO_ERROR,
+                                         G_IO_ERROR_NOT_CONNECTED,
+                                         _("The task list is not available")));
+      return;
+    }
+
+  e_cal_client_create_objects (client,
+                               priv->batch,
+                               g_task_get_cancellable (priv->task),
+                               (GAsyncReadyCallback) gtd_importer__create_objects_finished,
+                               g_object_ref (importer));
+}
+
+static void
+gtd_importer__parse_timezone (GtdImporter *importer)
+{
+  GtdImporterPrivate *priv = importer->priv;
+  icalcomponent *component;
+  icaltimezone *zone;
+  const gchar *tzid;
+
+  component = icalcomponent_new_from_string (priv->component->str);
+
+  g_string_truncate (priv->component, 0);
+
+  if (!component || icalcomponent_isa (component) != ICAL_VTIMEZONE_COMPONENT)
+    {
+      g_clear_pointer (&component, icalcomponent_free);
+      return;
+    }
+
+  zone = icaltimezone_new ();
+
+  if (!icaltimezone_set_component (zone, component))
+    {
+      icaltimezone_free (zone, TRUE);
+      icalcomponent_free (component);
+      return;
+    }
+
+  tzid = icaltimezone_get_tzid (zone);
+
+  /* Zones libical knows are resolved anywhere */
+  if (icaltimezone_get_builtin_timezone_from_tzid (tzid) ||
+      icaltimezone_get_builtin_timezone (tzid))
+    {
+      icaltimezone_free (zone, TRUE);
+      return;
+    }
+
+  g_hash_table_replace (priv->zones, g_strdup (tzid), zone);
+}
+
+/* Converts the date-times of @component in zones of the file to UTC */
+static void
+gtd_importer__convert_times (GtdImporter   *importer,
+                             icalcomponent *component)
+{
+  GtdImporterPrivate *priv = importer->priv;
+  icalproperty *prop;
+
+  if (g_hash_table_size (priv->zones) == 0)
+    return;
+
+  for (prop = icalcomponent_get_first_property (component, ICAL_ANY_PROPERTY);
+       prop != NULL;
+       prop = icalcomponent_get_next_property (component, ICAL_ANY_PROPERTY))
+    {
+      struct icaltimetype itt;
+      icalparameter *param;
+      icaltimezone *zone;
+      icalvalue *value;
+
+      param = icalproperty_get_first_parameter (prop, ICAL_TZID_PARAMETER);
+
+      if (!param)
+        continue;
+
+      zone = g_hash_table_lookup (priv->zones, icalparameter_get_tzid (param));
+      value = icalproperty_get_value (prop);
+
+      if (!zone || !value || icalvalue_isa (value) != ICAL_DATETIME_VALUE)
+        continue;
+
+      itt = icalvalue_get_datetime (value);
+
+      icaltimezone_convert_time (&itt, zone, icaltimezone_get_utc_timezone ());
+      itt.is_utc = 1;
+
+      icalvalue_set_datetime (value, itt);
+      icalproperty_remove_parameter_by_kind (prop, ICAL_TZID_PARAMETER);
+    }
+}
+
+static void
+gtd_importer__parse_component (GtdImporter *importer)
+{
+  GtdImporterPrivate *priv = importer->priv;
+  icalcomponent *component;
+  const gchar *uid;
+
+  component = icalcomponent_new_from_string (priv->component->str);
+
+  g_string_truncate (priv->component, 0);
+
+  if (!component || icalcomponent_isa (component) != ICAL_VTODO_COMPONENT)
+    {
+      g_clear_pointer (&component, icalcomponent_free);
+      priv->n_skipped++;
+      return;
+    }
+
+  uid = icalcomponent_get_uid (component);
+
+  if (!uid || *uid == '\0')
+    {
+      gchar *new_uid;
+
+      new_uid = e_cal_component_gen_uid ();
+      icalcomponent_set_uid (component, new_uid);
+      g_free (new_uid);
+
+      uid = icalcomponent_get_uid (component);
+    }
+  else if (g_hash_table_contains (priv->uids, uid))
+    {
+      /* The task is already in the list */
+      icalcomponent_free (component);
+      priv->n_skipped++;
+      return;
+    }
+
+  g_hash_table_add (priv->uids, g_strdup (uid));
+
+  gtd_importer__convert_times (importer, component);
+
+  priv->batch = g_slist_prepend (priv->batch, component);
+  priv->batch_size++;
+}
+
+static void
+gtd_importer__process_line (GtdImporter *importer,
+                            gchar       *line)
+{
+  GtdImporterPrivate *priv = importer->priv;
+  gsize len;
+
+  len = strlen (line);
+
+  if (len > 0 && line[len - 1] == '\r')
+    line[len - 1] = '\0';
+
+  /*
+   * Folded lines start with a space or a tab, so they never match
+   * the delimiters; libical unfolds them when parsing the component.
+   */
+  if (!priv->in_todo && !priv->in_timezone)
+    {
+      if (g_ascii_strcasecmp (line, "BEGIN:VTODO") == 0)
+        priv->in_todo = TRUE;
+      else if (g_ascii_strcasecmp (line, "BEGIN:VTIMEZONE") == 0)
+        priv->in_timezone = TRUE;
+      else
+        return;
+
+      g_string_truncate (priv->component, 0);
+    }
+
+  g_string_append (priv->component, line);
+  g_string_append (priv->component, "\r\n");
+
+  if (priv->in_todo && g_ascii_strcasecmp (line, "END:VTODO") == 0)
+    {
+      priv->in_todo = FALSE;
+      gtd_importer__parse_component (importer);
+    }
+  else if (priv->in_timezone && g_ascii_strcasecmp (line, "END:VTIMEZONE") == 0)
+    {
+      priv->in_timezone = FALSE;
+      gtd_importer__parse_timezone (importer);
+    }
+}
+
+static void
+gtd_importer__line_read (GObject      *stream,
+                         GAsyncResult *result,
+                         gpointer      user_data)
+{
+  GtdImporterPrivate *priv;
+  GtdImporter *importer;
+  GError *error;
+  gchar *line;
+
+  importer = GTD_IMPORTER (user_data);
+  priv = importer->priv;
+  error = NULL;
+
+  line = g_data_input_stream_read_line_finish (G_DATA_INPUT_STREAM (stream),
+                                               result,
+                                               NULL,
+                                               &error);
+
+  if (error)
+    {
+      gtd_importer__finish (importer, error);
+      g_object_unref (importer);
+      return;
+    }
+
+  if (line)
+    {
+      gtd_importer__process_line (importer, line);
+      g_free (line);
+    }
+  else
+    {
+      priv->at_eof = TRUE;
+    }
+
+  if (priv->batch_size >= IMPORT_BATCH_SIZE || (priv->at_eof && priv->batch))
+    gtd_importer__flush_batch (importer);
+  else if (priv->at_eof)
+    gtd_importer__continue (importer);
+  else
+    gtd_importer__read_next (importer);
+
+  g_object_unref (importer);
+}
+
+static void
+gtd_importer__read_next (GtdImporter *importer)
+{
+  GtdImporterPrivate *priv = importer->priv;
+
+  g_data_input_stream_read_line_async (priv->stream,
+                                       G_PRIORITY_LOW,
+                                       g_task_get_cancellable (priv->task),
+                                       (GAsyncReadyCallback) gtd_importer__line_read,
+                                       g_object_ref (importer));
+}
+
+static void
+gtd_importer__file_read (GObject      *file,
+                         GAsyncResult *result,
+                         gpointer      user_data)
+{
+  GtdImporterPrivate *priv;
+  GFileInputStream *stream;
+  GtdImporter *importer;
+  GList *tasks;
+  GList *l;
+  GError *error;
+  gchar **frozen_uids;
+  guint i;
+
+  importer = GTD_IMPORTER (user_data);
+  priv = importer->priv;
+  error = NULL;
+
+  stream = g_file_read_finish (G_FILE (file), result, &error);
+
+  if (error)
+    {
+      gtd_importer__finish (importer, error);
+      g_object_unref (importer);
+      return;
+    }
+
+  priv->stream = g_data_input_stream_new (G_INPUT_STREAM (stream));
+  g_data_input_stream_set_newline_type (priv->stream, G_DATA_STREAM_NEWLINE_TYPE_ANY);
+
+  g_object_unref (stream);
+
+  /* Index the tasks already in the list, so duplicates are skipped */
+  priv->uids = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+  tasks = gtd_task_list_get_tasks (priv->list);
+
+  for (l = tasks; l != NULL; l = l->next)
+    g_hash_table_add (priv->uids, g_strdup (gtd_object_get_uid (l->data)));
+
+  g_list_free (tasks);
+
+  frozen_uids = gtd_task_list_get_frozen_uids (priv->list);
+
+  for (i = 0; frozen_uids[i] != NULL; i++)
+    g_hash_table_add (priv->uids, frozen_uids[i]);
+
+  /* The strings now belong to the table */
+  g_free (frozen_uids);
+
+  gtd_importer__read_next (importer);
+  g_object_unref (importer);
+}
+
+static void
+gtd_importer_finalize (GObject *object)
+{
+  GtdImporter *self = (GtdImporter *)object;
+  GtdImporterPrivate *priv = gtd_importer_get_instance_private (self);
+
+  g_clear_object (&priv->manager);
+  g_clear_object (&priv->list);
+  g_string_free (priv->component, TRUE);
+  g_hash_table_destroy (priv->zones);
+
+  G_OBJECT_CLASS (gtd_importer_parent_class)->finalize (object);
+}
+
+static void
+gtd_importer_class_init (GtdImporterClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->finalize = gtd_importer_finalize;
+
+  /**
+   * GtdImporter::progress:
+   *
+   * The ::progress signal is emmited after each batch of tasks
+   * is imported.
+   */
+  signals[PROGRESS] = g_signal_new ("progress",
+                                    GTD_TYPE_IMPORTER,
+                                    G_SIGNAL_RUN_LAST,
+                                    0,
+                                    NULL,
+                                    NULL,
+                                    NULL,
+                                    G_TYPE_NONE,
+                                    0);
+}
+
+static void
+gtd_importer_init (GtdImporter *self)
+{
+  self->priv = gtd_importer_get_instance_private (self);
+  self->priv->component = g_string_new (NULL);
+  self->priv->zones = g_hash_table_new_full (g_str_hash,
+                                             g_str_equal,
+                                             g_free,
+                                             (GDestroyNotify) gtd_importer__free_zone);
+}
+
+/**
+ * gtd_importer_new:
+ * @manager: a #GtdManager
+ * @list: the #GtdTaskList to import tasks into
+ *
+ * Creates a new #GtdImporter.
+ *
+ * Returns: (transfer full): a new #GtdImporter
+ */
+GtdImporter*
+gtd_importer_new (GtdManager  *manager,
+                  GtdTaskList *list)
+{
+  GtdImporter *self;
+
+  g_return_val_if_fail (GTD_IS_MANAGER (manager), NULL);
+  g_return_val_if_fail (GTD_IS_TASK_LIST (list), NULL);
+
+  self = g_object_new (GTD_TYPE_IMPORTER, NULL);
+  self->priv->manager = g_object_ref (manager);
+  self->priv->list = g_object_ref (list);
+
+  return self;
+}
+
+/**
+ * gtd_importer_get_list:
+ * @importer: a #GtdImporter
+ *
+ * Retrieves the list tasks are imported into.
+ *
+ * Returns: (transfer none): the #GtdTaskList of @importer
+ */
+GtdTaskList*
+gtd_importer_get_list (GtdImporter *importer)
+{
+  g_return_val_if_fail (GTD_IS_IMPORTER (importer), NULL);
+
+  return importer->priv->list;
+}
+
+/**
+ * gtd_importer_get_n_imported:
+ * @importer: a #GtdImporter
+ *
+ * Retrieves the number of tasks imported so far.
+ *
+ * Returns: the number of imported tasks
+ */
+guint
+gtd_importer_get_n_imported (GtdImporter *importer)
+{
+  g_return_val_if_fail (GTD_IS_IMPORTER (importer), 0);
+
+  return importer->priv->n_imported;
+}
+
+/**
+ * gtd_importer_get_n_skipped:
+ * @importer: a #GtdImporter
+ *
+ * Retrieves the number of tasks that were skipped so far, either
+ * because they were already in the list or because they were invalid.
+ *
+ * Returns: the number of skipped tasks
+ */
+guint
+gtd_importer_get_n_skipped (GtdImporter *importer)
+{
+  g_return_val_if_fail (GTD_IS_IMPORTER (importer), 0);
+
+  return importer->priv->n_skipped;
+}
+
+/**
+ * gtd_importer_import:
+ * @importer: a #GtdImporter
+ * @file: the iCalendar file to import
+ * @cancellable: (nullable): a #GCancellable, or %NULL
+ * @callback: the callback to call when the import finishes
+ * @user_data: user data for @callback
+ *
+ * Imports the tasks of @file into the list of @importer. Tasks whose
+ * UID is already in the list are skipped. The ::progress signal is
+ * emitted as tasks are imported.
+ *
+ * Returns:
+ */
+void
+gtd_importer_import (GtdImporter         *importer,
+                     GFile               *file,
+                     GCancellable        *cancellable,
+                     GAsyncReadyCallback  callback,
+                     gpointer             user_data)
+{
+  GtdImporterPrivate *priv;
+  GTask *task;
+
+  g_return_if_fail (GTD_IS_IMPORTER (importer));
+  g_return_if_fail (G_IS_FILE (file));
+
+  priv = importer->priv;
+  task = g_task_new (importer, cancellable, callback, user_data);
+  g_task_set_source_tag (task, gtd_importer_import);
+
+  if (priv->task)
+    {
+      g_task_return_new_error (task,
+                               G_IO_ERROR,
+                               G_IO_ERROR_PENDING,
+                               _("An import is already running"));
+      g_object_unref (task);
+      return;
+    }
+
+  priv->task = task;
+  priv->in_todo = FALSE;
+  priv->in_timezone = FALSE;
+  priv->at_eof = FALSE;
+  priv->n_imported = 0;
+  priv->n_skipped = 0;
+
+  g_hash_table_remove_all (priv->zones);
+
+  g_file_read_async (file,
+                     G_PRIORITY_LOW,
+                     cancellable,
+                     (GAsyncReadyCallback) gtd_importer__file_read,
+                     g_object_ref (importer));
+}
+
+/**
+ * gtd_importer_import_finish:
+ * @importer: a #GtdImporter
+ * @result: a #GAsyncResult
+ * @error: (nullable): return location for a #GError, or %NULL
+ *
+ * Finishes an import started with gtd_importer_import().
+ *
+ * Returns: the number of imported tasks
+ */
+guint
+gtd_importer_import_finish (GtdImporter   *importer,
+                            GAsyncResult  *result,
+                            GError       **error)
+{
+  gssize n_imported;
+
+  g_return_val_if_fail (GTD_IS_IMPORTER (importer), 0);
+  g_return_val_if_fail (g_task_is_valid (result, importer), 0);
+
+  n_imported = g_task_propagate_int (G_TASK (result), error);
+
+  return n_imported > 0 ? n_imported : 0;
+}
@@ -0,0 +1,53 @@
+/* gtd-importer.h
+ *
+ * Copyright (C) 2015 Georges Basile Stavracas Neto <georges.stavracas@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef GTD_IMPORTER_H
+#define GTD_IMPORTER_H
+
+#include "gtd-types.h"
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+#define GTD_TYPE_IMPORTER (gtd_importer_get_type())
+
+G_DECLARE_FINAL_TYPE (GtdImporter, gtd_importer, GTD, IMPORTER, GObject)
+
+GtdImporter*            gtd_importer_new                        (GtdManager             *manager,
+                                                                 GtdTaskList            *list);
+
+GtdTaskList*            gtd_importer_get_list                   (GtdImporter            *importer);
+
+guint                   gtd_importer_get_n_imported             (GtdImporter            *importer);
+
+guint                   gtd_importer_get_n_skipped              (GtdImporter            *importer);
+
+void                    gtd_importer_import                     (GtdImporter            *importer,
+                                                                 GFile                  *file,
+                                                                 GCancellable           *cancellable,
+                                                                 GAsyncReadyCallback     callback,
+                                                                 gpointer                user_data);
+
+guint                   gtd_importer_import_finish              (GtdImporter            *importer,
+                                                                 GAsyncResult           *result,
+                                                                 GError                **error);
+
+G_END_DECLS
+
+#endif /* GTD_IMPORTER_H */
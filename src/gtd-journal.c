@@ -0,0 +1,637 @@
+/* gtd-journal.c
+ *
+ * Copyright (C) 2015 Georges Basile Stavracas Neto <georges.stavracas@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gtd-append-log.h"
+#include "gtd-journal.h"
+
+/*
+ * The journal is stored in a #GtdAppendLog, with one record per
+ * operation:
+ *
+ *   <type> \t <serial> \t <source uid> \t <task uid> \t <data>
+ *
+ * where <type> is 'C', 'M' or 'R' for create, modify and remove
+ * operations, 'S' for an operation that was sent to the source, and
+ * 'D' for an operation that was successfully replayed. The data of a
+ * removal is the UID of the source the task was moved to, if any.
+ */
+
+typedef struct
+{
+  GtdAppendLog         *log;
+
+  /* Live entries, keyed by source and task UID, and their order */
+  GHashTable           *entries;
+  GQueue               *queue;
+  guint64               next_serial;
+} GtdJournalPrivate;
+
+struct _GtdJournal
+{
+  GObject               parent;
+
+  /*<private>*/
+  GtdJournalPrivate    *priv;
+};
+
+G_DEFINE_TYPE_WITH_PRIVATE (GtdJournal, gtd_journal, G_TYPE_OBJECT)
+
+static const gchar operation_types[] = { 'C', 'M', 'R' };
+
+static gchar*
+get_key (const gchar *source_uid,
+         const gchar *task_uid)
+{
+  return g_strconcat (source_uid, "\n", task_uid, NULL);
+}
+
+static GtdJournalEntry*
+gtd_journal_entry_copy (GtdJournalEntry *entry)
+{
+  GtdJournalEntry *copy;
+
+  copy = g_new0 (GtdJournalEntry, 1);
+  copy->operation = entry->operation;
+  copy->source_uid = g_strdup (entry->source_uid);
+  copy->task_uid = g_strdup (entry->task_uid);
+  copy->data = g_strdup (entry->data);
+  copy->serial = entry->serial;
+  copy->sent = entry->sent;
+
+  return copy;
+}
+
+static void
+gtd_journal__write_record (GtdJournal  *journal,
+                           gchar        type,
+                           guint64      serial,
+                           const gchar *source_uid,
+                           const gchar *task_uid,
+                           const gchar *data)
+{
+  const gchar *fields[5];
+  gchar type_str[2] = { type, '\0' };
+  gchar *serial_str;
+
+  serial_str = g_strdup_printf ("%" G_GUINT64_FORMAT, serial);
+
+  fields[0] = type_str;
+  fields[1] = serial_str;
+  fields[2] = source_uid;
+  fields[3] = task_uid;
+  fields[4] = data;
+
+  gtd_append_log_append (journal->priv->log, fields, G_N_ELEMENTS (fields));
+
+  g_free (serial_str);
+}
+
+static void
+gtd_journal__remove_entry (GtdJournal      *journal,
+                           GtdJournalEntry *entry)
+{
+  GtdJournalPrivate *priv = journal->priv;
+  gchar *key;
+
+  key = get_key (entry->source_uid, entry->task_uid);
+
+  g_queue_remove (priv->queue, entry);
+  g_hash_table_remove (priv->entries, key);
+
+  g_free (key);
+}
+
+/*
+ * Merges a new operation into the pending entry of the same task, so
+ * that the journal holds at most one entry per task.
+ */
+static void
+gtd_journal__apply (GtdJournal          *journal,
+                    GtdJournalOperation  operation,
+                    const gchar         *source_uid,
+                    const gchar         *task_uid,
+                    const gchar         *data,
+                    guint64              serial)
+{
+  GtdJournalPrivate *priv = journal->priv;
+  GtdJournalEntry *entry;
+  gchar *key;
+
+  key = get_key (source_uid, task_uid);
+  entry = g_hash_table_lookup (priv->entries, key);
+
+  if (entry)
+    {
+      switch (entry->operation)
+        {
+        case GTD_JOURNAL_OPERATION_CREATE:
+          /* The task never reached the source, so there's nothing to remove */
+          if (operation == GTD_JOURNAL_OPERATION_REMOVE && !entry->sent)
+            {
+              gtd_journal__remove_entry (journal, entry);
+              g_free (key);
+
+              priv->next_serial = MAX (priv->next_serial, serial + 1);
+              return;
+            }
+
+          /* The creation may have reached the source, so remove it there too */
+          if (operation != GTD_JOURNAL_OPERATION_REMOVE)
+            operation = GTD_JOURNAL_OPERATION_CREATE;
+          break;
+
+        case GTD_JOURNAL_OPERATION_REMOVE:
+          /* The task still exists on the source, so it must be updated */
+          if (operation == GTD_JOURNAL_OPERATION_CREATE)
+            operation = GTD_JOURNAL_OPERATION_MODIFY;
+          break;
+
+        case GTD_JOURNAL_OPERATION_MODIFY:
+        default:
+          break;
+        }
+
+      /* Move the entry to the tail of the queue */
+      g_queue_remove (priv->queue, entry);
+      g_clear_pointer (&entry->data, g_free);
+      g_free (key);
+    }
+  else
+    {
+      entry = g_new0 (GtdJournalEntry, 1);
+      entry->source_uid = g_strdup (source_uid);
+      entry->task_uid = g_strdup (task_uid);
+
+      g_hash_table_insert (priv->entries, key, entry);
+    }
+
+  entry->operation = operation;
+  entry->data = g_strdup (data);
+  entry->serial = serial;
+
+  g_queue_push_tail (priv->queue, entry);
+
+  priv->next_serial = MAX (priv->next_serial, serial + 1);
+}
+
+static void
+gtd_journal__complete (GtdJournal  *journal,
+                       const gchar *source_uid,
+                       const gchar *task_uid,
+                       guint64      serial)
+{
+  GtdJournalEntry *entry;
+  gchar *key;
+
+  key = get_key (source_uid, task_uid);
+  entry = g_hash_table_lookup (journal->priv->entries, key);
+
+  /* Only drop the entry if it wasn't superseded in the meantime */
+  if (entry && entry->serial == serial)
+    gtd_journal__remove_entry (journal, entry);
+
+  g_free (key);
+}
+
+static void
+gtd_journal__mark_sent (GtdJournal  *journal,
+                        const gchar *source_uid,
+                        const gchar *task_uid,
+                        guint64      serial)
+{
+  GtdJournalEntry *entry;
+  gchar *key;
+
+  key = get_key (source_uid, task_uid);
+  entry = g_hash_table_lookup (journal->priv->entries, key);
+
+  /* Later operations merged into the entry don't unsend it */
+  if (entry && entry->serial >= serial)
+    entry->sent = TRUE;
+
+  g_free (key);
+}
+
+static void
+gtd_journal__read_record (gchar    **fields,
+                          guint      n_fields,
+                          gpointer   user_data)
+{
+  GtdJournal *journal = user_data;
+  const gchar *data;
+  guint64 serial;
+
+  if (n_fields != 5 || fields[0][0] == '\0' || fields[0][1] != '\0')
+    return;
+
+  serial = g_ascii_strtoull (fields[1], NULL, 10);
+  data = fields[4][0] != '\0' ? fields[4] : NULL;
+
+  switch (fields[0][0])
+    {
+    case 'C':
+      gtd_journal__apply (journal, GTD_JOURNAL_OPERATION_CREATE, fields[2], fields[3], data, serial);
+      break;
+
+    case 'M':
+      gtd_journal__apply (journal, GTD_JOURNAL_OPERATION_MODIFY, fields[2], fields[3], data, serial);
+      break;
+
+    case 'R':
+      gtd_journal__apply (journal, GTD_JOURNAL_OPERATION_REMOVE, fields[2], fields[3], data, serial);
+      break;
+
+    case 'S':
+      gtd_journal__mark_sent (journal, fields[2], fields[3], serial);
+      break;
+
+    case 'D':
+      gtd_journal__complete (journal, fields[2], fields[3], serial);
+      break;
+
+    default:
+      break;
+    }
+}
+
+static void
+gtd_journal__compact (GtdAppendLog *log,
+                      GString      *contents,
+                      gpointer      user_data)
+{
+  GtdJournal *journal = user_data;
+  GList *l;
+
+  for (l = journal->priv->queue->head; l != NULL; l = l->next)
+    {
+      GtdJournalEntry *entry = l->data;
+      const gchar *fields[5];
+      gchar type_str[2] = { operation_types[entry->operation], '\0' };
+      gchar *serial_str;
+
+      serial_str = g_strdup_printf ("%" G_GUINT64_FORMAT, entry->serial);
+
+      fields[0] = type_str;
+      fields[1] = serial_str;
+      fields[2] = entry->source_uid;
+      fields[3] = entry->task_uid;
+      fields[4] = entry->data;
+
+      gtd_append_log_format_record (contents, fields, G_N_ELEMENTS (fields));
+
+      if (entry->sent)
+        {
+          fields[0] = "S";
+          fields[4] = NULL;
+
+          gtd_append_log_format_record (contents, fields, G_N_ELEMENTS (fields));
+        }
+
+      g_free (serial_str);
+    }
+}
+
+static void
+gtd_journal_finalize (GObject *object)
+{
+  GtdJournal *self = (GtdJournal *)object;
+  GtdJournalPrivate *priv = gtd_journal_get_instance_private (self);
+
+  /* The log writes the records of the current batch */
+  g_clear_object (&priv->log);
+
+  g_clear_pointer (&priv->entries, g_hash_table_destroy);
+  g_queue_free (priv->queue);
+
+  G_OBJECT_CLASS (gtd_journal_parent_class)->finalize (object);
+}
+
+static void
+gtd_journal_class_init (GtdJournalClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->finalize = gtd_journal_finalize;
+}
+
+static void
+gtd_journal_init (GtdJournal *self)
+{
+  self->priv = gtd_journal_get_instance_private (self);
+
+  self->priv->next_serial = 1;
+  self->priv->entries = g_hash_table_new_full (g_str_hash,
+                                               g_str_equal,
+                                               g_free,
+                                               (GDestroyNotify) gtd_journal_entry_free);
+  self->priv->queue = g_queue_new ();
+}
+
+/**
+ * gtd_journal_entry_free:
+ * @entry: a #GtdJournalEntry
+ *
+ * Frees @entry.
+ *
+ * Returns:
+ */
+void
+gtd_journal_entry_free (GtdJournalEntry *entry)
+{
+  g_return_if_fail (entry);
+
+  g_free (entry->source_uid);
+  g_free (entry->task_uid);
+  g_free (entry->data);
+  g_free (entry);
+}
+
+/**
+ * gtd_journal_new:
+ * @filename: the path of the journal file
+ *
+ * Creates a new #GtdJournal, loading the pending operations
+ * stored in @filename.
+ *
+ * Returns: (transfer full): a new #GtdJournal
+ */
+GtdJournal*
+gtd_journal_new (const gchar *filename)
+{
+  GtdJournal *self;
+
+  g_return_val_if_fail (filename, NULL);
+
+  self = g_object_new (GTD_TYPE_JOURNAL, NULL);
+  self->priv->log = gtd_append_log_new (filename);
+
+  gtd_append_log_read (self->priv->log, gtd_journal__read_record, self);
+  gtd_append_log_set_n_live (self->priv->log, g_queue_get_length (self->priv->queue));
+  gtd_append_log_set_compact_func (self->priv->log, gtd_journal__compact, self);
+
+  return self;
+}
+
+/**
+ * gtd_journal_append:
+ * @journal: a #GtdJournal
+ * @operation: the operation to record
+ * @source_uid: the UID of the source
+ * @task_uid: the UID of the task
+ * @data: (nullable): the iCalendar string of the task, or the UID of
+ * the source the task was moved to for removals
+ *
+ * Records a pending @operation on a task. Repeated operations on the
+ * same task are collapsed into a single entry.
+ *
+ * Returns: the serial number of the new entry
+ */
+guint64
+gtd_journal_append (GtdJournal          *journal,
+                    GtdJournalOperation  operation,
+                    const gchar         *source_uid,
+                    const gchar         *task_uid,
+                    const gchar         *data)
+{
+  GtdJournalPrivate *priv;
+  guint64 serial;
+
+  g_return_val_if_fail (GTD_IS_JOURNAL (journal), 0);
+  g_return_val_if_fail (source_uid && task_uid, 0);
+
+  priv = journal->priv;
+  serial = priv->next_serial;
+
+  gtd_journal__apply (journal, operation, source_uid, task_uid, data, serial);
+  gtd_journal__write_record (journal,
+                             operation_types[operation],
+                             serial,
+                             source_uid,
+                             task_uid,
+                             data);
+
+  gtd_append_log_set_n_live (priv->log, g_queue_get_length (priv->queue));
+
+  return serial;
+}
+
+/**
+ * gtd_journal_complete:
+ * @journal: a #GtdJournal
+ * @entry: a #GtdJournalEntry
+ *
+ * Marks @entry as successfully replayed. If the task changed again
+ * after @entry was retrieved, the newer entry is kept.
+ *
+ * Returns:
+ */
+void
+gtd_journal_complete (GtdJournal      *journal,
+                      GtdJournalEntry *entry)
+{
+  g_return_if_fail (GTD_IS_JOURNAL (journal));
+  g_return_if_fail (entry);
+
+  gtd_journal_complete_operation (journal, entry->source_uid, entry->task_uid, entry->serial);
+}
+
+/**
+ * gtd_journal_complete_operation:
+ * @journal: a #GtdJournal
+ * @source_uid: the UID of the source
+ * @task_uid: the UID of the task
+ * @serial: the serial number returned by gtd_journal_append()
+ *
+ * Marks the operation appended with @serial as done, without
+ * retrieving its entry first.
+ *
+ * Returns:
+ */
+void
+gtd_journal_complete_operation (GtdJournal  *journal,
+                                const gchar *source_uid,
+                                const gchar *task_uid,
+                                guint64      serial)
+{
+  g_return_if_fail (GTD_IS_JOURNAL (journal));
+  g_return_if_fail (source_uid && task_uid);
+
+  /* The UIDs may belong to the entry, so write the record first */
+  gtd_journal__write_record (journal, 'D', serial, source_uid, task_uid, NULL);
+  gtd_journal__complete (journal, source_uid, task_uid, serial);
+
+  gtd_append_log_set_n_live (journal->priv->log, g_queue_get_length (journal->priv->queue));
+}
+
+/**
+ * gtd_journal_mark_sent:
+ * @journal: a #GtdJournal
+ * @source_uid: the UID of the source
+ * @task_uid: the UID of the task
+ * @serial: the serial number returned by gtd_journal_append()
+ *
+ * Records that the operation appended with @serial was sent to the
+ * source, so it may have been applied there even if it never
+ * completes. A creation that was sent is not dropped by a later
+ * removal of the same task.
+ *
+ * Returns:
+ */
+void
+gtd_journal_mark_sent (GtdJournal  *journal,
+                       const gchar *source_uid,
+                       const gchar *task_uid,
+                       guint64      serial)
+{
+  g_return_if_fail (GTD_IS_JOURNAL (journal));
+  g_return_if_fail (source_uid && task_uid);
+
+  gtd_journal__write_record (journal, 'S', serial, source_uid, task_uid, NULL);
+  gtd_journal__mark_sent (journal, source_uid, task_uid, serial);
+}
+
+/**
+ * gtd_journal_get_entries:
+ * @journal: a #GtdJournal
+ * @source_uid: the UID of a source
+ *
+ * Retrieves the pending entries of @source_uid, in the order they
+ * must be replayed.
+ *
+ * Returns: (transfer full) (element-type GtdJournalEntry): the pending
+ * entries. Free with g_list_free_full() and gtd_journal_entry_free().
+ */
+GList*
+gtd_journal_get_entries (GtdJournal  *journal,
+                         const gchar *source_uid)
+{
+  GList *entries = NULL;
+  GList *l;
+
+  g_return_val_if_fail (GTD_IS_JOURNAL (journal), NULL);
+
+  for (l = journal->priv->queue->tail; l != NULL; l = l->prev)
+    {
+      GtdJournalEntry *entry = l->data;
+
+      if (g_strcmp0 (entry->source_uid, source_uid) == 0)
+        entries = g_list_prepend (entries, gtd_journal_entry_copy (entry));
+    }
+
+  return entries;
+}
+
+/**
+ * gtd_journal_has_entries:
+ * @journal: a #GtdJournal
+ * @source_uid: the UID of a source
+ *
+ * Checks whether there are pending operations on @source_uid.
+ *
+ * Returns: %TRUE if @source_uid has pending entries, %FALSE otherwise
+ */
+gboolean
+gtd_journal_has_entries (GtdJournal  *journal,
+                         const gchar *source_uid)
+{
+  GList *l;
+
+  g_return_val_if_fail (GTD_IS_JOURNAL (journal), FALSE);
+
+  for (l = journal->priv->queue->head; l != NULL; l = l->next)
+    {
+      GtdJournalEntry *entry = l->data;
+
+      if (g_strcmp0 (entry->source_uid, source_uid) == 0)
+        return TRUE;
+    }
+
+  return FALSE;
+}
+
+/**
+ * gtd_journal_contains:
+ * @journal: a #GtdJournal
+ * @source_uid: the UID of a source
+ * @task_uid: the UID of a task
+ *
+ * Checks whether there is a pending operation on the given task.
+ *
+ * Returns: %TRUE if the task has a pending entry, %FALSE otherwise
+ */
+gboolean
+gtd_journal_contains (GtdJournal  *journal,
+                      const gchar *source_uid,
+                      const gchar *task_uid)
+{
+  gboolean contains;
+  gchar *key;
+
+  g_return_val_if_fail (GTD_IS_JOURNAL (journal), FALSE);
+
+  key = get_key (source_uid, task_uid);
+  contains = g_hash_table_contains (journal->priv->entries, key);
+  g_free (key);
+
+  return contains;
+}
+
+/**
+ * gtd_journal_lookup:
+ * @journal: a #GtdJournal
+ * @source_uid: the UID of a source
+ * @task_uid: the UID of a task
+ *
+ * Retrieves the pending entry of the given task.
+ *
+ * Returns: (transfer none) (nullable): the pending entry, which is only
+ * valid until @journal is modified, or %NULL
+ */
+const GtdJournalEntry*
+gtd_journal_lookup (GtdJournal  *journal,
+                    const gchar *source_uid,
+                    const gchar *task_uid)
+{
+  GtdJournalEntry *entry;
+  gchar *key;
+
+  g_return_val_if_fail (GTD_IS_JOURNAL (journal), NULL);
+
+  key = get_key (source_uid, task_uid);
+  entry = g_hash_table_lookup (journal->priv->entries, key);
+  g_free (key);
+
+  return entry;
+}
+
+/**
+ * gtd_journal_flush:
+ * @journal: a #GtdJournal
+ *
+ * Writes the buffered records of @journal to disk, and compacts
+ * the file when most of its records are dead.
+ *
+ * Returns:
+ */
+void
+gtd_journal_flush (GtdJournal *journal)
+{
+  g_return_if_fail (GTD_IS_JOURNAL (journal));
+
+  gtd_append_log_flush (journal->priv->log);
+}
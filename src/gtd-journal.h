@@ -0,0 +1,97 @@
+/* gtd-journal.h
+ *
+ * Copyright (C) 2015 Georges Basile Stavracas Neto <georges.stavracas@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef GTD_JOURNAL_H
+#define GTD_JOURNAL_H
+
+#include "gtd-enums.h"
+#include "gtd-types.h"
+
+#include <glib-object.h>
+
+G_BEGIN_DECLS
+
+#define GTD_TYPE_JOURNAL (gtd_journal_get_type())
+
+G_DECLARE_FINAL_TYPE (GtdJournal, gtd_journal, GTD, JOURNAL, GObject)
+
+/**
+ * GtdJournalEntry:
+ * @operation: the pending operation
+ * @source_uid: the UID of the source the operation targets
+ * @task_uid: the UID of the task
+ * @data: the iCalendar string of the task or, for removals, the UID
+ *   of the source the task was moved to, if any
+ * @serial: the serial number of the entry
+ * @sent: whether a creation was already sent to the source
+ *
+ * A pending operation on a task. Entries returned by the journal are
+ * copies, and must be freed with gtd_journal_entry_free().
+ */
+typedef struct
+{
+  GtdJournalOperation operation;
+  gchar              *source_uid;
+  gchar              *task_uid;
+  gchar              *data;
+  guint64             serial;
+  gboolean            sent;
+} GtdJournalEntry;
+
+void                    gtd_journal_entry_free                  (GtdJournalEntry        *entry);
+
+GtdJournal*             gtd_journal_new                         (const gchar            *filename);
+
+guint64                 gtd_journal_append                      (GtdJournal             *journal,
+                                                                 GtdJournalOperation     operation,
+                                                                 const gchar            *source_uid,
+                                                                 const gchar            *task_uid,
+                                                                 const gchar            *data);
+
+void                    gtd_journal_complete                    (GtdJournal             *journal,
+                                                                 GtdJournalEntry        *entry);
+
+void                    gtd_journal_complete_operation          (GtdJournal             *journal,
+                                                                 const gchar            *source_uid,
+                                                                 const gchar            *task_uid,
+                                                                 guint64                 serial);
+
+void                    gtd_journal_mark_sent                   (GtdJournal             *journal,
+                                                                 const gchar            *source_uid,
+                                                                 const gchar            *task_uid,
+                                                                 guint64                 serial);
+
+GList*                  gtd_journal_get_entries                 (GtdJournal             *journal,
+                                                                 const gchar            *source_uid);
+
+gboolean                gtd_journal_has_entries                 (GtdJournal             *journal,
+                                                                 const gchar            *source_uid);
+
+gboolean                gtd_journal_contains                    (GtdJournal             *journal,
+                                                                 const gchar            *source_uid,
+                                                                 const gchar            *task_uid);
+
+const GtdJournalEntry*  gtd_journal_lookup                      (GtdJournal             *journal,
+                                                                 const gchar            *source_uid,
+                                                                 const gchar            *task_uid);
+
+void                    gtd_journal_flush                       (GtdJournal             *journal);
+
+G_END_DECLS
+
+#endif /* GTD_JOURNAL_H */
@@ -0,0 +1,628 @@
+/* gtd-local-store.c
+ *
+ * Copyright (C) 2015 Georges Basile Stavracas Neto <georges.stavracas@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gtd-append-log.h"
+#include "gtd-local-store.h"
+#include "gtd-task.h"
+
+#include <glib/gi18n.h>
+#include <libecal/libecal.h>
+
+/*
+ * Tasks of local lists are stored in a #GtdAppendLog, one record per
+ * write:
+ *
+ *   T \t <uid> \t <title> \t <description> \t <priority> \t <due date> \t <due tzid>
+ *     \t <completed> \t <status> \t <percent> \t <sequence> \t <created>
+ *     \t <last modified> \t <stamp> \t <extra>
+ *   X \t <uid>
+ *
+ * for saved and removed tasks. The properties To Do knows about are
+ * kept as plain fields, and empty fields stand for missing properties.
+ * Everything else, like recurrences, alarms or X- properties, is kept
+ * verbatim in <extra> as iCalendar lines, so it survives a round trip
+ * but is only parsed when there is any.
+ *
+ * The latest record of each task is kept in memory, indexed by UID,
+ * and is what the log is compacted to.
+ */
+
+enum
+{
+  FIELD_TYPE,
+  FIELD_UID,
+  FIELD_TITLE,
+  FIELD_DESCRIPTION,
+  FIELD_PRIORITY,
+  FIELD_DUE_DATE,
+  FIELD_DUE_TZID,
+  FIELD_COMPLETED,
+  FIELD_STATUS,
+  FIELD_PERCENT,
+  FIELD_SEQUENCE,
+  FIELD_CREATED,
+  FIELD_LAST_MODIFIED,
+  FIELD_STAMP,
+  FIELD_EXTRA,
+  N_FIELDS
+};
+
+typedef struct
+{
+  GtdAppendLog         *log;
+
+  /* The latest record of each task, keyed by UID */
+  GHashTable           *records;
+} GtdLocalStorePrivate;
+
+struct _GtdLocalStore
+{
+  GObject               parent;
+
+  /*<private>*/
+  GtdLocalStorePrivate *priv;
+};
+
+G_DEFINE_TYPE_WITH_PRIVATE (GtdLocalStore, gtd_local_store, G_TYPE_OBJECT)
+
+static void
+gtd_local_store__read_record (gchar    **fields,
+                              guint      n_fields,
+                              gpointer   user_data)
+{
+  GtdLocalStore *store = user_data;
+
+  if (n_fields == N_FIELDS && g_strcmp0 (fields[FIELD_TYPE], "T") == 0)
+    {
+      g_hash_table_replace (store->priv->records,
+                            g_strdup (fields[FIELD_UID]),
+                            g_strdupv (fields));
+    }
+  else if (n_fields == 2 && g_strcmp0 (fields[FIELD_TYPE], "X") == 0)
+    {
+      g_hash_table_remove (store->priv->records, fields[FIELD_UID]);
+    }
+}
+
+static void
+gtd_local_store__compact (GtdAppendLog *log,
+                          GString      *contents,
+                          gpointer      user_data)
+{
+  GtdLocalStore *store = user_data;
+  GHashTableIter iter;
+  gpointer record;
+
+  g_hash_table_iter_init (&iter, store->priv->records);
+
+  while (g_hash_table_iter_next (&iter, NULL, &record))
+    gtd_append_log_format_record (contents, (const gchar * const *) record, N_FIELDS);
+}
+
+/*
+ * Whether @prop fits in a plain field, i.e. it has no parameters that
+ * would be lost. The VALUE parameter follows from the value itself.
+ */
+static gboolean
+gtd_local_store__is_plain_property (icalproperty *prop)
+{
+  icalparameter *param;
+
+  for (param = icalproperty_get_first_parameter (prop, ICAL_ANY_PARAMETER);
+       param != NULL;
+       param = icalproperty_get_next_parameter (prop, ICAL_ANY_PARAMETER))
+    {
+      icalparameter_kind kind = icalparameter_isa (param);
+
+      if (kind == ICAL_VALUE_PARAMETER)
+        continue;
+
+      if (kind == ICAL_TZID_PARAMETER && icalproperty_isa (prop) == ICAL_DUE_PROPERTY)
+        continue;
+
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
+/*
+ * Stores @prop in its field of @record. Returns %FALSE if @prop has
+ * no field, or can't be stored in it, and must go to the extra lines.
+ */
+static gboolean
+gtd_local_store__store_property (gchar        **record,
+                                 icalproperty  *prop)
+{
+  const gchar *text;
+  guint field;
+
+  switch (icalproperty_isa (prop))
+    {
+    case ICAL_UID_PROPERTY:
+      return TRUE;
+
+    case ICAL_SUMMARY_PROPERTY:
+      field = FIELD_TITLE;
+      break;
+
+    case ICAL_DESCRIPTION_PROPERTY:
+      field = FIELD_DESCRIPTION;
+      break;
+
+    case ICAL_PRIORITY_PROPERTY:
+      field = FIELD_PRIORITY;
+      break;
+
+    case ICAL_DUE_PROPERTY:
+      field = FIELD_DUE_DATE;
+      break;
+
+    case ICAL_COMPLETED_PROPERTY:
+      field = FIELD_COMPLETED;
+      break;
+
+    case ICAL_STATUS_PROPERTY:
+      field = FIELD_STATUS;
+      break;
+
+    case ICAL_PERCENTCOMPLETE_PROPERTY:
+      field = FIELD_PERCENT;
+      break;
+
+    case ICAL_SEQUENCE_PROPERTY:
+      field = FIELD_SEQUENCE;
+      break;
+
+    case ICAL_CREATED_PROPERTY:
+      field = FIELD_CREATED;
+      break;
+
+    case ICAL_LASTMODIFIED_PROPERTY:
+      field = FIELD_LAST_MODIFIED;
+      break;
+
+    case ICAL_DTSTAMP_PROPERTY:
+      field = FIELD_STAMP;
+      break;
+
+    default:
+      return FALSE;
+    }
+
+  /* Repeated properties, and those with parameters, go verbatim */
+  if (record[field] || !gtd_local_store__is_plain_property (prop))
+    return FALSE;
+
+  switch (field)
+    {
+    case FIELD_TITLE:
+    case FIELD_DESCRIPTION:
+      text = field == FIELD_TITLE ? icalproperty_get_summary (prop) : icalproperty_get_description (prop);
+
+      /* Empty fields stand for missing properties */
+      if (!text || text[0] == '\0')
+        return FALSE;
+
+      record[field] = g_strdup (text);
+      break;
+
+    case FIELD_PRIORITY:
+      record[field] = g_strdup_printf ("%d", icalproperty_get_priority (prop));
+      break;
+
+    case FIELD_DUE_DATE:
+      record[field] = icaltime_as_ical_string_r (icalproperty_get_due (prop));
+
+      text = icalproperty_get_parameter_as_string (prop, "TZID");
+      record[FIELD_DUE_TZID] = g_strdup (text ? text : "");
+      break;
+
+    case FIELD_COMPLETED:
+      record[field] = icaltime_as_ical_string_r (icalproperty_get_completed (prop));
+      break;
+
+    case FIELD_STATUS:
+      record[field] = g_strdup (icalproperty_status_to_string (icalproperty_get_status (prop)));
+      break;
+
+    case FIELD_PERCENT:
+      record[field] = g_strdup_printf ("%d", icalproperty_get_percentcomplete (prop));
+      break;
+
+    case FIELD_SEQUENCE:
+      record[field] = g_strdup_printf ("%d", icalproperty_get_sequence (prop));
+      break;
+
+    case FIELD_CREATED:
+      record[field] = icaltime_as_ical_string_r (icalproperty_get_created (prop));
+      break;
+
+    case FIELD_LAST_MODIFIED:
+      record[field] = icaltime_as_ical_string_r (icalproperty_get_lastmodified (prop));
+      break;
+
+    case FIELD_STAMP:
+      record[field] = icaltime_as_ical_string_r (icalproperty_get_dtstamp (prop));
+      break;
+    }
+
+  return TRUE;
+}
+
+static void
+gtd_local_store__add_time (icalcomponent  *component,
+                           icalproperty*  (*new_func) (struct icaltimetype),
+                           const gchar    *value)
+{
+  if (value[0] != '\0')
+    icalcomponent_add_property (component, new_func (icaltime_from_string (value)));
+}
+
+static void
+gtd_local_store__add_int (icalcomponent  *component,
+                          icalproperty*  (*new_func) (int),
+                          const gchar    *value)
+{
+  if (value[0] != '\0')
+    icalcomponent_add_property (component, new_func ((gint) g_ascii_strtoll (value, NULL, 10)));
+}
+
+static GtdTask*
+gtd_local_store__create_task (gchar **record)
+{
+  ECalComponent *component;
+  icalcomponent *ical;
+  GtdTask *task;
+
+  /* Only tasks with properties To Do doesn't know need the parser */
+  if (record[FIELD_EXTRA][0] != '\0')
+    {
+      gchar *str;
+
+      str = g_strconcat ("BEGIN:VTODO\r\n", record[FIELD_EXTRA], "END:VTODO\r\n", NULL);
+      ical = icalcomponent_new_from_string (str);
+
+      g_free (str);
+    }
+  else
+    {
+      ical = icalcomponent_new (ICAL_VTODO_COMPONENT);
+    }
+
+  if (!ical)
+    {
+      g_warning ("%s: %s (%s)",
+                 G_STRFUNC,
+                 _("Error parsing stored task"),
+                 record[FIELD_UID]);
+
+      return NULL;
+    }
+
+  icalcomponent_add_property (ical, icalproperty_new_uid (record[FIELD_UID]));
+
+  if (record[FIELD_TITLE][0] != '\0')
+    icalcomponent_add_property (ical, icalproperty_new_summary (record[FIELD_TITLE]));
+
+  if (record[FIELD_DESCRIPTION][0] != '\0')
+    icalcomponent_add_property (ical, icalproperty_new_description (record[FIELD_DESCRIPTION]));
+
+  if (record[FIELD_DUE_DATE][0] != '\0')
+    {
+      icalproperty *due;
+
+      due = icalproperty_new_due (icaltime_from_string (record[FIELD_DUE_DATE]));
+
+      if (record[FIELD_DUE_TZID][0] != '\0')
+        icalproperty_add_parameter (due, icalparameter_new_tzid (record[FIELD_DUE_TZID]));
+
+      icalcomponent_add_property (ical, due);
+    }
+
+  if (record[FIELD_STATUS][0] != '\0')
+    icalcomponent_add_property (ical, icalproperty_new_status (icalproperty_string_to_status (record[FIELD_STATUS])));
+
+  gtd_local_store__add_int (ical, icalproperty_new_priority, record[FIELD_PRIORITY]);
+  gtd_local_store__add_int (ical, icalproperty_new_percentcomplete, record[FIELD_PERCENT]);
+  gtd_local_store__add_int (ical, icalproperty_new_sequence, record[FIELD_SEQUENCE]);
+
+  gtd_local_store__add_time (ical, icalproperty_new_completed, record[FIELD_COMPLETED]);
+  gtd_local_store__add_time (ical, icalproperty_new_created, record[FIELD_CREATED]);
+  gtd_local_store__add_time (ical, icalproperty_new_lastmodified, record[FIELD_LAST_MODIFIED]);
+  gtd_local_store__add_time (ical, icalproperty_new_dtstamp, record[FIELD_STAMP]);
+
+  /* Takes ownership of @ical, and frees it on errors */
+  component = e_cal_component_new_from_icalcomponent (ical);
+
+  if (!component)
+    return NULL;
+
+  task = gtd_task_new (component);
+
+  g_object_unref (component);
+
+  return task;
+}
+
+static gchar**
+gtd_local_store__create_record (GtdTask *task)
+{
+  icalcomponent *component;
+  icalcomponent *child;
+  icalproperty *prop;
+  GString *extra;
+  gchar **record;
+  guint i;
+
+  component = e_cal_component_get_icalcomponent (gtd_task_get_component (task));
+  extra = g_string_new ("");
+
+  record = g_new0 (gchar*, N_FIELDS + 1);
+  record[FIELD_TYPE] = g_strdup ("T");
+  record[FIELD_UID] = g_strdup (gtd_object_get_uid (GTD_OBJECT (task)));
+
+  for (prop = icalcomponent_get_first_property (component, ICAL_ANY_PROPERTY);
+       prop != NULL;
+       prop = icalcomponent_get_next_property (component, ICAL_ANY_PROPERTY))
+    {
+      gchar *str;
+
+      if (gtd_local_store__store_property (record, prop))
+        continue;
+
+      str = icalproperty_as_ical_string_r (prop);
+      g_string_append (extra, str);
+      g_free (str);
+    }
+
+  /* Alarms and other subcomponents */
+  for (child = icalcomponent_get_first_component (component, ICAL_ANY_COMPONENT);
+       child != NULL;
+       child = icalcomponent_get_next_component (component, ICAL_ANY_COMPONENT))
+    {
+      gchar *str;
+
+      str = icalcomponent_as_ical_string_r (child);
+      g_string_append (extra, str);
+      g_free (str);
+    }
+
+  for (i = FIELD_TITLE; i < FIELD_EXTRA; i++)
+    {
+      if (!record[i])
+        record[i] = g_strdup ("");
+    }
+
+  record[FIELD_EXTRA] = g_string_free (extra, FALSE);
+
+  return record;
+}
+
+static void
+gtd_local_store_finalize (GObject *object)
+{
+  GtdLocalStore *self = (GtdLocalStore *)object;
+  GtdLocalStorePrivate *priv = gtd_local_store_get_instance_private (self);
+
+  g_clear_object (&priv->log);
+  g_clear_pointer (&priv->records, g_hash_table_destroy);
+
+  G_OBJECT_CLASS (gtd_local_store_parent_class)->finalize (object);
+}
+
+static void
+gtd_local_store_class_init (GtdLocalStoreClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->finalize = gtd_local_store_finalize;
+}
+
+static void
+gtd_local_store_init (GtdLocalStore *self)
+{
+  self->priv = gtd_local_store_get_instance_private (self);
+  self->priv->records = g_hash_table_new_full (g_str_hash,
+                                               g_str_equal,
+                                               g_free,
+                                               (GDestroyNotify) g_strfreev);
+}
+
+/**
+ * gtd_local_store_new:
+ * @filename: the path of the store
+ *
+ * Creates a new #GtdLocalStore, loading the tasks stored in @filename.
+ *
+ * Returns: (transfer full): a new #GtdLocalStore
+ */
+GtdLocalStore*
+gtd_local_store_new (const gchar *filename)
+{
+  GtdLocalStore *self;
+
+  g_return_val_if_fail (filename, NULL);
+
+  self = g_object_new (GTD_TYPE_LOCAL_STORE, NULL);
+  self->priv->log = gtd_append_log_new (filename);
+
+  gtd_append_log_read (self->priv->log, gtd_local_store__read_record, self);
+  gtd_append_log_set_n_live (self->priv->log, g_hash_table_size (self->priv->records));
+  gtd_append_log_set_compact_func (self->priv->log, gtd_local_store__compact, self);
+
+  return self;
+}
+
+/**
+ * gtd_local_store_exists:
+ * @filename: the path of a store
+ *
+ * Checks whether a store was already created at @filename.
+ *
+ * Returns: %TRUE if @filename exists, %FALSE otherwise
+ */
+gboolean
+gtd_local_store_exists (const gchar *filename)
+{
+  g_return_val_if_fail (filename, FALSE);
+
+  return g_file_test (filename, G_FILE_TEST_EXISTS);
+}
+
+/**
+ * gtd_local_store_get_tasks:
+ * @store: a #GtdLocalStore
+ *
+ * Creates a #GtdTask for each task in @store.
+ *
+ * Returns: (transfer full) (element-type GtdTask): the tasks of @store.
+ */
+GList*
+gtd_local_store_get_tasks (GtdLocalStore *store)
+{
+  GHashTableIter iter;
+  gpointer record;
+  GList *tasks;
+
+  g_return_val_if_fail (GTD_IS_LOCAL_STORE (store), NULL);
+
+  tasks = NULL;
+  g_hash_table_iter_init (&iter, store->priv->records);
+
+  while (g_hash_table_iter_next (&iter, NULL, &record))
+    {
+      GtdTask *task;
+
+      task = gtd_local_store__create_task (record);
+
+      if (task)
+        tasks = g_list_prepend (tasks, task);
+    }
+
+  return tasks;
+}
+
+/**
+ * gtd_local_store_get_n_tasks:
+ * @store: a #GtdLocalStore
+ *
+ * Retrieves the number of tasks in @store.
+ *
+ * Returns: the number of tasks in @store
+ */
+guint
+gtd_local_store_get_n_tasks (GtdLocalStore *store)
+{
+  g_return_val_if_fail (GTD_IS_LOCAL_STORE (store), 0);
+
+  return g_hash_table_size (store->priv->records);
+}
+
+/**
+ * gtd_local_store_save_task:
+ * @store: a #GtdLocalStore
+ * @task: a #GtdTask
+ *
+ * Adds @task to @store, or updates it if it's already there. The
+ * record is written to disk with the next batch.
+ *
+ * Returns:
+ */
+void
+gtd_local_store_save_task (GtdLocalStore *store,
+                           GtdTask       *task)
+{
+  GtdLocalStorePrivate *priv;
+  gchar **record;
+
+  g_return_if_fail (GTD_IS_LOCAL_STORE (store));
+  g_return_if_fail (GTD_IS_TASK (task));
+
+  priv = store->priv;
+  record = gtd_local_store__create_record (task);
+
+  gtd_append_log_append (priv->log, (const gchar * const *) record, N_FIELDS);
+  g_hash_table_replace (priv->records, g_strdup (record[FIELD_UID]), record);
+
+  gtd_append_log_set_n_live (priv->log, g_hash_table_size (priv->records));
+}
+
+/**
+ * gtd_local_store_remove_task:
+ * @store: a #GtdLocalStore
+ * @uid: the UID of a task
+ *
+ * Removes the task identified by @uid from @store.
+ *
+ * Returns:
+ */
+void
+gtd_local_store_remove_task (GtdLocalStore *store,
+                             const gchar   *uid)
+{
+  GtdLocalStorePrivate *priv;
+  const gchar *record[2];
+
+  g_return_if_fail (GTD_IS_LOCAL_STORE (store));
+  g_return_if_fail (uid);
+
+  priv = store->priv;
+
+  if (!g_hash_table_remove (priv->records, uid))
+    return;
+
+  record[FIELD_TYPE] = "X";
+  record[FIELD_UID] = uid;
+
+  gtd_append_log_append (priv->log, record, G_N_ELEMENTS (record));
+  gtd_append_log_set_n_live (priv->log, g_hash_table_size (priv->records));
+}
+
+/**
+ * gtd_local_store_flush:
+ * @store: a #GtdLocalStore
+ *
+ * Writes the pending records of @store to disk.
+ *
+ * Returns:
+ */
+void
+gtd_local_store_flush (GtdLocalStore *store)
+{
+  g_return_if_fail (GTD_IS_LOCAL_STORE (store));
+
+  gtd_append_log_flush (store->priv->log);
+}
+
+/**
+ * gtd_local_store_delete:
+ * @store: a #GtdLocalStore
+ *
+ * Deletes every task of @store, and its file.
+ *
+ * Returns:
+ */
+void
+gtd_local_store_delete (GtdLocalStore *store)
+{
+  g_return_if_fail (GTD_IS_LOCAL_STORE (store));
+
+  g_hash_table_remove_all (store->priv->records);
+  gtd_append_log_delete (store->priv->log);
+}
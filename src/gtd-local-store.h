@@ -0,0 +1,52 @@
+/* gtd-local-store.h
+ *
+ * Copyright (C) 2015 Georges Basile Stavracas Neto <georges.stavracas@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef GTD_LOCAL_STORE_H
+#define GTD_LOCAL_STORE_H
+
+#include "gtd-types.h"
+
+#include <glib-object.h>
+
+G_BEGIN_DECLS
+
+#define GTD_TYPE_LOCAL_STORE (gtd_local_store_get_type())
+
+G_DECLARE_FINAL_TYPE (GtdLocalStore, gtd_local_store, GTD, LOCAL_STORE, GObject)
+
+GtdLocalStore*          gtd_local_store_new                     (const gchar            *filename);
+
+gboolean                gtd_local_store_exists                  (const gchar            *filename);
+
+GList*                  gtd_local_store_get_tasks               (GtdLocalStore          *store);
+
+guint                   gtd_local_store_get_n_tasks             (GtdLocalStore          *store);
+
+void                    gtd_local_store_save_task               (GtdLocalStore          *store,
+                                                                 GtdTask                *task);
+
+void                    gtd_local_store_remove_task             (GtdLocalStore          *store,
+                                                                 const gchar            *uid);
+
+void                    gtd_local_store_flush                   (GtdLocalStore          *store);
+
+void                    gtd_local_store_delete                  (GtdLocalStore          *store);
+
+G_END_DECLS
+
+#endif /* GTD_LOCAL_STORE_H */
@@ -16,7 +16,13 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include "gtd-cancellable.h"
+#include "gtd-deletion-queue.h"
+#include "gtd-journal.h"
+#include "gtd-local-store.h"
 #include "gtd-manager.h"
+#include "gtd-rule-engine.h"
+#include "gtd-search-index.h"
 #include "gtd-storage.h"
 #include "gtd-task.h"
 #include "gtd-task-list.h"
@@ -27,30 +33,81 @@
 
 typedef struct
 {
-  GHashTable            *clients;
+  /* Task lists, indexed by their ESource */
+  GHashTable            *lists;
   GList                 *task_lists;
   ECredentialsPrompter  *credentials_prompter;
   ESourceRegistry       *source_registry;
 
   /*
-   * Today & Scheduled lists
+   * Today & Scheduled lists, kept up to date
+   * by the rule engine.
    */
+  GtdRuleEngine         *rule_engine;
   GtdTaskList           *today_tasks_list;
   GtdTaskList           *scheduled_tasks_list;
 
+  /* Task titles, for the shell search provider */
+  GtdSearchIndex        *search_index;
+
   /* Online accounts */
   GoaClient             *goa_client;
   gboolean               goa_client_ready;
   GList                 *storage_locations;
 
+  /* Task list sources, indexed by their GOA account id */
+  GHashTable            *goa_sources;
+
   GSettings             *settings;
 
   /*
-   * Small flag that contains the number of sources
-   * that still have to be loaded. When this number
-   * reaches 0, all sources are loaded.
+   * Root of the cancellation hierarchy. Each source has
+   * a child cancellable, keyed by the source UID, which
+   * is the parent of the task list's cancellable.
+   */
+  GCancellable          *cancellable;
+  GHashTable            *source_cancellables;
+
+  /* Operations waiting for their sources to come back */
+  GtdJournal            *journal;
+
+  /* Removals that can still be undone */
+  GtdDeletionQueue      *deletions;
+
+  /* Moved tasks found again in their old sources, to be removed */
+  GList                 *interrupted_moves;
+  guint                  moves_idle_id;
+
+  /*
+   * Lists whose completed tasks must not be frozen, with the
+   * number of holds on each. The NULL key holds every list.
    */
-  gint                   load_sources;
+  GHashTable            *completed_holds;
+  guint                  compact_timeout_id;
+
+  /*
+   * Task lists by last use, most recent first, and the
+   * number of holds on each list that is in use.
+   */
+  GQueue                *recent_lists;
+  GHashTable            *list_holds;
+  guint                  budget_idle_id;
+
+  /* Replays of the journal and refreshes running, by task list */
+  GHashTable            *replays;
+  GHashTable            *refreshes;
+
+  /*
+   * Lists whose tasks are fetched for the first time, with whether
+   * they must be synced once that's done, and evicted lists being
+   * loaded again.
+   */
+  GHashTable            *fetches;
+  GHashTable            *reloads;
+
+  /* Updates held back by gtd_manager_begin_updates() */
+  guint                  updates_depth;
+  GHashTable            *pending_updates;
 } GtdManagerPrivate;
 
 struct _GtdManager
@@ -64,10 +121,74 @@ struct _GtdManager
 /* Auxiliary struct for asyncronous task operations */
 typedef struct _TaskData
 {
-  GtdManager *manager;
-  gpointer   *data;
+  GtdManager   *manager;
+  gpointer     *data;
+  GCancellable *cancellable;
+
+  /* Journal serial of the write, for operations on tasks */
+  guint64       serial;
 } TaskData;
 
+/* Auxiliary struct for replaying the journal of a source */
+typedef struct
+{
+  GtdManager   *manager;
+  ECalClient   *client;
+  GtdTaskList  *list;
+  GList        *entries;
+  GList        *current;
+  GCancellable *cancellable;
+
+  /*
+   * Whether the list must be fetched after replaying,
+   * rather than reconciled with the source.
+   */
+  gboolean      fetch;
+
+  /* Whether another replay was asked for while this one ran */
+  gboolean      again;
+} ReplayData;
+
+/* Auxiliary struct for moving tasks to a list, a batch at a time */
+typedef struct
+{
+  GtdManager   *manager;
+  GtdTaskList  *list;
+  GQueue       *pending;
+  GList        *batch;
+  GCancellable *cancellable;
+
+  /* Removal requests of the current batch still running */
+  guint         n_removals;
+} MoveData;
+
+/*
+ * A task being moved, the list it was moved from, and the
+ * serials of both halves of the move in the journal.
+ */
+typedef struct
+{
+  GtdTask      *task;
+  GtdTaskList  *from;
+  MoveData     *move;
+  guint64       create_serial;
+  guint64       remove_serial;
+
+  /* Whether the new source still has a copy of the task */
+  gboolean      in_target;
+} MoveEntry;
+
+/* Deadlines of the backend operations, in seconds */
+#define TASK_OPERATION_TIMEOUT           30
+#define LIST_FETCH_TIMEOUT               120
+#define SOURCE_OPERATION_TIMEOUT         30
+
+/* Tasks created in the new source per request when moving */
+#define MOVE_BATCH_SIZE                  250
+
+/* Seconds completed tasks stay loaded after they were last needed */
+#define COMPACT_TIMEOUT                  60
+
 G_DEFINE_TYPE_WITH_PRIVATE (GtdManager, gtd_manager, GTD_TYPE_OBJECT)
 
 const gchar *supported_providers[] = {
@@ -101,35 +222,201 @@ enum
 static guint signals[NUM_SIGNALS] = { 0, };
 
 static TaskData*
-task_data_new (GtdManager *manager,
-               gpointer   *data)
+task_data_new (GtdManager   *manager,
+               gpointer     *data,
+               GCancellable *cancellable)
 {
   TaskData *tdata;
 
   tdata = g_new0 (TaskData, 1);
   tdata->manager = manager;
   tdata->data = data;
+  tdata->cancellable = cancellable;
 
   return tdata;
 }
 
-static gboolean
-is_today (GDateTime *dt)
+static void
+task_data_free (TaskData *data)
+{
+  g_clear_object (&data->cancellable);
+  g_free (data);
+}
+
+static void
+move_entry_free (MoveEntry *entry)
+{
+  g_object_unref (entry->task);
+  g_object_unref (entry->from);
+  g_free (entry);
+}
+
+static void
+move_data_free (MoveData *data)
+{
+  g_queue_free_full (data->pending, (GDestroyNotify) move_entry_free);
+  g_list_free_full (data->batch, (GDestroyNotify) move_entry_free);
+  g_clear_object (&data->cancellable);
+  g_object_unref (data->list);
+  g_free (data);
+}
+
+static void
+gtd_manager__warn_error (const gchar  *function,
+                         const gchar  *message,
+                         GCancellable *cancellable,
+                         const GError *error)
+{
+  /*
+   * Explicit cancellations (e.g. the source was removed) are not
+   * errors, but operations hitting their deadline are.
+   */
+  if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+    {
+      if (cancellable && gtd_cancellable_get_timed_out (cancellable))
+        g_warning ("%s: %s: %s", function, message, _("The operation timed out"));
+
+      return;
+    }
+
+  g_warning ("%s: %s: %s", function, message, error->message);
+}
+
+static GCancellable*
+gtd_manager__get_source_cancellable (GtdManager *manager,
+                                     ESource    *source)
+{
+  GtdManagerPrivate *priv = manager->priv;
+  GCancellable *cancellable;
+
+  cancellable = g_hash_table_lookup (priv->source_cancellables, e_source_get_uid (source));
+
+  if (!cancellable)
+    {
+      cancellable = gtd_cancellable_new (priv->cancellable, 0);
+
+      g_hash_table_insert (priv->source_cancellables,
+                           g_strdup (e_source_get_uid (source)),
+                           cancellable);
+    }
+
+  return cancellable;
+}
+
+static GCancellable*
+gtd_manager__new_list_operation (GtdTaskList *list,
+                                 guint        timeout)
 {
-  GDateTime *today;
+  return gtd_cancellable_new (gtd_task_list_get_cancellable (list), timeout);
+}
 
-  today = g_date_time_new_now_local ();
+/*
+ * Whether the operation failed because the source couldn't be
+ * reached, and thus should be retried when it comes back.
+ */
+static gboolean
+gtd_manager__is_offline_error (GCancellable *cancellable,
+                               const GError *error)
+{
+  if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+    return cancellable && gtd_cancellable_get_timed_out (cancellable);
+
+  return g_error_matches (error, E_CLIENT_ERROR, E_CLIENT_ERROR_REPOSITORY_OFFLINE) ||
+         g_error_matches (error, E_CLIENT_ERROR, E_CLIENT_ERROR_BUSY) ||
+         g_error_matches (error, G_IO_ERROR, G_IO_ERROR_TIMED_OUT) ||
+         g_error_matches (error, G_IO_ERROR, G_IO_ERROR_NETWORK_UNREACHABLE) ||
+         g_error_matches (error, G_IO_ERROR, G_IO_ERROR_HOST_UNREACHABLE) ||
+         g_error_matches (error, G_IO_ERROR, G_IO_ERROR_HOST_NOT_FOUND) ||
+         g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CONNECTION_REFUSED) ||
+         g_error_matches (error, G_IO_ERROR, G_IO_ERROR_NOT_CONNECTED);
+}
 
-  if (g_date_time_get_year (dt) == g_date_time_get_year (today) &&
-      g_date_time_get_month (dt) == g_date_time_get_month (today) &&
-      g_date_time_get_day_of_month (dt) == g_date_time_get_day_of_month (today))
+/*
+ * Whether a write that failed with @error must stay in the journal:
+ * the source couldn't be reached, or To Do is quitting and the write
+ * is replayed the next time it starts.
+ */
+static gboolean
+gtd_manager__keep_write (GtdManager   *manager,
+                         GCancellable *cancellable,
+                         const GError *error)
+{
+  if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED) &&
+      g_cancellable_is_cancelled (manager->priv->cancellable))
     {
       return TRUE;
     }
 
-  g_date_time_unref (today);
+  return gtd_manager__is_offline_error (cancellable, error);
+}
+
+static guint64
+gtd_manager__journal_task (GtdManager          *manager,
+                           GtdJournalOperation  operation,
+                           GtdTask             *task)
+{
+  GtdManagerPrivate *priv = manager->priv;
+  ECalComponent *component;
+  ESource *source;
+  guint64 serial;
+  gchar *data;
+
+  source = gtd_task_list_get_source (gtd_task_get_list (task));
+  component = gtd_task_get_component (task);
+  data = NULL;
+
+  if (operation != GTD_JOURNAL_OPERATION_REMOVE)
+    data = e_cal_component_get_as_string (component);
+
+  serial = gtd_journal_append (priv->journal,
+                               operation,
+                               e_source_get_uid (source),
+                               gtd_object_get_uid (GTD_OBJECT (task)),
+                               data);
+
+  g_free (data);
+
+  return serial;
+}
+
+/* The creation of @task may reach the source from now on */
+static void
+gtd_manager__mark_sent (GtdManager *manager,
+                        GtdTask    *task,
+                        guint64     serial)
+{
+  gtd_journal_mark_sent (manager->priv->journal,
+                         e_source_get_uid (gtd_task_list_get_source (gtd_task_get_list (task))),
+                         gtd_object_get_uid (GTD_OBJECT (task)),
+                         serial);
+}
+
+/*
+ * Drops the journal entry of @task once a write sent after @serial
+ * was journaled finished. Entries journaled afterwards are newer than
+ * the write and are kept, and so are entries of another operation
+ * when the write failed.
+ */
+static void
+gtd_manager__complete_write (GtdManager          *manager,
+                             GtdJournalOperation  operation,
+                             GtdTask             *task,
+                             guint64              serial,
+                             gboolean             failed)
+{
+  const GtdJournalEntry *entry;
+  const gchar *source_uid;
+  const gchar *task_uid;
+
+  source_uid = e_source_get_uid (gtd_task_list_get_source (gtd_task_get_list (task)));
+  task_uid = gtd_object_get_uid (GTD_OBJECT (task));
+
+  entry = gtd_journal_lookup (manager->priv->journal, source_uid, task_uid);
+
+  if (!entry || entry->serial > serial || (failed && entry->operation != operation))
+    return;
 
-  return FALSE;
+  gtd_journal_complete_operation (manager->priv->journal, source_uid, task_uid, entry->serial);
 }
 
 static void
@@ -137,51 +424,168 @@ gtd_manager__setup_url (GtdManager *manager,
                         GtdStorage *storage)
 {
   GtdManagerPrivate *priv;
-  GList *sources;
-  GList *l;
+  ESource *source;
 
   g_return_if_fail (GTD_IS_MANAGER (manager));
   g_return_if_fail (GTD_IS_STORAGE (storage));
 
   priv = manager->priv;
+  source = g_hash_table_lookup (priv->goa_sources, gtd_storage_get_id (storage));
+
+  if (source)
+    gtd_storage_set_parent (storage, e_source_get_uid (source));
+}
+
+/*
+ * Retrieves the account id of the ESourceGoa extension of @source's
+ * ancestors, or %NULL if @source doesn't belong to an online account.
+ */
+static gchar*
+gtd_manager__get_goa_account_id (GtdManager *manager,
+                                 ESource    *source)
+{
+  ESource *goa_source;
+  gchar *account_id;
+
+  goa_source = e_source_registry_find_extension (manager->priv->source_registry,
+                                                 source,
+                                                 E_SOURCE_EXTENSION_GOA);
+
+  if (!goa_source)
+    return NULL;
+
+  account_id = e_source_goa_dup_account_id (e_source_get_extension (goa_source, E_SOURCE_EXTENSION_GOA));
+
+  g_object_unref (goa_source);
+
+  return account_id;
+}
+
+/*
+ * Retrieves the account id @source is indexed under, or %NULL if
+ * @source isn't the storage parent of any account.
+ */
+static const gchar*
+gtd_manager__lookup_indexed_account (GtdManager *manager,
+                                     ESource    *source)
+{
+  GHashTableIter iter;
+  gpointer account_id;
+  gpointer value;
+
+  g_hash_table_iter_init (&iter, manager->priv->goa_sources);
+
+  while (g_hash_table_iter_next (&iter, &account_id, &value))
+    {
+      if (value == source)
+        return account_id;
+    }
+
+  return NULL;
+}
 
-  if (!priv->source_registry)
+static void          gtd_manager__index_source                   (GtdManager         *manager,
+                                                                  ESource            *source);
+
+static void
+gtd_manager__unindex_source (GtdManager *manager,
+                             ESource    *source)
+{
+  GtdManagerPrivate *priv = manager->priv;
+  gchar *account_id;
+  GList *sources;
+  GList *l;
+
+  account_id = g_strdup (gtd_manager__lookup_indexed_account (manager, source));
+
+  if (!account_id)
     return;
 
-  /*
-   * Search for the ESource whose parent source has an ESourceGoa extension.
-   * The ESourceGoa, then, must have the same account uid that of @storage.
-   */
+  g_hash_table_remove (priv->goa_sources, account_id);
+
+  /* Another task list of the same account may take its place */
   sources = e_source_registry_list_sources (priv->source_registry, E_SOURCE_EXTENSION_TASK_LIST);
 
-  for (l = sources; l != NULL; l = l->next)
+  for (l = sources; l != NULL && !g_hash_table_contains (priv->goa_sources, account_id); l = l->next)
     {
-      ESource *source;
-      ESource *goa_source;
+      if (l->data != source)
+        gtd_manager__index_source (manager, l->data);
+    }
 
-      source = l->data;
-      goa_source = e_source_registry_find_extension (priv->source_registry,
-                                                     source,
-                                                     E_SOURCE_EXTENSION_GOA);
+  g_list_free_full (sources, g_object_unref);
 
-      if (goa_source)
+  /* Nothing is left of the account to be the storage's parent */
+  if (!g_hash_table_contains (priv->goa_sources, account_id))
+    {
+      for (l = priv->storage_locations; l != NULL; l = l->next)
         {
-          ESourceGoa *goa_ext;
+          if (g_strcmp0 (gtd_storage_get_id (l->data), account_id) == 0)
+            gtd_storage_set_parent (l->data, NULL);
+        }
+    }
 
-          goa_ext = e_source_get_extension (goa_source, E_SOURCE_EXTENSION_GOA);
+  g_free (account_id);
+}
 
-          /* Found an ESourceGoa with the same uid of storage */
-          if (g_strcmp0 (e_source_goa_get_account_id (goa_ext), gtd_storage_get_id (storage)) == 0)
-            {
-              gtd_storage_set_parent (storage, e_source_get_uid (source));
-              break;
-            }
-        }
+static void
+gtd_manager__index_source (GtdManager *manager,
+                           ESource    *source)
+{
+  GtdManagerPrivate *priv = manager->priv;
+  gchar *account_id;
+  GList *l;
+
+  if (!e_source_has_extension (source, E_SOURCE_EXTENSION_TASK_LIST))
+    return;
+
+  account_id = gtd_manager__get_goa_account_id (manager, source);
+
+  /* The first task list of an account is the storage's parent */
+  if (!account_id || g_hash_table_contains (priv->goa_sources, account_id))
+    {
+      g_free (account_id);
+      return;
+    }
+
+  g_hash_table_insert (priv->goa_sources, account_id, g_object_ref (source));
 
-      g_clear_object (&goa_source);
+  /* Storages of this account can now resolve their url */
+  for (l = priv->storage_locations; l != NULL; l = l->next)
+    {
+      if (g_strcmp0 (gtd_storage_get_id (l->data), account_id) == 0)
+        gtd_manager__setup_url (manager, l->data);
     }
+}
 
-  g_list_free_full (sources, g_object_unref);
+/*
+ * Most changes to a source, e.g. renaming or recoloring it, don't
+ * move it to another account, and leave the index untouched.
+ */
+static void
+gtd_manager__reindex_source (GtdManager *manager,
+                             ESource    *source)
+{
+  const gchar *indexed_id;
+  gchar *account_id;
+
+  if (!e_source_has_extension (source, E_SOURCE_EXTENSION_TASK_LIST))
+    return;
+
+  indexed_id = gtd_manager__lookup_indexed_account (manager, source);
+  account_id = gtd_manager__get_goa_account_id (manager, source);
+
+  /* Moved to another account, or its account has no parent yet */
+  if (indexed_id && g_strcmp0 (indexed_id, account_id) != 0)
+    {
+      gtd_manager__unindex_source (manager, source);
+      gtd_manager__index_source (manager, source);
+    }
+  else if (!indexed_id && account_id && !g_hash_table_contains (manager->priv->goa_sources, account_id))
+    {
+      gtd_manager__index_source (manager, source);
+    }
+
+  g_free (account_id);
 }
 
 static void
@@ -387,25 +791,27 @@ gtd_manager__commit_source_finished (GObject      *registry,
                                      GAsyncResult *result,
                                      gpointer      user_data)
 {
+  TaskData *data = user_data;
   GError *error = NULL;
 
-  g_return_if_fail (GTD_IS_MANAGER (user_data));
+  g_return_if_fail (GTD_IS_MANAGER (data->manager));
 
-  gtd_object_set_ready (GTD_OBJECT (user_data), TRUE);
+  gtd_object_end_operation (GTD_OBJECT (data->manager));
   e_source_registry_commit_source_finish (E_SOURCE_REGISTRY (registry),
                                           result,
                                           &error);
 
   if (error)
     {
-      g_warning ("%s: %s: %s",
-                 G_STRFUNC,
-                 _("Error saving task list"),
-                 error->message);
+      gtd_manager__warn_error (G_STRFUNC,
+                               _("Error saving task list"),
+                               data->cancellable,
+                               error);
 
       g_error_free (error);
-      return;
     }
+
+  task_data_free (data);
 }
 
 static void
@@ -413,30 +819,34 @@ gtd_manager__remove_source_finished (GObject      *source,
                                      GAsyncResult *result,
                                      gpointer      user_data)
 {
-  GtdManagerPrivate *priv = GTD_MANAGER (user_data)->priv;
+  GtdManagerPrivate *priv;
+  TaskData *data = user_data;
   GError *error = NULL;
 
-  g_return_if_fail (GTD_IS_MANAGER (user_data));
+  g_return_if_fail (GTD_IS_MANAGER (data->manager));
+
+  priv = data->manager->priv;
 
-  gtd_object_set_ready (GTD_OBJECT (user_data), TRUE);
+  gtd_object_end_operation (GTD_OBJECT (data->manager));
   e_source_remove_finish (E_SOURCE (source),
                           result,
                           &error);
 
   if (error)
     {
-      g_warning ("%s: %s: %s",
-                 G_STRFUNC,
-                 _("Error removing task list"),
-                 error->message);
+      gtd_manager__warn_error (G_STRFUNC,
+                               _("Error removing task list"),
+                               data->cancellable,
+                               error);
 
       g_error_free (error);
-      return;
     }
   else
     {
-      priv->task_lists = g_list_remove (priv->task_lists, source);
+      priv->task_lists = g_list_remove (priv->task_lists, data->data);
     }
+
+  task_data_free (data);
 }
 
 static void
@@ -455,33 +865,43 @@ gtd_manager__create_task_finished (GObject      *client,
                                      &new_uid,
                                      &error);
 
-  gtd_object_set_ready (GTD_OBJECT (data->data), TRUE);
+  gtd_object_end_operation (GTD_OBJECT (data->data));
 
   if (error)
     {
-      g_warning ("%s: %s: %s",
-                 G_STRFUNC,
-                 _("Error creating task"),
-                 error->message);
+      /* Keep the task, and create it when the source is back */
+      if (gtd_manager__keep_write (data->manager, data->cancellable, error))
+        {
+          gtd_rule_engine_add_task (priv->rule_engine, GTD_TASK (data->data));
+        }
+      else
+        {
+          gtd_manager__complete_write (data->manager,
+                                       GTD_JOURNAL_OPERATION_CREATE,
+                                       GTD_TASK (data->data),
+                                       data->serial,
+                                       TRUE);
+
+          gtd_manager__warn_error (G_STRFUNC,
+                                   _("Error creating task"),
+                                   data->cancellable,
+                                   error);
+        }
 
       g_error_free (error);
-      g_free (data);
+      task_data_free (data);
       return;
     }
   else
     {
-      GDateTime *dt;
-
-      /*
-       * Add in 'Today' and/or 'Scheduled' lists.
-       */
-      dt = gtd_task_get_due_date (GTD_TASK (data->data));
+      gtd_manager__complete_write (data->manager,
+                                   GTD_JOURNAL_OPERATION_CREATE,
+                                   GTD_TASK (data->data),
+                                   data->serial,
+                                   FALSE);
 
-      if (dt)
-        gtd_task_list_save_task (priv->scheduled_tasks_list, (GtdTask*) data->data);
-
-      if (dt && is_today (dt))
-        gtd_task_list_save_task (priv->today_tasks_list, (GtdTask*) data->data);
+      /* Add to the virtual lists it matches */
+      gtd_rule_engine_add_task (priv->rule_engine, GTD_TASK (data->data));
 
       /*
        * In the case the task UID changes because of creation proccess,
@@ -490,10 +910,11 @@ gtd_manager__create_task_finished (GObject      *client,
       if (new_uid)
         {
           gtd_object_set_uid (GTD_OBJECT (data->data), new_uid);
+          gtd_search_index_update_task (priv->search_index, GTD_TASK (data->data));
           g_free (new_uid);
         }
 
-      g_free (data);
+      task_data_free (data);
     }
 }
 
@@ -511,366 +932,2141 @@ gtd_manager__remove_task_finished (GObject      *client,
                                      result,
                                      &error);
 
-  gtd_object_set_ready (GTD_OBJECT (data->data), TRUE);
+  gtd_object_end_operation (GTD_OBJECT (data->data));
 
-  /* Remove from 'Today' or 'Scheduled' as needed */
-  gtd_task_list_remove_task (priv->scheduled_tasks_list, (GtdTask*) data->data);
-  gtd_task_list_remove_task (priv->today_tasks_list, (GtdTask*) data->data);
+  /* Remove from the virtual lists */
+  gtd_rule_engine_remove_task (priv->rule_engine, (GtdTask*) data->data);
 
-  g_object_unref ((GtdTask*) data->data);
-  g_free (data);
+  /* Removed when the source is back */
+  if (error && gtd_manager__keep_write (data->manager, data->cancellable, error))
+    {
+      g_clear_error (&error);
+    }
+  else
+    {
+      gtd_manager__complete_write (data->manager,
+                                   GTD_JOURNAL_OPERATION_REMOVE,
+                                   GTD_TASK (data->data),
+                                   data->serial,
+                                   error != NULL);
+    }
 
   if (error)
     {
-      g_warning ("%s: %s: %s",
-                 G_STRFUNC,
-                 _("Error removing task"),
-                 error->message);
+      gtd_manager__warn_error (G_STRFUNC,
+                               _("Error removing task"),
+                               data->cancellable,
+                               error);
 
       g_error_free (error);
-      return;
     }
+
+  g_object_unref ((GtdTask*) data->data);
+
+  task_data_free (data);
 }
 
 static void
-gtd_manager__update_task_finished (GObject      *client,
-                                   GAsyncResult *result,
-                                   gpointer      user_data)
+gtd_manager__remove_tasks_finished (GObject      *client,
+                                    GAsyncResult *result,
+                                    gpointer      user_data)
 {
   GtdManagerPrivate *priv;
-  GDateTime *dt;
   TaskData *data = user_data;
-  GtdTask *task;
   GError *error = NULL;
+  gboolean offline;
+  GList *l;
 
   priv = data->manager->priv;
-  task = GTD_TASK (data->data);
-  e_cal_client_modify_object_finish (E_CAL_CLIENT (client),
-                                     result,
-                                     &error);
+  e_cal_client_remove_objects_finish (E_CAL_CLIENT (client),
+                                      result,
+                                      &error);
 
-  /* Check if the task still fits internal lists */
-  dt = gtd_task_get_due_date (task);
+  offline = error && gtd_manager__keep_write (data->manager, data->cancellable, error);
 
-  if (dt)
+  for (l = (GList*) data->data; l != NULL; l = l->next)
     {
-      gtd_task_list_save_task (priv->scheduled_tasks_list, task);
+      gtd_object_end_operation (GTD_OBJECT (l->data));
 
-      if (is_today (dt))
-        gtd_task_list_save_task (priv->today_tasks_list, task);
-      else
-        gtd_task_list_remove_task (priv->today_tasks_list, task);
-    }
-  else
-    {
-      gtd_task_list_remove_task (priv->scheduled_tasks_list, task);
-      gtd_task_list_remove_task (priv->today_tasks_list, task);
-    }
-
-  g_clear_pointer (&dt, g_date_time_unref);
-  g_free (data);
+      /* Remove from the virtual lists */
+      gtd_rule_engine_remove_task (priv->rule_engine, l->data);
 
-  gtd_object_set_ready (GTD_OBJECT (data->data), TRUE);
+      if (!offline)
+        gtd_manager__complete_write (data->manager, GTD_JOURNAL_OPERATION_REMOVE, l->data, data->serial, error != NULL);
+    }
 
   if (error)
     {
-      g_warning ("%s: %s: %s",
-                 G_STRFUNC,
-                 _("Error updating task"),
-                 error->message);
+      if (!offline)
+        {
+          gtd_manager__warn_error (G_STRFUNC,
+                                   _("Error removing tasks"),
+                                   data->cancellable,
+                                   error);
+        }
 
       g_error_free (error);
-      return;
     }
+
+  g_list_free_full ((GList*) data->data, g_object_unref);
+
+  task_data_free (data);
 }
 
 static void
-gtd_manager__invoke_authentication (GObject      *source_object,
-                                    GAsyncResult *result,
-                                    gpointer      user_data)
+gtd_manager__update_task_finished (GObject      *client,
+                                   GAsyncResult *result,
+                                   gpointer      user_data)
 {
-  ESource *source = E_SOURCE (source_object);
+  GtdManagerPrivate *priv;
+  TaskData *data = user_data;
+  GtdTask *task;
   GError *error = NULL;
-  gboolean canceled;
 
-  e_source_invoke_authenticate_finish (source,
-                                       result,
-                                       &error);
+  priv = data->manager->priv;
+  task = GTD_TASK (data->data);
+  e_cal_client_modify_object_finish (E_CAL_CLIENT (client),
+                                     result,
+                                     &error);
 
-  canceled = g_error_matches (error,
-                                   G_IO_ERROR,
-                                   G_IO_ERROR_CANCELLED);
+  /* Check if the task still fits the virtual lists */
+  gtd_rule_engine_update_task (priv->rule_engine, task);
 
-  if (!canceled)
+  gtd_object_end_operation (GTD_OBJECT (task));
+
+  /* Updated when the source is back */
+  if (error && gtd_manager__keep_write (data->manager, data->cancellable, error))
+    g_clear_error (&error);
+  else
+    gtd_manager__complete_write (data->manager, GTD_JOURNAL_OPERATION_MODIFY, task, data->serial, error != NULL);
+
+  if (error)
     {
-      g_warning ("%s: %s (%s): %s",
-                 G_STRFUNC,
-                 _("Failed to prompt for credentials"),
-                 e_source_get_uid (source),
-                 error->message);
+      gtd_manager__warn_error (G_STRFUNC,
+                               _("Error updating task"),
+                               data->cancellable,
+                               error);
+
+      g_error_free (error);
     }
 
-  g_clear_error (&error);
+  task_data_free (data);
 }
 
 static void
-gtd_manager__credentials_prompt_done (GObject      *source_object,
-                                      GAsyncResult *result,
-                                      gpointer      user_data)
+gtd_manager__update_tasks_finished (GObject      *client,
+                                    GAsyncResult *result,
+                                    gpointer      user_data)
 {
-  ETrustPromptResponse response = E_TRUST_PROMPT_RESPONSE_UNKNOWN;
-  ESource *source = E_SOURCE (source_object);
+  GtdManagerPrivate *priv;
+  TaskData *data = user_data;
   GError *error = NULL;
+  gboolean offline;
+  GList *l;
 
-  e_trust_prompt_run_for_source_finish (source, result, &response, &error);
+  priv = data->manager->priv;
+  e_cal_client_modify_objects_finish (E_CAL_CLIENT (client),
+                                      result,
+                                      &error);
 
-  if (error)
+  offline = error && gtd_manager__keep_write (data->manager, data->cancellable, error);
+
+  for (l = (GList*) data->data; l != NULL; l = l->next)
     {
-      g_warning ("%s: %s '%s': %s",
-                 G_STRFUNC,
-                 _("Failed to prompt for credentials for"),
-                 e_source_get_display_name (source),
-                 error->message);
+      /* Check if the task still fits the virtual lists */
+      gtd_rule_engine_update_task (priv->rule_engine, l->data);
 
+      gtd_object_end_operation (GTD_OBJECT (l->data));
+
+      if (!offline)
+        gtd_manager__complete_write (data->manager, GTD_JOURNAL_OPERATION_MODIFY, l->data, data->serial, error != NULL);
     }
-  else if (response == E_TRUST_PROMPT_RESPONSE_ACCEPT || response == E_TRUST_PROMPT_RESPONSE_ACCEPT_TEMPORARILY)
+
+  if (error)
     {
-      /* Use NULL credentials to reuse those from the last time. */
-      e_source_invoke_authenticate (source,
-                                    NULL,
-                                    NULL /* cancellable */,
-                                    gtd_manager__invoke_authentication,
-                                    NULL);
+      if (!offline)
+        {
+          gtd_manager__warn_error (G_STRFUNC,
+                                   _("Error updating tasks"),
+                                   data->cancellable,
+                                   error);
+        }
+
+      g_error_free (error);
     }
 
-  g_clear_error (&error);
+  g_list_free_full ((GList*) data->data, g_object_unref);
+
+  task_data_free (data);
 }
 
+/* Moves @task from its list to @list, without touching the sources */
 static void
-gtd_manager__credentials_required (ESourceRegistry          *registry,
-                                   ESource                  *source,
-                                   ESourceCredentialsReason  reason,
-                                   const gchar              *certificate_pem,
-                                   GTlsCertificateFlags      certificate_errors,
-                                   const GError             *error,
-                                   gpointer                  user_data)
+gtd_manager__move_task_to_list (GtdManager  *manager,
+                                GtdTask     *task,
+                                GtdTaskList *list)
 {
-  GtdManagerPrivate *priv;
-
-  g_return_if_fail (GTD_IS_MANAGER (user_data));
+  GtdTaskList *from;
 
-  priv = GTD_MANAGER (user_data)->priv;
+  from = gtd_task_get_list (task);
 
-  if (e_credentials_prompter_get_auto_prompt_disabled_for (priv->credentials_prompter, source))
-    return;
+  /* The list's reference goes along with the task */
+  gtd_task_list_remove_task (from, task);
+  gtd_task_set_list (task, list);
+  gtd_task_list_save_task (list, task);
 
-  if (reason == E_SOURCE_CREDENTIALS_REASON_SSL_FAILED)
-    {
-      e_trust_prompt_run_for_source (e_credentials_prompter_get_dialog_parent (priv->credentials_prompter),
-                                     source,
-                                     certificate_pem,
-                                     certificate_errors,
-                                     error ? error->message : NULL,
-                                     TRUE, // allow saving sources
-                                     NULL, // we won't cancel the operation
-                                     gtd_manager__credentials_prompt_done,
-                                     NULL);
-    }
-  else if (error && reason == E_SOURCE_CREDENTIALS_REASON_ERROR)
-    {
-      g_warning ("%s: %s '%s': %s",
-                 G_STRFUNC,
-                 _("Authentication failure"),
-                 e_source_get_display_name (source),
-                 error->message);
-    }
+  gtd_rule_engine_update_task (manager->priv->rule_engine, task);
 }
 
 static void
-gtd_manager__fill_task_list (GObject      *client,
-                             GAsyncResult *result,
-                             gpointer      user_data)
+gtd_manager__complete_move (GtdManager  *manager,
+                            GtdTaskList *list,
+                            GtdTask     *task,
+                            guint64      serial)
 {
-  GtdManagerPrivate *priv;
-  GtdTaskList *list;
-  TaskData *data = user_data;
-  GSList *component_list;
-  GError *error = NULL;
+  if (serial == 0)
+    return;
 
-  g_return_if_fail (GTD_IS_MANAGER (data->manager));
+  gtd_journal_complete_operation (manager->priv->journal,
+                                  e_source_get_uid (gtd_task_list_get_source (list)),
+                                  gtd_object_get_uid (GTD_OBJECT (task)),
+                                  serial);
+}
 
-  priv = data->manager->priv;
-  list = GTD_TASK_LIST (data->data);
+/*
+ * Whether the removal @entry belongs to a task that was moved to
+ * another source, and wasn't created there yet.
+ */
+static gboolean
+gtd_manager__move_pending (GtdManager            *manager,
+                           const GtdJournalEntry *entry)
+{
+  const GtdJournalEntry *create;
 
-  e_cal_client_get_object_list_as_comps_finish (E_CAL_CLIENT (client),
-                                                result,
-                                                &component_list,
-                                                &error);
+  if (entry->operation != GTD_JOURNAL_OPERATION_REMOVE || !entry->data)
+    return FALSE;
 
-  gtd_object_set_ready (GTD_OBJECT (data->data), TRUE);
-  g_free (data);
+  create = gtd_journal_lookup (manager->priv->journal, entry->data, entry->task_uid);
 
-  if (!error)
-    {
-      GSList *l;
+  return create && create->operation == GTD_JOURNAL_OPERATION_CREATE;
+}
 
-      for (l = component_list; l != NULL; l = l->next)
-        {
-          GDateTime *dt;
-          GtdTask *task;
+/*
+ * Retrieves the removal of @entry from the journal. If the task was
+ * moved again in the meantime, the removal may have been merged into
+ * another operation, or dropped.
+ *
+ * Returns: (nullable): the journal entry of the removal, or %NULL
+ */
+static const GtdJournalEntry*
+gtd_manager__lookup_removal (GtdManager *manager,
+                             MoveEntry  *entry)
+{
+  const GtdJournalEntry *removal;
 
-          task = gtd_task_new (l->data);
-          gtd_task_set_list (task, list);
+  removal = gtd_journal_lookup (manager->priv->journal,
+                                e_source_get_uid (gtd_task_list_get_source (entry->from)),
+                                gtd_object_get_uid (GTD_OBJECT (entry->task)));
 
-          gtd_task_list_save_task (list, task);
+  if (!removal ||
+      removal->operation != GTD_JOURNAL_OPERATION_REMOVE ||
+      removal->serial != entry->remove_serial)
+    {
+      return NULL;
+    }
 
-          /*
-           * Add in 'Today' and/or 'Scheduled' lists.
-           */
-          dt = gtd_task_get_due_date (task);
+  return removal;
+}
 
-          if (dt)
-            gtd_task_list_save_task (priv->scheduled_tasks_list, task);
+static void          gtd_manager__move_next_batch                (MoveData           *data);
 
-          if (dt && is_today (dt))
-            gtd_task_list_save_task (priv->today_tasks_list, task);
+static void
+gtd_manager__remove_moved_tasks_finished (GObject      *client,
+                                          GAsyncResult *result,
+                                          gpointer      user_data)
+{
+  TaskData *data = user_data;
+  MoveData *move;
+  GError *error = NULL;
+  gboolean complete;
+  GList *entries;
+  GList *l;
 
-          g_clear_pointer (&dt, g_date_time_unref);
-        }
+  entries = (GList*) data->data;
+  move = ((MoveEntry*) entries->data)->move;
 
-      e_cal_client_free_ecalcomp_slist (component_list);
+  e_cal_client_remove_objects_finish (E_CAL_CLIENT (client),
+                                      result,
+                                      &error);
+
+  /*
+   * A request removes all of its tasks or none, so a missing task
+   * leaves the others to the journal, which removes them one by one.
+   */
+  if (g_error_matches (error, E_CAL_CLIENT_ERROR, E_CAL_CLIENT_ERROR_OBJECT_NOT_FOUND))
+    {
+      complete = entries->next == NULL;
+      g_clear_error (&error);
+    }
+  else if (error && gtd_manager__keep_write (data->manager, data->cancellable, error))
+    {
+      complete = FALSE;
+      g_clear_error (&error);
     }
   else
     {
-      g_warning ("%s: %s: %s",
-                 G_STRFUNC,
-                 _("Error fetching tasks from list"),
-                 error->message);
+      complete = TRUE;
+    }
 
+  if (error)
+    {
+      gtd_manager__warn_error (G_STRFUNC,
+                               _("Error removing moved tasks"),
+                               data->cancellable,
+                               error);
       g_error_free (error);
-      return;
     }
+
+  for (l = entries; l != NULL; l = l->next)
+    {
+      MoveEntry *entry = l->data;
+
+      if (complete)
+        gtd_manager__complete_move (data->manager, entry->from, entry->task, entry->remove_serial);
+
+      gtd_object_end_operation (GTD_OBJECT (entry->task));
+    }
+
+  g_list_free_full (entries, (GDestroyNotify) move_entry_free);
+
+  task_data_free (data);
+
+  if (move && --move->n_removals == 0)
+    gtd_manager__move_next_batch (move);
 }
 
+/*
+ * Second phase of a move: removes the tasks of @entries from the
+ * sources they were moved from, with a single request per source.
+ * If the entries belong to a move, its next batch starts once all
+ * the requests finished. Takes ownership of @entries.
+ */
 static void
-gtd_manager__on_client_connected (GObject      *source_object,
-                                  GAsyncResult *result,
-                                  gpointer      user_data)
+gtd_manager__remove_moved_tasks (GtdManager *manager,
+                                 GList      *entries,
+                                 MoveData   *move)
 {
-  GtdManagerPrivate *priv = GTD_MANAGER (user_data)->priv;
-  ECalClient *client;
-  ESource *source;
-  GError *error = NULL;
+  GHashTableIter iter;
+  GHashTable *batches;
+  gpointer from;
+  gpointer batch;
+  GList *l;
 
-  source = e_client_get_source (E_CLIENT (source_object));
-  client = E_CAL_CLIENT (e_cal_client_connect_finish (result, &error));
+  batches = g_hash_table_new (g_direct_hash, g_direct_equal);
 
-  /* Update ready flag */
-  priv->load_sources--;
-  gtd_object_set_ready (GTD_OBJECT (user_data),
-                        priv->load_sources <= 0);
+  for (l = entries; l != NULL; l = l->next)
+    {
+      MoveEntry *entry = l->data;
+      const GtdJournalEntry *removal;
 
-  if (!error)
+      entry->move = move;
+      removal = gtd_manager__lookup_removal (manager, entry);
+
+      /* Superseded, or the task moved on and isn't in its new source yet */
+      if (!removal || gtd_manager__move_pending (manager, removal))
+        {
+          gtd_object_end_operation (GTD_OBJECT (entry->task));
+          move_entry_free (entry);
+          continue;
+        }
+
+      batch = g_hash_table_lookup (batches, entry->from);
+      g_hash_table_insert (batches, entry->from, g_list_prepend (batch, entry));
+    }
+
+  g_list_free (entries);
+
+  g_hash_table_iter_init (&iter, batches);
+
+  while (g_hash_table_iter_next (&iter, &from, &batch))
     {
-      GtdTaskList *list;
+      GtdLocalStore *store;
+      ECalClient *client;
+      GSList *ids;
       TaskData *data;
-      ESource *parent;
 
-      /* parent source's display name is list's origin */
-      parent = e_source_registry_ref_source (priv->source_registry, e_source_get_parent (source));
+      store = gtd_task_list_get_store (from);
+      client = gtd_task_list_get_client (from);
 
-      /* creates a new task list */
-      list = gtd_task_list_new (source, e_source_get_display_name (parent));
+      /* Disconnected sources are left to the journal */
+      if (store || !client)
+        {
+          for (l = batch; l != NULL; l = l->next)
+            {
+              MoveEntry *entry = l->data;
 
-      /* it's not ready until we fetch the list of tasks from client */
-      gtd_object_set_ready (GTD_OBJECT (list), FALSE);
+              if (store)
+                {
+                  gtd_local_store_remove_task (store, gtd_object_get_uid (GTD_OBJECT (entry->task)));
+                  gtd_manager__complete_move (manager, from, entry->task, entry->remove_serial);
+                }
 
-      /* async data */
-      data = task_data_new (user_data, (gpointer) list);
+              gtd_object_end_operation (GTD_OBJECT (entry->task));
+            }
 
-      /* asyncronously fetch the task list */
-      e_cal_client_get_object_list_as_comps (client,
-                                             "contains? \"any\" \"\"",
-                                             NULL,
-                                             (GAsyncReadyCallback) gtd_manager__fill_task_list,
-                                             data);
+          g_list_free_full (batch, (GDestroyNotify) move_entry_free);
+          continue;
+        }
 
+      ids = NULL;
 
-      priv->task_lists = g_list_append (priv->task_lists, list);
+      for (l = batch; l != NULL; l = l->next)
+        {
+          MoveEntry *entry = l->data;
 
-      g_object_set_data (G_OBJECT (source), "task-list", list);
-      g_hash_table_insert (priv->clients, source, client);
+          ids = g_slist_prepend (ids, e_cal_component_get_id (gtd_task_get_component (entry->task)));
+        }
 
-      g_signal_emit (user_data,
-                     signals[LIST_ADDED],
-                     0,
-                     list);
+      data = task_data_new (manager,
+                            batch,
+                            gtd_manager__new_list_operation (from, TASK_OPERATION_TIMEOUT));
 
-      g_object_unref (parent);
+      if (move)
+        move->n_removals++;
 
-      g_debug ("%s: %s (%s)",
-               G_STRFUNC,
-               _("Task list source successfully connected"),
-               e_source_get_display_name (source));
-    }
-  else
-    {
-      g_debug ("%s: %s (%s): %s",
-               G_STRFUNC,
-               _("Failed to connect to task list source"),
-               e_source_get_uid (source),
-               error->message);
+      e_cal_client_remove_objects (client,
+                                   ids,
+                                   E_CAL_OBJ_MOD_THIS,
+                                   data->cancellable,
+                                   (GAsyncReadyCallback) gtd_manager__remove_moved_tasks_finished,
+                                   data);
 
-      g_error_free (error);
-      return;
+      g_slist_free_full (ids, (GDestroyNotify) e_cal_component_free_id);
     }
 
+  g_hash_table_destroy (batches);
+
+  if (move && move->n_removals == 0)
+    gtd_manager__move_next_batch (move);
 }
 
+/*
+ * Puts a task that couldn't be created in @list back in the list
+ * it was moved from, and forgets about the move.
+ */
 static void
-gtd_manager__load__source (GtdManager *manager,
-                           ESource    *source)
+gtd_manager__rollback_move (GtdManager  *manager,
+                            GtdTaskList *list,
+                            MoveEntry   *entry)
 {
   GtdManagerPrivate *priv = manager->priv;
+  gboolean removal;
+  ESource *source;
+  gchar *data;
 
-  if (e_source_has_extension (source, E_SOURCE_EXTENSION_TASK_LIST) &&
-      !g_hash_table_lookup (priv->clients, source))
+  gtd_object_end_operation (GTD_OBJECT (entry->task));
+  gtd_manager__complete_move (manager, list, entry->task, entry->create_serial);
+
+  source = gtd_task_list_get_source (entry->from);
+
+  /* The old copy is kept, whatever happened to the task meanwhile */
+  removal = gtd_manager__lookup_removal (manager, entry) != NULL;
+
+  if (removal)
+    gtd_manager__complete_move (manager, entry->from, entry->task, entry->remove_serial);
+
+  /* Moved somewhere else meanwhile, or the old list is gone */
+  if (gtd_task_get_list (entry->task) != list ||
+      g_hash_table_lookup (priv->lists, source) != entry->from)
     {
-      e_cal_client_connect (source,
-                            E_CAL_CLIENT_SOURCE_TYPE_TASKS,
-                            5, /* seconds to wait */
-                            NULL,
-                            gtd_manager__on_client_connected,
-                            manager);
+      return;
     }
-  else
+
+  /*
+   * If the removal was merged into a pending creation, the old
+   * source never got the task, and must still create it.
+   */
+  if (!removal &&
+      !gtd_task_list_get_store (entry->from) &&
+      !gtd_journal_contains (priv->journal,
+                             e_source_get_uid (source),
+                             gtd_object_get_uid (GTD_OBJECT (entry->task))))
     {
-      g_warning ("%s: %s %s (%s)",
-                 G_STRFUNC,
-                 _("Skipping already loaded task list "),
-                 e_source_get_display_name (source),
-                 e_source_get_uid (source));
+      data = e_cal_component_get_as_string (gtd_task_get_component (entry->task));
+
+      gtd_journal_append (priv->journal,
+                          GTD_JOURNAL_OPERATION_CREATE,
+                          e_source_get_uid (source),
+                          gtd_object_get_uid (GTD_OBJECT (entry->task)),
+                          data);
+
+      g_free (data);
     }
+
+  gtd_manager__move_task_to_list (manager, entry->task, entry->from);
 }
 
+/*
+ * Finishes creating the current batch of a move, rolling it back
+ * if @error is set, and removes what was created from the old
+ * sources.
+ */
 static void
-gtd_manager__remove_source (GtdManager *manager,
-                            ESource    *source)
+gtd_manager__finish_moved_batch (MoveData     *data,
+                                 const GError *error)
 {
-  GtdManagerPrivate *priv = manager->priv;
-  GtdTaskList *list;
+  GtdManagerPrivate *priv = data->manager->priv;
+  const gchar *target_uid;
+  GList *created = NULL;
+  GList *l;
 
-  list = g_object_get_data (G_OBJECT (source), "task-list");
+  target_uid = e_source_get_uid (gtd_task_list_get_source (data->list));
 
-  g_hash_table_remove (priv->clients, source);
+  for (l = data->batch; l != NULL; l = l->next)
+    {
+      MoveEntry *entry = l->data;
+      const gchar *uid;
 
-  g_signal_emit (manager,
-                 signals[LIST_REMOVED],
-                 0,
-                 list);
-}
+      /* Tasks that were already in the source weren't part of the request */
+      if (entry->in_target)
+        {
+          created = g_list_prepend (created, entry);
+          continue;
+        }
 
-static void
+      if (error)
+        {
+          gtd_manager__rollback_move (data->manager, data->list, entry);
+          move_entry_free (entry);
+          continue;
+        }
+
+      uid = gtd_object_get_uid (GTD_OBJECT (entry->task));
+      gtd_manager__complete_move (data->manager, data->list, entry->task, entry->create_serial);
+
+      /*
+       * Moving the task on while it was being created dropped its
+       * removal from this source, so the new copy must go as well.
+       */
+      if (gtd_task_get_list (entry->task) != data->list &&
+          !gtd_journal_contains (priv->journal, target_uid, uid))
+        {
+          MoveEntry *leftover;
+          ESource *destination;
+
+          destination = gtd_task_list_get_source (gtd_task_get_list (entry->task));
+
+          leftover = g_new0 (MoveEntry, 1);
+          leftover->task = g_object_ref (entry->task);
+          leftover->from = g_object_ref (data->list);
+          leftover->remove_serial = gtd_journal_append (priv->journal,
+                                                        GTD_JOURNAL_OPERATION_REMOVE,
+                                                        target_uid,
+                                                        uid,
+                                                        e_source_get_uid (destination));
+
+          gtd_object_begin_operation (GTD_OBJECT (entry->task));
+
+          created = g_list_prepend (created, leftover);
+        }
+
+      created = g_list_prepend (created, entry);
+    }
+
+  g_list_free (data->batch);
+  data->batch = NULL;
+
+  /* Only tasks that exist in the new source are removed from the old ones */
+  gtd_manager__remove_moved_tasks (data->manager, g_list_reverse (created), data);
+}
+
+static void
+gtd_manager__create_moved_tasks_finished (GObject      *client,
+                                          GAsyncResult *result,
+                                          gpointer      user_data)
+{
+  MoveData *data = user_data;
+  GSList *uids = NULL;
+  GError *error = NULL;
+  GList *l;
+
+  e_cal_client_create_objects_finish (E_CAL_CLIENT (client),
+                                      result,
+                                      &uids,
+                                      &error);
+
+  g_slist_free_full (uids, g_free);
+
+  /* The journal creates them when the source is back */
+  if (error && gtd_manager__keep_write (data->manager, data->cancellable, error))
+    {
+      g_debug ("%s: %s (%s): %u",
+               G_STRFUNC,
+               "Postponing move",
+               gtd_task_list_get_name (data->list),
+               g_list_length (data->batch) + g_queue_get_length (data->pending));
+
+      for (l = data->batch; l != NULL; l = l->next)
+        gtd_object_end_operation (GTD_OBJECT (((MoveEntry*) l->data)->task));
+
+      for (l = data->pending->head; l != NULL; l = l->next)
+        gtd_object_end_operation (GTD_OBJECT (((MoveEntry*) l->data)->task));
+
+      g_error_free (error);
+      move_data_free (data);
+      return;
+    }
+
+  if (error)
+    {
+      gtd_manager__warn_error (G_STRFUNC,
+                               _("Error moving tasks"),
+                               data->cancellable,
+                               error);
+    }
+
+  gtd_manager__finish_moved_batch (data, error);
+
+  g_clear_error (&error);
+}
+
+/*
+ * Creates the next batch of a move in the new source, or saves it
+ * when the new list is local. Batches keep the requests small, and
+ * a batch is only started once the previous one was removed from
+ * the old sources.
+ */
+static void
+gtd_manager__move_next_batch (MoveData *data)
+{
+  GtdLocalStore *store;
+  ECalClient *client;
+  GSList *components;
+  GList *l;
+  guint i;
+
+  g_clear_object (&data->cancellable);
+
+  store = gtd_task_list_get_store (data->list);
+  client = gtd_task_list_get_client (data->list);
+
+  /* Everything was moved, or the journal takes it from here */
+  if (g_queue_is_empty (data->pending) || (!store && !client))
+    {
+      for (l = data->pending->head; l != NULL; l = l->next)
+        gtd_object_end_operation (GTD_OBJECT (((MoveEntry*) l->data)->task));
+
+      move_data_free (data);
+      return;
+    }
+
+  for (i = 0; i < MOVE_BATCH_SIZE && !g_queue_is_empty (data->pending); i++)
+    data->batch = g_list_prepend (data->batch, g_queue_pop_head (data->pending));
+
+  data->batch = g_list_reverse (data->batch);
+
+  if (store)
+    {
+      GList *batch = data->batch;
+
+      for (l = batch; l != NULL; l = l->next)
+        gtd_local_store_save_task (store, ((MoveEntry*) l->data)->task);
+
+      /* The old copies must not go away before the new ones are on disk */
+      gtd_local_store_flush (store);
+
+      data->batch = NULL;
+      gtd_manager__remove_moved_tasks (data->manager, batch, data);
+      return;
+    }
+
+  components = NULL;
+
+  for (l = data->batch; l != NULL; l = l->next)
+    {
+      MoveEntry *entry = l->data;
+
+      if (entry->in_target)
+        continue;
+
+      gtd_manager__mark_sent (data->manager, entry->task, entry->create_serial);
+
+      components = g_slist_prepend (components,
+                                    e_cal_component_get_icalcomponent (gtd_task_get_component (entry->task)));
+    }
+
+  /* Everything in the batch is there already */
+  if (!components)
+    {
+      gtd_manager__finish_moved_batch (data, NULL);
+      return;
+    }
+
+  data->cancellable = gtd_manager__new_list_operation (data->list, TASK_OPERATION_TIMEOUT);
+
+  e_cal_client_create_objects (client,
+                               g_slist_reverse (components),
+                               data->cancellable,
+                               (GAsyncReadyCallback) gtd_manager__create_moved_tasks_finished,
+                               data);
+
+  g_slist_free (components);
+}
+
+static void
+gtd_manager__invoke_authentication (GObject      *source_object,
+                                    GAsyncResult *result,
+                                    gpointer      user_data)
+{
+  ESource *source = E_SOURCE (source_object);
+  GError *error = NULL;
+  gboolean canceled;
+
+  e_source_invoke_authenticate_finish (source,
+                                       result,
+                                       &error);
+
+  canceled = g_error_matches (error,
+                                   G_IO_ERROR,
+                                   G_IO_ERROR_CANCELLED);
+
+  if (!canceled)
+    {
+      g_warning ("%s: %s (%s): %s",
+                 G_STRFUNC,
+                 _("Failed to prompt for credentials"),
+                 e_source_get_uid (source),
+                 error->message);
+    }
+
+  g_clear_error (&error);
+}
+
+static void
+gtd_manager__credentials_prompt_done (GObject      *source_object,
+                                      GAsyncResult *result,
+                                      gpointer      user_data)
+{
+  ETrustPromptResponse response = E_TRUST_PROMPT_RESPONSE_UNKNOWN;
+  ESource *source = E_SOURCE (source_object);
+  GError *error = NULL;
+
+  e_trust_prompt_run_for_source_finish (source, result, &response, &error);
+
+  if (error)
+    {
+      g_warning ("%s: %s '%s': %s",
+                 G_STRFUNC,
+                 _("Failed to prompt for credentials for"),
+                 e_source_get_display_name (source),
+                 error->message);
+
+    }
+  else if (response == E_TRUST_PROMPT_RESPONSE_ACCEPT || response == E_TRUST_PROMPT_RESPONSE_ACCEPT_TEMPORARILY)
+    {
+      /* Use NULL credentials to reuse those from the last time. */
+      e_source_invoke_authenticate (source,
+                                    NULL,
+                                    user_data,
+                                    gtd_manager__invoke_authentication,
+                                    NULL);
+    }
+
+  g_object_unref (user_data);
+  g_clear_error (&error);
+}
+
+static void
+gtd_manager__credentials_required (ESourceRegistry          *registry,
+                                   ESource                  *source,
+                                   ESourceCredentialsReason  reason,
+                                   const gchar              *certificate_pem,
+                                   GTlsCertificateFlags      certificate_errors,
+                                   const GError             *error,
+                                   gpointer                  user_data)
+{
+  GtdManagerPrivate *priv;
+
+  g_return_if_fail (GTD_IS_MANAGER (user_data));
+
+  priv = GTD_MANAGER (user_data)->priv;
+
+  if (e_credentials_prompter_get_auto_prompt_disabled_for (priv->credentials_prompter, source))
+    return;
+
+  if (reason == E_SOURCE_CREDENTIALS_REASON_SSL_FAILED)
+    {
+      e_trust_prompt_run_for_source (e_credentials_prompter_get_dialog_parent (priv->credentials_prompter),
+                                     source,
+                                     certificate_pem,
+                                     certificate_errors,
+                                     error ? error->message : NULL,
+                                     TRUE, // allow saving sources
+                                     gtd_manager__get_source_cancellable (GTD_MANAGER (user_data), source),
+                                     gtd_manager__credentials_prompt_done,
+                                     g_object_ref (gtd_manager__get_source_cancellable (GTD_MANAGER (user_data), source)));
+    }
+  else if (error && reason == E_SOURCE_CREDENTIALS_REASON_ERROR)
+    {
+      g_warning ("%s: %s '%s': %s",
+                 G_STRFUNC,
+                 _("Authentication failure"),
+                 e_source_get_display_name (source),
+                 error->message);
+    }
+}
+
+static gboolean
+gtd_manager__completed_held (GtdManager  *manager,
+                             GtdTaskList *list)
+{
+  GtdManagerPrivate *priv = manager->priv;
+
+  return g_hash_table_contains (priv->completed_holds, NULL) ||
+         g_hash_table_contains (priv->completed_holds, list);
+}
+
+/*
+ * Whether @task must stay loaded whatever happens to its list: tasks
+ * being written, or shown by Today and Scheduled.
+ */
+static gboolean
+gtd_manager__task_pinned (GtdManager  *manager,
+                          GtdTaskList *list,
+                          GtdTask     *task)
+{
+  GtdManagerPrivate *priv = manager->priv;
+
+  return !gtd_object_get_ready (GTD_OBJECT (task)) ||
+         gtd_task_list_contains (priv->today_tasks_list, task) ||
+         gtd_task_list_contains (priv->scheduled_tasks_list, task) ||
+         gtd_journal_contains (priv->journal,
+                               e_source_get_uid (gtd_task_list_get_source (list)),
+                               gtd_object_get_uid (GTD_OBJECT (task)));
+}
+
+static void
+gtd_manager__freeze_list (GtdManager  *manager,
+                          GtdTaskList *list)
+{
+  GtdManagerPrivate *priv = manager->priv;
+  GList *tasks;
+  GList *l;
+  guint n_frozen;
+
+  if (gtd_manager__completed_held (manager, list) || !gtd_object_get_ready (GTD_OBJECT (list)))
+    return;
+
+  tasks = gtd_task_list_get_tasks (list);
+  n_frozen = 0;
+
+  for (l = tasks; l != NULL; l = l->next)
+    {
+      GtdTask *task = l->data;
+
+      if (!gtd_task_get_complete (task) || gtd_manager__task_pinned (manager, list, task))
+        continue;
+
+      gtd_rule_engine_remove_task (priv->rule_engine, task);
+      gtd_task_list_freeze_task (list, task);
+
+      n_frozen++;
+    }
+
+  if (n_frozen > 0)
+    {
+      g_debug ("%s: %s (%s): %u",
+               G_STRFUNC,
+               "Completed tasks frozen",
+               gtd_task_list_get_name (list),
+               n_frozen);
+    }
+
+  g_list_free (tasks);
+}
+
+static void
+gtd_manager__thaw_list (GtdManager  *manager,
+                        GtdTaskList *list)
+{
+  GList *tasks;
+  GList *l;
+
+  tasks = gtd_task_list_thaw (list);
+
+  for (l = tasks; l != NULL; l = l->next)
+    gtd_rule_engine_add_task (manager->priv->rule_engine, l->data);
+
+  g_list_free (tasks);
+}
+
+static gboolean
+gtd_manager__compact (GtdManager *manager)
+{
+  GList *l;
+
+  manager->priv->compact_timeout_id = 0;
+
+  for (l = manager->priv->task_lists; l != NULL; l = l->next)
+    gtd_manager__freeze_list (manager, l->data);
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+gtd_manager__schedule_compact (GtdManager *manager)
+{
+  GtdManagerPrivate *priv = manager->priv;
+
+  if (priv->compact_timeout_id > 0)
+    return;
+
+  priv->compact_timeout_id = g_timeout_add_seconds (COMPACT_TIMEOUT,
+                                                    (GSourceFunc) gtd_manager__compact,
+                                                    manager);
+}
+
+static gboolean
+gtd_manager__finish_interrupted_moves (GtdManager *manager)
+{
+  GtdManagerPrivate *priv = manager->priv;
+  GList *entries;
+
+  priv->moves_idle_id = 0;
+
+  entries = g_list_reverse (priv->interrupted_moves);
+  priv->interrupted_moves = NULL;
+
+  gtd_manager__remove_moved_tasks (manager, entries, NULL);
+
+  return G_SOURCE_REMOVE;
+}
+
+/*
+ * Removes @task, the copy left in @list by a move that was created in
+ * its new source, once the list finished loading. Copies found in the
+ * same load are removed together.
+ */
+static void
+gtd_manager__queue_interrupted_move (GtdManager  *manager,
+                                     GtdTaskList *list,
+                                     GtdTask     *task,
+                                     guint64      serial)
+{
+  GtdManagerPrivate *priv = manager->priv;
+  MoveEntry *entry;
+
+  entry = g_new0 (MoveEntry, 1);
+  entry->task = g_object_ref (task);
+  entry->from = g_object_ref (list);
+  entry->remove_serial = serial;
+
+  gtd_object_begin_operation (GTD_OBJECT (task));
+
+  priv->interrupted_moves = g_list_prepend (priv->interrupted_moves, entry);
+
+  if (priv->moves_idle_id == 0)
+    {
+      priv->moves_idle_id = g_idle_add ((GSourceFunc) gtd_manager__finish_interrupted_moves,
+                                        manager);
+    }
+}
+
+/*
+ * Handles a task just read from the source of @list whose removal is
+ * pending. If To Do quit before sending the removal, it's sent now;
+ * otherwise, the user may still undo it, and the loaded copy is
+ * dropped. The same goes for tasks moved to another source, which
+ * are only removed once they exist in the new one.
+ *
+ * Returns: %TRUE if @task was consumed, %FALSE if it should be loaded
+ */
+static gboolean
+gtd_manager__handle_pending_removal (GtdManager  *manager,
+                                     GtdTaskList *list,
+                                     GtdTask     *task)
+{
+  GtdManagerPrivate *priv = manager->priv;
+  const GtdJournalEntry *entry;
+  const gchar *source_uid;
+  const gchar *task_uid;
+
+  source_uid = e_source_get_uid (gtd_task_list_get_source (list));
+  task_uid = gtd_object_get_uid (GTD_OBJECT (task));
+
+  entry = gtd_journal_lookup (priv->journal, source_uid, task_uid);
+
+  /* The task lives in another list now */
+  if (entry && entry->operation == GTD_JOURNAL_OPERATION_REMOVE && entry->data)
+    {
+      if (!gtd_manager__move_pending (manager, entry))
+        gtd_manager__queue_interrupted_move (manager, list, task, entry->serial);
+
+      g_object_unref (task);
+      return TRUE;
+    }
+
+  if (!gtd_deletion_queue_contains (priv->deletions, source_uid, task_uid))
+    return FALSE;
+
+  if (gtd_deletion_queue_lookup (priv->deletions, source_uid, task_uid))
+    {
+      g_object_unref (task);
+      return TRUE;
+    }
+
+  g_debug ("%s: %s (%s): %s",
+           G_STRFUNC,
+           "Finishing interrupted removal",
+           gtd_task_list_get_name (list),
+           task_uid);
+
+  gtd_deletion_queue_forget (priv->deletions, source_uid, task_uid);
+  gtd_manager_remove_task (manager, task);
+
+  return TRUE;
+}
+
+static guint
+gtd_manager__evict_list (GtdManager  *manager,
+                         GtdTaskList *list)
+{
+  GtdManagerPrivate *priv = manager->priv;
+  GList *tasks;
+  GList *l;
+  guint n_evicted;
+
+  /* Save the preview before the tasks go away */
+  gtd_task_list_set_evicted (list, TRUE);
+
+  tasks = gtd_task_list_get_tasks (list);
+  n_evicted = 0;
+
+  for (l = tasks; l != NULL; l = l->next)
+    {
+      GtdTask *task = l->data;
+
+      if (gtd_manager__task_pinned (manager, list, task))
+        continue;
+
+      gtd_rule_engine_remove_task (priv->rule_engine, task);
+      gtd_task_list_remove_task (list, task);
+
+      g_object_unref (task);
+
+      n_evicted++;
+    }
+
+  /* Everything comes back from the source when reloading */
+  gtd_task_list_clear_frozen (list);
+
+  g_debug ("%s: %s (%s): %u",
+           G_STRFUNC,
+           "Task list evicted",
+           gtd_task_list_get_name (list),
+           n_evicted);
+
+  g_list_free (tasks);
+
+  return n_evicted;
+}
+
+static gboolean
+gtd_manager__enforce_budget (GtdManager *manager)
+{
+  GtdManagerPrivate *priv = manager->priv;
+  GList *l;
+  guint n_tasks;
+  guint budget;
+
+  priv->budget_idle_id = 0;
+
+  budget = g_settings_get_uint (priv->settings, "max-loaded-tasks");
+
+  if (budget == 0)
+    return G_SOURCE_REMOVE;
+
+  n_tasks = 0;
+
+  for (l = priv->task_lists; l != NULL; l = l->next)
+    n_tasks += gtd_task_list_get_n_tasks (l->data);
+
+  /* Evict the least recently used lists first */
+  for (l = priv->recent_lists->tail; l != NULL && n_tasks > budget; l = l->prev)
+    {
+      GtdTaskList *list = l->data;
+
+      /*
+       * Lists in use, still loading, or that can't be loaded
+       * again are left alone.
+       */
+      if (gtd_task_list_get_evicted (list) ||
+          gtd_task_list_get_n_tasks (list) == 0 ||
+          g_hash_table_contains (priv->list_holds, list) ||
+          gtd_manager__completed_held (manager, list) ||
+          !gtd_object_get_ready (GTD_OBJECT (list)) ||
+          (!gtd_task_list_get_client (list) && !gtd_task_list_get_store (list)))
+        {
+          continue;
+        }
+
+      n_tasks -= gtd_manager__evict_list (manager, list);
+    }
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+gtd_manager__schedule_budget (GtdManager *manager)
+{
+  GtdManagerPrivate *priv = manager->priv;
+
+  if (priv->budget_idle_id > 0)
+    return;
+
+  priv->budget_idle_id = g_idle_add_full (G_PRIORITY_LOW,
+                                          (GSourceFunc) gtd_manager__enforce_budget,
+                                          manager,
+                                          NULL);
+}
+
+/*
+ * Adds the tasks of @list's local store that were evicted back
+ * to @list. Local stores keep every record in memory, so this
+ * doesn't need to wait for anything.
+ */
+static void
+gtd_manager__reload_local_list (GtdManager  *manager,
+                                GtdTaskList *list)
+{
+  GtdManagerPrivate *priv = manager->priv;
+  GHashTable *loaded;
+  GList *tasks;
+  GList *l;
+
+  loaded = g_hash_table_new (g_str_hash, g_str_equal);
+  tasks = gtd_task_list_get_tasks (list);
+
+  for (l = tasks; l != NULL; l = l->next)
+    g_hash_table_add (loaded, (gpointer) gtd_object_get_uid (l->data));
+
+  g_list_free (tasks);
+
+  gtd_task_list_set_evicted (list, FALSE);
+
+  tasks = gtd_local_store_get_tasks (gtd_task_list_get_store (list));
+
+  for (l = tasks; l != NULL; l = l->next)
+    {
+      /* Pinned tasks were never evicted */
+      if (g_hash_table_contains (loaded, gtd_object_get_uid (l->data)))
+        {
+          g_object_unref (l->data);
+          continue;
+        }
+
+      gtd_task_set_list (l->data, list);
+
+      if (gtd_manager__handle_pending_removal (manager, list, l->data))
+        continue;
+
+      gtd_task_list_save_task (list, l->data);
+
+      gtd_rule_engine_add_task (priv->rule_engine, l->data);
+    }
+
+  g_hash_table_destroy (loaded);
+  g_list_free (tasks);
+}
+
+static gboolean      gtd_manager__is_local_source                (ESource            *source);
+
+static void          gtd_manager__migrate_to_local_store         (GtdManager         *manager,
+                                                                  GtdTaskList        *list);
+
+static void          gtd_manager__sync_task_list                 (GtdManager         *manager,
+                                                                  GtdTaskList        *list);
+
+static void
+gtd_manager__fill_task_list (GObject      *client,
+                             GAsyncResult *result,
+                             gpointer      user_data)
+{
+  GtdManagerPrivate *priv;
+  GtdTaskList *list;
+  TaskData *data = user_data;
+  GSList *component_list;
+  GError *error = NULL;
+  gboolean sync;
+
+  g_return_if_fail (GTD_IS_MANAGER (data->manager));
+
+  priv = data->manager->priv;
+  list = GTD_TASK_LIST (data->data);
+
+  e_cal_client_get_object_list_as_comps_finish (E_CAL_CLIENT (client),
+                                                result,
+                                                &component_list,
+                                                &error);
+
+  gtd_object_end_operation (GTD_OBJECT (data->data));
+
+  sync = GPOINTER_TO_INT (g_hash_table_lookup (priv->fetches, list));
+  g_hash_table_remove (priv->fetches, list);
+
+  if (!error)
+    {
+      GSList *l;
+
+      for (l = component_list; l != NULL; l = l->next)
+        {
+          GtdTask *task;
+
+          task = gtd_task_new (l->data);
+          gtd_task_set_list (task, list);
+
+          if (gtd_manager__handle_pending_removal (data->manager, list, task))
+            continue;
+
+          gtd_task_list_save_task (list, task);
+
+          /* Add to the virtual lists it matches */
+          gtd_rule_engine_add_task (priv->rule_engine, task);
+        }
+
+      e_cal_client_free_ecalcomp_slist (component_list);
+
+      /* Local lists are handled natively from now on */
+      if (gtd_manager__is_local_source (gtd_task_list_get_source (list)))
+        gtd_manager__migrate_to_local_store (data->manager, list);
+
+      gtd_manager__schedule_compact (data->manager);
+      gtd_manager__schedule_budget (data->manager);
+    }
+  else
+    {
+      gtd_manager__warn_error (G_STRFUNC,
+                               _("Error fetching tasks from list"),
+                               data->cancellable,
+                               error);
+
+      g_error_free (error);
+    }
+
+  /* The source came back online while fetching */
+  if (sync)
+    gtd_manager__sync_task_list (data->manager, list);
+
+  task_data_free (data);
+}
+
+/*
+ * Checks whether @new_component is a different revision of @old_component,
+ * looking at SEQUENCE and LAST-MODIFIED. When the component carries
+ * neither, the whole component is compared.
+ */
+static gboolean
+gtd_manager__component_changed (ECalComponent *old_component,
+                                ECalComponent *new_component)
+{
+  struct icaltimetype *old_modified = NULL;
+  struct icaltimetype *new_modified = NULL;
+  gint *old_sequence = NULL;
+  gint *new_sequence = NULL;
+  gboolean changed;
+
+  e_cal_component_get_sequence (old_component, &old_sequence);
+  e_cal_component_get_sequence (new_component, &new_sequence);
+  e_cal_component_get_last_modified (old_component, &old_modified);
+  e_cal_component_get_last_modified (new_component, &new_modified);
+
+  if ((old_sequence == NULL) != (new_sequence == NULL) ||
+      (old_sequence && *old_sequence != *new_sequence))
+    {
+      changed = TRUE;
+    }
+  else if (old_modified && new_modified)
+    {
+      changed = icaltime_compare (*old_modified, *new_modified) != 0;
+    }
+  else
+    {
+      gchar *old_string, *new_string;
+
+      old_string = icalcomponent_as_ical_string_r (e_cal_component_get_icalcomponent (old_component));
+      new_string = icalcomponent_as_ical_string_r (e_cal_component_get_icalcomponent (new_component));
+
+      changed = g_strcmp0 (old_string, new_string) != 0;
+
+      g_free (old_string);
+      g_free (new_string);
+    }
+
+  g_clear_pointer (&old_sequence, e_cal_component_free_sequence);
+  g_clear_pointer (&new_sequence, e_cal_component_free_sequence);
+  g_clear_pointer (&old_modified, e_cal_component_free_icaltimetype);
+  g_clear_pointer (&new_modified, e_cal_component_free_icaltimetype);
+
+  return changed;
+}
+
+static void
+gtd_manager__refresh_task_list_finished (GObject      *client,
+                                         GAsyncResult *result,
+                                         gpointer      user_data)
+{
+  GtdManagerPrivate *priv;
+  GHashTableIter iter;
+  GtdTaskList *list;
+  GHashTable *tasks;
+  GHashTable *frozen;
+  const gchar *source_uid;
+  TaskData *data = user_data;
+  GSList *component_list;
+  GList *task_list, *t;
+  GSList *l;
+  GError *error = NULL;
+  gpointer task;
+  gchar **frozen_uids;
+  gboolean reloading;
+  gboolean evicted;
+  guint n_added, n_updated, n_removed;
+  guint i;
+
+  priv = data->manager->priv;
+  list = GTD_TASK_LIST (data->data);
+
+  e_cal_client_get_object_list_as_comps_finish (E_CAL_CLIENT (client),
+                                                result,
+                                                &component_list,
+                                                &error);
+
+  /* A newer refresh of the list is running, and its snapshot wins */
+  if (g_hash_table_lookup (priv->refreshes, list) != data)
+    {
+      if (error)
+        g_error_free (error);
+      else
+        e_cal_client_free_ecalcomp_slist (component_list);
+
+      g_object_unref (list);
+      task_data_free (data);
+      return;
+    }
+
+  g_hash_table_remove (priv->refreshes, list);
+
+  /*
+   * Unless an evicted list is being loaded again, only what Today
+   * and Scheduled show of it is loaded.
+   */
+  reloading = g_hash_table_remove (priv->reloads, list);
+  evicted = gtd_task_list_get_evicted (list) && !reloading;
+
+  if (error)
+    {
+      gtd_manager__warn_error (G_STRFUNC,
+                               _("Error refreshing task list"),
+                               data->cancellable,
+                               error);
+
+      /* Finish reloading; the list stays evicted */
+      if (reloading)
+        gtd_object_end_operation (GTD_OBJECT (list));
+
+      g_error_free (error);
+      g_object_unref (list);
+      task_data_free (data);
+      return;
+    }
+
+  source_uid = e_source_get_uid (gtd_task_list_get_source (list));
+  n_added = n_updated = n_removed = 0;
+
+  /* Index the current tasks by UID */
+  tasks = g_hash_table_new (g_str_hash, g_str_equal);
+  task_list = gtd_task_list_get_tasks (list);
+
+  for (t = task_list; t != NULL; t = t->next)
+    g_hash_table_insert (tasks, (gpointer) gtd_object_get_uid (t->data), t->data);
+
+  g_list_free (task_list);
+
+  /* ... and the frozen ones */
+  frozen = g_hash_table_new (g_str_hash, g_str_equal);
+  frozen_uids = gtd_task_list_get_frozen_uids (list);
+
+  for (i = 0; frozen_uids[i] != NULL; i++)
+    g_hash_table_add (frozen, frozen_uids[i]);
+
+  for (l = component_list; l != NULL; l = l->next)
+    {
+      ECalComponent *component = l->data;
+      const gchar *uid;
+
+      e_cal_component_get_uid (component, &uid);
+      task = g_hash_table_lookup (tasks, uid);
+
+      /* Frozen tasks are only thawed when they changed */
+      if (!task && g_hash_table_remove (frozen, uid))
+        {
+          gchar *string;
+          gboolean changed;
+
+          string = e_cal_component_get_as_string (component);
+          changed = g_strcmp0 (string, gtd_task_list_get_frozen_data (list, uid)) != 0;
+
+          g_free (string);
+
+          if (!changed)
+            continue;
+
+          task = gtd_task_list_thaw_task (list, uid);
+
+          if (task)
+            gtd_rule_engine_add_task (priv->rule_engine, task);
+        }
+
+      /* New on the source */
+      if (!task)
+        {
+          task = gtd_task_new (component);
+          gtd_task_set_list (task, list);
+
+          if (gtd_manager__handle_pending_removal (data->manager, list, task))
+            continue;
+
+          gtd_rule_engine_add_task (priv->rule_engine, task);
+
+          if (evicted && !gtd_manager__task_pinned (data->manager, list, task))
+            {
+              gtd_rule_engine_remove_task (priv->rule_engine, task);
+              g_object_unref (task);
+              continue;
+            }
+
+          gtd_task_list_save_task (list, task);
+
+          n_added++;
+          continue;
+        }
+
+      /* The key is owned by the task's component, so drop it first */
+      g_hash_table_remove (tasks, uid);
+
+      /* Local changes that are still being written win */
+      if (!gtd_object_get_ready (task) ||
+          gtd_journal_contains (priv->journal, source_uid, gtd_object_get_uid (task)))
+        {
+          continue;
+        }
+
+      if (gtd_manager__component_changed (gtd_task_get_component (task), component))
+        {
+          gtd_task_set_component (task, component);
+
+          gtd_task_list_save_task (list, task);
+          gtd_rule_engine_update_task (priv->rule_engine, task);
+
+          n_updated++;
+        }
+    }
+
+  /* Whatever is left was removed from the source */
+  g_hash_table_iter_init (&iter, tasks);
+
+  while (g_hash_table_iter_next (&iter, NULL, &task))
+    {
+      if (!gtd_object_get_ready (task) ||
+          gtd_journal_contains (priv->journal, source_uid, gtd_object_get_uid (task)))
+        {
+          continue;
+        }
+
+      gtd_rule_engine_remove_task (priv->rule_engine, task);
+      gtd_task_list_remove_task (list, task);
+
+      g_object_unref (task);
+
+      n_removed++;
+    }
+
+  g_hash_table_iter_init (&iter, frozen);
+
+  while (g_hash_table_iter_next (&iter, &task, NULL))
+    {
+      if (gtd_journal_contains (priv->journal, source_uid, task))
+        continue;
+
+      gtd_task_list_remove_frozen_task (list, task);
+
+      n_removed++;
+    }
+
+  g_debug ("%s: %s (%s): %u added, %u updated, %u removed",
+           G_STRFUNC,
+           "Task list refreshed",
+           gtd_task_list_get_name (list),
+           n_added,
+           n_updated,
+           n_removed);
+
+  g_hash_table_destroy (tasks);
+  g_hash_table_destroy (frozen);
+  g_strfreev (frozen_uids);
+  e_cal_client_free_ecalcomp_slist (component_list);
+
+  /* Finish reloading */
+  if (reloading)
+    {
+      gtd_task_list_set_evicted (list, FALSE);
+      gtd_object_end_operation (GTD_OBJECT (list));
+    }
+
+  gtd_manager__schedule_compact (data->manager);
+  gtd_manager__schedule_budget (data->manager);
+
+  g_object_unref (list);
+  task_data_free (data);
+}
+
+static void
+gtd_manager__fetch_task_list (GtdManager  *manager,
+                              ECalClient  *client,
+                              GtdTaskList *list)
+{
+  TaskData *data;
+
+  /* async data */
+  data = task_data_new (manager,
+                        (gpointer) list,
+                        gtd_manager__new_list_operation (list, LIST_FETCH_TIMEOUT));
+
+  /* asyncronously fetch the task list */
+  e_cal_client_get_object_list_as_comps (client,
+                                         "contains? \"any\" \"\"",
+                                         data->cancellable,
+                                         (GAsyncReadyCallback) gtd_manager__fill_task_list,
+                                         data);
+}
+
+static void          gtd_manager__replay_next                    (ReplayData         *data);
+
+static void          gtd_manager__replay_journal                 (GtdManager         *manager,
+                                                                  ECalClient         *client,
+                                                                  GtdTaskList        *list,
+                                                                  gboolean            fetch);
+
+static void
+replay_data_free (ReplayData *data)
+{
+  g_list_free_full (data->entries, (GDestroyNotify) gtd_journal_entry_free);
+  g_clear_object (&data->cancellable);
+  g_object_unref (data->client);
+  g_object_unref (data->list);
+  g_free (data);
+}
+
+/*
+ * Applies the UID the backend gave to a task created from the journal
+ * to the loaded task, so that later writes reach it.
+ */
+static void
+gtd_manager__apply_new_uid (GtdManager  *manager,
+                            GtdTaskList *list,
+                            const gchar *old_uid,
+                            const gchar *new_uid)
+{
+  GtdManagerPrivate *priv = manager->priv;
+  GtdTask *task;
+
+  task = gtd_search_index_lookup (priv->search_index, old_uid);
+
+  if (!task || gtd_task_get_list (task) != list)
+    return;
+
+  gtd_object_set_uid (GTD_OBJECT (task), new_uid);
+  gtd_search_index_update_task (priv->search_index, task);
+}
+
+static void
+gtd_manager__replay_finished (GObject      *client,
+                              GAsyncResult *result,
+                              gpointer      user_data)
+{
+  GtdJournalEntry *entry;
+  ReplayData *data = user_data;
+  gchar *new_uid = NULL;
+  GError *error = NULL;
+
+  entry = data->current->data;
+
+  switch (entry->operation)
+    {
+    case GTD_JOURNAL_OPERATION_CREATE:
+      e_cal_client_create_object_finish (E_CAL_CLIENT (client), result, &new_uid, &error);
+
+      /* The backend may have given the task another UID */
+      if (new_uid && g_strcmp0 (new_uid, entry->task_uid) != 0)
+        gtd_manager__apply_new_uid (data->manager, data->list, entry->task_uid, new_uid);
+
+      g_free (new_uid);
+
+      /* a previous replay may have been interrupted after creating it */
+      if (g_error_matches (error, E_CAL_CLIENT_ERROR, E_CAL_CLIENT_ERROR_OBJECT_ID_ALREADY_EXISTS))
+        g_clear_error (&error);
+      break;
+
+    case GTD_JOURNAL_OPERATION_MODIFY:
+      e_cal_client_modify_object_finish (E_CAL_CLIENT (client), result, &error);
+      break;
+
+    case GTD_JOURNAL_OPERATION_REMOVE:
+      e_cal_client_remove_object_finish (E_CAL_CLIENT (client), result, &error);
+
+      if (g_error_matches (error, E_CAL_CLIENT_ERROR, E_CAL_CLIENT_ERROR_OBJECT_NOT_FOUND))
+        g_clear_error (&error);
+      break;
+    }
+
+  if (error)
+    {
+      /* The source went away again; keep the remaining entries */
+      if (gtd_manager__is_offline_error (data->cancellable, error) ||
+          g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+        {
+          data->current = NULL;
+        }
+      else
+        {
+          gtd_manager__warn_error (G_STRFUNC,
+                                   _("Error replaying pending operation"),
+                                   data->cancellable,
+                                   error);
+
+          /* It won't ever succeed, so drop it */
+          gtd_journal_complete (data->manager->priv->journal, entry);
+          data->current = data->current->next;
+        }
+
+      g_error_free (error);
+    }
+  else
+    {
+      gtd_journal_complete (data->manager->priv->journal, entry);
+      data->current = data->current->next;
+    }
+
+  g_clear_object (&data->cancellable);
+
+  gtd_manager__replay_next (data);
+}
+
+static void
+gtd_manager__replay_next (ReplayData *data)
+{
+  GtdJournalEntry *entry;
+  icalcomponent *component;
+
+  /* Moved tasks stay in their old sources until created in the new ones */
+  while (data->current && gtd_manager__move_pending (data->manager, data->current->data))
+    data->current = data->current->next;
+
+  /* Either everything was replayed, or the source is offline again */
+  if (!data->current || g_cancellable_is_cancelled (gtd_task_list_get_cancellable (data->list)))
+    {
+      ECalClient *client;
+
+      g_hash_table_remove (data->manager->priv->replays, data->list);
+      client = gtd_task_list_get_client (data->list);
+
+      if (!g_cancellable_is_cancelled (gtd_task_list_get_cancellable (data->list)))
+        {
+          /* Pick up the entries journaled while this replay ran */
+          if (data->again && client)
+            gtd_manager__replay_journal (data->manager, client, data->list, data->fetch);
+          else if (data->fetch)
+            gtd_manager__fetch_task_list (data->manager, data->client, data->list);
+          else
+            gtd_manager_refresh_task_list (data->manager, data->list);
+        }
+
+      replay_data_free (data);
+      return;
+    }
+
+  entry = data->current->data;
+  data->cancellable = gtd_manager__new_list_operation (data->list, TASK_OPERATION_TIMEOUT);
+
+  if (entry->operation == GTD_JOURNAL_OPERATION_REMOVE)
+    {
+      e_cal_client_remove_object (data->client,
+                                  entry->task_uid,
+                                  NULL,
+                                  E_CAL_OBJ_MOD_THIS,
+                                  data->cancellable,
+                                  (GAsyncReadyCallback) gtd_manager__replay_finished,
+                                  data);
+      return;
+    }
+
+  component = icalcomponent_new_from_string (entry->data);
+
+  if (!component)
+    {
+      g_warning ("%s: %s (%s)",
+                 G_STRFUNC,
+                 _("Dropping invalid pending operation"),
+                 entry->task_uid);
+
+      gtd_journal_complete (data->manager->priv->journal, entry);
+      g_clear_object (&data->cancellable);
+
+      data->current = data->current->next;
+      gtd_manager__replay_next (data);
+      return;
+    }
+
+  if (entry->operation == GTD_JOURNAL_OPERATION_CREATE)
+    {
+      gtd_journal_mark_sent (data->manager->priv->journal,
+                             entry->source_uid,
+                             entry->task_uid,
+                             entry->serial);
+
+      e_cal_client_create_object (data->client,
+                                  component,
+                                  data->cancellable,
+                                  (GAsyncReadyCallback) gtd_manager__replay_finished,
+                                  data);
+    }
+  else
+    {
+      e_cal_client_modify_object (data->client,
+                                  component,
+                                  E_CAL_OBJ_MOD_THIS,
+                                  data->cancellable,
+                                  (GAsyncReadyCallback) gtd_manager__replay_finished,
+                                  data);
+    }
+
+  icalcomponent_free (component);
+}
+
+/*
+ * Replays, in order, the operations that failed while the
+ * source of @list was unreachable.
+ */
+static void
+gtd_manager__replay_journal (GtdManager  *manager,
+                             ECalClient  *client,
+                             GtdTaskList *list,
+                             gboolean     fetch)
+{
+  ReplayData *data;
+  ESource *source;
+
+  source = gtd_task_list_get_source (list);
+
+  /* Replaying the same entries twice at once would reorder them */
+  data = g_hash_table_lookup (manager->priv->replays, list);
+
+  if (data)
+    {
+      data->again = TRUE;
+      data->fetch |= fetch;
+      return;
+    }
+
+  data = g_new0 (ReplayData, 1);
+  data->manager = manager;
+  data->client = g_object_ref (client);
+  data->list = g_object_ref (list);
+  data->entries = gtd_journal_get_entries (manager->priv->journal, e_source_get_uid (source));
+  data->current = data->entries;
+  data->fetch = fetch;
+
+  g_hash_table_insert (manager->priv->replays, list, data);
+
+  g_debug ("%s: %s (%s): %u",
+           G_STRFUNC,
+           "Replaying pending operations",
+           e_source_get_display_name (source),
+           g_list_length (data->entries));
+
+  gtd_manager__replay_next (data);
+}
+
+/* Pushes pending operations, then picks up what changed meanwhile */
+static void
+gtd_manager__sync_task_list (GtdManager  *manager,
+                             GtdTaskList *list)
+{
+  ECalClient *client;
+  ESource *source;
+
+  client = gtd_task_list_get_client (list);
+  source = gtd_task_list_get_source (list);
+
+  if (!client)
+    return;
+
+  if (gtd_journal_has_entries (manager->priv->journal, e_source_get_uid (source)))
+    gtd_manager__replay_journal (manager, client, list, FALSE);
+  else
+    gtd_manager_refresh_task_list (manager, list);
+}
+
+static void
+gtd_manager__client_online_changed (EClient    *client,
+                                    GParamSpec *pspec,
+                                    GtdManager *manager)
+{
+  GtdTaskList *list;
+  ESource *source;
+
+  source = e_client_get_source (client);
+  list = g_hash_table_lookup (manager->priv->lists, source);
+
+  if (!list || !e_client_is_online (client))
+    return;
+
+  /* The fetch may have started before, so sync once it's done */
+  if (g_hash_table_contains (manager->priv->fetches, list))
+    {
+      g_hash_table_insert (manager->priv->fetches, list, GINT_TO_POINTER (TRUE));
+      return;
+    }
+
+  gtd_manager__sync_task_list (manager, list);
+}
+
+static GtdTaskList*
+gtd_manager__create_task_list (GtdManager *manager,
+                               ESource    *source)
+{
+  GtdManagerPrivate *priv = manager->priv;
+  GCancellable *cancellable;
+  GtdTaskList *list;
+  ESource *parent;
+
+  /* parent source's display name is list's origin */
+  parent = e_source_registry_ref_source (priv->source_registry, e_source_get_parent (source));
+
+  list = gtd_task_list_new (source, e_source_get_display_name (parent));
+
+  /* the list's operations are cancelled together with its source's */
+  cancellable = gtd_cancellable_new (gtd_manager__get_source_cancellable (manager, source), 0);
+  gtd_task_list_set_cancellable (list, cancellable);
+  g_object_unref (cancellable);
+
+  priv->task_lists = g_list_append (priv->task_lists, list);
+  g_hash_table_insert (priv->lists, g_object_ref (source), list);
+  g_queue_push_tail (priv->recent_lists, list);
+
+  gtd_search_index_add_list (priv->search_index, list);
+
+  g_object_unref (parent);
+
+  return list;
+}
+
+static gboolean
+gtd_manager__is_local_source (ESource *source)
+{
+  return g_strcmp0 (e_source_get_parent (source), "local-stub") == 0;
+}
+
+static gchar*
+gtd_manager__get_local_store_path (ESource *source)
+{
+  gchar *basename;
+  gchar *path;
+
+  basename = g_strconcat (e_source_get_uid (source), ".log", NULL);
+  path = g_build_filename (g_get_user_data_dir (), "gnome-todo", "local", basename, NULL);
+
+  g_free (basename);
+
+  return path;
+}
+
+/*
+ * Moves the tasks fetched from the evolution-data-server local backend
+ * into a #GtdLocalStore, which handles the list from now on.
+ */
+static void
+gtd_manager__migrate_to_local_store (GtdManager  *manager,
+                                     GtdTaskList *list)
+{
+  GtdLocalStore *store;
+  ECalClient *client;
+  GList *tasks;
+  GList *l;
+  gchar *path;
+
+  path = gtd_manager__get_local_store_path (gtd_task_list_get_source (list));
+  store = gtd_local_store_new (path);
+  tasks = gtd_task_list_get_tasks (list);
+
+  for (l = tasks; l != NULL; l = l->next)
+    gtd_local_store_save_task (store, l->data);
+
+  /* creates the file even for empty lists, so they're migrated once */
+  gtd_local_store_flush (store);
+  gtd_task_list_set_store (list, store);
+
+  /* the backend isn't used anymore */
+  client = gtd_task_list_get_client (list);
+
+  if (client)
+    {
+      g_signal_handlers_disconnect_by_func (client, gtd_manager__client_online_changed, manager);
+      gtd_task_list_set_client (list, NULL);
+    }
+
+  g_debug ("%s: %s (%s): %u",
+           G_STRFUNC,
+           "Moved task list to local storage",
+           gtd_task_list_get_name (list),
+           g_list_length (tasks));
+
+  g_list_free (tasks);
+  g_object_unref (store);
+  g_free (path);
+}
+
+static void
+gtd_manager__load_local_source (GtdManager *manager,
+                                ESource    *source)
+{
+  GtdManagerPrivate *priv = manager->priv;
+  GtdLocalStore *store;
+  GtdTaskList *list;
+  GList *tasks;
+  GList *l;
+  gchar *path;
+
+  path = gtd_manager__get_local_store_path (source);
+  store = gtd_local_store_new (path);
+
+  list = gtd_manager__create_task_list (manager, source);
+  gtd_task_list_set_store (list, store);
+
+  /* the list has no listeners yet, so this is cheap */
+  tasks = gtd_local_store_get_tasks (store);
+
+  for (l = tasks; l != NULL; l = l->next)
+    {
+      gtd_task_set_list (l->data, list);
+
+      if (gtd_manager__handle_pending_removal (manager, list, l->data))
+        continue;
+
+      gtd_task_list_save_task (list, l->data);
+
+      gtd_rule_engine_add_task (priv->rule_engine, l->data);
+    }
+
+  gtd_manager__schedule_compact (manager);
+  gtd_manager__schedule_budget (manager);
+
+  gtd_object_end_operation (GTD_OBJECT (manager));
+
+  g_signal_emit (manager,
+                 signals[LIST_ADDED],
+                 0,
+                 list);
+
+  g_debug ("%s: %s (%s): %u",
+           G_STRFUNC,
+           "Task list loaded from local storage",
+           e_source_get_display_name (source),
+           g_list_length (tasks));
+
+  g_list_free (tasks);
+  g_object_unref (store);
+  g_free (path);
+}
+
+static void
+gtd_manager__on_client_connected (GObject      *source_object,
+                                  GAsyncResult *result,
+                                  gpointer      user_data)
+{
+  GtdManagerPrivate *priv = GTD_MANAGER (user_data)->priv;
+  ECalClient *client;
+  ESource *source;
+  GError *error = NULL;
+
+  source = e_client_get_source (E_CLIENT (source_object));
+  client = E_CAL_CLIENT (e_cal_client_connect_finish (result, &error));
+
+  gtd_object_end_operation (GTD_OBJECT (user_data));
+
+  if (!error)
+    {
+      GtdTaskList *list;
+
+      /* creates a new task list */
+      list = gtd_manager__create_task_list (user_data, source);
+
+      /* it's not ready until we fetch the list of tasks from client */
+      gtd_object_begin_operation (GTD_OBJECT (list));
+      g_hash_table_insert (priv->fetches, list, GINT_TO_POINTER (FALSE));
+
+      /* push the operations made while offline before fetching the tasks */
+      if (gtd_journal_has_entries (priv->journal, e_source_get_uid (source)))
+        gtd_manager__replay_journal (user_data, client, list, TRUE);
+      else
+        gtd_manager__fetch_task_list (user_data, client, list);
+
+      /* replay again whenever the source goes back online */
+      g_signal_connect (client,
+                        "notify::online",
+                        G_CALLBACK (gtd_manager__client_online_changed),
+                        user_data);
+
+      /* the list keeps the client alive */
+      gtd_task_list_set_client (list, client);
+      g_object_unref (client);
+
+      g_signal_emit (user_data,
+                     signals[LIST_ADDED],
+                     0,
+                     list);
+
+      g_debug ("%s: %s (%s)",
+               G_STRFUNC,
+               "Task list source successfully connected",
+               e_source_get_display_name (source));
+    }
+  else
+    {
+      if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+        {
+          g_debug ("%s: %s (%s): %s",
+                   G_STRFUNC,
+                   "Failed to connect to task list source",
+                   e_source_get_uid (source),
+                   error->message);
+        }
+
+      g_error_free (error);
+      return;
+    }
+
+}
+
+static void
+gtd_manager__load__source (GtdManager *manager,
+                           ESource    *source)
+{
+  GtdManagerPrivate *priv = manager->priv;
+
+  if (e_source_has_extension (source, E_SOURCE_EXTENSION_TASK_LIST) &&
+      !g_hash_table_contains (priv->lists, source))
+    {
+      gchar *path;
+
+      path = gtd_manager__get_local_store_path (source);
+
+      /* Local lists that were already moved out of the backend */
+      if (gtd_manager__is_local_source (source) && gtd_local_store_exists (path))
+        {
+          gtd_object_begin_operation (GTD_OBJECT (manager));
+          gtd_manager__load_local_source (manager, source);
+          g_free (path);
+          return;
+        }
+
+      g_free (path);
+
+      /* The manager is not ready until every source is loaded */
+      gtd_object_begin_operation (GTD_OBJECT (manager));
+
+      e_cal_client_connect (source,
+                            E_CAL_CLIENT_SOURCE_TYPE_TASKS,
+                            5, /* seconds to wait */
+                            gtd_manager__get_source_cancellable (manager, source),
+                            gtd_manager__on_client_connected,
+                            manager);
+    }
+  else
+    {
+      g_warning ("%s: %s %s (%s)",
+                 G_STRFUNC,
+                 _("Skipping already loaded task list "),
+                 e_source_get_display_name (source),
+                 e_source_get_uid (source));
+    }
+}
+
+static void
+gtd_manager__remove_source (GtdManager *manager,
+                            ESource    *source)
+{
+  GtdManagerPrivate *priv = manager->priv;
+  GCancellable *cancellable;
+  GtdTaskList *list;
+  GList *tasks;
+  GList *l;
+
+  list = g_hash_table_lookup (priv->lists, source);
+
+  /* Abort everything still running on the source and its list */
+  cancellable = g_hash_table_lookup (priv->source_cancellables, e_source_get_uid (source));
+
+  if (cancellable)
+    {
+      g_cancellable_cancel (cancellable);
+      g_hash_table_remove (priv->source_cancellables, e_source_get_uid (source));
+    }
+
+  if (!list)
+    return;
+
+  g_hash_table_remove (priv->fetches, list);
+  g_hash_table_remove (priv->reloads, list);
+
+  /* Writes to the list now go to the journal */
+  if (gtd_task_list_get_client (list))
+    {
+      g_signal_handlers_disconnect_by_func (gtd_task_list_get_client (list),
+                                            gtd_manager__client_online_changed,
+                                            manager);
+      gtd_task_list_set_client (list, NULL);
+    }
+
+  /* The list is gone, and so are its local tasks */
+  if (gtd_task_list_get_store (list))
+    {
+      gtd_local_store_delete (gtd_task_list_get_store (list));
+      gtd_task_list_set_store (list, NULL);
+    }
+
+  priv->task_lists = g_list_remove (priv->task_lists, list);
+  g_queue_remove (priv->recent_lists, list);
+
+  /* The virtual lists hold references to the tasks of the list */
+  tasks = gtd_task_list_get_tasks (list);
+
+  for (l = tasks; l != NULL; l = l->next)
+    gtd_rule_engine_remove_task (priv->rule_engine, l->data);
+
+  g_list_free (tasks);
+
+  gtd_search_index_remove_list (priv->search_index, list);
+
+  g_signal_emit (manager,
+                 signals[LIST_REMOVED],
+                 0,
+                 list);
+
+  g_hash_table_remove (priv->lists, source);
+}
+
+static void
 gtd_manager__source_registry_finish_cb (GObject      *source_object,
                                         GAsyncResult *result,
                                         gpointer      user_data)
@@ -909,30 +3105,47 @@ gtd_manager__source_registry_finish_cb (GObject      *source_object,
   sources = e_source_registry_list_sources (priv->source_registry,
                                             E_SOURCE_EXTENSION_TASK_LIST);
 
-  /* While load_sources > 0, GtdManager::ready = FALSE */
-  priv->load_sources = g_list_length (sources);
-
-
   /*
    * When ESourceRegistry is loaded, it enabled loading the GtdStorage::url properties.
-   * Load them now.
+   * Index the sources by online account, which also sets up the urls.
    */
-  for (l = priv->storage_locations; l != NULL; l = l->next)
-    gtd_manager__setup_url (GTD_MANAGER (user_data), l->data);
+  for (l = sources; l != NULL; l = l->next)
+    gtd_manager__index_source (GTD_MANAGER (user_data), l->data);
 
 
   g_debug ("%s: number of sources to load: %d",
            G_STRFUNC,
-           priv->load_sources);
+           g_list_length (sources));
 
-  gtd_object_set_ready (GTD_OBJECT (user_data),
-                        priv->load_sources == 0);
+  /*
+   * Keep the manager busy until every source is started, so that
+   * sources loaded synchronously don't flip the ready state.
+   */
+  gtd_object_begin_operation (GTD_OBJECT (user_data));
 
   for (l = sources; l != NULL; l = l->next)
     gtd_manager__load__source (GTD_MANAGER (user_data), l->data);
 
+  gtd_object_end_operation (GTD_OBJECT (user_data));
+
   g_list_free_full (sources, g_object_unref);
 
+  /* keep the online account index up to date */
+  g_signal_connect_swapped (priv->source_registry,
+                            "source-added",
+                            G_CALLBACK (gtd_manager__index_source),
+                            user_data);
+
+  g_signal_connect_swapped (priv->source_registry,
+                            "source-changed",
+                            G_CALLBACK (gtd_manager__reindex_source),
+                            user_data);
+
+  g_signal_connect_swapped (priv->source_registry,
+                            "source-removed",
+                            G_CALLBACK (gtd_manager__unindex_source),
+                            user_data);
+
   /* listen to the signals, so new sources don't slip by */
   g_signal_connect_swapped (priv->source_registry,
                             "source-added",
@@ -957,9 +3170,41 @@ gtd_manager_finalize (GObject *object)
 {
   GtdManager *self = (GtdManager *)object;
 
+  g_cancellable_cancel (self->priv->cancellable);
+
+  if (self->priv->compact_timeout_id > 0)
+    g_source_remove (self->priv->compact_timeout_id);
+
+  if (self->priv->budget_idle_id > 0)
+    g_source_remove (self->priv->budget_idle_id);
+
+  if (self->priv->moves_idle_id > 0)
+    g_source_remove (self->priv->moves_idle_id);
+
+  g_list_free_full (self->priv->interrupted_moves, (GDestroyNotify) move_entry_free);
+
   g_clear_object (&self->priv->goa_client);
-  g_clear_object (&self->priv->scheduled_tasks_list);
-  g_clear_object (&self->priv->today_tasks_list);
+  g_clear_object (&self->priv->rule_engine);
+  g_clear_object (&self->priv->search_index);
+  g_clear_object (&self->priv->cancellable);
+  g_clear_pointer (&self->priv->source_cancellables, g_hash_table_destroy);
+  g_clear_object (&self->priv->journal);
+  g_clear_object (&self->priv->deletions);
+  g_clear_pointer (&self->priv->goa_sources, g_hash_table_destroy);
+  g_clear_pointer (&self->priv->completed_holds, g_hash_table_destroy);
+  g_clear_pointer (&self->priv->list_holds, g_hash_table_destroy);
+  g_clear_pointer (&self->priv->replays, g_hash_table_destroy);
+  g_clear_pointer (&self->priv->refreshes, g_hash_table_destroy);
+  g_clear_pointer (&self->priv->fetches, g_hash_table_destroy);
+  g_clear_pointer (&self->priv->reloads, g_hash_table_destroy);
+  g_clear_pointer (&self->priv->recent_lists, g_queue_free);
+  g_clear_pointer (&self->priv->pending_updates, g_hash_table_destroy);
+
+  /* the lists are owned by the hash table */
+  g_clear_pointer (&self->priv->task_lists, g_list_free);
+  g_clear_pointer (&self->priv->lists, g_hash_table_destroy);
+  g_list_free_full (self->priv->storage_locations, g_object_unref);
+  self->priv->storage_locations = NULL;
 
   G_OBJECT_CLASS (gtd_manager_parent_class)->finalize (object);
 }
@@ -1002,13 +3247,13 @@ gtd_manager_constructed (GObject *object)
   default_location = g_settings_get_string (priv->settings, "storage-location");
 
   /* hash table */
-  priv->clients = g_hash_table_new_full ((GHashFunc) e_source_hash,
-                                         (GEqualFunc) e_source_equal,
-                                         g_object_unref,
-                                         g_object_unref);
+  priv->lists = g_hash_table_new_full (g_direct_hash,
+                                       g_direct_equal,
+                                       g_object_unref,
+                                       g_object_unref);
 
   /* load the source registry */
-  e_source_registry_new (NULL,
+  e_source_registry_new (priv->cancellable,
                          (GAsyncReadyCallback) gtd_manager__source_registry_finish_cb,
                          object);
 
@@ -1023,7 +3268,7 @@ gtd_manager_constructed (GObject *object)
   priv->storage_locations = g_list_append (priv->storage_locations, local_storage);
 
   /* online accounts */
-  goa_client_new (NULL,
+  goa_client_new (priv->cancellable,
                   (GAsyncReadyCallback) gtd_manager__goa_client_finish_cb,
                   object);
 
@@ -1207,12 +3452,59 @@ gtd_manager_class_init (GtdManagerClass *klass)
 static void
 gtd_manager_init (GtdManager *self)
 {
+  const GtdRuleCondition scheduled_rule[] = {
+    { GTD_TASK_FIELD_DUE_DATE, GTD_RULE_OP_IS_SET, 0, NULL }
+  };
+  const GtdRuleCondition today_rule[] = {
+    { GTD_TASK_FIELD_DUE_DATE, GTD_RULE_OP_EQUAL,  0, NULL }
+  };
+  gchar *deletions_path;
+  gchar *journal_path;
+
   self->priv = gtd_manager_get_instance_private (self);
   self->priv->settings = g_settings_new ("org.gnome.todo");
 
+  /* cancellation hierarchy */
+  self->priv->cancellable = g_cancellable_new ();
+  self->priv->source_cancellables = g_hash_table_new_full (g_str_hash,
+                                                           g_str_equal,
+                                                           g_free,
+                                                           g_object_unref);
+
+  /* online account index */
+  self->priv->goa_sources = g_hash_table_new_full (g_str_hash,
+                                                   g_str_equal,
+                                                   g_free,
+                                                   g_object_unref);
+
+  /* offline journal */
+  journal_path = g_build_filename (g_get_user_data_dir (), "gnome-todo", "journal", NULL);
+  self->priv->journal = gtd_journal_new (journal_path);
+  g_free (journal_path);
+
+  /* removals waiting for undo */
+  deletions_path = g_build_filename (g_get_user_data_dir (), "gnome-todo", "deletions", NULL);
+  self->priv->deletions = gtd_deletion_queue_new (deletions_path);
+  g_free (deletions_path);
+
   /* fixed task lists */
-  self->priv->scheduled_tasks_list = g_object_new (GTD_TYPE_TASK_LIST, NULL);
-  self->priv->today_tasks_list = g_object_new (GTD_TYPE_TASK_LIST, NULL);
+  self->priv->rule_engine = gtd_rule_engine_new ();
+  self->priv->scheduled_tasks_list = gtd_rule_engine_add_rule (self->priv->rule_engine,
+                                                               scheduled_rule,
+                                                               G_N_ELEMENTS (scheduled_rule));
+  self->priv->today_tasks_list = gtd_rule_engine_add_rule (self->priv->rule_engine,
+                                                           today_rule,
+                                                           G_N_ELEMENTS (today_rule));
+
+  self->priv->search_index = gtd_search_index_new ();
+  self->priv->completed_holds = g_hash_table_new (g_direct_hash, g_direct_equal);
+  self->priv->list_holds = g_hash_table_new (g_direct_hash, g_direct_equal);
+  self->priv->replays = g_hash_table_new (g_direct_hash, g_direct_equal);
+  self->priv->refreshes = g_hash_table_new (g_direct_hash, g_direct_equal);
+  self->priv->fetches = g_hash_table_new (g_direct_hash, g_direct_equal);
+  self->priv->reloads = g_hash_table_new (g_direct_hash, g_direct_equal);
+  self->priv->recent_lists = g_queue_new ();
+  self->priv->pending_updates = g_hash_table_new_full (g_direct_hash, g_direct_equal, g_object_unref, NULL);
 }
 
 GtdManager*
@@ -1235,27 +3527,49 @@ gtd_manager_create_task (GtdManager *manager,
                          GtdTask    *task)
 {
   GtdManagerPrivate *priv = GTD_MANAGER (manager)->priv;
+  GtdLocalStore *store;
   ECalComponent *component;
   ECalClient *client;
   TaskData *data;
-  ESource *source;
 
   g_return_if_fail (GTD_IS_MANAGER (manager));
   g_return_if_fail (GTD_IS_TASK (task));
 
-  source = gtd_task_list_get_source (gtd_task_get_list (task));
-  client = g_hash_table_lookup (priv->clients, source);
+  client = gtd_task_list_get_client (gtd_task_get_list (task));
   component = gtd_task_get_component (task);
+  store = gtd_task_list_get_store (gtd_task_get_list (task));
+
+  /* Local lists are written directly */
+  if (store)
+    {
+      gtd_local_store_save_task (store, task);
+      gtd_rule_engine_add_task (priv->rule_engine, task);
+      return;
+    }
+
+  /* The source isn't connected, create it later */
+  if (!client)
+    {
+      gtd_manager__journal_task (manager, GTD_JOURNAL_OPERATION_CREATE, task);
+      gtd_rule_engine_add_task (priv->rule_engine, task);
+      return;
+    }
 
   /* Temporary data for async operation */
-  data = task_data_new (manager, (gpointer) task);
+  data = task_data_new (manager,
+                        (gpointer) task,
+                        gtd_manager__new_list_operation (gtd_task_get_list (task), TASK_OPERATION_TIMEOUT));
+
+  /* Written ahead, so it survives quitting before the source answers */
+  data->serial = gtd_manager__journal_task (manager, GTD_JOURNAL_OPERATION_CREATE, task);
+  gtd_manager__mark_sent (manager, task, data->serial);
 
   /* The task is not ready until we finish the operation */
-  gtd_object_set_ready (GTD_OBJECT (task), FALSE);
+  gtd_object_begin_operation (GTD_OBJECT (task));
 
   e_cal_client_create_object (client,
                               e_cal_component_get_icalcomponent (component),
-                              NULL, // We won't cancel the operation
+                              data->cancellable,
                               (GAsyncReadyCallback) gtd_manager__create_task_finished,
                               data);
 }
@@ -1274,37 +3588,261 @@ gtd_manager_remove_task (GtdManager *manager,
                          GtdTask    *task)
 {
   GtdManagerPrivate *priv = GTD_MANAGER (manager)->priv;
+  GtdLocalStore *store;
   ECalComponent *component;
   ECalComponentId *id;
   ECalClient *client;
   TaskData *data;
-  ESource *source;
 
   g_return_if_fail (GTD_IS_MANAGER (manager));
   g_return_if_fail (GTD_IS_TASK (task));
 
-  source = gtd_task_list_get_source (gtd_task_get_list (task));
-  client = g_hash_table_lookup (priv->clients, source);
+  client = gtd_task_list_get_client (gtd_task_get_list (task));
   component = gtd_task_get_component (task);
+  store = gtd_task_list_get_store (gtd_task_get_list (task));
+
+  /* Local lists are written directly */
+  if (store)
+    {
+      gtd_local_store_remove_task (store, gtd_object_get_uid (GTD_OBJECT (task)));
+      gtd_rule_engine_remove_task (priv->rule_engine, task);
+      g_object_unref (task);
+      return;
+    }
+
+  /* The source isn't connected, remove it later */
+  if (!client)
+    {
+      gtd_manager__journal_task (manager, GTD_JOURNAL_OPERATION_REMOVE, task);
+      gtd_rule_engine_remove_task (priv->rule_engine, task);
+      g_object_unref (task);
+      return;
+    }
+
   id = e_cal_component_get_id (component);
 
   /* Temporary data for async operation */
-  data = task_data_new (manager, (gpointer) task);
+  data = task_data_new (manager,
+                        (gpointer) task,
+                        gtd_manager__new_list_operation (gtd_task_get_list (task), TASK_OPERATION_TIMEOUT));
+
+  /* Written ahead, so it survives quitting before the source answers */
+  data->serial = gtd_manager__journal_task (manager, GTD_JOURNAL_OPERATION_REMOVE, task);
 
   /* The task is not ready until we finish the operation */
-  gtd_object_set_ready (GTD_OBJECT (task), FALSE);
+  gtd_object_begin_operation (GTD_OBJECT (task));
 
   e_cal_client_remove_object (client,
                               id->uid,
                               id->rid,
                               E_CAL_OBJ_MOD_THIS,
-                              NULL, // We won't cancel the operation
+                              data->cancellable,
                               (GAsyncReadyCallback) gtd_manager__remove_task_finished,
                               data);
 
   e_cal_component_free_id (id);
 }
 
+/**
+ * gtd_manager_remove_tasks:
+ * @manager: a #GtdManager
+ * @tasks: (element-type GtdTask): the tasks to remove
+ *
+ * Removes @tasks like gtd_manager_remove_task() does, but sends
+ * a single request to each source they belong to.
+ *
+ * Returns:
+ */
+void
+gtd_manager_remove_tasks (GtdManager *manager,
+                          GList      *tasks)
+{
+  GHashTableIter iter;
+  GHashTable *batches;
+  gpointer client;
+  gpointer batch;
+  GList *l;
+
+  g_return_if_fail (GTD_IS_MANAGER (manager));
+
+  /* Group the tasks by the client of their list */
+  batches = g_hash_table_new (g_direct_hash, g_direct_equal);
+
+  for (l = tasks; l != NULL; l = l->next)
+    {
+      GtdTaskList *list = gtd_task_get_list (l->data);
+
+      client = gtd_task_list_get_client (list);
+
+      /* Local and disconnected lists don't talk to a backend */
+      if (!client || gtd_task_list_get_store (list))
+        {
+          gtd_manager_remove_task (manager, l->data);
+          continue;
+        }
+
+      batch = g_hash_table_lookup (batches, client);
+      g_hash_table_insert (batches, client, g_list_prepend (batch, l->data));
+    }
+
+  g_hash_table_iter_init (&iter, batches);
+
+  while (g_hash_table_iter_next (&iter, &client, &batch))
+    {
+      TaskData *data;
+      guint64 serial;
+      GSList *ids;
+
+      if (!((GList*) batch)->next)
+        {
+          gtd_manager_remove_task (manager, ((GList*) batch)->data);
+          g_list_free (batch);
+          continue;
+        }
+
+      ids = NULL;
+      serial = 0;
+
+      for (l = batch; l != NULL; l = l->next)
+        {
+          ids = g_slist_prepend (ids, e_cal_component_get_id (gtd_task_get_component (l->data)));
+          serial = gtd_manager__journal_task (manager, GTD_JOURNAL_OPERATION_REMOVE, l->data);
+
+          /* The tasks are not ready until we finish the operation */
+          gtd_object_begin_operation (GTD_OBJECT (l->data));
+        }
+
+      data = task_data_new (manager,
+                            batch,
+                            gtd_manager__new_list_operation (gtd_task_get_list (((GList*) batch)->data),
+                                                             TASK_OPERATION_TIMEOUT));
+      data->serial = serial;
+
+      e_cal_client_remove_objects (client,
+                                   ids,
+                                   E_CAL_OBJ_MOD_THIS,
+                                   data->cancellable,
+                                   (GAsyncReadyCallback) gtd_manager__remove_tasks_finished,
+                                   data);
+
+      g_slist_free_full (ids, (GDestroyNotify) e_cal_component_free_id);
+    }
+
+  g_hash_table_destroy (batches);
+}
+
+/**
+ * gtd_manager_defer_remove_task:
+ * @manager: a #GtdManager
+ * @task: a #GtdTask
+ *
+ * Takes @task out of its list and of the virtual lists, and records
+ * that it's about to be removed. The removal can be undone with
+ * gtd_manager_undo_remove_task() until it's sent to the source with
+ * gtd_manager_commit_removals(), which also happens when @manager
+ * is cancelled. Removals interrupted by a crash are finished the next
+ * time the task is loaded.
+ *
+ * Returns:
+ */
+void
+gtd_manager_defer_remove_task (GtdManager *manager,
+                               GtdTask    *task)
+{
+  GtdManagerPrivate *priv;
+
+  g_return_if_fail (GTD_IS_MANAGER (manager));
+  g_return_if_fail (GTD_IS_TASK (task));
+
+  priv = manager->priv;
+
+  gtd_deletion_queue_add (priv->deletions, task);
+
+  gtd_rule_engine_remove_task (priv->rule_engine, task);
+  gtd_task_list_remove_task (gtd_task_get_list (task), task);
+}
+
+/**
+ * gtd_manager_undo_remove_task:
+ * @manager: a #GtdManager
+ * @task: a #GtdTask passed to gtd_manager_defer_remove_task()
+ *
+ * Puts @task back into its list, if its removal wasn't sent yet.
+ *
+ * Returns: %TRUE if @task was brought back, %FALSE otherwise
+ */
+gboolean
+gtd_manager_undo_remove_task (GtdManager *manager,
+                              GtdTask    *task)
+{
+  GtdManagerPrivate *priv;
+
+  g_return_val_if_fail (GTD_IS_MANAGER (manager), FALSE);
+  g_return_val_if_fail (GTD_IS_TASK (task), FALSE);
+
+  priv = manager->priv;
+
+  /* The list keeps the reference the queue had */
+  g_object_ref (task);
+
+  if (!gtd_deletion_queue_remove (priv->deletions, task))
+    {
+      g_object_unref (task);
+      return FALSE;
+    }
+
+  gtd_task_list_save_task (gtd_task_get_list (task), task);
+  gtd_rule_engine_add_task (priv->rule_engine, task);
+
+  g_object_unref (task);
+
+  return TRUE;
+}
+
+/**
+ * gtd_manager_commit_removals:
+ * @manager: a #GtdManager
+ * @tasks: (element-type GtdTask) (nullable): tasks passed to
+ * gtd_manager_defer_remove_task(), or %NULL for every pending removal
+ *
+ * Sends the pending removals of @tasks to their sources, in a single
+ * request per source. Tasks whose removal was undone or already sent
+ * are skipped.
+ *
+ * Returns:
+ */
+void
+gtd_manager_commit_removals (GtdManager *manager,
+                             GList      *tasks)
+{
+  GtdManagerPrivate *priv;
+  GList *pending;
+  GList *removals;
+  GList *l;
+
+  g_return_if_fail (GTD_IS_MANAGER (manager));
+
+  priv = manager->priv;
+  pending = tasks ? g_list_copy (tasks) : gtd_deletion_queue_get_tasks (priv->deletions);
+  removals = NULL;
+
+  for (l = pending; l != NULL; l = l->next)
+    {
+      /* The reference of the queue goes to the removal */
+      g_object_ref (l->data);
+
+      if (gtd_deletion_queue_remove (priv->deletions, l->data))
+        removals = g_list_prepend (removals, l->data);
+      else
+        g_object_unref (l->data);
+    }
+
+  gtd_manager_remove_tasks (manager, removals);
+
+  g_list_free (removals);
+  g_list_free (pending);
+}
+
 /**
  * gtd_manager_update_task:
  * @manager: a #GtdManager
@@ -1319,30 +3857,327 @@ gtd_manager_update_task (GtdManager *manager,
                          GtdTask    *task)
 {
   GtdManagerPrivate *priv = GTD_MANAGER (manager)->priv;
+  GtdLocalStore *store;
   ECalComponent *component;
   ECalClient *client;
   TaskData *data;
-  ESource *source;
 
   g_return_if_fail (GTD_IS_MANAGER (manager));
   g_return_if_fail (GTD_IS_TASK (task));
 
-  source = gtd_task_list_get_source (gtd_task_get_list (task));
-  client = g_hash_table_lookup (priv->clients, source);
+  /* Sent together when the batch is committed */
+  if (priv->updates_depth > 0)
+    {
+      if (!g_hash_table_contains (priv->pending_updates, task))
+        g_hash_table_add (priv->pending_updates, g_object_ref (task));
+
+      return;
+    }
+
+  client = gtd_task_list_get_client (gtd_task_get_list (task));
   component = gtd_task_get_component (task);
+  store = gtd_task_list_get_store (gtd_task_get_list (task));
+
+  gtd_search_index_update_task (priv->search_index, task);
+
+  if (gtd_task_get_complete (task))
+    gtd_manager__schedule_compact (manager);
+
+  /* Local lists are written directly */
+  if (store)
+    {
+      gtd_local_store_save_task (store, task);
+      gtd_rule_engine_update_task (priv->rule_engine, task);
+      return;
+    }
+
+  /* The source isn't connected, update it later */
+  if (!client)
+    {
+      gtd_manager__journal_task (manager, GTD_JOURNAL_OPERATION_MODIFY, task);
+      gtd_rule_engine_update_task (priv->rule_engine, task);
+      return;
+    }
+
+  /* Temporary data for async operation */
+  data = task_data_new (manager,
+                        (gpointer) task,
+                        gtd_manager__new_list_operation (gtd_task_get_list (task), TASK_OPERATION_TIMEOUT));
+
+  /* Written ahead, so it survives quitting before the source answers */
+  data->serial = gtd_manager__journal_task (manager, GTD_JOURNAL_OPERATION_MODIFY, task);
+
+  /* The task is not ready until we finish the operation */
+  gtd_object_begin_operation (GTD_OBJECT (task));
+
+  e_cal_client_modify_object (client,
+                              e_cal_component_get_icalcomponent (component),
+                              E_CAL_OBJ_MOD_THIS,
+                              data->cancellable,
+                              (GAsyncReadyCallback) gtd_manager__update_task_finished,
+                              data);
+}
+
+/**
+ * gtd_manager_update_tasks:
+ * @manager: a #GtdManager
+ * @tasks: (element-type GtdTask): the tasks to update
+ *
+ * Updates @tasks like gtd_manager_update_task() does, but sends
+ * a single request to each source they belong to.
+ *
+ * Returns:
+ */
+void
+gtd_manager_update_tasks (GtdManager *manager,
+                          GList      *tasks)
+{
+  GtdManagerPrivate *priv;
+  GHashTableIter iter;
+  GHashTable *batches;
+  gpointer client;
+  gpointer batch;
+  GList *l;
+
+  g_return_if_fail (GTD_IS_MANAGER (manager));
+
+  priv = manager->priv;
+
+  /* Group the tasks by the client of their list */
+  batches = g_hash_table_new (g_direct_hash, g_direct_equal);
+
+  for (l = tasks; l != NULL; l = l->next)
+    {
+      GtdTaskList *list = gtd_task_get_list (l->data);
+
+      client = gtd_task_list_get_client (list);
+
+      /* Local and disconnected lists don't talk to a backend */
+      if (priv->updates_depth > 0 || !client || gtd_task_list_get_store (list))
+        {
+          gtd_manager_update_task (manager, l->data);
+          continue;
+        }
+
+      batch = g_hash_table_lookup (batches, client);
+      g_hash_table_insert (batches, client, g_list_prepend (batch, g_object_ref (l->data)));
+    }
+
+  g_hash_table_iter_init (&iter, batches);
+
+  while (g_hash_table_iter_next (&iter, &client, &batch))
+    {
+      GSList *components;
+      TaskData *data;
+      guint64 serial;
+
+      if (!((GList*) batch)->next)
+        {
+          gtd_manager_update_task (manager, ((GList*) batch)->data);
+          g_list_free_full (batch, g_object_unref);
+          continue;
+        }
+
+      components = NULL;
+      serial = 0;
+
+      for (l = batch; l != NULL; l = l->next)
+        {
+          components = g_slist_prepend (components,
+                                        e_cal_component_get_icalcomponent (gtd_task_get_component (l->data)));
+          serial = gtd_manager__journal_task (manager, GTD_JOURNAL_OPERATION_MODIFY, l->data);
+
+          gtd_search_index_update_task (priv->search_index, l->data);
+
+          if (gtd_task_get_complete (l->data))
+            gtd_manager__schedule_compact (manager);
+
+          /* The tasks are not ready until we finish the operation */
+          gtd_object_begin_operation (GTD_OBJECT (l->data));
+        }
+
+      data = task_data_new (manager,
+                            batch,
+                            gtd_manager__new_list_operation (gtd_task_get_list (((GList*) batch)->data),
+                                                             TASK_OPERATION_TIMEOUT));
+      data->serial = serial;
+
+      e_cal_client_modify_objects (client,
+                                   components,
+                                   E_CAL_OBJ_MOD_THIS,
+                                   data->cancellable,
+                                   (GAsyncReadyCallback) gtd_manager__update_tasks_finished,
+                                   data);
+
+      g_slist_free (components);
+    }
+
+  g_hash_table_destroy (batches);
+}
+
+/**
+ * gtd_manager_begin_updates:
+ * @manager: a #GtdManager
+ *
+ * Holds back the updates of tasks until the matching call to
+ * gtd_manager_commit_updates(), so that changes to many tasks
+ * are sent together. A task updated many times is sent once.
+ * Calls can be nested.
+ *
+ * Returns:
+ */
+void
+gtd_manager_begin_updates (GtdManager *manager)
+{
+  g_return_if_fail (GTD_IS_MANAGER (manager));
+
+  manager->priv->updates_depth++;
+}
+
+/**
+ * gtd_manager_commit_updates:
+ * @manager: a #GtdManager
+ *
+ * Ends the batch started with gtd_manager_begin_updates(). When the
+ * outermost batch ends, the held back updates are sent with a single
+ * request per source.
+ *
+ * Returns:
+ */
+void
+gtd_manager_commit_updates (GtdManager *manager)
+{
+  GtdManagerPrivate *priv;
+  GHashTable *pending;
+  GList *tasks;
+
+  g_return_if_fail (GTD_IS_MANAGER (manager));
+  g_return_if_fail (manager->priv->updates_depth > 0);
+
+  priv = manager->priv;
+  priv->updates_depth--;
+
+  if (priv->updates_depth > 0 || g_hash_table_size (priv->pending_updates) == 0)
+    return;
+
+  /* Keep the tasks alive while the new batch is built */
+  pending = priv->pending_updates;
+  priv->pending_updates = g_hash_table_new_full (g_direct_hash, g_direct_equal, g_object_unref, NULL);
+
+  tasks = g_hash_table_get_keys (pending);
+
+  gtd_manager_update_tasks (manager, tasks);
+
+  g_list_free (tasks);
+  g_hash_table_destroy (pending);
+}
+
+/**
+ * gtd_manager_move_tasks:
+ * @manager: a #GtdManager
+ * @tasks: (element-type GtdTask): the tasks to move
+ * @list: the #GtdTaskList to move @tasks to
+ *
+ * Moves @tasks to @list, which may belong to another source. The
+ * tasks are the same instances afterwards, and are taken out of
+ * their lists and put in @list right away.
+ *
+ * Both halves of the move are written to the journal before the
+ * sources are touched. The tasks are then created in the source of
+ * @list in batches, and each batch is removed from the old sources
+ * once it was created. Tasks that can't be created go back to their
+ * old lists. If To Do quits or a source goes offline halfway, the
+ * journal finishes the move later, and never removes a task before
+ * it exists in @list.
+ *
+ * Returns:
+ */
+void
+gtd_manager_move_tasks (GtdManager  *manager,
+                        GList       *tasks,
+                        GtdTaskList *list)
+{
+  GtdManagerPrivate *priv;
+  const GtdJournalEntry *created;
+  const gchar *target_uid;
+  MoveData *data;
+  GList *l;
+
+  g_return_if_fail (GTD_IS_MANAGER (manager));
+  g_return_if_fail (GTD_IS_TASK_LIST (list));
+
+  priv = manager->priv;
+  target_uid = e_source_get_uid (gtd_task_list_get_source (list));
+
+  data = g_new0 (MoveData, 1);
+  data->manager = manager;
+  data->list = g_object_ref (list);
+  data->pending = g_queue_new ();
+
+  for (l = tasks; l != NULL; l = l->next)
+    {
+      GtdTaskList *from;
+      MoveEntry *entry;
+      const gchar *uid;
+
+      from = gtd_task_get_list (l->data);
+      uid = gtd_object_get_uid (GTD_OBJECT (l->data));
+
+      if (from == list)
+        continue;
+
+      entry = g_new0 (MoveEntry, 1);
+      entry->task = g_object_ref (l->data);
+      entry->from = g_object_ref (from);
+
+      /* Local lists are written right away, and need no journal */
+      if (!gtd_task_list_get_store (list))
+        {
+          gchar *ical;
+
+          ical = e_cal_component_get_as_string (gtd_task_get_component (l->data));
+          entry->create_serial = gtd_journal_append (priv->journal,
+                                                     GTD_JOURNAL_OPERATION_CREATE,
+                                                     target_uid,
+                                                     uid,
+                                                     ical);
+          g_free (ical);
+
+          /* Moving back before the old copy was removed */
+          created = gtd_journal_lookup (priv->journal, target_uid, uid);
+          entry->in_target = created->operation == GTD_JOURNAL_OPERATION_MODIFY;
+        }
+
+      entry->remove_serial = gtd_journal_append (priv->journal,
+                                                 GTD_JOURNAL_OPERATION_REMOVE,
+                                                 e_source_get_uid (gtd_task_list_get_source (from)),
+                                                 uid,
+                                                 target_uid);
+
+      /* Not ready until both sources are done with it */
+      gtd_object_begin_operation (GTD_OBJECT (l->data));
+
+      gtd_manager__move_task_to_list (manager, l->data, list);
+
+      g_queue_push_tail (data->pending, entry);
+    }
+
+  if (g_queue_is_empty (data->pending))
+    {
+      move_data_free (data);
+      return;
+    }
 
-  /* Temporary data for async operation */
-  data = task_data_new (manager, (gpointer) task);
+  /* The sources may only change once the journal is on disk */
+  gtd_journal_flush (priv->journal);
 
-  /* The task is not ready until we finish the operation */
-  gtd_object_set_ready (GTD_OBJECT (task), FALSE);
+  g_debug ("%s: %s (%s): %u",
+           G_STRFUNC,
+           "Moving tasks",
+           gtd_task_list_get_name (list),
+           g_queue_get_length (data->pending));
 
-  e_cal_client_modify_object (client,
-                              e_cal_component_get_icalcomponent (component),
-                              E_CAL_OBJ_MOD_THIS,
-                              NULL, // We won't cancel the operation
-                              (GAsyncReadyCallback) gtd_manager__update_task_finished,
-                              data);
+  gtd_manager__move_next_batch (data);
 }
 
 /**
@@ -1358,6 +4193,7 @@ void
 gtd_manager_remove_task_list (GtdManager  *manager,
                               GtdTaskList *list)
 {
+  TaskData *data;
   ESource *source;
 
   g_return_if_fail (GTD_IS_MANAGER (manager));
@@ -1365,12 +4201,15 @@ gtd_manager_remove_task_list (GtdManager  *manager,
   g_return_if_fail (gtd_task_list_get_source (list));
 
   source = gtd_task_list_get_source (list);
+  data = task_data_new (manager,
+                        (gpointer) list,
+                        gtd_cancellable_new (manager->priv->cancellable, SOURCE_OPERATION_TIMEOUT));
 
-  gtd_object_set_ready (GTD_OBJECT (manager), FALSE);
+  gtd_object_begin_operation (GTD_OBJECT (manager));
   e_source_remove (source,
-                   NULL,
+                   data->cancellable,
                    (GAsyncReadyCallback) gtd_manager__remove_source_finished,
-                   manager);
+                   data);
 }
 
 /**
@@ -1386,6 +4225,7 @@ void
 gtd_manager_save_task_list (GtdManager  *manager,
                             GtdTaskList *list)
 {
+  TaskData *data;
   ESource *source;
 
   g_return_if_fail (GTD_IS_MANAGER (manager));
@@ -1393,13 +4233,75 @@ gtd_manager_save_task_list (GtdManager  *manager,
   g_return_if_fail (gtd_task_list_get_source (list));
 
   source = gtd_task_list_get_source (list);
+  data = task_data_new (manager,
+                        (gpointer) list,
+                        gtd_cancellable_new (manager->priv->cancellable, SOURCE_OPERATION_TIMEOUT));
 
-  gtd_object_set_ready (GTD_OBJECT (manager), FALSE);
+  gtd_object_begin_operation (GTD_OBJECT (manager));
   e_source_registry_commit_source (manager->priv->source_registry,
                                    source,
-                                   NULL,
+                                   data->cancellable,
                                    (GAsyncReadyCallback) gtd_manager__commit_source_finished,
-                                   manager);
+                                   data);
+}
+
+/**
+ * gtd_manager_refresh_task_list:
+ * @manager: a #GtdManager
+ * @list: a #GtdTaskList
+ *
+ * Fetches the current tasks of @list's source, and reconciles them
+ * with the tasks in @list. Existing #GtdTask instances are kept and
+ * updated in place; only the tasks that were actually added, changed
+ * or removed on the source cause @list to emit signals. A refresh of
+ * @list still running is cancelled, and its results are discarded.
+ * While the tasks of @list are fetched for the first time, the
+ * refresh is postponed until the fetch is done.
+ *
+ * Returns:
+ */
+void
+gtd_manager_refresh_task_list (GtdManager  *manager,
+                               GtdTaskList *list)
+{
+  ECalClient *client;
+  TaskData *previous;
+  TaskData *data;
+
+  g_return_if_fail (GTD_IS_MANAGER (manager));
+  g_return_if_fail (GTD_IS_TASK_LIST (list));
+  g_return_if_fail (gtd_task_list_get_source (list));
+
+  client = gtd_task_list_get_client (list);
+
+  /* Nothing to refresh from; local lists are always up to date */
+  if (!client)
+    return;
+
+  /* The initial fetch would add the same tasks again */
+  if (g_hash_table_contains (manager->priv->fetches, list))
+    {
+      g_hash_table_insert (manager->priv->fetches, list, GINT_TO_POINTER (TRUE));
+      return;
+    }
+
+  /* The snapshot of a refresh still running would be older */
+  previous = g_hash_table_lookup (manager->priv->refreshes, list);
+
+  if (previous)
+    g_cancellable_cancel (previous->cancellable);
+
+  data = task_data_new (manager,
+                        g_object_ref (list),
+                        gtd_manager__new_list_operation (list, LIST_FETCH_TIMEOUT));
+
+  g_hash_table_insert (manager->priv->refreshes, list, data);
+
+  e_cal_client_get_object_list_as_comps (client,
+                                         "contains? \"any\" \"\"",
+                                         data->cancellable,
+                                         (GAsyncReadyCallback) gtd_manager__refresh_task_list_finished,
+                                         data);
 }
 
 /**
@@ -1454,6 +4356,54 @@ gtd_manager_get_task_lists (GtdManager *manager)
   return g_list_copy (manager->priv->task_lists);
 }
 
+/**
+ * gtd_manager_find_task_list:
+ * @manager: a #GtdManager
+ * @name: the name of a task list
+ *
+ * Looks up a loaded #GtdTaskList by its name, ignoring case. The
+ * names "today" and "scheduled" always refer to the virtual lists.
+ *
+ * Returns: (transfer none) (nullable): the #GtdTaskList named @name,
+ * or %NULL if there is none.
+ */
+GtdTaskList*
+gtd_manager_find_task_list (GtdManager  *manager,
+                            const gchar *name)
+{
+  GtdTaskList *found;
+  gchar *folded_name;
+  GList *l;
+
+  g_return_val_if_fail (GTD_IS_MANAGER (manager), NULL);
+  g_return_val_if_fail (name, NULL);
+
+  if (g_ascii_strcasecmp (name, "today") == 0)
+    return gtd_manager_get_today_list (manager);
+
+  if (g_ascii_strcasecmp (name, "scheduled") == 0)
+    return gtd_manager_get_scheduled_list (manager);
+
+  found = NULL;
+  folded_name = g_utf8_casefold (name, -1);
+
+  for (l = manager->priv->task_lists; l != NULL && !found; l = l->next)
+    {
+      gchar *list_name;
+
+      list_name = g_utf8_casefold (gtd_task_list_get_name (l->data), -1);
+
+      if (g_strcmp0 (folded_name, list_name) == 0)
+        found = l->data;
+
+      g_free (list_name);
+    }
+
+  g_free (folded_name);
+
+  return found;
+}
+
 /**
  * gtd_manager_get_storage_locations:
  *
@@ -1572,6 +4522,23 @@ gtd_manager_set_is_first_run (GtdManager *manager,
                           is_first_run);
 }
 
+/**
+ * gtd_manager_get_run_in_background:
+ * @manager: a #GtdManager
+ *
+ * Retrieves the 'run-in-background' setting.
+ *
+ * Returns: %TRUE if To Do keeps running after its window is closed,
+ * %FALSE otherwise.
+ */
+gboolean
+gtd_manager_get_run_in_background (GtdManager *manager)
+{
+  g_return_val_if_fail (GTD_IS_MANAGER (manager), FALSE);
+
+  return g_settings_get_boolean (manager->priv->settings, "run-in-background");
+}
+
 /**
  * gtd_manager_get_scheduled_list:
  * @manager: a #GtdManager
@@ -1605,3 +4572,323 @@ gtd_manager_get_today_list (GtdManager *manager)
 
   return manager->priv->today_tasks_list;
 }
+
+/**
+ * gtd_manager_get_rule_engine:
+ * @manager: a #GtdManager
+ *
+ * Retrieves the #GtdRuleEngine that keeps the virtual lists of
+ * @manager up to date. New smart lists can be added to it with
+ * gtd_rule_engine_add_rule().
+ *
+ * Returns: (transfer none): the internal #GtdRuleEngine
+ */
+GtdRuleEngine*
+gtd_manager_get_rule_engine (GtdManager *manager)
+{
+  g_return_val_if_fail (GTD_IS_MANAGER (manager), NULL);
+
+  return manager->priv->rule_engine;
+}
+
+/**
+ * gtd_manager_get_search_index:
+ * @manager: a #GtdManager
+ *
+ * Retrieves the #GtdSearchIndex that holds the titles of the tasks
+ * of @manager.
+ *
+ * Returns: (transfer none): the internal #GtdSearchIndex
+ */
+GtdSearchIndex*
+gtd_manager_get_search_index (GtdManager *manager)
+{
+  g_return_val_if_fail (GTD_IS_MANAGER (manager), NULL);
+
+  return manager->priv->search_index;
+}
+
+/*
+ * Requests sent while quitting would be cancelled right away, so the
+ * pending removals are written to local lists directly, and to the
+ * journal otherwise, to be replayed when To Do starts again.
+ */
+static void
+gtd_manager__journal_removals (GtdManager *manager)
+{
+  GtdManagerPrivate *priv = manager->priv;
+  GList *tasks;
+  GList *l;
+
+  tasks = gtd_deletion_queue_get_tasks (priv->deletions);
+
+  for (l = tasks; l != NULL; l = l->next)
+    {
+      GtdTask *task = l->data;
+      GtdLocalStore *store;
+
+      store = gtd_task_list_get_store (gtd_task_get_list (task));
+
+      if (store)
+        gtd_local_store_remove_task (store, gtd_object_get_uid (GTD_OBJECT (task)));
+      else
+        gtd_manager__journal_task (manager, GTD_JOURNAL_OPERATION_REMOVE, task);
+
+      gtd_deletion_queue_remove (priv->deletions, task);
+
+      /* Drop the reference the list had */
+      g_object_unref (task);
+    }
+
+  g_list_free (tasks);
+}
+
+/**
+ * gtd_manager_cancel:
+ * @manager: a #GtdManager
+ *
+ * Cancels every outstanding operation of @manager, including the
+ * ones running on its sources, lists and tasks. This is meant to
+ * be called when the application quits. Writes to tasks are in the
+ * journal before they are sent, so the ones cancelled here are
+ * replayed the next time To Do starts.
+ *
+ * Returns:
+ */
+void
+gtd_manager_cancel (GtdManager *manager)
+{
+  g_return_if_fail (GTD_IS_MANAGER (manager));
+
+  /* Pending removals can't be undone anymore */
+  gtd_manager__journal_removals (manager);
+
+  g_cancellable_cancel (manager->priv->cancellable);
+
+  /* make sure the pending operations hit the disk */
+  gtd_manager_trim (manager);
+}
+
+/**
+ * gtd_manager_trim:
+ * @manager: a #GtdManager
+ *
+ * Writes the pending journal, removal and local list records to disk,
+ * releasing the buffers that hold them, and freezes the completed tasks no one
+ * holds with gtd_manager_hold_completed(). The loaded lists, their
+ * clients and the indexes are kept, so @manager stays ready to serve
+ * requests. This is meant to be called when the application becomes
+ * idle.
+ *
+ * Returns:
+ */
+void
+gtd_manager_trim (GtdManager *manager)
+{
+  GList *l;
+
+  g_return_if_fail (GTD_IS_MANAGER (manager));
+
+  gtd_journal_flush (manager->priv->journal);
+  gtd_deletion_queue_flush (manager->priv->deletions);
+
+  for (l = manager->priv->task_lists; l != NULL; l = l->next)
+    {
+      if (gtd_task_list_get_store (l->data))
+        gtd_local_store_flush (gtd_task_list_get_store (l->data));
+    }
+
+  /* Don't wait to freeze the completed tasks no one looks at, unless quitting */
+  if (!g_cancellable_is_cancelled (manager->priv->cancellable))
+    {
+      if (manager->priv->compact_timeout_id > 0)
+        g_source_remove (manager->priv->compact_timeout_id);
+
+      gtd_manager__compact (manager);
+    }
+}
+
+static GtdTaskList*
+gtd_manager__get_hold_key (GtdManager  *manager,
+                           GtdTaskList *list)
+{
+  /* Today and Scheduled look at every list */
+  if (list == manager->priv->today_tasks_list ||
+      list == manager->priv->scheduled_tasks_list)
+    {
+      return NULL;
+    }
+
+  return list;
+}
+
+/**
+ * gtd_manager_hold_completed:
+ * @manager: a #GtdManager
+ * @list: (nullable): the #GtdTaskList whose completed tasks are needed,
+ * or %NULL for every list
+ *
+ * Completed tasks that aren't used for a while are frozen, and left out
+ * of gtd_task_list_get_tasks() until needed again. This brings them back
+ * and keeps them until gtd_manager_release_completed() is called, e.g.
+ * while they are shown.
+ *
+ * Returns:
+ */
+void
+gtd_manager_hold_completed (GtdManager  *manager,
+                            GtdTaskList *list)
+{
+  GtdManagerPrivate *priv;
+  GtdTaskList *key;
+  guint n_holds;
+
+  g_return_if_fail (GTD_IS_MANAGER (manager));
+  g_return_if_fail (!list || GTD_IS_TASK_LIST (list));
+
+  priv = manager->priv;
+  key = gtd_manager__get_hold_key (manager, list);
+  n_holds = GPOINTER_TO_UINT (g_hash_table_lookup (priv->completed_holds, key));
+
+  g_hash_table_insert (priv->completed_holds, key, GUINT_TO_POINTER (n_holds + 1));
+
+  if (n_holds > 0)
+    return;
+
+  if (key)
+    {
+      gtd_manager__thaw_list (manager, key);
+    }
+  else
+    {
+      GList *l;
+
+      for (l = priv->task_lists; l != NULL; l = l->next)
+        gtd_manager__thaw_list (manager, l->data);
+    }
+}
+
+/**
+ * gtd_manager_release_completed:
+ * @manager: a #GtdManager
+ * @list: (nullable): the #GtdTaskList passed to gtd_manager_hold_completed()
+ *
+ * Releases a hold on the completed tasks of @list. They are frozen
+ * again once no one uses them for a while.
+ *
+ * Returns:
+ */
+void
+gtd_manager_release_completed (GtdManager  *manager,
+                               GtdTaskList *list)
+{
+  GtdManagerPrivate *priv;
+  GtdTaskList *key;
+  guint n_holds;
+
+  g_return_if_fail (GTD_IS_MANAGER (manager));
+  g_return_if_fail (!list || GTD_IS_TASK_LIST (list));
+
+  priv = manager->priv;
+  key = gtd_manager__get_hold_key (manager, list);
+  n_holds = GPOINTER_TO_UINT (g_hash_table_lookup (priv->completed_holds, key));
+
+  g_return_if_fail (n_holds > 0);
+
+  if (n_holds > 1)
+    {
+      g_hash_table_insert (priv->completed_holds, key, GUINT_TO_POINTER (n_holds - 1));
+      return;
+    }
+
+  g_hash_table_remove (priv->completed_holds, key);
+
+  gtd_manager__schedule_compact (manager);
+}
+
+/**
+ * gtd_manager_hold_task_list:
+ * @manager: a #GtdManager
+ * @list: a #GtdTaskList
+ *
+ * When more tasks than the "max-loaded-tasks" setting are loaded, the
+ * least recently used lists are evicted: their tasks are unloaded, except
+ * for the ones Today and Scheduled show. This marks @list as used, reloads
+ * it if it was evicted, and keeps it loaded until gtd_manager_release_task_list()
+ * is called. @list isn't ready while it's being reloaded.
+ *
+ * Returns:
+ */
+void
+gtd_manager_hold_task_list (GtdManager  *manager,
+                            GtdTaskList *list)
+{
+  GtdManagerPrivate *priv;
+  guint n_holds;
+
+  g_return_if_fail (GTD_IS_MANAGER (manager));
+  g_return_if_fail (GTD_IS_TASK_LIST (list));
+
+  priv = manager->priv;
+
+  /* Today and Scheduled are never evicted */
+  if (!g_queue_remove (priv->recent_lists, list))
+    return;
+
+  g_queue_push_head (priv->recent_lists, list);
+
+  n_holds = GPOINTER_TO_UINT (g_hash_table_lookup (priv->list_holds, list));
+  g_hash_table_insert (priv->list_holds, list, GUINT_TO_POINTER (n_holds + 1));
+
+  if (!gtd_task_list_get_evicted (list) || g_hash_table_contains (priv->reloads, list))
+    return;
+
+  if (gtd_task_list_get_store (list))
+    {
+      gtd_manager__reload_local_list (manager, list);
+      gtd_manager__schedule_budget (manager);
+    }
+  else if (gtd_task_list_get_client (list))
+    {
+      g_hash_table_add (priv->reloads, list);
+      gtd_object_begin_operation (GTD_OBJECT (list));
+      gtd_manager_refresh_task_list (manager, list);
+    }
+}
+
+/**
+ * gtd_manager_release_task_list:
+ * @manager: a #GtdManager
+ * @list: the #GtdTaskList passed to gtd_manager_hold_task_list()
+ *
+ * Releases a hold on @list. It may be evicted again once it's one of the
+ * least recently used lists.
+ *
+ * Returns:
+ */
+void
+gtd_manager_release_task_list (GtdManager  *manager,
+                               GtdTaskList *list)
+{
+  GtdManagerPrivate *priv;
+  guint n_holds;
+
+  g_return_if_fail (GTD_IS_MANAGER (manager));
+  g_return_if_fail (GTD_IS_TASK_LIST (list));
+
+  priv = manager->priv;
+  n_holds = GPOINTER_TO_UINT (g_hash_table_lookup (priv->list_holds, list));
+
+  if (n_holds == 0)
+    return;
+
+  if (n_holds > 1)
+    {
+      g_hash_table_insert (priv->list_holds, list, GUINT_TO_POINTER (n_holds - 1));
+      return;
+    }
+
+  g_hash_table_remove (priv->list_holds, list);
+
+  gtd_manager__schedule_budget (manager);
+}
@@ -39,6 +39,9 @@ ESourceRegistry*        gtd_manager_get_source_registry   (GtdManager
 
 GList*                  gtd_manager_get_task_lists        (GtdManager           *manager);
 
+GtdTaskList*            gtd_manager_find_task_list        (GtdManager           *manager,
+                                                           const gchar          *name);
+
 GList*                  gtd_manager_get_storage_locations (GtdManager           *manager);
 
 void                    gtd_manager_remove_task_list      (GtdManager           *manager,
@@ -47,6 +50,19 @@ void                    gtd_manager_remove_task_list      (GtdManager
 void                    gtd_manager_save_task_list        (GtdManager           *manager,
                                                            GtdTaskList          *list);
 
+void                    gtd_manager_refresh_task_list     (GtdManager           *manager,
+                                                           GtdTaskList          *list);
+
+void                    gtd_manager_hold_task_list        (GtdManager           *manager,
+                                                           GtdTaskList          *list);
+
+void                    gtd_manager_release_task_list     (GtdManager           *manager,
+                                                           GtdTaskList          *list);
+
+void                    gtd_manager_cancel                (GtdManager           *manager);
+
+void                    gtd_manager_trim                  (GtdManager           *manager);
+
 /* Tasks */
 void                    gtd_manager_create_task           (GtdManager           *manager,
                                                            GtdTask              *task);
@@ -54,14 +70,47 @@ void                    gtd_manager_create_task           (GtdManager
 void                    gtd_manager_remove_task           (GtdManager           *manager,
                                                            GtdTask              *task);
 
+void                    gtd_manager_remove_tasks          (GtdManager           *manager,
+                                                           GList                *tasks);
+
+void                    gtd_manager_defer_remove_task     (GtdManager           *manager,
+                                                           GtdTask              *task);
+
+gboolean                gtd_manager_undo_remove_task      (GtdManager           *manager,
+                                                           GtdTask              *task);
+
+void                    gtd_manager_commit_removals       (GtdManager           *manager,
+                                                           GList                *tasks);
+
 void                    gtd_manager_update_task           (GtdManager           *manager,
                                                            GtdTask              *task);
 
+void                    gtd_manager_update_tasks          (GtdManager           *manager,
+                                                           GList                *tasks);
+
+void                    gtd_manager_begin_updates         (GtdManager           *manager);
+
+void                    gtd_manager_commit_updates        (GtdManager           *manager);
+
+void                    gtd_manager_move_tasks            (GtdManager           *manager,
+                                                           GList                *tasks,
+                                                           GtdTaskList          *list);
+
+void                    gtd_manager_hold_completed        (GtdManager           *manager,
+                                                           GtdTaskList          *list);
+
+void                    gtd_manager_release_completed     (GtdManager           *manager,
+                                                           GtdTaskList          *list);
+
 /* Special lists */
 GtdTaskList*            gtd_manager_get_scheduled_list    (GtdManager           *manager);
 
 GtdTaskList*            gtd_manager_get_today_list        (GtdManager           *manager);
 
+GtdRuleEngine*          gtd_manager_get_rule_engine       (GtdManager           *manager);
+
+GtdSearchIndex*         gtd_manager_get_search_index      (GtdManager           *manager);
+
 /* Online accounts */
 GoaClient*              gtd_manager_get_goa_client        (GtdManager           *manager);
 
@@ -78,6 +127,8 @@ gboolean                gtd_manager_get_is_first_run      (GtdManager
 void                    gtd_manager_set_is_first_run      (GtdManager           *manager,
                                                            gboolean              is_first_run);
 
+gboolean                gtd_manager_get_run_in_background (GtdManager           *manager);
+
 G_END_DECLS
 
 #endif /* GTD_MANAGER_H */
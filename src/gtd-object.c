@@ -22,15 +22,36 @@
 
 typedef struct
 {
-  gboolean       ready;
   gchar         *uid;
+
+  /* operations in flight, and their start times in FIFO order */
+  guint          n_operations;
+  GArray        *started;
+
+  /* progress since the object was last ready */
+  guint          n_completed;
+  guint          n_total;
+
+  /* latency of every operation finished so far */
+  guint          n_finished;
+  gint64         total_latency;
+
+  guint64        generation;
 } GtdObjectPrivate;
 
 G_DEFINE_TYPE_WITH_PRIVATE (GtdObject, gtd_object, G_TYPE_OBJECT)
 
+/*
+ * Generations are taken from a single counter, so that no two
+ * objects ever share one, even if one replaces the other at the
+ * same address.
+ */
+static guint64 last_generation = 0;
+
 enum
 {
   PROP_0,
+  PROP_PROGRESS,
   PROP_READY,
   PROP_UID,
   LAST_PROP
@@ -65,6 +86,8 @@ gtd_object_real_set_uid (GtdObject   *object,
 
       priv->uid = g_strdup (uid);
 
+      gtd_object_increment_generation (object);
+
       g_object_notify (G_OBJECT (object), "uid");
     }
 }
@@ -78,6 +101,8 @@ gtd_object_finalize (GObject *object)
   if (priv->uid)
     g_free (priv->uid);
 
+  g_clear_pointer (&priv->started, g_array_unref);
+
   G_OBJECT_CLASS (gtd_object_parent_class)->finalize (object);
 }
 
@@ -92,8 +117,12 @@ gtd_object_get_property (GObject    *object,
 
   switch (prop_id)
     {
+    case PROP_PROGRESS:
+      g_value_set_double (value, priv->n_total > 0 ? (gdouble) priv->n_completed / priv->n_total : 1.0);
+      break;
+
     case PROP_READY:
-      g_value_set_boolean (value, priv->ready);
+      g_value_set_boolean (value, priv->n_operations == 0);
       break;
 
     case PROP_UID:
@@ -115,10 +144,6 @@ gtd_object_set_property (GObject      *object,
 
   switch (prop_id)
     {
-    case PROP_READY:
-      gtd_object_set_ready (self, g_value_get_boolean (value));
-      break;
-
     case PROP_UID:
       GTD_OBJECT_GET_CLASS (self)->set_uid (self, g_value_get_string (value));
       break;
@@ -157,7 +182,8 @@ gtd_object_class_init (GtdObjectClass *klass)
   /**
    * GtdObject::ready:
    *
-   * Whether the object is ready or not.
+   * Whether the object is ready or not, i.e. whether no
+   * operation is running on it.
    */
   g_object_class_install_property (
         object_class,
@@ -166,7 +192,24 @@ gtd_object_class_init (GtdObjectClass *klass)
                               _("Ready state of the object"),
                               _("Whether the object is marked as ready or not"),
                               TRUE,
-                              G_PARAM_READWRITE));
+                              G_PARAM_READABLE));
+
+  /**
+   * GtdObject::progress:
+   *
+   * The fraction of the operations started since the object was
+   * last ready that are already finished.
+   */
+  g_object_class_install_property (
+        object_class,
+        PROP_PROGRESS,
+        g_param_spec_double ("progress",
+                             _("Progress of the object"),
+                             _("The fraction of the running operations that are finished"),
+                             0.0,
+                             1.0,
+                             1.0,
+                             G_PARAM_READABLE));
 }
 
 static void
@@ -174,7 +217,7 @@ gtd_object_init (GtdObject *self)
 {
   GtdObjectPrivate *priv = gtd_object_get_instance_private (self);
 
-  priv->ready = TRUE;
+  priv->generation = ++last_generation;
 }
 
 /**
@@ -239,7 +282,8 @@ gtd_object_set_uid (GtdObject   *object,
  * gtd_object_get_ready:
  * @object: a #GtdObject
  *
- * Whether @object is ready.
+ * Whether @object is ready, i.e. whether no operation is
+ * running on it.
  *
  * Returns: %TRUE if @object is ready, %FALSE otherwise.
  */
@@ -252,30 +296,214 @@ gtd_object_get_ready (GtdObject *object)
 
   priv = gtd_object_get_instance_private (object);
 
-  return priv->ready;
+  return priv->n_operations == 0;
 }
 
 /**
- * gtd_object_set_ready:
+ * gtd_object_begin_operation:
+ * @object: a #GtdObject
  *
- * Sets the GtdObject::ready property to @ready.
+ * Marks the start of an operation on @object. @object is not
+ * ready until every started operation is finished with
+ * gtd_object_end_operation().
  *
  * Returns:
  */
 void
-gtd_object_set_ready (GtdObject *object,
-                      gboolean   ready)
+gtd_object_begin_operation (GtdObject *object)
 {
   GtdObjectPrivate *priv;
+  gint64 now;
 
-  g_assert (GTD_IS_OBJECT (object));
+  g_return_if_fail (GTD_IS_OBJECT (object));
 
   priv = gtd_object_get_instance_private (object);
+  now = g_get_monotonic_time ();
 
-  if (priv->ready != ready)
-    {
-      priv->ready = ready;
+  if (!priv->started)
+    priv->started = g_array_new (FALSE, FALSE, sizeof (gint64));
+
+  g_array_append_val (priv->started, now);
 
-      g_object_notify (G_OBJECT (object), "ready");
+  /* Progress counts from the moment the object stops being ready */
+  if (priv->n_operations == 0)
+    {
+      priv->n_completed = 0;
+      priv->n_total = 0;
     }
+
+  priv->n_operations++;
+  priv->n_total++;
+
+  g_object_freeze_notify (G_OBJECT (object));
+
+  if (priv->n_operations == 1)
+    g_object_notify (G_OBJECT (object), "ready");
+
+  g_object_notify (G_OBJECT (object), "progress");
+
+  g_object_thaw_notify (G_OBJECT (object));
+}
+
+/**
+ * gtd_object_end_operation:
+ * @object: a #GtdObject
+ *
+ * Marks the end of an operation started with gtd_object_begin_operation().
+ * When the last running operation ends, @object becomes ready again.
+ *
+ * Returns:
+ */
+void
+gtd_object_end_operation (GtdObject *object)
+{
+  GtdObjectPrivate *priv;
+
+  g_return_if_fail (GTD_IS_OBJECT (object));
+
+  priv = gtd_object_get_instance_private (object);
+
+  g_return_if_fail (priv->n_operations > 0);
+
+  /*
+   * Operations may finish out of order, but matching them to the
+   * oldest start time still sums up to the exact total latency.
+   */
+  priv->total_latency += g_get_monotonic_time () - g_array_index (priv->started, gint64, 0);
+  priv->n_finished++;
+
+  g_array_remove_index (priv->started, 0);
+
+  priv->n_operations--;
+  priv->n_completed++;
+
+  /* Most objects are idle most of the time */
+  if (priv->n_operations == 0)
+    g_clear_pointer (&priv->started, g_array_unref);
+
+  g_object_freeze_notify (G_OBJECT (object));
+
+  g_object_notify (G_OBJECT (object), "progress");
+
+  if (priv->n_operations == 0)
+    g_object_notify (G_OBJECT (object), "ready");
+
+  g_object_thaw_notify (G_OBJECT (object));
+}
+
+/**
+ * gtd_object_get_progress:
+ * @object: a #GtdObject
+ * @n_completed: (out) (nullable): return location for the number of
+ * finished operations
+ * @n_total: (out) (nullable): return location for the number of
+ * started operations
+ *
+ * Retrieves how many of the operations started since @object was
+ * last ready are finished. Both are 0 if nothing ran yet.
+ *
+ * Returns:
+ */
+void
+gtd_object_get_progress (GtdObject *object,
+                         guint     *n_completed,
+                         guint     *n_total)
+{
+  GtdObjectPrivate *priv;
+
+  g_return_if_fail (GTD_IS_OBJECT (object));
+
+  priv = gtd_object_get_instance_private (object);
+
+  if (n_completed)
+    *n_completed = priv->n_completed;
+
+  if (n_total)
+    *n_total = priv->n_total;
+}
+
+/**
+ * gtd_object_get_average_latency:
+ * @object: a #GtdObject
+ *
+ * Retrieves the average time the finished operations of
+ * @object took, in microseconds.
+ *
+ * Returns: the average latency of @object, or 0 if no
+ * operation finished yet.
+ */
+gint64
+gtd_object_get_average_latency (GtdObject *object)
+{
+  GtdObjectPrivate *priv;
+
+  g_return_val_if_fail (GTD_IS_OBJECT (object), 0);
+
+  priv = gtd_object_get_instance_private (object);
+
+  return priv->n_finished > 0 ? priv->total_latency / priv->n_finished : 0;
+}
+
+/**
+ * gtd_object_get_n_finished_operations:
+ * @object: a #GtdObject
+ *
+ * Retrieves how many operations on @object finished since
+ * it was created.
+ *
+ * Returns: the number of finished operations of @object
+ */
+guint
+gtd_object_get_n_finished_operations (GtdObject *object)
+{
+  GtdObjectPrivate *priv;
+
+  g_return_val_if_fail (GTD_IS_OBJECT (object), 0);
+
+  priv = gtd_object_get_instance_private (object);
+
+  return priv->n_finished;
+}
+
+/**
+ * gtd_object_get_generation:
+ * @object: a #GtdObject
+ *
+ * Retrieves the modification generation of @object. It grows every
+ * time @object changes, so anything computed from @object is still
+ * valid as long as the generation is the same.
+ *
+ * Returns: the current generation of @object
+ */
+guint64
+gtd_object_get_generation (GtdObject *object)
+{
+  GtdObjectPrivate *priv;
+
+  g_return_val_if_fail (GTD_IS_OBJECT (object), 0);
+
+  priv = gtd_object_get_instance_private (object);
+
+  return priv->generation;
+}
+
+/**
+ * gtd_object_increment_generation:
+ * @object: a #GtdObject
+ *
+ * Marks @object as modified, moving it to a new generation
+ * that is greater than any generation given out so far.
+ *
+ * Returns:
+ */
+void
+gtd_object_increment_generation (GtdObject *object)
+{
+  GtdObjectPrivate *priv;
+
+  g_return_if_fail (GTD_IS_OBJECT (object));
+
+  priv = gtd_object_get_instance_private (object);
+
+  priv->generation = ++last_generation;
 }
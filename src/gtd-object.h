@@ -48,8 +48,21 @@ void                    gtd_object_set_uid                (GtdObject          *o
 
 gboolean                gtd_object_get_ready              (GtdObject          *object);
 
-void                    gtd_object_set_ready              (GtdObject          *object,
-                                                           gboolean            ready);
+void                    gtd_object_begin_operation        (GtdObject          *object);
+
+void                    gtd_object_end_operation          (GtdObject          *object);
+
+void                    gtd_object_get_progress           (GtdObject          *object,
+                                                           guint              *n_completed,
+                                                           guint              *n_total);
+
+gint64                  gtd_object_get_average_latency    (GtdObject          *object);
+
+guint                   gtd_object_get_n_finished_operations (GtdObject       *object);
+
+guint64                 gtd_object_get_generation         (GtdObject          *object);
+
+void                    gtd_object_increment_generation   (GtdObject          *object);
 
 G_END_DECLS
 
@@ -0,0 +1,637 @@
+/* gtd-rule-engine.c
+ *
+ * Copyright (C) 2015 Georges Basile Stavracas Neto <georges.stavracas@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gtd-date.h"
+#include "gtd-rule-engine.h"
+#include "gtd-task.h"
+#include "gtd-task-list.h"
+
+#include <glib/gi18n.h>
+
+typedef struct
+{
+  GtdTaskList          *list;
+  GtdRuleCondition     *conditions;
+  guint                 n_conditions;
+
+  /* Union of the fields the conditions look at */
+  GtdTaskField          fields;
+
+  /* Set of the tasks currently matching the rule */
+  GHashTable           *members;
+} GtdRule;
+
+/* A tracked task, referenced until it stops being tracked */
+typedef struct
+{
+  GtdTask              *task;
+  gulong                changed_id;
+
+  /* Fields changed since the last evaluation */
+  GtdTaskField          dirty;
+} TaskEntry;
+
+typedef struct
+{
+  GList                *rules;
+  GHashTable           *tasks;
+
+  /* Julian day of today, used by due date conditions */
+  guint32               today;
+  guint                 day_change_timeout_id;
+} GtdRuleEnginePrivate;
+
+struct _GtdRuleEngine
+{
+  GObject               parent;
+
+  /*<private>*/
+  GtdRuleEnginePrivate *priv;
+};
+
+G_DEFINE_TYPE_WITH_PRIVATE (GtdRuleEngine, gtd_rule_engine, G_TYPE_OBJECT)
+
+static void          gtd_rule_engine__schedule_day_change        (GtdRuleEngine      *engine);
+
+static gboolean
+compare_numbers (GtdRuleOperator op,
+                 gint64          a,
+                 gint64          b)
+{
+  switch (op)
+    {
+    /* Unset values are handled by the callers */
+    case GTD_RULE_OP_IS_SET:
+      return TRUE;
+
+    case GTD_RULE_OP_IS_UNSET:
+      return FALSE;
+
+    case GTD_RULE_OP_EQUAL:
+      return a == b;
+
+    case GTD_RULE_OP_NOT_EQUAL:
+      return a != b;
+
+    case GTD_RULE_OP_LESS:
+      return a < b;
+
+    case GTD_RULE_OP_LESS_EQUAL:
+      return a <= b;
+
+    case GTD_RULE_OP_GREATER:
+      return a > b;
+
+    case GTD_RULE_OP_GREATER_EQUAL:
+      return a >= b;
+
+    default:
+      return FALSE;
+    }
+}
+
+static gboolean
+compare_strings (GtdRuleOperator  op,
+                 const gchar     *str,
+                 const gchar     *value)
+{
+  gboolean retval;
+  gchar *str_folded;
+  gchar *value_folded;
+
+  switch (op)
+    {
+    case GTD_RULE_OP_IS_SET:
+      return str && *str != '\0';
+
+    case GTD_RULE_OP_IS_UNSET:
+      return !str || *str == '\0';
+
+    case GTD_RULE_OP_EQUAL:
+      return g_strcmp0 (str, value) == 0;
+
+    case GTD_RULE_OP_NOT_EQUAL:
+      return g_strcmp0 (str, value) != 0;
+
+    case GTD_RULE_OP_CONTAINS:
+      if (!str || !value)
+        return FALSE;
+
+      str_folded = g_utf8_casefold (str, -1);
+      value_folded = g_utf8_casefold (value, -1);
+
+      retval = g_strstr_len (str_folded, -1, value_folded) != NULL;
+
+      g_free (str_folded);
+      g_free (value_folded);
+
+      return retval;
+
+    default:
+      return FALSE;
+    }
+}
+
+static gboolean
+gtd_rule_engine__condition_matches (GtdRuleEngine          *engine,
+                                    const GtdRuleCondition *condition,
+                                    GtdTask                *task)
+{
+  switch (condition->field)
+    {
+    case GTD_TASK_FIELD_COMPLETE:
+      /* Completed tasks are set, incomplete ones are unset */
+      if (condition->op == GTD_RULE_OP_IS_SET)
+        return gtd_task_get_complete (task);
+      else if (condition->op == GTD_RULE_OP_IS_UNSET)
+        return !gtd_task_get_complete (task);
+
+      return compare_numbers (condition->op, gtd_task_get_complete (task), condition->value);
+
+    case GTD_TASK_FIELD_DESCRIPTION:
+      return compare_strings (condition->op, gtd_task_get_description (task), condition->string);
+
+    case GTD_TASK_FIELD_DUE_DATE:
+      {
+        guint32 day;
+        gint64 offset;
+
+        day = gtd_task_get_due_day (task);
+
+        if (day == 0)
+          return condition->op == GTD_RULE_OP_IS_UNSET;
+
+        offset = (gint64) day - (gint64) engine->priv->today;
+
+        return compare_numbers (condition->op, offset, condition->value);
+      }
+
+    case GTD_TASK_FIELD_LIST:
+      {
+        GtdTaskList *list;
+        ESource *source;
+
+        list = gtd_task_get_list (task);
+        source = list ? gtd_task_list_get_source (list) : NULL;
+
+        if (!source)
+          return condition->op == GTD_RULE_OP_IS_UNSET;
+
+        /*
+         * A list condition matches either the list itself or the parent
+         * source of the list, so that rules can target a whole account.
+         */
+        if (condition->op == GTD_RULE_OP_EQUAL)
+          {
+            return g_strcmp0 (e_source_get_uid (source), condition->string) == 0 ||
+                   g_strcmp0 (e_source_get_parent (source), condition->string) == 0;
+          }
+        else if (condition->op == GTD_RULE_OP_NOT_EQUAL)
+          {
+            return g_strcmp0 (e_source_get_uid (source), condition->string) != 0 &&
+                   g_strcmp0 (e_source_get_parent (source), condition->string) != 0;
+          }
+
+        return compare_strings (condition->op, e_source_get_uid (source), condition->string);
+      }
+
+    case GTD_TASK_FIELD_PRIORITY:
+      {
+        gint priority;
+
+        priority = gtd_task_get_priority (task);
+
+        if (priority <= 0)
+          return condition->op == GTD_RULE_OP_IS_UNSET;
+
+        return compare_numbers (condition->op, priority, condition->value);
+      }
+
+    case GTD_TASK_FIELD_TITLE:
+      return compare_strings (condition->op, gtd_task_get_title (task), condition->string);
+
+    default:
+      g_warn_if_reached ();
+      return FALSE;
+    }
+}
+
+static gboolean
+gtd_rule_engine__rule_matches (GtdRuleEngine *engine,
+                               GtdRule       *rule,
+                               GtdTask       *task)
+{
+  guint i;
+
+  for (i = 0; i < rule->n_conditions; i++)
+    {
+      if (!gtd_rule_engine__condition_matches (engine, &rule->conditions[i], task))
+        return FALSE;
+    }
+
+  return TRUE;
+}
+
+static void
+gtd_rule_engine__evaluate (GtdRuleEngine *engine,
+                           GtdRule       *rule,
+                           GtdTask       *task)
+{
+  gboolean is_member;
+  gboolean matches;
+
+  is_member = g_hash_table_contains (rule->members, task);
+  matches = gtd_rule_engine__rule_matches (engine, rule, task);
+
+  if (matches)
+    {
+      if (!is_member)
+        g_hash_table_add (rule->members, task);
+
+      gtd_task_list_save_task (rule->list, task);
+    }
+  else if (is_member)
+    {
+      g_hash_table_remove (rule->members, task);
+      gtd_task_list_remove_task (rule->list, task);
+    }
+}
+
+static void
+gtd_rule_engine__evaluate_fields (GtdRuleEngine *engine,
+                                  GtdTask       *task,
+                                  GtdTaskField   fields)
+{
+  GList *l;
+
+  for (l = engine->priv->rules; l != NULL; l = l->next)
+    {
+      GtdRule *rule = l->data;
+
+      if (rule->fields & fields)
+        gtd_rule_engine__evaluate (engine, rule, task);
+    }
+}
+
+static void
+gtd_rule_engine__task_changed (GtdTask   *task,
+                               guint      fields,
+                               TaskEntry *entry)
+{
+  entry->dirty |= fields;
+}
+
+static void
+task_entry_free (TaskEntry *entry)
+{
+  g_signal_handler_disconnect (entry->task, entry->changed_id);
+  g_object_unref (entry->task);
+  g_free (entry);
+}
+
+static void
+gtd_rule_free (GtdRule *rule)
+{
+  guint i;
+
+  for (i = 0; i < rule->n_conditions; i++)
+    g_free ((gchar*) rule->conditions[i].string);
+
+  g_hash_table_destroy (rule->members);
+  g_clear_object (&rule->list);
+  g_free (rule->conditions);
+  g_free (rule);
+}
+
+static void
+gtd_rule_engine__update_today (GtdRuleEngine *engine)
+{
+  engine->priv->today = gtd_date_get_today ();
+}
+
+static gboolean
+gtd_rule_engine__day_changed_cb (GtdRuleEngine *engine)
+{
+  engine->priv->day_change_timeout_id = 0;
+
+  gtd_rule_engine__update_today (engine);
+  gtd_rule_engine_invalidate (engine, GTD_TASK_FIELD_DUE_DATE);
+
+  gtd_rule_engine__schedule_day_change (engine);
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+gtd_rule_engine__schedule_day_change (GtdRuleEngine *engine)
+{
+  GDateTime *now;
+  GDateTime *midnight;
+  GDateTime *tomorrow;
+  GTimeSpan span;
+
+  now = g_date_time_new_now_local ();
+  midnight = g_date_time_new_local (g_date_time_get_year (now),
+                                    g_date_time_get_month (now),
+                                    g_date_time_get_day_of_month (now),
+                                    0,
+                                    0,
+                                    0);
+  tomorrow = g_date_time_add_days (midnight, 1);
+  span = g_date_time_difference (tomorrow, now);
+
+  /* Wake up one second after midnight, so we don't see the old day */
+  engine->priv->day_change_timeout_id = g_timeout_add_seconds (span / G_TIME_SPAN_SECOND + 1,
+                                                               (GSourceFunc) gtd_rule_engine__day_changed_cb,
+                                                               engine);
+
+  g_date_time_unref (tomorrow);
+  g_date_time_unref (midnight);
+  g_date_time_unref (now);
+}
+
+static void
+gtd_rule_engine_finalize (GObject *object)
+{
+  GtdRuleEngine *self = (GtdRuleEngine *)object;
+  GtdRuleEnginePrivate *priv = gtd_rule_engine_get_instance_private (self);
+
+  if (priv->day_change_timeout_id > 0)
+    g_source_remove (priv->day_change_timeout_id);
+
+  g_list_free_full (priv->rules, (GDestroyNotify) gtd_rule_free);
+  g_hash_table_destroy (priv->tasks);
+
+  G_OBJECT_CLASS (gtd_rule_engine_parent_class)->finalize (object);
+}
+
+static void
+gtd_rule_engine_class_init (GtdRuleEngineClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->finalize = gtd_rule_engine_finalize;
+}
+
+static void
+gtd_rule_engine_init (GtdRuleEngine *self)
+{
+  self->priv = gtd_rule_engine_get_instance_private (self);
+  self->priv->tasks = g_hash_table_new_full (g_direct_hash,
+                                             g_direct_equal,
+                                             NULL,
+                                             (GDestroyNotify) task_entry_free);
+
+  gtd_rule_engine__update_today (self);
+  gtd_rule_engine__schedule_day_change (self);
+}
+
+/**
+ * gtd_rule_engine_new:
+ *
+ * Creates a new #GtdRuleEngine.
+ *
+ * Returns: (transfer full): a new #GtdRuleEngine
+ */
+GtdRuleEngine*
+gtd_rule_engine_new (void)
+{
+  return g_object_new (GTD_TYPE_RULE_ENGINE, NULL);
+}
+
+/**
+ * gtd_rule_engine_add_rule:
+ * @engine: a #GtdRuleEngine
+ * @conditions: (array length=n_conditions): the conditions of the rule
+ * @n_conditions: the number of conditions
+ *
+ * Adds a new rule to @engine. The returned virtual #GtdTaskList holds
+ * every task that matches all of @conditions, and is kept up to date
+ * while tasks are added, updated and removed.
+ *
+ * Returns: (transfer none): the virtual #GtdTaskList of the rule.
+ */
+GtdTaskList*
+gtd_rule_engine_add_rule (GtdRuleEngine          *engine,
+                          const GtdRuleCondition *conditions,
+                          guint                   n_conditions)
+{
+  GHashTableIter iter;
+  TaskEntry *entry;
+  GtdRule *rule;
+  guint i;
+
+  g_return_val_if_fail (GTD_IS_RULE_ENGINE (engine), NULL);
+  g_return_val_if_fail (conditions != NULL || n_conditions == 0, NULL);
+
+  rule = g_new0 (GtdRule, 1);
+  rule->list = g_object_new (GTD_TYPE_TASK_LIST, NULL);
+  rule->members = g_hash_table_new (g_direct_hash, g_direct_equal);
+  rule->n_conditions = n_conditions;
+  rule->conditions = g_new0 (GtdRuleCondition, n_conditions);
+
+  for (i = 0; i < n_conditions; i++)
+    {
+      rule->conditions[i] = conditions[i];
+      rule->conditions[i].string = g_strdup (conditions[i].string);
+
+      rule->fields |= conditions[i].field;
+    }
+
+  engine->priv->rules = g_list_append (engine->priv->rules, rule);
+
+  /* Populate the rule with the tasks already known */
+  g_hash_table_iter_init (&iter, engine->priv->tasks);
+
+  while (g_hash_table_iter_next (&iter, NULL, (gpointer*) &entry))
+    gtd_rule_engine__evaluate (engine, rule, entry->task);
+
+  return rule->list;
+}
+
+/**
+ * gtd_rule_engine_remove_rule:
+ * @engine: a #GtdRuleEngine
+ * @list: the virtual #GtdTaskList returned by gtd_rule_engine_add_rule()
+ *
+ * Removes the rule that populates @list.
+ *
+ * Returns:
+ */
+void
+gtd_rule_engine_remove_rule (GtdRuleEngine *engine,
+                             GtdTaskList   *list)
+{
+  GList *l;
+
+  g_return_if_fail (GTD_IS_RULE_ENGINE (engine));
+  g_return_if_fail (GTD_IS_TASK_LIST (list));
+
+  for (l = engine->priv->rules; l != NULL; l = l->next)
+    {
+      GtdRule *rule = l->data;
+
+      if (rule->list == list)
+        {
+          engine->priv->rules = g_list_delete_link (engine->priv->rules, l);
+          gtd_rule_free (rule);
+          break;
+        }
+    }
+}
+
+/**
+ * gtd_rule_engine_add_task:
+ * @engine: a #GtdRuleEngine
+ * @task: a #GtdTask
+ *
+ * Starts tracking @task, and adds it to the virtual lists whose
+ * rules it matches.
+ *
+ * Returns:
+ */
+void
+gtd_rule_engine_add_task (GtdRuleEngine *engine,
+                          GtdTask       *task)
+{
+  TaskEntry *entry;
+
+  g_return_if_fail (GTD_IS_RULE_ENGINE (engine));
+  g_return_if_fail (GTD_IS_TASK (task));
+
+  if (g_hash_table_contains (engine->priv->tasks, task))
+    {
+      gtd_rule_engine_update_task (engine, task);
+      return;
+    }
+
+  entry = g_new0 (TaskEntry, 1);
+  entry->task = g_object_ref (task);
+  entry->changed_id = g_signal_connect (task,
+                                        "changed",
+                                        G_CALLBACK (gtd_rule_engine__task_changed),
+                                        entry);
+
+  g_hash_table_insert (engine->priv->tasks, task, entry);
+
+  gtd_rule_engine__evaluate_fields (engine, task, GTD_TASK_FIELD_ALL);
+}
+
+/**
+ * gtd_rule_engine_update_task:
+ * @engine: a #GtdRuleEngine
+ * @task: a #GtdTask
+ *
+ * Re-evaluates @task against the rules that look at the fields
+ * changed since the last evaluation. Rules whose fields didn't
+ * change are skipped.
+ *
+ * Returns:
+ */
+void
+gtd_rule_engine_update_task (GtdRuleEngine *engine,
+                             GtdTask       *task)
+{
+  GtdTaskField dirty;
+  TaskEntry *entry;
+  GList *l;
+
+  g_return_if_fail (GTD_IS_RULE_ENGINE (engine));
+  g_return_if_fail (GTD_IS_TASK (task));
+
+  entry = g_hash_table_lookup (engine->priv->tasks, task);
+
+  if (!entry)
+    {
+      gtd_rule_engine_add_task (engine, task);
+      return;
+    }
+
+  dirty = entry->dirty;
+  entry->dirty = GTD_TASK_FIELD_NONE;
+
+  for (l = engine->priv->rules; l != NULL; l = l->next)
+    {
+      GtdRule *rule = l->data;
+
+      /*
+       * Rules that don't look at the changed fields are not evaluated
+       * again, but the virtual lists holding the task are still told
+       * that it was updated.
+       */
+      if (rule->fields & dirty)
+        gtd_rule_engine__evaluate (engine, rule, task);
+      else if (g_hash_table_contains (rule->members, task))
+        gtd_task_list_save_task (rule->list, task);
+    }
+}
+
+/**
+ * gtd_rule_engine_remove_task:
+ * @engine: a #GtdRuleEngine
+ * @task: a #GtdTask
+ *
+ * Stops tracking @task, and removes it from every virtual list.
+ *
+ * Returns:
+ */
+void
+gtd_rule_engine_remove_task (GtdRuleEngine *engine,
+                             GtdTask       *task)
+{
+  GList *l;
+
+  g_return_if_fail (GTD_IS_RULE_ENGINE (engine));
+  g_return_if_fail (GTD_IS_TASK (task));
+
+  for (l = engine->priv->rules; l != NULL; l = l->next)
+    {
+      GtdRule *rule = l->data;
+
+      if (g_hash_table_remove (rule->members, task))
+        gtd_task_list_remove_task (rule->list, task);
+    }
+
+  g_hash_table_remove (engine->priv->tasks, task);
+}
+
+/**
+ * gtd_rule_engine_invalidate:
+ * @engine: a #GtdRuleEngine
+ * @fields: the fields whose meaning changed
+ *
+ * Re-evaluates every task against the rules that look at @fields. This
+ * is used when the reference values change, e.g. when the day changes
+ * and due date conditions must be checked again.
+ *
+ * Returns:
+ */
+void
+gtd_rule_engine_invalidate (GtdRuleEngine *engine,
+                            GtdTaskField   fields)
+{
+  GHashTableIter iter;
+  TaskEntry *entry;
+
+  g_return_if_fail (GTD_IS_RULE_ENGINE (engine));
+
+  g_hash_table_iter_init (&iter, engine->priv->tasks);
+
+  while (g_hash_table_iter_next (&iter, NULL, (gpointer*) &entry))
+    gtd_rule_engine__evaluate_fields (engine, entry->task, fields);
+}
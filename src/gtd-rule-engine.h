@@ -0,0 +1,75 @@
+/* gtd-rule-engine.h
+ *
+ * Copyright (C) 2015 Georges Basile Stavracas Neto <georges.stavracas@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef GTD_RULE_ENGINE_H
+#define GTD_RULE_ENGINE_H
+
+#include "gtd-types.h"
+
+#include <glib-object.h>
+
+G_BEGIN_DECLS
+
+#define GTD_TYPE_RULE_ENGINE (gtd_rule_engine_get_type())
+
+G_DECLARE_FINAL_TYPE (GtdRuleEngine, gtd_rule_engine, GTD, RULE_ENGINE, GObject)
+
+/**
+ * GtdRuleCondition:
+ * @field: the task field the condition looks at
+ * @op: how @field is compared against the value
+ * @value: the numeric value; for #GTD_TASK_FIELD_DUE_DATE, it is a number
+ * of days relative to today
+ * @string: the string value, used by #GTD_TASK_FIELD_TITLE and
+ * #GTD_TASK_FIELD_LIST
+ *
+ * A single predicate over a task field. A rule matches a task when all
+ * of its conditions match.
+ */
+typedef struct
+{
+  GtdTaskField        field;
+  GtdRuleOperator     op;
+  gint64              value;
+  const gchar        *string;
+} GtdRuleCondition;
+
+GtdRuleEngine*          gtd_rule_engine_new                     (void);
+
+GtdTaskList*            gtd_rule_engine_add_rule                (GtdRuleEngine          *engine,
+                                                                 const GtdRuleCondition *conditions,
+                                                                 guint                   n_conditions);
+
+void                    gtd_rule_engine_remove_rule             (GtdRuleEngine          *engine,
+                                                                 GtdTaskList            *list);
+
+void                    gtd_rule_engine_add_task                (GtdRuleEngine          *engine,
+                                                                 GtdTask                *task);
+
+void                    gtd_rule_engine_update_task             (GtdRuleEngine          *engine,
+                                                                 GtdTask                *task);
+
+void                    gtd_rule_engine_remove_task             (GtdRuleEngine          *engine,
+                                                                 GtdTask                *task);
+
+void                    gtd_rule_engine_invalidate              (GtdRuleEngine          *engine,
+                                                                 GtdTaskField            fields);
+
+G_END_DECLS
+
+#endif /* GTD_RULE_ENGINE_H */
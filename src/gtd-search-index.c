@@ -0,0 +1,736 @@
+/* gtd-search-index.c
+ *
+ * Copyright (C) 2015 Georges Basile Stavracas Neto <georges.stavracas@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gtd-search-index.h"
+#include "gtd-task.h"
+#include "gtd-task-list.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Task titles are split into case-folded words, and every word is kept
+ * in an array sorted alphabetically. The tasks with a word starting with
+ * a given prefix are then a contiguous range of the array, found with a
+ * binary search.
+ *
+ * Keeping the array sorted on every change would be too expensive while
+ * lists load, so new words go to a small unsorted array first, and
+ * removed tasks are only flagged. Both are merged into the sorted array
+ * when idle, or when a search finds them grown too large.
+ */
+
+#define MERGE_THRESHOLD                  1024
+
+typedef struct
+{
+  gchar                *uid;
+  GtdTask              *task;
+  gchar               **words;
+  gboolean              removed;
+
+  /* Generation of the task when it was indexed */
+  guint64               generation;
+} IndexEntry;
+
+typedef struct
+{
+  const gchar          *word;
+  IndexEntry           *entry;
+} WordRef;
+
+typedef struct
+{
+  /* Live entries, by task and by UID */
+  GHashTable           *tasks;
+  GHashTable           *uids;
+
+  GArray               *sorted;
+  GArray               *pending;
+
+  /* Removed entries still referenced by the sorted array */
+  GPtrArray            *dead;
+  guint                 n_dead_words;
+
+  guint                 merge_idle_id;
+} GtdSearchIndexPrivate;
+
+struct _GtdSearchIndex
+{
+  GObject                parent;
+
+  /*<private>*/
+  GtdSearchIndexPrivate *priv;
+};
+
+G_DEFINE_TYPE_WITH_PRIVATE (GtdSearchIndex, gtd_search_index, G_TYPE_OBJECT)
+
+static void
+index_entry_free (IndexEntry *entry)
+{
+  g_free (entry->uid);
+  g_strfreev (entry->words);
+  g_free (entry);
+}
+
+static gint
+word_ref_compare (gconstpointer a,
+                  gconstpointer b)
+{
+  return strcmp (((const WordRef*) a)->word, ((const WordRef*) b)->word);
+}
+
+static gchar**
+gtd_search_index__tokenize (const gchar *text)
+{
+  gchar **ascii_alternates;
+  gchar **tokens;
+  guint n_tokens;
+  guint n_alternates;
+
+  if (!text)
+    return g_new0 (gchar*, 1);
+
+  ascii_alternates = NULL;
+  tokens = g_str_tokenize_and_fold (text, NULL, &ascii_alternates);
+
+  /* Accented words are also indexed by their ASCII spelling */
+  n_tokens = g_strv_length (tokens);
+  n_alternates = ascii_alternates ? g_strv_length (ascii_alternates) : 0;
+
+  if (n_alternates > 0)
+    {
+      tokens = g_renew (gchar*, tokens, n_tokens + n_alternates + 1);
+      memcpy (tokens + n_tokens, ascii_alternates, n_alternates * sizeof (gchar*));
+      tokens[n_tokens + n_alternates] = NULL;
+
+      /* The strings now belong to tokens */
+      g_free (ascii_alternates);
+    }
+  else
+    {
+      g_strfreev (ascii_alternates);
+    }
+
+  return tokens;
+}
+
+static gboolean
+gtd_search_index__words_equal (gchar **a,
+                               gchar **b)
+{
+  guint i;
+
+  for (i = 0; a[i] != NULL && b[i] != NULL; i++)
+    {
+      if (strcmp (a[i], b[i]) != 0)
+        return FALSE;
+    }
+
+  return a[i] == NULL && b[i] == NULL;
+}
+
+static gboolean
+gtd_search_index__merge (GtdSearchIndex *self)
+{
+  GtdSearchIndexPrivate *priv = self->priv;
+  GArray *merged;
+  guint i;
+  guint j;
+
+  priv->merge_idle_id = 0;
+
+  g_array_sort (priv->pending, word_ref_compare);
+
+  merged = g_array_sized_new (FALSE, FALSE, sizeof (WordRef), priv->sorted->len + priv->pending->len);
+
+  /* Both arrays are sorted, merge them while dropping removed tasks */
+  for (i = 0, j = 0; i < priv->sorted->len || j < priv->pending->len;)
+    {
+      WordRef *ref;
+
+      if (j >= priv->pending->len ||
+          (i < priv->sorted->len &&
+           word_ref_compare (&g_array_index (priv->sorted, WordRef, i),
+                             &g_array_index (priv->pending, WordRef, j)) <= 0))
+        {
+          ref = &g_array_index (priv->sorted, WordRef, i++);
+        }
+      else
+        {
+          ref = &g_array_index (priv->pending, WordRef, j++);
+        }
+
+      if (!ref->entry->removed)
+        g_array_append_val (merged, *ref);
+    }
+
+  g_array_unref (priv->sorted);
+  priv->sorted = merged;
+
+  g_array_set_size (priv->pending, 0);
+
+  g_ptr_array_set_size (priv->dead, 0);
+  priv->n_dead_words = 0;
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+gtd_search_index__schedule_merge (GtdSearchIndex *self)
+{
+  GtdSearchIndexPrivate *priv = self->priv;
+
+  if (priv->merge_idle_id > 0)
+    return;
+
+  if (priv->pending->len < MERGE_THRESHOLD && priv->n_dead_words < MERGE_THRESHOLD)
+    return;
+
+  priv->merge_idle_id = g_idle_add_full (G_PRIORITY_LOW,
+                                         (GSourceFunc) gtd_search_index__merge,
+                                         self,
+                                         NULL);
+}
+
+static void
+gtd_search_index__ensure_merged (GtdSearchIndex *self)
+{
+  GtdSearchIndexPrivate *priv = self->priv;
+
+  /* Small pending arrays are cheaper to scan than to merge */
+  if (priv->pending->len < MERGE_THRESHOLD && priv->n_dead_words < MERGE_THRESHOLD)
+    return;
+
+  if (priv->merge_idle_id > 0)
+    {
+      g_source_remove (priv->merge_idle_id);
+      priv->merge_idle_id = 0;
+    }
+
+  gtd_search_index__merge (self);
+}
+
+static void
+gtd_search_index__task_added (GtdTaskList    *list,
+                              GtdTask        *task,
+                              GtdSearchIndex *self)
+{
+  gtd_search_index_add_task (self, task);
+}
+
+static void
+gtd_search_index__task_updated (GtdTaskList    *list,
+                                GtdTask        *task,
+                                GtdSearchIndex *self)
+{
+  gtd_search_index_update_task (self, task);
+}
+
+static void
+gtd_search_index__task_removed (GtdTaskList    *list,
+                                GtdTask        *task,
+                                GtdSearchIndex *self)
+{
+  gtd_search_index_remove_task (self, task);
+}
+
+static gboolean
+gtd_search_index__entry_has_prefix (IndexEntry  *entry,
+                                    const gchar *prefix)
+{
+  guint i;
+
+  for (i = 0; entry->words[i] != NULL; i++)
+    {
+      if (g_str_has_prefix (entry->words[i], prefix))
+        return TRUE;
+    }
+
+  return FALSE;
+}
+
+static gboolean
+gtd_search_index__entry_matches (IndexEntry  *entry,
+                                 gchar      **terms)
+{
+  guint i;
+
+  for (i = 0; terms[i] != NULL; i++)
+    {
+      if (!gtd_search_index__entry_has_prefix (entry, terms[i]))
+        return FALSE;
+    }
+
+  return TRUE;
+}
+
+static gchar**
+gtd_search_index__fold_terms (const gchar * const *terms)
+{
+  GPtrArray *folded;
+  guint i;
+
+  folded = g_ptr_array_new ();
+
+  for (i = 0; terms && terms[i] != NULL; i++)
+    {
+      gchar **tokens;
+      guint j;
+
+      tokens = g_str_tokenize_and_fold (terms[i], NULL, NULL);
+
+      for (j = 0; tokens[j] != NULL; j++)
+        g_ptr_array_add (folded, tokens[j]);
+
+      g_free (tokens);
+    }
+
+  g_ptr_array_add (folded, NULL);
+
+  return (gchar**) g_ptr_array_free (folded, FALSE);
+}
+
+static void
+gtd_search_index_finalize (GObject *object)
+{
+  GtdSearchIndex *self = (GtdSearchIndex *)object;
+  GtdSearchIndexPrivate *priv = gtd_search_index_get_instance_private (self);
+
+  if (priv->merge_idle_id > 0)
+    g_source_remove (priv->merge_idle_id);
+
+  g_array_unref (priv->sorted);
+  g_array_unref (priv->pending);
+  g_ptr_array_unref (priv->dead);
+  g_hash_table_destroy (priv->uids);
+  g_hash_table_destroy (priv->tasks);
+
+  G_OBJECT_CLASS (gtd_search_index_parent_class)->finalize (object);
+}
+
+static void
+gtd_search_index_class_init (GtdSearchIndexClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->finalize = gtd_search_index_finalize;
+}
+
+static void
+gtd_search_index_init (GtdSearchIndex *self)
+{
+  self->priv = gtd_search_index_get_instance_private (self);
+
+  self->priv->tasks = g_hash_table_new_full (g_direct_hash,
+                                             g_direct_equal,
+                                             NULL,
+                                             (GDestroyNotify) index_entry_free);
+  self->priv->uids = g_hash_table_new (g_str_hash, g_str_equal);
+  self->priv->sorted = g_array_new (FALSE, FALSE, sizeof (WordRef));
+  self->priv->pending = g_array_new (FALSE, FALSE, sizeof (WordRef));
+  self->priv->dead = g_ptr_array_new_with_free_func ((GDestroyNotify) index_entry_free);
+}
+
+/**
+ * gtd_search_index_new:
+ *
+ * Creates a new #GtdSearchIndex.
+ *
+ * Returns: (transfer full): a new #GtdSearchIndex
+ */
+GtdSearchIndex*
+gtd_search_index_new (void)
+{
+  return g_object_new (GTD_TYPE_SEARCH_INDEX, NULL);
+}
+
+/**
+ * gtd_search_index_add_list:
+ * @index: a #GtdSearchIndex
+ * @list: a #GtdTaskList
+ *
+ * Indexes the tasks of @list, and keeps following the tasks that
+ * are added to or removed from it.
+ *
+ * Returns:
+ */
+void
+gtd_search_index_add_list (GtdSearchIndex *index,
+                           GtdTaskList    *list)
+{
+  GList *tasks;
+  GList *l;
+
+  g_return_if_fail (GTD_IS_SEARCH_INDEX (index));
+  g_return_if_fail (GTD_IS_TASK_LIST (list));
+
+  tasks = gtd_task_list_get_tasks (list);
+
+  for (l = tasks; l != NULL; l = l->next)
+    gtd_search_index_add_task (index, l->data);
+
+  g_list_free (tasks);
+
+  g_signal_connect (list,
+                    "task-added",
+                    G_CALLBACK (gtd_search_index__task_added),
+                    index);
+
+  g_signal_connect (list,
+                    "task-updated",
+                    G_CALLBACK (gtd_search_index__task_updated),
+                    index);
+
+  g_signal_connect (list,
+                    "task-removed",
+                    G_CALLBACK (gtd_search_index__task_removed),
+                    index);
+}
+
+/**
+ * gtd_search_index_remove_list:
+ * @index: a #GtdSearchIndex
+ * @list: a #GtdTaskList
+ *
+ * Removes the tasks of @list from @index, and stops following it.
+ *
+ * Returns:
+ */
+void
+gtd_search_index_remove_list (GtdSearchIndex *index,
+                              GtdTaskList    *list)
+{
+  GList *tasks;
+  GList *l;
+
+  g_return_if_fail (GTD_IS_SEARCH_INDEX (index));
+  g_return_if_fail (GTD_IS_TASK_LIST (list));
+
+  g_signal_handlers_disconnect_by_data (list, index);
+
+  tasks = gtd_task_list_get_tasks (list);
+
+  for (l = tasks; l != NULL; l = l->next)
+    gtd_search_index_remove_task (index, l->data);
+
+  g_list_free (tasks);
+}
+
+/**
+ * gtd_search_index_add_task:
+ * @index: a #GtdSearchIndex
+ * @task: a #GtdTask
+ *
+ * Indexes the title of @task. If @task is already indexed, this
+ * is the same as gtd_search_index_update_task().
+ *
+ * Returns:
+ */
+void
+gtd_search_index_add_task (GtdSearchIndex *index,
+                           GtdTask        *task)
+{
+  GtdSearchIndexPrivate *priv;
+  IndexEntry *entry;
+  guint i;
+
+  g_return_if_fail (GTD_IS_SEARCH_INDEX (index));
+  g_return_if_fail (GTD_IS_TASK (task));
+
+  priv = index->priv;
+
+  if (g_hash_table_contains (priv->tasks, task))
+    {
+      gtd_search_index_update_task (index, task);
+      return;
+    }
+
+  entry = g_new0 (IndexEntry, 1);
+  entry->uid = g_strdup (gtd_object_get_uid (GTD_OBJECT (task)));
+  entry->task = task;
+  entry->words = gtd_search_index__tokenize (gtd_task_get_title (task));
+  entry->generation = gtd_object_get_generation (GTD_OBJECT (task));
+
+  g_hash_table_insert (priv->tasks, task, entry);
+
+  if (entry->uid)
+    g_hash_table_insert (priv->uids, entry->uid, entry);
+
+  for (i = 0; entry->words[i] != NULL; i++)
+    {
+      WordRef ref = { entry->words[i], entry };
+
+      g_array_append_val (priv->pending, ref);
+    }
+
+  gtd_search_index__schedule_merge (index);
+}
+
+/**
+ * gtd_search_index_update_task:
+ * @index: a #GtdSearchIndex
+ * @task: a #GtdTask
+ *
+ * Updates the indexed title and UID of @task.
+ *
+ * Returns:
+ */
+void
+gtd_search_index_update_task (GtdSearchIndex *index,
+                              GtdTask        *task)
+{
+  IndexEntry *entry;
+  gchar **words;
+  gboolean changed;
+
+  g_return_if_fail (GTD_IS_SEARCH_INDEX (index));
+  g_return_if_fail (GTD_IS_TASK (task));
+
+  entry = g_hash_table_lookup (index->priv->tasks, task);
+
+  if (!entry)
+    {
+      gtd_search_index_add_task (index, task);
+      return;
+    }
+
+  if (entry->generation == gtd_object_get_generation (GTD_OBJECT (task)))
+    return;
+
+  entry->generation = gtd_object_get_generation (GTD_OBJECT (task));
+
+  /* Most updates don't touch the title or UID */
+  words = gtd_search_index__tokenize (gtd_task_get_title (task));
+  changed = !gtd_search_index__words_equal (words, entry->words) ||
+            g_strcmp0 (entry->uid, gtd_object_get_uid (GTD_OBJECT (task))) != 0;
+
+  g_strfreev (words);
+
+  if (!changed)
+    return;
+
+  gtd_search_index_remove_task (index, task);
+  gtd_search_index_add_task (index, task);
+}
+
+/**
+ * gtd_search_index_remove_task:
+ * @index: a #GtdSearchIndex
+ * @task: a #GtdTask
+ *
+ * Removes @task from @index.
+ *
+ * Returns:
+ */
+void
+gtd_search_index_remove_task (GtdSearchIndex *index,
+                              GtdTask        *task)
+{
+  GtdSearchIndexPrivate *priv;
+  IndexEntry *entry;
+
+  g_return_if_fail (GTD_IS_SEARCH_INDEX (index));
+  g_return_if_fail (GTD_IS_TASK (task));
+
+  priv = index->priv;
+  entry = g_hash_table_lookup (priv->tasks, task);
+
+  if (!entry)
+    return;
+
+  if (entry->uid && g_hash_table_lookup (priv->uids, entry->uid) == entry)
+    g_hash_table_remove (priv->uids, entry->uid);
+
+  /* The word arrays still point to the entry, free it when merging */
+  g_hash_table_steal (priv->tasks, task);
+
+  entry->removed = TRUE;
+  entry->task = NULL;
+
+  g_ptr_array_add (priv->dead, entry);
+  priv->n_dead_words += g_strv_length (entry->words);
+
+  gtd_search_index__schedule_merge (index);
+}
+
+/**
+ * gtd_search_index_lookup:
+ * @index: a #GtdSearchIndex
+ * @uid: the UID of a task
+ *
+ * Retrieves the indexed task whose UID is @uid.
+ *
+ * Returns: (transfer none) (nullable): a #GtdTask, or %NULL
+ */
+GtdTask*
+gtd_search_index_lookup (GtdSearchIndex *index,
+                         const gchar    *uid)
+{
+  IndexEntry *entry;
+
+  g_return_val_if_fail (GTD_IS_SEARCH_INDEX (index), NULL);
+  g_return_val_if_fail (uid, NULL);
+
+  entry = g_hash_table_lookup (index->priv->uids, uid);
+
+  return entry ? entry->task : NULL;
+}
+
+/**
+ * gtd_search_index_search:
+ * @index: a #GtdSearchIndex
+ * @terms: a %NULL-terminated array of search terms
+ *
+ * Finds the tasks that, for every term in @terms, have a word in
+ * their title starting with that term.
+ *
+ * Returns: (transfer container) (element-type GtdTask): the matching tasks
+ */
+GPtrArray*
+gtd_search_index_search (GtdSearchIndex      *index,
+                         const gchar * const *terms)
+{
+  GtdSearchIndexPrivate *priv;
+  GHashTable *seen;
+  GPtrArray *results;
+  const gchar *key;
+  gchar **folded;
+  gsize key_len;
+  guint lo;
+  guint hi;
+  guint i;
+
+  g_return_val_if_fail (GTD_IS_SEARCH_INDEX (index), NULL);
+
+  priv = index->priv;
+  results = g_ptr_array_new ();
+  folded = gtd_search_index__fold_terms (terms);
+
+  if (!folded[0])
+    {
+      g_strfreev (folded);
+      return results;
+    }
+
+  gtd_search_index__ensure_merged (index);
+
+  /* The longest term is the most selective one, walk its range */
+  key = folded[0];
+
+  for (i = 1; folded[i] != NULL; i++)
+    {
+      if (strlen (folded[i]) > strlen (key))
+        key = folded[i];
+    }
+
+  key_len = strlen (key);
+  seen = g_hash_table_new (g_direct_hash, g_direct_equal);
+
+  lo = 0;
+  hi = priv->sorted->len;
+
+  while (lo < hi)
+    {
+      guint mid = lo + (hi - lo) / 2;
+
+      if (strcmp (g_array_index (priv->sorted, WordRef, mid).word, key) < 0)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+
+  for (i = lo; i < priv->sorted->len; i++)
+    {
+      WordRef *ref = &g_array_index (priv->sorted, WordRef, i);
+
+      if (strncmp (ref->word, key, key_len) != 0)
+        break;
+
+      if (ref->entry->removed || g_hash_table_contains (seen, ref->entry))
+        continue;
+
+      g_hash_table_add (seen, ref->entry);
+
+      if (gtd_search_index__entry_matches (ref->entry, folded))
+        g_ptr_array_add (results, ref->entry->task);
+    }
+
+  /* Words added since the last merge */
+  for (i = 0; i < priv->pending->len; i++)
+    {
+      WordRef *ref = &g_array_index (priv->pending, WordRef, i);
+
+      if (ref->entry->removed ||
+          !g_str_has_prefix (ref->word, key) ||
+          g_hash_table_contains (seen, ref->entry))
+        {
+          continue;
+        }
+
+      g_hash_table_add (seen, ref->entry);
+
+      if (gtd_search_index__entry_matches (ref->entry, folded))
+        g_ptr_array_add (results, ref->entry->task);
+    }
+
+  g_hash_table_destroy (seen);
+  g_strfreev (folded);
+
+  return results;
+}
+
+/**
+ * gtd_search_index_subsearch:
+ * @index: a #GtdSearchIndex
+ * @previous_uids: the UIDs of the previous results
+ * @terms: a %NULL-terminated array of search terms
+ *
+ * Narrows down the results of a previous search to the tasks that
+ * match @terms, without walking the index again.
+ *
+ * Returns: (transfer container) (element-type GtdTask): the matching tasks
+ */
+GPtrArray*
+gtd_search_index_subsearch (GtdSearchIndex      *index,
+                            const gchar * const *previous_uids,
+                            const gchar * const *terms)
+{
+  GPtrArray *results;
+  gchar **folded;
+  guint i;
+
+  g_return_val_if_fail (GTD_IS_SEARCH_INDEX (index), NULL);
+
+  results = g_ptr_array_new ();
+  folded = gtd_search_index__fold_terms (terms);
+
+  for (i = 0; previous_uids && previous_uids[i] != NULL; i++)
+    {
+      IndexEntry *entry;
+
+      entry = g_hash_table_lookup (index->priv->uids, previous_uids[i]);
+
+      if (entry && gtd_search_index__entry_matches (entry, folded))
+        g_ptr_array_add (results, entry->task);
+    }
+
+  g_strfreev (folded);
+
+  return results;
+}
@@ -0,0 +1,61 @@
+/* gtd-search-index.h
+ *
+ * Copyright (C) 2015 Georges Basile Stavracas Neto <georges.stavracas@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef GTD_SEARCH_INDEX_H
+#define GTD_SEARCH_INDEX_H
+
+#include "gtd-types.h"
+
+#include <glib-object.h>
+
+G_BEGIN_DECLS
+
+#define GTD_TYPE_SEARCH_INDEX (gtd_search_index_get_type())
+
+G_DECLARE_FINAL_TYPE (GtdSearchIndex, gtd_search_index, GTD, SEARCH_INDEX, GObject)
+
+GtdSearchIndex*         gtd_search_index_new                    (void);
+
+void                    gtd_search_index_add_list               (GtdSearchIndex         *index,
+                                                                 GtdTaskList            *list);
+
+void                    gtd_search_index_remove_list            (GtdSearchIndex         *index,
+                                                                 GtdTaskList            *list);
+
+void                    gtd_search_index_add_task               (GtdSearchIndex         *index,
+                                                                 GtdTask                *task);
+
+void                    gtd_search_index_update_task            (GtdSearchIndex         *index,
+                                                                 GtdTask                *task);
+
+void                    gtd_search_index_remove_task            (GtdSearchIndex         *index,
+                                                                 GtdTask                *task);
+
+GtdTask*                gtd_search_index_lookup                 (GtdSearchIndex         *index,
+                                                                 const gchar            *uid);
+
+GPtrArray*              gtd_search_index_search                 (GtdSearchIndex         *index,
+                                                                 const gchar * const    *terms);
+
+GPtrArray*              gtd_search_index_subsearch              (GtdSearchIndex         *index,
+                                                                 const gchar * const    *previous_uids,
+                                                                 const gchar * const    *terms);
+
+G_END_DECLS
+
+#endif /* GTD_SEARCH_INDEX_H */
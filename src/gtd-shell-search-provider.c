@@ -0,0 +1,385 @@
+/* gtd-shell-search-provider.c
+ *
+ * Copyright (C) 2015 Georges Basile Stavracas Neto <georges.stavracas@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gtd-application.h"
+#include "gtd-manager.h"
+#include "gtd-search-index.h"
+#include "gtd-shell-search-provider.h"
+#include "gtd-task.h"
+#include "gtd-task-list.h"
+#include "gtd-window.h"
+
+/*
+ * GNOME Shell asks for results on every keystroke, so searches are
+ * answered from the #GtdSearchIndex of the manager rather than by
+ * walking every task. Result IDs are task UIDs, which lets narrowed
+ * searches check only the previous results.
+ */
+
+/* Shell only shows a handful of results per provider */
+#define MAX_RESULTS                      50
+
+static const gchar introspection_xml[] =
+  "<node>"
+  "  <interface name='org.gnome.Shell.SearchProvider2'>"
+  "    <method name='GetInitialResultSet'>"
+  "      <arg type='as' name='terms' direction='in'/>"
+  "      <arg type='as' name='results' direction='out'/>"
+  "    </method>"
+  "    <method name='GetSubsearchResultSet'>"
+  "      <arg type='as' name='previous_results' direction='in'/>"
+  "      <arg type='as' name='terms' direction='in'/>"
+  "      <arg type='as' name='results' direction='out'/>"
+  "    </method>"
+  "    <method name='GetResultMetas'>"
+  "      <arg type='as' name='identifiers' direction='in'/>"
+  "      <arg type='aa{sv}' name='metas' direction='out'/>"
+  "    </method>"
+  "    <method name='ActivateResult'>"
+  "      <arg type='s' name='identifier' direction='in'/>"
+  "      <arg type='as' name='terms' direction='in'/>"
+  "      <arg type='u' name='timestamp' direction='in'/>"
+  "    </method>"
+  "    <method name='LaunchSearch'>"
+  "      <arg type='as' name='terms' direction='in'/>"
+  "      <arg type='u' name='timestamp' direction='in'/>"
+  "    </method>"
+  "  </interface>"
+  "</node>";
+
+typedef struct
+{
+  GtdApplication       *application;
+
+  GDBusConnection      *connection;
+  guint                 registration_id;
+} GtdShellSearchProviderPrivate;
+
+struct _GtdShellSearchProvider
+{
+  GObject                        parent;
+
+  /*<private>*/
+  GtdShellSearchProviderPrivate *priv;
+};
+
+G_DEFINE_TYPE_WITH_PRIVATE (GtdShellSearchProvider, gtd_shell_search_provider, G_TYPE_OBJECT)
+
+static GDBusNodeInfo *introspection_data = NULL;
+
+static GVariant*
+gtd_shell_search_provider__build_results (GPtrArray *tasks)
+{
+  GVariantBuilder builder;
+  guint i;
+
+  g_variant_builder_init (&builder, G_VARIANT_TYPE ("as"));
+
+  for (i = 0; i < tasks->len && i < MAX_RESULTS; i++)
+    {
+      const gchar *uid;
+
+      uid = gtd_object_get_uid (GTD_OBJECT (g_ptr_array_index (tasks, i)));
+
+      if (uid)
+        g_variant_builder_add (&builder, "s", uid);
+    }
+
+  return g_variant_new ("(as)", &builder);
+}
+
+static void
+gtd_shell_search_provider__get_initial_result_set (GtdSearchIndex        *index,
+                                                   GVariant              *parameters,
+                                                   GDBusMethodInvocation *invocation)
+{
+  GPtrArray *tasks;
+  const gchar **terms;
+
+  g_variant_get (parameters, "(^a&s)", &terms);
+
+  tasks = gtd_search_index_search (index, terms);
+
+  g_dbus_method_invocation_return_value (invocation, gtd_shell_search_provider__build_results (tasks));
+
+  g_ptr_array_unref (tasks);
+  g_free (terms);
+}
+
+static void
+gtd_shell_search_provider__get_subsearch_result_set (GtdSearchIndex        *index,
+                                                     GVariant              *parameters,
+                                                     GDBusMethodInvocation *invocation)
+{
+  GPtrArray *tasks;
+  const gchar **previous_results;
+  const gchar **terms;
+
+  g_variant_get (parameters, "(^a&s^a&s)", &previous_results, &terms);
+
+  tasks = gtd_search_index_subsearch (index, previous_results, terms);
+
+  g_dbus_method_invocation_return_value (invocation, gtd_shell_search_provider__build_results (tasks));
+
+  g_ptr_array_unref (tasks);
+  g_free (previous_results);
+  g_free (terms);
+}
+
+static void
+gtd_shell_search_provider__get_result_metas (GtdSearchIndex        *index,
+                                             GVariant              *parameters,
+                                             GDBusMethodInvocation *invocation)
+{
+  GVariantBuilder builder;
+  GVariant *icon;
+  GIcon *themed_icon;
+  const gchar **uids;
+  guint i;
+
+  g_variant_get (parameters, "(^a&s)", &uids);
+
+  themed_icon = g_themed_icon_new ("gnome-todo");
+  icon = g_icon_serialize (themed_icon);
+
+  g_variant_builder_init (&builder, G_VARIANT_TYPE ("aa{sv}"));
+
+  for (i = 0; uids[i] != NULL; i++)
+    {
+      GtdTaskList *list;
+      GtdTask *task;
+
+      task = gtd_search_index_lookup (index, uids[i]);
+
+      if (!task)
+        continue;
+
+      list = gtd_task_get_list (task);
+
+      g_variant_builder_open (&builder, G_VARIANT_TYPE ("a{sv}"));
+      g_variant_builder_add (&builder, "{sv}", "id", g_variant_new_string (uids[i]));
+      g_variant_builder_add (&builder, "{sv}", "name", g_variant_new_string (gtd_task_get_title (task) ? gtd_task_get_title (task) : ""));
+      g_variant_builder_add (&builder, "{sv}", "icon", icon);
+
+      if (list)
+        g_variant_builder_add (&builder, "{sv}", "description", g_variant_new_string (gtd_task_list_get_name (list)));
+
+      g_variant_builder_close (&builder);
+    }
+
+  g_dbus_method_invocation_return_value (invocation, g_variant_new ("(aa{sv})", &builder));
+
+  g_variant_unref (icon);
+  g_object_unref (themed_icon);
+  g_free (uids);
+}
+
+static void
+gtd_shell_search_provider__activate_result (GtdShellSearchProvider *provider,
+                                            GtdSearchIndex         *index,
+                                            GVariant               *parameters,
+                                            GDBusMethodInvocation  *invocation)
+{
+  GtkWindow *window;
+  GtdTask *task;
+  const gchar *uid;
+
+  g_variant_get (parameters, "(&s^a&su)", &uid, NULL, NULL);
+
+  task = gtd_search_index_lookup (index, uid);
+
+  g_application_activate (G_APPLICATION (provider->priv->application));
+
+  window = gtk_application_get_active_window (GTK_APPLICATION (provider->priv->application));
+
+  /* On the first run, the initial setup window is shown instead */
+  if (task && gtd_task_get_list (task) && GTD_IS_WINDOW (window))
+    gtd_window_show_list (GTD_WINDOW (window), gtd_task_get_list (task));
+
+  g_dbus_method_invocation_return_value (invocation, NULL);
+}
+
+static void
+gtd_shell_search_provider__method_call (GDBusConnection       *connection,
+                                        const gchar           *sender,
+                                        const gchar           *object_path,
+                                        const gchar           *interface_name,
+                                        const gchar           *method_name,
+                                        GVariant              *parameters,
+                                        GDBusMethodInvocation *invocation,
+                                        gpointer               user_data)
+{
+  GtdShellSearchProvider *provider;
+  GtdSearchIndex *index;
+  GApplication *application;
+
+  provider = GTD_SHELL_SEARCH_PROVIDER (user_data);
+  application = G_APPLICATION (provider->priv->application);
+  index = gtd_manager_get_search_index (gtd_application_get_manager (provider->priv->application));
+
+  /* Don't let a background instance quit while serving the shell */
+  g_application_hold (application);
+
+  if (g_strcmp0 (method_name, "GetInitialResultSet") == 0)
+    {
+      gtd_shell_search_provider__get_initial_result_set (index, parameters, invocation);
+    }
+  else if (g_strcmp0 (method_name, "GetSubsearchResultSet") == 0)
+    {
+      gtd_shell_search_provider__get_subsearch_result_set (index, parameters, invocation);
+    }
+  else if (g_strcmp0 (method_name, "GetResultMetas") == 0)
+    {
+      gtd_shell_search_provider__get_result_metas (index, parameters, invocation);
+    }
+  else if (g_strcmp0 (method_name, "ActivateResult") == 0)
+    {
+      gtd_shell_search_provider__activate_result (provider, index, parameters, invocation);
+    }
+  else if (g_strcmp0 (method_name, "LaunchSearch") == 0)
+    {
+      g_application_activate (application);
+      g_dbus_method_invocation_return_value (invocation, NULL);
+    }
+  else
+    {
+      g_assert_not_reached ();
+    }
+
+  g_application_release (application);
+}
+
+static const GDBusInterfaceVTable interface_vtable = {
+  gtd_shell_search_provider__method_call,
+  NULL,
+  NULL
+};
+
+static void
+gtd_shell_search_provider_finalize (GObject *object)
+{
+  GtdShellSearchProvider *self = (GtdShellSearchProvider *)object;
+
+  gtd_shell_search_provider_unregister (self);
+
+  G_OBJECT_CLASS (gtd_shell_search_provider_parent_class)->finalize (object);
+}
+
+static void
+gtd_shell_search_provider_class_init (GtdShellSearchProviderClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->finalize = gtd_shell_search_provider_finalize;
+
+  introspection_data = g_dbus_node_info_new_for_xml (introspection_xml, NULL);
+  g_assert (introspection_data != NULL);
+}
+
+static void
+gtd_shell_search_provider_init (GtdShellSearchProvider *self)
+{
+  self->priv = gtd_shell_search_provider_get_instance_private (self);
+}
+
+/**
+ * gtd_shell_search_provider_new:
+ * @application: the #GtdApplication whose tasks are searched
+ *
+ * Creates a new #GtdShellSearchProvider.
+ *
+ * Returns: (transfer full): a new #GtdShellSearchProvider
+ */
+GtdShellSearchProvider*
+gtd_shell_search_provider_new (GtdApplication *application)
+{
+  GtdShellSearchProvider *self;
+
+  g_return_val_if_fail (GTD_IS_APPLICATION (application), NULL);
+
+  self = g_object_new (GTD_TYPE_SHELL_SEARCH_PROVIDER, NULL);
+  self->priv->application = application;
+
+  return self;
+}
+
+/**
+ * gtd_shell_search_provider_register:
+ * @provider: a #GtdShellSearchProvider
+ * @connection: the #GDBusConnection to export the interface on
+ * @object_path: the object path to export the interface at
+ * @error: (nullable): return location for a #GError, or %NULL
+ *
+ * Exports the org.gnome.Shell.SearchProvider2 interface of @provider.
+ *
+ * Returns: %TRUE if the interface was exported, %FALSE otherwise
+ */
+gboolean
+gtd_shell_search_provider_register (GtdShellSearchProvider  *provider,
+                                    GDBusConnection         *connection,
+                                    const gchar             *object_path,
+                                    GError                 **error)
+{
+  GtdShellSearchProviderPrivate *priv;
+
+  g_return_val_if_fail (GTD_IS_SHELL_SEARCH_PROVIDER (provider), FALSE);
+  g_return_val_if_fail (G_IS_DBUS_CONNECTION (connection), FALSE);
+  g_return_val_if_fail (provider->priv->registration_id == 0, FALSE);
+
+  priv = provider->priv;
+  priv->registration_id = g_dbus_connection_register_object (connection,
+                                                             object_path,
+                                                             introspection_data->interfaces[0],
+                                                             &interface_vtable,
+                                                             provider,
+                                                             NULL,
+                                                             error);
+
+  if (priv->registration_id == 0)
+    return FALSE;
+
+  priv->connection = g_object_ref (connection);
+
+  return TRUE;
+}
+
+/**
+ * gtd_shell_search_provider_unregister:
+ * @provider: a #GtdShellSearchProvider
+ *
+ * Stops exporting the interface of @provider.
+ *
+ * Returns:
+ */
+void
+gtd_shell_search_provider_unregister (GtdShellSearchProvider *provider)
+{
+  GtdShellSearchProviderPrivate *priv;
+
+  g_return_if_fail (GTD_IS_SHELL_SEARCH_PROVIDER (provider));
+
+  priv = provider->priv;
+
+  if (priv->registration_id > 0)
+    {
+      g_dbus_connection_unregister_object (priv->connection, priv->registration_id);
+      priv->registration_id = 0;
+    }
+
+  g_clear_object (&priv->connection);
+}
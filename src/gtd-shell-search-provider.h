@@ -0,0 +1,43 @@
+/* gtd-shell-search-provider.h
+ *
+ * Copyright (C) 2015 Georges Basile Stavracas Neto <georges.stavracas@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef GTD_SHELL_SEARCH_PROVIDER_H
+#define GTD_SHELL_SEARCH_PROVIDER_H
+
+#include "gtd-types.h"
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+#define GTD_TYPE_SHELL_SEARCH_PROVIDER (gtd_shell_search_provider_get_type())
+
+G_DECLARE_FINAL_TYPE (GtdShellSearchProvider, gtd_shell_search_provider, GTD, SHELL_SEARCH_PROVIDER, GObject)
+
+GtdShellSearchProvider* gtd_shell_search_provider_new           (GtdApplication         *application);
+
+gboolean                gtd_shell_search_provider_register      (GtdShellSearchProvider *provider,
+                                                                 GDBusConnection        *connection,
+                                                                 const gchar            *object_path,
+                                                                 GError                **error);
+
+void                    gtd_shell_search_provider_unregister    (GtdShellSearchProvider *provider);
+
+G_END_DECLS
+
+#endif /* GTD_SHELL_SEARCH_PROVIDER_H */
@@ -34,6 +34,10 @@ typedef struct
   GtdTaskList               *list;
   GtdWindowMode              mode;
 
+  /* What the current thumbnail was rendered from */
+  guint64                    thumbnail_generation;
+  GtkStateFlags              thumbnail_state;
+
 } GtdTaskListItemPrivate;
 
 struct _GtdTaskListItem
@@ -57,6 +61,48 @@ enum {
   LAST_PROP
 };
 
+static GPtrArray*
+gtd_task_list_item__get_titles (GtdTaskList *list)
+{
+  GPtrArray *titles;
+
+  titles = g_ptr_array_new ();
+
+  /* Evicted lists only remember the titles of their first tasks */
+  if (gtd_task_list_get_evicted (list))
+    {
+      const gchar * const *preview;
+      guint i;
+
+      preview = gtd_task_list_get_preview (list);
+
+      for (i = 0; preview[i] != NULL; i++)
+        g_ptr_array_add (titles, (gpointer) preview[i]);
+    }
+  else
+    {
+      GList *tasks;
+      GList *l;
+
+      /*
+       * Sort the list, so that the first tasks are similar to what
+       * the user will see when selecting the list.
+       */
+      tasks = g_list_sort (gtd_task_list_get_tasks (list), (GCompareFunc) gtd_task_compare);
+
+      /* Don't render completed tasks */
+      for (l = tasks; l != NULL; l = l->next)
+        {
+          if (!gtd_task_get_complete (l->data))
+            g_ptr_array_add (titles, (gpointer) gtd_task_get_title (l->data));
+        }
+
+      g_list_free (tasks);
+    }
+
+  return titles;
+}
+
 static GdkPixbuf*
 gtd_task_list_item__render_thumbnail (GtdTaskListItem *item)
 {
@@ -73,7 +119,7 @@ gtd_task_list_item__render_thumbnail (GtdTaskListItem *item)
   GdkRGBA *color;
   cairo_t *cr;
   GError *error = NULL;
-  GList *tasks;
+  GPtrArray *titles;
 
   /* TODO: review size here, maybe not hardcoded */
   list = item->priv->list;
@@ -135,8 +181,7 @@ gtd_task_list_item__render_thumbnail (GtdTaskListItem *item)
                                  &padding);
 
   layout = pango_cairo_create_layout (cr);
-  tasks = gtd_task_list_get_tasks (list);
-
+  titles = gtd_task_list_item__get_titles (list);
 
   /*
    * If the list color is way too dark, we draw the task names in a light
@@ -145,44 +190,27 @@ gtd_task_list_item__render_thumbnail (GtdTaskListItem *item)
   if (LUMINANCE (color) < 0.5)
     gtk_style_context_add_class (context, "dark");
 
-  /*
-   * Sort the list, so that the first tasks are similar to what
-   * the user will see when selecting the list.
-   */
-  tasks = g_list_sort (tasks, (GCompareFunc) gtd_task_compare);
-
   pango_layout_set_font_description (layout, font_desc);
   pango_layout_set_ellipsize (layout, PANGO_ELLIPSIZE_END);
   pango_layout_set_width (layout, (126 - margin.left - margin.right) * PANGO_SCALE);
 
-  /*
-   * If the list exists and it's first element is a completed task,
-   * we know for sure (since the list is already sorted) that there's
-   * no undone tasks here.
-   */
-  if (!tasks ||
-      (g_list_length (tasks) == 0) ||
-      (tasks && !gtd_task_get_complete (tasks->data)))
+  if (titles->len > 0)
     {
       /* Draw the task name for each selected row. */
       gdouble x, y;
-      GList *l;
+      guint i;
 
       x = 33.0 + margin.left;
       y = 9.0 + margin.top;
 
-      for (l = tasks; l != NULL; l = l->next)
+      for (i = 0; i < titles->len; i++)
         {
           gint font_height;
 
-          /* Don't render completed tasks */
-          if (gtd_task_get_complete (l->data))
-            continue;
-
           y += padding.top;
 
           pango_layout_set_text (layout,
-                                 gtd_task_get_title (l->data),
+                                 g_ptr_array_index (titles, i),
                                  -1);
 
           pango_layout_get_pixel_size (layout,
@@ -215,8 +243,6 @@ gtd_task_list_item__render_thumbnail (GtdTaskListItem *item)
 
           y += font_height + padding.bottom;
         }
-
-      g_list_free (tasks);
     }
   else
     {
@@ -245,6 +271,7 @@ gtd_task_list_item__render_thumbnail (GtdTaskListItem *item)
     }
 
   pango_font_description_free (font_desc);
+  g_ptr_array_unref (titles);
   g_object_unref (layout);
 
   /* Retrieves the pixbuf from the drawed image */
@@ -267,9 +294,21 @@ static void
 gtd_task_list_item__update_thumbnail (GtdTaskListItem *item)
 {
   GtdTaskListItemPrivate *priv;
+  GtkStateFlags state;
   GdkPixbuf *pix;
+  guint64 generation;
 
   priv = item->priv;
+  generation = gtd_object_get_generation (GTD_OBJECT (priv->list));
+  state = gtk_widget_get_state_flags (GTK_WIDGET (item));
+
+  /* Nothing drawn changed since the last time */
+  if (priv->thumbnail_generation == generation && priv->thumbnail_state == state)
+    return;
+
+  priv->thumbnail_generation = generation;
+  priv->thumbnail_state = state;
+
   pix = gtd_task_list_item__render_thumbnail (item);
 
   gtk_image_set_from_pixbuf (GTK_IMAGE (priv->icon_image), pix);
@@ -284,6 +323,13 @@ gtd_task_list_item__task_changed (GtdTaskList *list,
 {
   g_return_if_fail (GTD_IS_TASK_LIST_ITEM (user_data));
 
+  /*
+   * Lists being loaded are redrawn once they're ready, and evicted
+   * lists keep showing the tasks they had before.
+   */
+  if (!gtd_object_get_ready (GTD_OBJECT (list)) || gtd_task_list_get_evicted (list))
+    return;
+
   if (!gtd_task_get_complete (task))
     gtd_task_list_item__update_thumbnail (GTD_TASK_LIST_ITEM (user_data));
 }
@@ -17,6 +17,7 @@
  */
 
 #include "gtd-arrow-frame.h"
+#include "gtd-date.h"
 #include "gtd-edit-pane.h"
 #include "gtd-task-list-view.h"
 #include "gtd-manager.h"
@@ -42,6 +43,9 @@ typedef struct
   GtkLabel              *done_label;
   GtkScrolledWindow     *viewport;
   GtkStack              *stack;
+  GtkRevealer           *selection_revealer;
+  GtkLabel              *selection_label;
+  GtkMenuButton         *move_button;
 
   /* internal */
   gboolean               can_toggle;
@@ -53,6 +57,17 @@ typedef struct
   GtdTaskList           *task_list;
   GtdManager            *manager;
 
+  /* the list held loaded while shown, and maybe its completed tasks */
+  gboolean               holds_completed;
+  GtdTaskList           *held_list;
+
+  /* selected tasks, and the one ranges are selected from */
+  GHashTable            *selection;
+  GtdTask               *selection_anchor;
+
+  /* bulk operations refresh the view once, when they end */
+  guint                  bulk_depth;
+
   /* color provider */
   GtkCssProvider        *color_provider;
 } GtdTaskListViewPrivate;
@@ -69,6 +84,24 @@ struct _GtdTaskListView
 #define LUMINANCE(c)   (0.299 * c->red + 0.587 * c->green + 0.114 * c->blue)
 
 #define TASK_REMOVED_NOTIFICATION_ID             "task-removed-id"
+#define BULK_UNDO_DATA                           "bulk-undo"
+
+/* The state of a task before a bulk operation, for undoing it */
+typedef struct
+{
+  GtdTask            *task;
+  GtdTaskList        *list;
+  GDateTime          *due_date;
+  gboolean            due_is_date;
+  gint                priority;
+  gboolean            complete;
+} TaskSnapshot;
+
+typedef struct
+{
+  GtdTaskListView    *view;
+  GPtrArray          *snapshots;
+} BulkUndo;
 
 /* prototypes */
 static void             gtd_task_list_view__task_completed            (GObject          *object,
@@ -77,12 +110,6 @@ static void             gtd_task_list_view__task_completed            (GObject
 
 G_DEFINE_TYPE_WITH_PRIVATE (GtdTaskListView, gtd_task_list_view, GTK_TYPE_OVERLAY)
 
-typedef struct
-{
-  GtdTaskListView *view;
-  GtdTask         *task;
-} RemoveTaskData;
-
 enum {
   PROP_0,
   PROP_MANAGER,
@@ -96,23 +123,98 @@ static void
 remove_task_action (GtdNotification *notification,
                     gpointer         user_data)
 {
-  RemoveTaskData *data = user_data;
+  GtdTaskListView *view = user_data;
+  GPtrArray *tasks;
+  GList *list;
+  guint i;
+
+  tasks = gtd_notification_get_items (notification);
+  list = NULL;
+
+  for (i = tasks->len; i > 0; i--)
+    list = g_list_prepend (list, g_ptr_array_index (tasks, i - 1));
 
-  gtd_manager_remove_task (data->view->priv->manager, data->task);
+  /* Merged removals are sent together */
+  gtd_manager_commit_removals (view->priv->manager, list);
 
-  g_free (data);
+  g_list_free (list);
 }
 
 static void
 undo_remove_task_action (GtdNotification *notification,
                          gpointer         user_data)
 {
-  RemoveTaskData  *data = user_data;
-  GtdTaskList *list = gtd_task_get_list (data->task);
+  GtdTaskListView *view = user_data;
+  GPtrArray *tasks;
+  guint i;
 
-  gtd_task_list_save_task (list, data->task);
+  tasks = gtd_notification_get_items (notification);
 
-  g_free (data);
+  for (i = 0; i < tasks->len; i++)
+    gtd_manager_undo_remove_task (view->priv->manager, g_ptr_array_index (tasks, i));
+}
+
+static void
+remove_task_merged (GtdNotification *notification,
+                    gpointer         user_data)
+{
+  guint n_tasks;
+  gchar *text;
+
+  n_tasks = gtd_notification_get_items (notification)->len;
+  text = g_strdup_printf (ngettext ("%d task removed",
+                                    "%d tasks removed",
+                                    n_tasks),
+                          n_tasks);
+
+  gtd_notification_set_text (notification, text);
+
+  g_free (text);
+}
+
+static void
+task_snapshot_free (TaskSnapshot *snapshot)
+{
+  g_clear_pointer (&snapshot->due_date, g_date_time_unref);
+  g_object_unref (snapshot->list);
+  g_object_unref (snapshot->task);
+  g_free (snapshot);
+}
+
+static BulkUndo*
+bulk_undo_new (GtdTaskListView *view,
+               GList           *tasks)
+{
+  BulkUndo *undo;
+  GList *l;
+
+  undo = g_new0 (BulkUndo, 1);
+  undo->view = view;
+  undo->snapshots = g_ptr_array_new_with_free_func ((GDestroyNotify) task_snapshot_free);
+
+  for (l = tasks; l != NULL; l = l->next)
+    {
+      TaskSnapshot *snapshot;
+
+      snapshot = g_new0 (TaskSnapshot, 1);
+      snapshot->task = g_object_ref (l->data);
+      snapshot->list = g_object_ref (gtd_task_get_list (l->data));
+      snapshot->due_date = gtd_task_get_due_date (l->data);
+      snapshot->due_is_date = gtd_task_get_due_is_date (l->data);
+      snapshot->priority = gtd_task_get_priority (l->data);
+      snapshot->complete = gtd_task_get_complete (l->data);
+
+      g_ptr_array_add (undo->snapshots, snapshot);
+    }
+
+  return undo;
+}
+
+static void
+bulk_undo_free (BulkUndo *undo)
+{
+  g_ptr_array_unref (undo->snapshots);
+  g_free (undo);
 }
 
 static void
@@ -150,6 +252,10 @@ gtd_task_list_view__update_empty_state (GtdTaskListView *view)
 
   priv = view->priv;
 
+  /* Bulk operations check it once they end */
+  if (priv->bulk_depth > 0)
+    return;
+
   /*
    * Here it explicitly check if it's readonly because we don't
    * want to show the empty state for lists that can be edited. If
@@ -184,49 +290,85 @@ gtd_task_list_view__update_empty_state (GtdTaskListView *view)
     }
 }
 
+/*
+ * Shows a single notification for the deferred removal of @tasks,
+ * which sends them together, or brings them back on Undo.
+ */
 static void
-gtd_task_list_view__remove_task_cb (GtdEditPane *pane,
-                                    GtdTask     *task,
-                                    gpointer     user_data)
+gtd_task_list_view__notify_removal (GtdTaskListView *view,
+                                    GList           *tasks)
 {
-  GtdTaskListViewPrivate *priv;
   GtdNotification *notification;
-  RemoveTaskData *data;
   GtdWindow *window;
+  guint n_tasks;
   gchar *text;
+  GList *l;
 
-  g_return_if_fail (GTD_IS_TASK_LIST_VIEW (user_data));
+  n_tasks = g_list_length (tasks);
+  window = GTD_WINDOW (gtk_widget_get_toplevel (GTK_WIDGET (view)));
 
-  priv = GTD_TASK_LIST_VIEW (user_data)->priv;
-  text = g_strdup_printf (_("Task <b>%s</b> removed"), gtd_task_get_title (task));
-  window = GTD_WINDOW (gtk_widget_get_toplevel (GTK_WIDGET (user_data)));
-
-  data = g_new0 (RemoveTaskData, 1);
-  data->view = user_data;
-  data->task = task;
+  if (n_tasks == 1)
+    {
+      text = g_strdup_printf (_("Task <b>%s</b> removed"), gtd_task_get_title (tasks->data));
+    }
+  else
+    {
+      text = g_strdup_printf (ngettext ("%d task removed",
+                                        "%d tasks removed",
+                                        n_tasks),
+                              n_tasks);
+    }
 
-  /* Remove the task from the list */
-  gtd_task_list_remove_task (gtd_task_get_list (task), task);
+  notification = gtd_notification_new (text, 7500.0);
 
-  gtk_revealer_set_reveal_child (priv->edit_revealer, FALSE);
+  gtd_notification_set_kind (notification, "task-removed");
 
-  /* Notify about the removal */
-  notification = gtd_notification_new (text, 7500.0);
+  for (l = tasks; l != NULL; l = l->next)
+    gtd_notification_add_item (notification, l->data);
 
   gtd_notification_set_primary_action (notification,
                                        (GtdNotificationActionFunc) remove_task_action,
-                                       data);
+                                       view);
 
   gtd_notification_set_secondary_action (notification,
                                          _("Undo"),
                                          (GtdNotificationActionFunc) undo_remove_task_action,
-                                         data);
+                                         view);
+
+  g_signal_connect (notification,
+                    "merged",
+                    G_CALLBACK (remove_task_merged),
+                    NULL);
 
   gtd_window_notify (window, notification);
 
+  g_object_unref (notification);
   g_free (text);
 }
 
+static void
+gtd_task_list_view__remove_task_cb (GtdEditPane *pane,
+                                    GtdTask     *task,
+                                    gpointer     user_data)
+{
+  GtdTaskListViewPrivate *priv;
+  GList *tasks;
+
+  g_return_if_fail (GTD_IS_TASK_LIST_VIEW (user_data));
+
+  priv = GTD_TASK_LIST_VIEW (user_data)->priv;
+  tasks = g_list_prepend (NULL, task);
+
+  /* Remove the task from the list, until the removal is sent or undone */
+  gtd_manager_defer_remove_task (priv->manager, task);
+
+  gtk_revealer_set_reveal_child (priv->edit_revealer, FALSE);
+
+  gtd_task_list_view__notify_removal (GTD_TASK_LIST_VIEW (user_data), tasks);
+
+  g_list_free (tasks);
+}
+
 static void
 gtd_task_list_view__edit_task_finished (GtdEditPane *pane,
                                         GtdTask     *task,
@@ -277,6 +419,43 @@ gtd_task_list_view__color_changed (GObject    *object,
   g_free (color_str);
 }
 
+static gint
+gtd_task_list_view__get_n_complete (GtdTaskListView *view)
+{
+  GtdTaskListViewPrivate *priv = view->priv;
+
+  /* Frozen tasks are complete, but not loaded */
+  if (priv->task_list)
+    return priv->complete_tasks + gtd_task_list_get_n_frozen (priv->task_list);
+
+  return priv->complete_tasks;
+}
+
+static void
+gtd_task_list_view__update_holds (GtdTaskListView *view)
+{
+  GtdTaskListViewPrivate *priv = view->priv;
+
+  if (!priv->manager)
+    return;
+
+  /* Hold the new list first, so tasks shared by both stay loaded */
+  if (priv->task_list && priv->task_list != priv->held_list)
+    gtd_manager_hold_task_list (priv->manager, priv->task_list);
+
+  if (priv->show_completed)
+    gtd_manager_hold_completed (priv->manager, priv->task_list);
+
+  if (priv->holds_completed)
+    gtd_manager_release_completed (priv->manager, priv->held_list);
+
+  if (priv->held_list && priv->held_list != priv->task_list)
+    gtd_manager_release_task_list (priv->manager, priv->held_list);
+
+  priv->holds_completed = priv->show_completed;
+  priv->held_list = priv->task_list;
+}
+
 static void
 gtd_task_list_view__update_done_label (GtdTaskListView *view)
 {
@@ -286,7 +465,7 @@ gtd_task_list_view__update_done_label (GtdTaskListView *view)
 
   new_label = g_strdup_printf ("%s (%d)",
                                _("Done"),
-                               view->priv->complete_tasks);
+                               gtd_task_list_view__get_n_complete (view));
 
   gtk_label_set_label (view->priv->done_label, new_label);
 
@@ -372,19 +551,301 @@ gtd_task_list_view__clear_list (GtdTaskListView *view)
   gtk_revealer_set_reveal_child (view->priv->revealer, FALSE);
   gtk_revealer_set_reveal_child (view->priv->edit_revealer, FALSE);
 
+  g_hash_table_remove_all (view->priv->selection);
+  view->priv->selection_anchor = NULL;
+  gtk_revealer_set_reveal_child (view->priv->selection_revealer, FALSE);
+
   g_list_free (children);
 }
 
+static GtdTaskRow*
+gtd_task_list_view__get_row_for_task (GtdTaskListView *view,
+                                      GtdTask         *task)
+{
+  GtdTaskRow *row;
+  GList *children;
+  GList *l;
+
+  row = NULL;
+  children = gtk_container_get_children (GTK_CONTAINER (view->priv->listbox));
+
+  for (l = children; l != NULL; l = l->next)
+    {
+      if (!gtd_task_row_get_new_task_mode (l->data) &&
+          gtd_task_row_get_task (l->data) == task)
+        {
+          row = l->data;
+          break;
+        }
+    }
+
+  g_list_free (children);
+
+  return row;
+}
+
+static void
+gtd_task_list_view__update_move_menu (GtdTaskListView *view)
+{
+  GtdTaskListViewPrivate *priv;
+  GList *lists;
+  GMenu *menu;
+  GList *l;
+
+  priv = view->priv;
+
+  if (!priv->manager)
+    return;
+
+  menu = g_menu_new ();
+  lists = gtd_manager_get_task_lists (priv->manager);
+
+  for (l = lists; l != NULL; l = l->next)
+    {
+      GMenuItem *item;
+
+      if (l->data == priv->task_list)
+        continue;
+
+      item = g_menu_item_new (gtd_task_list_get_name (l->data), NULL);
+      g_menu_item_set_action_and_target_value (item,
+                                               "list.move-selection",
+                                               g_variant_new_string (e_source_get_uid (gtd_task_list_get_source (l->data))));
+
+      g_menu_append_item (menu, item);
+
+      g_object_unref (item);
+    }
+
+  gtk_menu_button_set_menu_model (priv->move_button, G_MENU_MODEL (menu));
+
+  g_object_unref (menu);
+  g_list_free (lists);
+}
+
+static void
+gtd_task_list_view__selection_changed (GtdTaskListView *view)
+{
+  GtdTaskListViewPrivate *priv;
+  guint n_selected;
+
+  priv = view->priv;
+  n_selected = g_hash_table_size (priv->selection);
+
+  if (n_selected > 0)
+    {
+      gchar *text;
+
+      text = g_strdup_printf (ngettext ("%d task selected",
+                                        "%d tasks selected",
+                                        n_selected),
+                              n_selected);
+
+      gtk_label_set_label (priv->selection_label, text);
+
+      /* The lists may have changed since the last selection */
+      if (!gtk_revealer_get_reveal_child (priv->selection_revealer))
+        gtd_task_list_view__update_move_menu (view);
+
+      g_free (text);
+    }
+
+  gtk_revealer_set_reveal_child (priv->selection_revealer, n_selected > 0);
+}
+
+static void
+gtd_task_list_view__set_task_selected (GtdTaskListView *view,
+                                       GtdTask         *task,
+                                       gboolean         selected)
+{
+  GtdTaskListViewPrivate *priv;
+  GtdTaskRow *row;
+
+  priv = view->priv;
+
+  if (selected == g_hash_table_contains (priv->selection, task))
+    return;
+
+  if (selected)
+    g_hash_table_add (priv->selection, g_object_ref (task));
+  else
+    g_hash_table_remove (priv->selection, task);
+
+  row = gtd_task_list_view__get_row_for_task (view, task);
+
+  if (!row)
+    return;
+
+  if (selected)
+    gtk_widget_set_state_flags (GTK_WIDGET (row), GTK_STATE_FLAG_SELECTED, FALSE);
+  else
+    gtk_widget_unset_state_flags (GTK_WIDGET (row), GTK_STATE_FLAG_SELECTED);
+}
+
+/* Drops @task from the selection, when it's no longer shown */
+static void
+gtd_task_list_view__forget_task (GtdTaskListView *view,
+                                 GtdTask         *task)
+{
+  GtdTaskListViewPrivate *priv = view->priv;
+
+  if (priv->selection_anchor == task)
+    priv->selection_anchor = NULL;
+
+  if (g_hash_table_remove (priv->selection, task))
+    gtd_task_list_view__selection_changed (view);
+}
+
+static void
+gtd_task_list_view__unselect_all (GtdTaskListView *view)
+{
+  GtdTaskListViewPrivate *priv;
+  GList *children;
+  GList *l;
+
+  priv = view->priv;
+  priv->selection_anchor = NULL;
+
+  if (g_hash_table_size (priv->selection) == 0)
+    return;
+
+  g_hash_table_remove_all (priv->selection);
+
+  children = gtk_container_get_children (GTK_CONTAINER (priv->listbox));
+
+  for (l = children; l != NULL; l = l->next)
+    gtk_widget_unset_state_flags (l->data, GTK_STATE_FLAG_SELECTED);
+
+  g_list_free (children);
+
+  gtd_task_list_view__selection_changed (view);
+}
+
+/* Selects the rows between the anchor and @row, in the order they're shown */
+static void
+gtd_task_list_view__select_range (GtdTaskListView *view,
+                                  GtdTaskRow      *row)
+{
+  GtdTaskListViewPrivate *priv;
+  GtdTaskRow *anchor_row;
+  GtdTask *anchor;
+  gint start;
+  gint end;
+  gint i;
+
+  priv = view->priv;
+  anchor = priv->selection_anchor;
+  anchor_row = gtd_task_list_view__get_row_for_task (view, anchor);
+
+  if (!anchor_row)
+    {
+      gtd_task_list_view__set_task_selected (view, gtd_task_row_get_task (row), TRUE);
+      priv->selection_anchor = gtd_task_row_get_task (row);
+      return;
+    }
+
+  start = gtk_list_box_row_get_index (GTK_LIST_BOX_ROW (anchor_row));
+  end = gtk_list_box_row_get_index (GTK_LIST_BOX_ROW (row));
+
+  if (start > end)
+    {
+      gint tmp = start;
+
+      start = end;
+      end = tmp;
+    }
+
+  /* The range replaces the selection, but keeps the anchor */
+  gtd_task_list_view__unselect_all (view);
+  priv->selection_anchor = anchor;
+
+  for (i = start; i <= end; i++)
+    {
+      GtkListBoxRow *current = gtk_list_box_get_row_at_index (priv->listbox, i);
+
+      if (!current || gtd_task_row_get_new_task_mode (GTD_TASK_ROW (current)))
+        continue;
+
+      gtd_task_list_view__set_task_selected (view, gtd_task_row_get_task (GTD_TASK_ROW (current)), TRUE);
+    }
+}
+
+/*
+ * Bulk operations hold back the backend writes, so each source gets
+ * a single request, and the view is sorted and counted only once.
+ */
+static void
+gtd_task_list_view__begin_bulk (GtdTaskListView *view)
+{
+  view->priv->bulk_depth++;
+
+  gtd_manager_begin_updates (view->priv->manager);
+}
+
+static void
+gtd_task_list_view__end_bulk (GtdTaskListView *view)
+{
+  GtdTaskListViewPrivate *priv = view->priv;
+
+  gtd_manager_commit_updates (priv->manager);
+
+  if (--priv->bulk_depth > 0)
+    return;
+
+  gtd_task_list_view__update_done_label (view);
+  gtk_revealer_set_reveal_child (priv->revealer, gtd_task_list_view__get_n_complete (view) > 0);
+
+  gtd_task_list_view__update_empty_state (view);
+
+  gtk_list_box_invalidate_sort (priv->listbox);
+}
+
 static void
 gtd_task_list_view__row_activated (GtkListBox *listbox,
                                    GtdTaskRow *row,
                                    gpointer    user_data)
 {
   GtdTaskListViewPrivate *priv = GTD_TASK_LIST_VIEW (user_data)->priv;
+  GdkModifierType modify_mask;
+  GdkModifierType extend_mask;
+  GdkModifierType state;
 
   if (row == priv->new_task_row)
     return;
 
+  if (!gtk_get_current_event_state (&state))
+    state = 0;
+
+  modify_mask = gtk_widget_get_modifier_mask (GTK_WIDGET (listbox), GDK_MODIFIER_INTENT_MODIFY_SELECTION);
+  extend_mask = gtk_widget_get_modifier_mask (GTK_WIDGET (listbox), GDK_MODIFIER_INTENT_EXTEND_SELECTION);
+
+  /* Ctrl toggles the row in the selection, and Shift selects a range */
+  if (state & (modify_mask | extend_mask))
+    {
+      GtdTask *task = gtd_task_row_get_task (row);
+
+      /* The selection and the edit pane don't go together */
+      gtd_edit_pane_set_task (priv->edit_pane, NULL);
+      gtk_revealer_set_reveal_child (priv->edit_revealer, FALSE);
+
+      if ((state & extend_mask) && priv->selection_anchor)
+        {
+          gtd_task_list_view__select_range (user_data, row);
+        }
+      else
+        {
+          gtd_task_list_view__set_task_selected (user_data,
+                                                 task,
+                                                 !g_hash_table_contains (priv->selection, task));
+          priv->selection_anchor = task;
+        }
+
+      gtd_task_list_view__selection_changed (user_data);
+      return;
+    }
+
+  gtd_task_list_view__unselect_all (user_data);
+
   gtd_edit_pane_set_task (priv->edit_pane, gtd_task_row_get_task (row));
 
   gtk_revealer_set_reveal_child (priv->edit_revealer, TRUE);
@@ -437,6 +898,8 @@ gtd_task_list_view__remove_task (GtdTaskListView *view,
   g_return_if_fail (GTD_IS_TASK_LIST_VIEW (view));
   g_return_if_fail (GTD_IS_TASK (task));
 
+  gtd_task_list_view__forget_task (view, task);
+
   children = gtk_container_get_children (GTK_CONTAINER (priv->listbox));
 
   for (l = children; l != NULL; l = l->next)
@@ -468,6 +931,7 @@ gtd_task_list_view__task_completed (GObject    *object,
 
   task_complete = gtd_task_get_complete (task);
 
+  /* Held back and sent together during bulk operations */
   gtd_manager_update_task (priv->manager, task);
   gtd_task_list_save_task (gtd_task_get_list (task), task);
 
@@ -487,9 +951,6 @@ gtd_task_list_view__task_completed (GObject    *object,
       gtd_edit_pane_set_task (priv->edit_pane, NULL);
     }
 
-  gtd_task_list_view__update_done_label (GTD_TASK_LIST_VIEW (user_data));
-  gtk_revealer_set_reveal_child (priv->revealer, priv->complete_tasks > 0);
-
   if (!priv->show_completed)
     {
       if (task_complete)
@@ -497,10 +958,16 @@ gtd_task_list_view__task_completed (GObject    *object,
       else
         gtd_task_list_view__add_task (GTD_TASK_LIST_VIEW (user_data), task);
     }
-  else
-    {
-      gtk_list_box_invalidate_sort (priv->listbox);
-    }
+
+  /* Bulk operations refresh the view when they end */
+  if (priv->bulk_depth > 0)
+    return;
+
+  gtd_task_list_view__update_done_label (GTD_TASK_LIST_VIEW (user_data));
+  gtk_revealer_set_reveal_child (priv->revealer, gtd_task_list_view__get_n_complete (GTD_TASK_LIST_VIEW (user_data)) > 0);
+
+  if (priv->show_completed)
+    gtk_list_box_invalidate_sort (priv->listbox);
 }
 
 static void
@@ -521,6 +988,28 @@ gtd_task_list_view__task_added (GtdTaskList *list,
                     user_data);
 }
 
+static void
+gtd_task_list_view__task_removed (GtdTaskList     *list,
+                                  GtdTask         *task,
+                                  GtdTaskListView *view)
+{
+  GtdTaskListViewPrivate *priv = view->priv;
+
+  g_signal_handlers_disconnect_by_func (task,
+                                        gtd_task_list_view__task_completed,
+                                        view);
+
+  if (gtd_task_get_complete (task))
+    {
+      priv->complete_tasks--;
+
+      gtd_task_list_view__update_done_label (view);
+      gtk_revealer_set_reveal_child (priv->revealer, gtd_task_list_view__get_n_complete (view) > 0);
+    }
+
+  gtd_task_list_view__remove_task (view, task);
+}
+
 static void
 gtd_task_list_view__create_task (GtdTaskRow *row,
                                  GtdTask    *task,
@@ -544,9 +1033,370 @@ gtd_task_list_view__create_task (GtdTaskRow *row,
   gtd_manager_create_task (priv->manager, task);
 }
 
+static void
+undo_bulk_edit_action (GtdNotification *notification,
+                       gpointer         user_data)
+{
+  GtdTaskListViewPrivate *priv;
+  GHashTableIter iter;
+  GHashTable *moves;
+  BulkUndo *undo;
+  gpointer list;
+  gpointer tasks;
+  gboolean sent;
+  guint i;
+
+  undo = user_data;
+  priv = undo->view->priv;
+  moves = g_hash_table_new (g_direct_hash, g_direct_equal);
+
+  gtd_task_list_view__begin_bulk (undo->view);
+
+  for (i = 0; i < undo->snapshots->len; i++)
+    {
+      TaskSnapshot *snapshot = g_ptr_array_index (undo->snapshots, i);
+
+      /* Moved tasks only go back to their lists */
+      if (gtd_task_get_list (snapshot->task) != snapshot->list)
+        {
+          tasks = g_hash_table_lookup (moves, snapshot->list);
+          g_hash_table_insert (moves, snapshot->list, g_list_prepend (tasks, snapshot->task));
+          continue;
+        }
+
+      /* Restoring the completion sends the task through notify::complete */
+      sent = gtd_task_get_complete (snapshot->task) != snapshot->complete &&
+             g_signal_handler_find (snapshot->task,
+                                    G_SIGNAL_MATCH_FUNC | G_SIGNAL_MATCH_DATA,
+                                    0, 0, NULL,
+                                    gtd_task_list_view__task_completed,
+                                    undo->view) != 0;
+
+      gtd_task_begin_changes (snapshot->task);
+      gtd_task_set_complete (snapshot->task, snapshot->complete);
+      gtd_task_set_priority (snapshot->task, snapshot->priority);
+
+      if (snapshot->due_is_date)
+        gtd_task_set_due_day (snapshot->task, gtd_date_get_day_from_date_time (snapshot->due_date));
+      else
+        gtd_task_set_due_date (snapshot->task, snapshot->due_date);
+
+      gtd_task_commit_changes (snapshot->task);
+
+      if (sent)
+        continue;
+
+      gtd_manager_update_task (priv->manager, snapshot->task);
+      gtd_task_list_save_task (snapshot->list, snapshot->task);
+    }
+
+  g_hash_table_iter_init (&iter, moves);
+
+  while (g_hash_table_iter_next (&iter, &list, &tasks))
+    {
+      gtd_manager_move_tasks (priv->manager, tasks, list);
+      g_list_free (tasks);
+    }
+
+  gtd_task_list_view__end_bulk (undo->view);
+
+  g_hash_table_destroy (moves);
+}
+
+/* Shows a single notification for a bulk operation, which can be undone */
+static void
+gtd_task_list_view__notify_bulk_edit (GtdTaskListView *view,
+                                      const gchar     *text,
+                                      BulkUndo        *undo)
+{
+  GtdNotification *notification;
+  GtdWindow *window;
+
+  window = GTD_WINDOW (gtk_widget_get_toplevel (GTK_WIDGET (view)));
+  notification = gtd_notification_new (text, 7500.0);
+
+  /* The changes were already sent, only Undo needs the snapshots */
+  g_object_set_data_full (G_OBJECT (notification),
+                          BULK_UNDO_DATA,
+                          undo,
+                          (GDestroyNotify) bulk_undo_free);
+
+  gtd_notification_set_secondary_action (notification,
+                                         _("Undo"),
+                                         (GtdNotificationActionFunc) undo_bulk_edit_action,
+                                         undo);
+
+  gtd_window_notify (window, notification);
+
+  g_object_unref (notification);
+}
+
+static void
+gtd_task_list_view__complete_selection_action (GSimpleAction *simple,
+                                               GVariant      *parameter,
+                                               gpointer       user_data)
+{
+  GtdTaskListView *view;
+  BulkUndo *undo;
+  GList *tasks;
+  GList *l;
+  guint n_tasks;
+  gchar *text;
+
+  view = GTD_TASK_LIST_VIEW (user_data);
+  tasks = g_hash_table_get_keys (view->priv->selection);
+
+  if (!tasks)
+    return;
+
+  g_list_foreach (tasks, (GFunc) g_object_ref, NULL);
+
+  n_tasks = g_list_length (tasks);
+  undo = bulk_undo_new (view, tasks);
+
+  /* Completed rows go away */
+  gtd_task_list_view__unselect_all (view);
+
+  gtd_task_list_view__begin_bulk (view);
+
+  for (l = tasks; l != NULL; l = l->next)
+    gtd_task_set_complete (l->data, TRUE);
+
+  gtd_task_list_view__end_bulk (view);
+
+  text = g_strdup_printf (ngettext ("%d task marked as done",
+                                    "%d tasks marked as done",
+                                    n_tasks),
+                          n_tasks);
+
+  gtd_task_list_view__notify_bulk_edit (view, text, undo);
+
+  g_list_free_full (tasks, g_object_unref);
+  g_free (text);
+}
+
+static void
+gtd_task_list_view__remove_selection_action (GSimpleAction *simple,
+                                             GVariant      *parameter,
+                                             gpointer       user_data)
+{
+  GtdTaskListView *view;
+  GList *tasks;
+  GList *l;
+
+  view = GTD_TASK_LIST_VIEW (user_data);
+  tasks = g_hash_table_get_keys (view->priv->selection);
+
+  if (!tasks)
+    return;
+
+  g_list_foreach (tasks, (GFunc) g_object_ref, NULL);
+
+  gtd_task_list_view__unselect_all (view);
+
+  /* Removed together, and undone together */
+  gtd_task_list_view__begin_bulk (view);
+
+  for (l = tasks; l != NULL; l = l->next)
+    gtd_manager_defer_remove_task (view->priv->manager, l->data);
+
+  gtd_task_list_view__end_bulk (view);
+
+  gtd_task_list_view__notify_removal (view, tasks);
+
+  g_list_free_full (tasks, g_object_unref);
+}
+
+static void
+gtd_task_list_view__set_priority_action (GSimpleAction *simple,
+                                         GVariant      *parameter,
+                                         gpointer       user_data)
+{
+  GtdTaskListView *view;
+  BulkUndo *undo;
+  GList *tasks;
+  GList *l;
+  guint n_tasks;
+  gchar *text;
+  gint priority;
+
+  view = GTD_TASK_LIST_VIEW (user_data);
+  tasks = g_hash_table_get_keys (view->priv->selection);
+  priority = g_variant_get_int32 (parameter);
+
+  if (!tasks)
+    return;
+
+  n_tasks = g_list_length (tasks);
+  undo = bulk_undo_new (view, tasks);
+
+  gtd_task_list_view__begin_bulk (view);
+
+  for (l = tasks; l != NULL; l = l->next)
+    {
+      gtd_task_set_priority (l->data, priority);
+
+      gtd_manager_update_task (view->priv->manager, l->data);
+      gtd_task_list_save_task (gtd_task_get_list (l->data), l->data);
+    }
+
+  gtd_task_list_view__end_bulk (view);
+
+  text = g_strdup_printf (ngettext ("Priority of %d task changed",
+                                    "Priority of %d tasks changed",
+                                    n_tasks),
+                          n_tasks);
+
+  gtd_task_list_view__notify_bulk_edit (view, text, undo);
+
+  g_list_free (tasks);
+  g_free (text);
+}
+
+static void
+gtd_task_list_view__set_due_date_action (GSimpleAction *simple,
+                                         GVariant      *parameter,
+                                         gpointer       user_data)
+{
+  GtdTaskListView *view;
+  BulkUndo *undo;
+  GList *tasks;
+  GList *l;
+  guint32 due_day;
+  guint n_tasks;
+  gchar *text;
+  gint days;
+
+  view = GTD_TASK_LIST_VIEW (user_data);
+  tasks = g_hash_table_get_keys (view->priv->selection);
+  days = g_variant_get_int32 (parameter);
+
+  if (!tasks)
+    return;
+
+  /* Days from today, or a negative number to unset the date */
+  due_day = days >= 0 ? gtd_date_get_today () + days : 0;
+
+  n_tasks = g_list_length (tasks);
+  undo = bulk_undo_new (view, tasks);
+
+  gtd_task_list_view__begin_bulk (view);
+
+  for (l = tasks; l != NULL; l = l->next)
+    {
+      gtd_task_set_due_day (l->data, due_day);
+
+      gtd_manager_update_task (view->priv->manager, l->data);
+      gtd_task_list_save_task (gtd_task_get_list (l->data), l->data);
+    }
+
+  gtd_task_list_view__end_bulk (view);
+
+  text = g_strdup_printf (ngettext ("Due date of %d task changed",
+                                    "Due date of %d tasks changed",
+                                    n_tasks),
+                          n_tasks);
+
+  gtd_task_list_view__notify_bulk_edit (view, text, undo);
+
+  g_list_free (tasks);
+  g_free (text);
+}
+
+static void
+gtd_task_list_view__move_selection_action (GSimpleAction *simple,
+                                           GVariant      *parameter,
+                                           gpointer       user_data)
+{
+  GtdTaskListView *view;
+  GtdTaskList *target;
+  BulkUndo *undo;
+  GList *tasks;
+  GList *lists;
+  GList *l;
+  guint n_tasks;
+  gchar *text;
+
+  view = GTD_TASK_LIST_VIEW (user_data);
+  lists = gtd_manager_get_task_lists (view->priv->manager);
+  target = NULL;
+
+  for (l = lists; l != NULL; l = l->next)
+    {
+      if (g_strcmp0 (e_source_get_uid (gtd_task_list_get_source (l->data)),
+                     g_variant_get_string (parameter, NULL)) == 0)
+        {
+          target = l->data;
+          break;
+        }
+    }
+
+  g_list_free (lists);
+
+  tasks = g_hash_table_get_keys (view->priv->selection);
+
+  if (!tasks || !target)
+    {
+      g_list_free (tasks);
+      return;
+    }
+
+  g_list_foreach (tasks, (GFunc) g_object_ref, NULL);
+
+  n_tasks = g_list_length (tasks);
+  undo = bulk_undo_new (view, tasks);
+
+  /* Moved rows may go away */
+  gtd_task_list_view__unselect_all (view);
+
+  gtd_task_list_view__begin_bulk (view);
+
+  gtd_manager_move_tasks (view->priv->manager, tasks, target);
+
+  gtd_task_list_view__end_bulk (view);
+
+  text = g_strdup_printf (ngettext ("%d task moved to <b>%s</b>",
+                                    "%d tasks moved to <b>%s</b>",
+                                    n_tasks),
+                          n_tasks,
+                          gtd_task_list_get_name (target));
+
+  gtd_task_list_view__notify_bulk_edit (view, text, undo);
+
+  g_list_free_full (tasks, g_object_unref);
+  g_free (text);
+}
+
+static void
+gtd_task_list_view__unselect_all_action (GSimpleAction *simple,
+                                         GVariant      *parameter,
+                                         gpointer       user_data)
+{
+  gtd_task_list_view__unselect_all (user_data);
+}
+
+static const GActionEntry gtd_task_list_view_entries[] = {
+  { "complete-selection", gtd_task_list_view__complete_selection_action },
+  { "move-selection",     gtd_task_list_view__move_selection_action, "s" },
+  { "remove-selection",   gtd_task_list_view__remove_selection_action },
+  { "set-due-date",       gtd_task_list_view__set_due_date_action, "i" },
+  { "set-priority",       gtd_task_list_view__set_priority_action, "i" },
+  { "unselect-all",       gtd_task_list_view__unselect_all_action }
+};
+
 static void
 gtd_task_list_view_finalize (GObject *object)
 {
+  GtdTaskListViewPrivate *priv = GTD_TASK_LIST_VIEW (object)->priv;
+
+  g_clear_pointer (&priv->selection, g_hash_table_destroy);
+
+  if (priv->holds_completed)
+    gtd_manager_release_completed (priv->manager, priv->held_list);
+
+  if (priv->held_list)
+    gtd_manager_release_task_list (priv->manager, priv->held_list);
+
   G_OBJECT_CLASS (gtd_task_list_view_parent_class)->finalize (object);
 }
 
@@ -711,6 +1561,9 @@ gtd_task_list_view_class_init (GtdTaskListViewClass *klass)
   gtk_widget_class_bind_template_child_private (widget_class, GtdTaskListView, done_label);
   gtk_widget_class_bind_template_child_private (widget_class, GtdTaskListView, viewport);
   gtk_widget_class_bind_template_child_private (widget_class, GtdTaskListView, stack);
+  gtk_widget_class_bind_template_child_private (widget_class, GtdTaskListView, selection_revealer);
+  gtk_widget_class_bind_template_child_private (widget_class, GtdTaskListView, selection_label);
+  gtk_widget_class_bind_template_child_private (widget_class, GtdTaskListView, move_button);
 
   gtk_widget_class_bind_template_callback (widget_class, gtd_task_list_view__done_button_clicked);
   gtk_widget_class_bind_template_callback (widget_class, gtd_task_list_view__edit_task_finished);
@@ -721,9 +1574,12 @@ gtd_task_list_view_class_init (GtdTaskListViewClass *klass)
 static void
 gtd_task_list_view_init (GtdTaskListView *self)
 {
+  GSimpleActionGroup *group;
+
   self->priv = gtd_task_list_view_get_instance_private (self);
   self->priv->readonly = TRUE;
   self->priv->can_toggle = TRUE;
+  self->priv->selection = g_hash_table_new_full (g_direct_hash, g_direct_equal, g_object_unref, NULL);
   self->priv->new_task_row = GTD_TASK_ROW (gtd_task_row_new (NULL));
   gtd_task_row_set_new_task_mode (self->priv->new_task_row, TRUE);
 
@@ -733,6 +1589,18 @@ gtd_task_list_view_init (GtdTaskListView *self)
                     self);
 
   gtk_widget_init_template (GTK_WIDGET (self));
+
+  /* bulk operations on the selected tasks */
+  group = g_simple_action_group_new ();
+
+  g_action_map_add_action_entries (G_ACTION_MAP (group),
+                                   gtd_task_list_view_entries,
+                                   G_N_ELEMENTS (gtd_task_list_view_entries),
+                                   self);
+
+  gtk_widget_insert_action_group (GTK_WIDGET (self), "list", G_ACTION_GROUP (group));
+
+  g_object_unref (group);
 }
 
 /**
@@ -959,6 +1827,9 @@ gtd_task_list_view_set_task_list (GtdTaskListView *view,
           g_signal_handlers_disconnect_by_func (priv->task_list,
                                                 gtd_task_list_view__task_added,
                                                 view);
+          g_signal_handlers_disconnect_by_func (priv->task_list,
+                                                gtd_task_list_view__task_removed,
+                                                view);
           g_signal_handlers_disconnect_by_func (priv->task_list,
                                                 gtd_task_list_view__color_changed,
                                                 view);
@@ -985,6 +1856,8 @@ gtd_task_list_view_set_task_list (GtdTaskListView *view,
 
       update_font_color (view);
 
+      gtd_task_list_view__update_holds (view);
+
       /* Add the tasks from the list */
       task_list = gtd_task_list_get_tasks (list);
 
@@ -992,14 +1865,18 @@ gtd_task_list_view_set_task_list (GtdTaskListView *view,
 
       g_list_free (task_list);
 
+      /* The frozen tasks count as done, too */
+      gtd_task_list_view__update_done_label (view);
+      gtk_revealer_set_reveal_child (priv->revealer, gtd_task_list_view__get_n_complete (view) > 0);
+
       g_signal_connect (list,
                         "task-added",
                         G_CALLBACK (gtd_task_list_view__task_added),
                         view);
-      g_signal_connect_swapped (list,
-                                "task-removed",
-                                G_CALLBACK (gtd_task_list_view__remove_task),
-                                view);
+      g_signal_connect (list,
+                        "task-removed",
+                        G_CALLBACK (gtd_task_list_view__task_removed),
+                        view);
       g_signal_connect (list,
                         "notify::color",
                         G_CALLBACK (gtd_task_list_view__color_changed),
@@ -1095,6 +1972,9 @@ gtd_task_list_view_set_show_completed (GtdTaskListView *view,
 
       priv->show_completed = show_completed;
 
+      /* Completed tasks may be frozen while hidden */
+      gtd_task_list_view__update_holds (view);
+
       gtk_image_set_from_icon_name (view->priv->done_image,
                                     show_completed ? "zoom-out-symbolic" : "zoom-in-symbolic",
                                     GTK_ICON_SIZE_BUTTON);
@@ -1141,10 +2021,19 @@ gtd_task_list_view_set_show_completed (GtdTaskListView *view,
               if (!gtd_task_row_get_new_task_mode (l->data) &&
                   gtd_task_get_complete (gtd_task_row_get_task (l->data)))
                 {
+                  gtd_task_list_view__forget_task (view, gtd_task_row_get_task (l->data));
                   gtd_task_row_destroy (l->data);
                 }
             }
 
+          /* Hidden tasks can't be edited */
+          if (gtd_edit_pane_get_task (priv->edit_pane) &&
+              gtd_task_get_complete (gtd_edit_pane_get_task (priv->edit_pane)))
+            {
+              gtk_revealer_set_reveal_child (priv->edit_revealer, FALSE);
+              gtd_edit_pane_set_task (priv->edit_pane, NULL);
+            }
+
           g_list_free (children);
         }
 
@@ -16,17 +16,57 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include "gtd-local-store.h"
 #include "gtd-task.h"
 #include "gtd-task-list.h"
 
 #include <glib/gi18n.h>
 #include <libecal/libecal.h>
+#include <string.h>
+
+/*
+ * Completed tasks are rarely looked at, but usually make up most of
+ * a list. While hidden, they are kept as the text of their iCalendar
+ * components in a single string chunk, instead of as a GtdTask with
+ * its parsed component tree, and only rebuilt when shown again.
+ */
+
+/* Rebuild the string chunk when this many bytes are unused */
+#define FROZEN_WASTE_THRESHOLD           (64 * 1024)
+
+/* Number of task titles kept around while the list is evicted */
+#define PREVIEW_SIZE                     10
 
 typedef struct
 {
-  GList               *tasks;
+  const gchar         *uid;
+  const gchar         *data;
+} FrozenTask;
+
+typedef struct
+{
+  GQueue              *tasks;
+
+  /* Maps each task to its link in @tasks */
+  GHashTable          *task_links;
+
+  /* Frozen completed tasks, sorted by UID when @frozen_sorted is set */
+  GStringChunk        *frozen_strings;
+  GArray              *frozen_tasks;
+  gboolean             frozen_sorted;
+  gsize                frozen_size;
+  gsize                frozen_wasted;
+
+  /* Set while the tasks were unloaded to save memory */
+  gboolean             evicted;
+  gchar              **preview;
+
   ESource             *source;
   gchar               *origin;
+
+  ECalClient          *client;
+  GtdLocalStore       *store;
+  GCancellable        *cancellable;
 } GtdTaskListPrivate;
 
 struct _GtdTaskList
@@ -59,12 +99,150 @@ enum
   LAST_PROP
 };
 
+static gint
+frozen_task_compare (gconstpointer a,
+                     gconstpointer b)
+{
+  return strcmp (((const FrozenTask*) a)->uid, ((const FrozenTask*) b)->uid);
+}
+
+static gint
+gtd_task_list__find_frozen (GtdTaskList *list,
+                            const gchar *uid)
+{
+  GtdTaskListPrivate *priv = list->priv;
+  guint lo;
+  guint hi;
+
+  if (!priv->frozen_sorted)
+    {
+      g_array_sort (priv->frozen_tasks, frozen_task_compare);
+      priv->frozen_sorted = TRUE;
+    }
+
+  lo = 0;
+  hi = priv->frozen_tasks->len;
+
+  while (lo < hi)
+    {
+      guint mid = lo + (hi - lo) / 2;
+      gint result;
+
+      result = strcmp (g_array_index (priv->frozen_tasks, FrozenTask, mid).uid, uid);
+
+      if (result == 0)
+        return mid;
+      else if (result < 0)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+
+  return -1;
+}
+
+static void
+gtd_task_list__clear_frozen (GtdTaskList *list)
+{
+  GtdTaskListPrivate *priv = list->priv;
+
+  g_array_set_size (priv->frozen_tasks, 0);
+  g_clear_pointer (&priv->frozen_strings, g_string_chunk_free);
+
+  priv->frozen_sorted = TRUE;
+  priv->frozen_size = 0;
+  priv->frozen_wasted = 0;
+}
+
+static void
+gtd_task_list__remove_frozen_at (GtdTaskList *list,
+                                 guint        index)
+{
+  GtdTaskListPrivate *priv = list->priv;
+  GStringChunk *strings;
+  FrozenTask *frozen;
+  guint i;
+
+  frozen = &g_array_index (priv->frozen_tasks, FrozenTask, index);
+  priv->frozen_wasted += strlen (frozen->uid) + strlen (frozen->data) + 2;
+
+  g_array_remove_index (priv->frozen_tasks, index);
+
+  if (priv->frozen_tasks->len == 0)
+    {
+      gtd_task_list__clear_frozen (list);
+      return;
+    }
+
+  /* String chunks can't free single strings, so copy the live ones */
+  if (priv->frozen_wasted < FROZEN_WASTE_THRESHOLD ||
+      priv->frozen_wasted < priv->frozen_size - priv->frozen_wasted)
+    {
+      return;
+    }
+
+  strings = g_string_chunk_new (priv->frozen_size - priv->frozen_wasted);
+
+  for (i = 0; i < priv->frozen_tasks->len; i++)
+    {
+      frozen = &g_array_index (priv->frozen_tasks, FrozenTask, i);
+      frozen->uid = g_string_chunk_insert (strings, frozen->uid);
+      frozen->data = g_string_chunk_insert (strings, frozen->data);
+    }
+
+  g_string_chunk_free (priv->frozen_strings);
+
+  priv->frozen_strings = strings;
+  priv->frozen_size -= priv->frozen_wasted;
+  priv->frozen_wasted = 0;
+}
+
+static GtdTask*
+gtd_task_list__thaw_at (GtdTaskList *list,
+                        guint        index)
+{
+  ECalComponent *component;
+  FrozenTask *frozen;
+  GtdTask *task;
+
+  frozen = &g_array_index (list->priv->frozen_tasks, FrozenTask, index);
+  component = e_cal_component_new_from_string (frozen->data);
+
+  if (!component)
+    {
+      g_warning ("%s: %s: %s",
+                 G_STRFUNC,
+                 _("Error thawing task"),
+                 frozen->uid);
+
+      return NULL;
+    }
+
+  task = gtd_task_new (component);
+  gtd_task_set_list (task, list);
+
+  g_object_unref (component);
+
+  return task;
+}
+
 static void
 gtd_task_list_finalize (GObject *object)
 {
   GtdTaskList *self = (GtdTaskList*) object;
 
   g_clear_pointer (&self->priv->origin, g_free);
+  g_clear_pointer (&self->priv->task_links, g_hash_table_destroy);
+  g_clear_object (&self->priv->cancellable);
+  g_clear_object (&self->priv->client);
+  g_clear_object (&self->priv->store);
+
+  g_queue_free (self->priv->tasks);
+
+  gtd_task_list__clear_frozen (self);
+  g_array_unref (self->priv->frozen_tasks);
+
+  g_strfreev (self->priv->preview);
 
   G_OBJECT_CLASS (gtd_task_list_parent_class)->finalize (object);
 }
@@ -252,6 +430,10 @@ static void
 gtd_task_list_init (GtdTaskList *self)
 {
   self->priv = gtd_task_list_get_instance_private (self);
+  self->priv->tasks = g_queue_new ();
+  self->priv->task_links = g_hash_table_new (g_direct_hash, g_direct_equal);
+  self->priv->frozen_tasks = g_array_new (FALSE, FALSE, sizeof (FrozenTask));
+  self->priv->frozen_sorted = TRUE;
 }
 
 /**
@@ -335,6 +517,8 @@ gtd_task_list_set_color (GtdTaskList   *list,
       e_source_selectable_set_color (selectable, color_str);
       g_free (color_str);
 
+      gtd_object_increment_generation (GTD_OBJECT (list));
+
       g_object_notify (G_OBJECT (list), "color");
     }
 
@@ -375,6 +559,8 @@ gtd_task_list_set_name (GtdTaskList *list,
     {
       e_source_set_display_name (list->priv->source, name);
 
+      gtd_object_increment_generation (GTD_OBJECT (list));
+
       g_object_notify (G_OBJECT (list), "name");
     }
 }
@@ -392,7 +578,24 @@ gtd_task_list_get_tasks (GtdTaskList *list)
 {
   g_return_val_if_fail (GTD_IS_TASK_LIST (list), NULL);
 
-  return g_list_copy (list->priv->tasks);
+  return g_list_copy (list->priv->tasks->head);
+}
+
+/**
+ * gtd_task_list_get_n_tasks:
+ * @list: a #GtdTaskList
+ *
+ * Retrieves the number of tasks loaded in @list, not counting
+ * the frozen ones.
+ *
+ * Returns: the number of tasks of @list
+ */
+guint
+gtd_task_list_get_n_tasks (GtdTaskList *list)
+{
+  g_return_val_if_fail (GTD_IS_TASK_LIST (list), 0);
+
+  return list->priv->tasks->length;
 }
 
 /**
@@ -413,11 +616,22 @@ gtd_task_list_save_task (GtdTaskList *list,
 
   if (gtd_task_list_contains (list, task))
     {
+      /*
+       * Generations only grow, so a task newer than the list changed
+       * after the list did. This is how lists that don't own @task,
+       * like Today, pick up its changes.
+       */
+      if (gtd_object_get_generation (GTD_OBJECT (task)) > gtd_object_get_generation (GTD_OBJECT (list)))
+        gtd_object_increment_generation (GTD_OBJECT (list));
+
       g_signal_emit (list, signals[TASK_UPDATED], 0, task);
     }
   else
     {
-      list->priv->tasks = g_list_append (list->priv->tasks, task);
+      g_queue_push_tail (list->priv->tasks, task);
+      g_hash_table_insert (list->priv->task_links, task, list->priv->tasks->tail);
+
+      gtd_object_increment_generation (GTD_OBJECT (list));
 
       g_signal_emit (list, signals[TASK_ADDED], 0, task);
     }
@@ -436,13 +650,20 @@ void
 gtd_task_list_remove_task (GtdTaskList *list,
                            GtdTask     *task)
 {
+  GList *link;
+
   g_assert (GTD_IS_TASK_LIST (list));
   g_assert (GTD_IS_TASK (task));
 
-  if (!gtd_task_list_contains (list, task))
+  link = g_hash_table_lookup (list->priv->task_links, task);
+
+  if (!link)
     return;
 
-  list->priv->tasks = g_list_remove (list->priv->tasks, task);
+  g_queue_delete_link (list->priv->tasks, link);
+  g_hash_table_remove (list->priv->task_links, task);
+
+  gtd_object_increment_generation (GTD_OBJECT (list));
 
   g_signal_emit (list, signals[TASK_REMOVED], 0, task);
 }
@@ -463,7 +684,7 @@ gtd_task_list_contains (GtdTaskList *list,
   g_assert (GTD_IS_TASK_LIST (list));
   g_assert (GTD_IS_TASK (task));
 
-  return (g_list_find (list->priv->tasks, task) != NULL);
+  return g_hash_table_contains (list->priv->task_links, task);
 }
 
 /**
@@ -497,3 +718,444 @@ gtd_task_list_get_origin (GtdTaskList *list)
 
   return list->priv->origin;
 }
+
+/**
+ * gtd_task_list_get_cancellable:
+ * @list: a @GtdTaskList
+ *
+ * Retrieves the #GCancellable of the operations running on @list. Cancelling
+ * it cancels every outstanding operation on @list and its tasks.
+ *
+ * Returns: (transfer none): the #GCancellable of @list.
+ */
+GCancellable*
+gtd_task_list_get_cancellable (GtdTaskList *list)
+{
+  g_return_val_if_fail (GTD_IS_TASK_LIST (list), NULL);
+
+  if (!list->priv->cancellable)
+    list->priv->cancellable = g_cancellable_new ();
+
+  return list->priv->cancellable;
+}
+
+/**
+ * gtd_task_list_set_cancellable:
+ * @list: a @GtdTaskList
+ * @cancellable: a #GCancellable
+ *
+ * Sets the #GCancellable of the operations running on @list. This is
+ * usually a child of the parent source's #GCancellable.
+ *
+ * Returns:
+ */
+void
+gtd_task_list_set_cancellable (GtdTaskList  *list,
+                               GCancellable *cancellable)
+{
+  g_return_if_fail (GTD_IS_TASK_LIST (list));
+  g_return_if_fail (G_IS_CANCELLABLE (cancellable));
+
+  g_set_object (&list->priv->cancellable, cancellable);
+}
+
+/**
+ * gtd_task_list_get_client:
+ * @list: a @GtdTaskList
+ *
+ * Retrieves the #ECalClient connected to the source of @list.
+ *
+ * Returns: (transfer none) (nullable): the #ECalClient of @list, or %NULL
+ * if the source isn't connected.
+ */
+ECalClient*
+gtd_task_list_get_client (GtdTaskList *list)
+{
+  g_return_val_if_fail (GTD_IS_TASK_LIST (list), NULL);
+
+  return list->priv->client;
+}
+
+/**
+ * gtd_task_list_set_client:
+ * @list: a @GtdTaskList
+ * @client: (nullable): an #ECalClient, or %NULL
+ *
+ * Sets the #ECalClient connected to the source of @list.
+ *
+ * Returns:
+ */
+void
+gtd_task_list_set_client (GtdTaskList *list,
+                          ECalClient  *client)
+{
+  g_return_if_fail (GTD_IS_TASK_LIST (list));
+  g_return_if_fail (!client || E_IS_CAL_CLIENT (client));
+
+  g_set_object (&list->priv->client, client);
+}
+
+/**
+ * gtd_task_list_get_store:
+ * @list: a @GtdTaskList
+ *
+ * Retrieves the #GtdLocalStore holding the tasks of @list, for
+ * lists stored natively rather than through a #ECalClient.
+ *
+ * Returns: (transfer none) (nullable): the #GtdLocalStore of @list, or %NULL
+ */
+GtdLocalStore*
+gtd_task_list_get_store (GtdTaskList *list)
+{
+  g_return_val_if_fail (GTD_IS_TASK_LIST (list), NULL);
+
+  return list->priv->store;
+}
+
+/**
+ * gtd_task_list_set_store:
+ * @list: a @GtdTaskList
+ * @store: (nullable): a #GtdLocalStore, or %NULL
+ *
+ * Sets the #GtdLocalStore holding the tasks of @list.
+ *
+ * Returns:
+ */
+void
+gtd_task_list_set_store (GtdTaskList   *list,
+                         GtdLocalStore *store)
+{
+  g_return_if_fail (GTD_IS_TASK_LIST (list));
+  g_return_if_fail (!store || GTD_IS_LOCAL_STORE (store));
+
+  g_set_object (&list->priv->store, store);
+}
+
+/**
+ * gtd_task_list_freeze_task:
+ * @list: a #GtdTaskList
+ * @task: a completed #GtdTask of @list
+ *
+ * Removes @task from @list and drops the reference @list holds on it,
+ * keeping it only as the text of its component. It is given back as a
+ * new #GtdTask by gtd_task_list_thaw() or gtd_task_list_thaw_task().
+ *
+ * Returns:
+ */
+void
+gtd_task_list_freeze_task (GtdTaskList *list,
+                           GtdTask     *task)
+{
+  GtdTaskListPrivate *priv;
+  FrozenTask frozen;
+  gchar *data;
+  GList *link;
+
+  g_return_if_fail (GTD_IS_TASK_LIST (list));
+  g_return_if_fail (GTD_IS_TASK (task));
+  g_return_if_fail (gtd_task_get_complete (task));
+
+  priv = list->priv;
+  link = g_hash_table_lookup (priv->task_links, task);
+
+  if (!link || !gtd_object_get_uid (GTD_OBJECT (task)))
+    return;
+
+  data = e_cal_component_get_as_string (gtd_task_get_component (task));
+
+  if (!priv->frozen_strings)
+    priv->frozen_strings = g_string_chunk_new (4096);
+
+  frozen.uid = g_string_chunk_insert (priv->frozen_strings, gtd_object_get_uid (GTD_OBJECT (task)));
+  frozen.data = g_string_chunk_insert (priv->frozen_strings, data);
+
+  priv->frozen_size += strlen (frozen.uid) + strlen (frozen.data) + 2;
+
+  g_array_append_val (priv->frozen_tasks, frozen);
+  priv->frozen_sorted = FALSE;
+
+  g_free (data);
+
+  g_queue_delete_link (priv->tasks, link);
+  g_hash_table_remove (priv->task_links, task);
+
+  gtd_object_increment_generation (GTD_OBJECT (list));
+
+  g_signal_emit (list, signals[TASK_REMOVED], 0, task);
+
+  g_object_unref (task);
+}
+
+/**
+ * gtd_task_list_thaw_task:
+ * @list: a #GtdTaskList
+ * @uid: the UID of a frozen task
+ *
+ * Adds the frozen task whose UID is @uid back to @list.
+ *
+ * Returns: (transfer none) (nullable): the thawed #GtdTask, or %NULL if
+ * no task with @uid is frozen in @list
+ */
+GtdTask*
+gtd_task_list_thaw_task (GtdTaskList *list,
+                         const gchar *uid)
+{
+  GtdTask *task;
+  gint index;
+
+  g_return_val_if_fail (GTD_IS_TASK_LIST (list), NULL);
+  g_return_val_if_fail (uid, NULL);
+
+  index = gtd_task_list__find_frozen (list, uid);
+
+  if (index < 0)
+    return NULL;
+
+  task = gtd_task_list__thaw_at (list, index);
+
+  gtd_task_list__remove_frozen_at (list, index);
+
+  if (task)
+    gtd_task_list_save_task (list, task);
+
+  return task;
+}
+
+/**
+ * gtd_task_list_thaw:
+ * @list: a #GtdTaskList
+ *
+ * Adds every frozen task back to @list.
+ *
+ * Returns: (element-type GtdTask) (transfer container): the thawed tasks
+ */
+GList*
+gtd_task_list_thaw (GtdTaskList *list)
+{
+  GList *tasks;
+  GList *l;
+  guint i;
+
+  g_return_val_if_fail (GTD_IS_TASK_LIST (list), NULL);
+
+  tasks = NULL;
+
+  for (i = 0; i < list->priv->frozen_tasks->len; i++)
+    {
+      GtdTask *task;
+
+      task = gtd_task_list__thaw_at (list, i);
+
+      if (task)
+        tasks = g_list_prepend (tasks, task);
+    }
+
+  /* Clear first, so the handlers of ::task-added see a consistent list */
+  gtd_task_list__clear_frozen (list);
+
+  tasks = g_list_reverse (tasks);
+
+  for (l = tasks; l != NULL; l = l->next)
+    gtd_task_list_save_task (list, l->data);
+
+  return tasks;
+}
+
+/**
+ * gtd_task_list_remove_frozen_task:
+ * @list: a #GtdTaskList
+ * @uid: the UID of a frozen task
+ *
+ * Forgets the frozen task whose UID is @uid, e.g. because it was
+ * removed from the source of @list.
+ *
+ * Returns: %TRUE if a task was removed, %FALSE otherwise
+ */
+gboolean
+gtd_task_list_remove_frozen_task (GtdTaskList *list,
+                                  const gchar *uid)
+{
+  gint index;
+
+  g_return_val_if_fail (GTD_IS_TASK_LIST (list), FALSE);
+  g_return_val_if_fail (uid, FALSE);
+
+  index = gtd_task_list__find_frozen (list, uid);
+
+  if (index < 0)
+    return FALSE;
+
+  gtd_task_list__remove_frozen_at (list, index);
+
+  return TRUE;
+}
+
+/**
+ * gtd_task_list_get_frozen_data:
+ * @list: a #GtdTaskList
+ * @uid: the UID of a frozen task
+ *
+ * Retrieves the iCalendar text of the frozen task whose UID is @uid.
+ *
+ * Returns: (transfer none) (nullable): the text of the task's component,
+ * or %NULL if no task with @uid is frozen in @list
+ */
+const gchar*
+gtd_task_list_get_frozen_data (GtdTaskList *list,
+                               const gchar *uid)
+{
+  gint index;
+
+  g_return_val_if_fail (GTD_IS_TASK_LIST (list), NULL);
+  g_return_val_if_fail (uid, NULL);
+
+  index = gtd_task_list__find_frozen (list, uid);
+
+  return index < 0 ? NULL : g_array_index (list->priv->frozen_tasks, FrozenTask, index).data;
+}
+
+/**
+ * gtd_task_list_get_frozen_uids:
+ * @list: a #GtdTaskList
+ *
+ * Retrieves the UIDs of the frozen tasks of @list.
+ *
+ * Returns: (transfer full): a %NULL-terminated array of UIDs. Free
+ * with g_strfreev() after use.
+ */
+gchar**
+gtd_task_list_get_frozen_uids (GtdTaskList *list)
+{
+  GtdTaskListPrivate *priv;
+  gchar **uids;
+  guint i;
+
+  g_return_val_if_fail (GTD_IS_TASK_LIST (list), NULL);
+
+  priv = list->priv;
+  uids = g_new0 (gchar*, priv->frozen_tasks->len + 1);
+
+  for (i = 0; i < priv->frozen_tasks->len; i++)
+    uids[i] = g_strdup (g_array_index (priv->frozen_tasks, FrozenTask, i).uid);
+
+  return uids;
+}
+
+/**
+ * gtd_task_list_get_n_frozen:
+ * @list: a #GtdTaskList
+ *
+ * Retrieves the number of frozen tasks of @list. Frozen tasks are
+ * always complete.
+ *
+ * Returns: the number of frozen tasks
+ */
+guint
+gtd_task_list_get_n_frozen (GtdTaskList *list)
+{
+  g_return_val_if_fail (GTD_IS_TASK_LIST (list), 0);
+
+  return list->priv->frozen_tasks->len;
+}
+
+/**
+ * gtd_task_list_clear_frozen:
+ * @list: a #GtdTaskList
+ *
+ * Forgets every frozen task of @list, without adding them back.
+ *
+ * Returns:
+ */
+void
+gtd_task_list_clear_frozen (GtdTaskList *list)
+{
+  g_return_if_fail (GTD_IS_TASK_LIST (list));
+
+  gtd_task_list__clear_frozen (list);
+}
+
+/**
+ * gtd_task_list_get_evicted:
+ * @list: a #GtdTaskList
+ *
+ * Retrieves whether the tasks of @list were unloaded to save
+ * memory. Evicted lists only keep the tasks that something else
+ * still needs, and must be reloaded before being shown.
+ *
+ * Returns: %TRUE if @list is evicted, %FALSE otherwise
+ */
+gboolean
+gtd_task_list_get_evicted (GtdTaskList *list)
+{
+  g_return_val_if_fail (GTD_IS_TASK_LIST (list), FALSE);
+
+  return list->priv->evicted;
+}
+
+/**
+ * gtd_task_list_set_evicted:
+ * @list: a #GtdTaskList
+ * @evicted: whether @list is evicted
+ *
+ * Marks @list as evicted or reloaded. When evicting, the titles of
+ * the first incomplete tasks are saved, so @list can still be
+ * summarized after its tasks are removed.
+ *
+ * Returns:
+ */
+void
+gtd_task_list_set_evicted (GtdTaskList *list,
+                           gboolean     evicted)
+{
+  GtdTaskListPrivate *priv;
+
+  g_return_if_fail (GTD_IS_TASK_LIST (list));
+
+  priv = list->priv;
+
+  if (priv->evicted == evicted)
+    return;
+
+  priv->evicted = evicted;
+
+  gtd_object_increment_generation (GTD_OBJECT (list));
+
+  g_clear_pointer (&priv->preview, g_strfreev);
+
+  if (evicted)
+    {
+      GList *tasks;
+      GList *l;
+      guint n;
+
+      tasks = g_list_sort (gtd_task_list_get_tasks (list), (GCompareFunc) gtd_task_compare);
+      priv->preview = g_new0 (gchar*, PREVIEW_SIZE + 1);
+      n = 0;
+
+      for (l = tasks; l != NULL && n < PREVIEW_SIZE; l = l->next)
+        {
+          if (!gtd_task_get_complete (l->data))
+            priv->preview[n++] = g_strdup (gtd_task_get_title (l->data));
+        }
+
+      g_list_free (tasks);
+    }
+}
+
+/**
+ * gtd_task_list_get_preview:
+ * @list: a #GtdTaskList
+ *
+ * Retrieves the titles of the first incomplete tasks of @list,
+ * saved when it was evicted.
+ *
+ * Returns: (transfer none) (nullable): a %NULL-terminated array of
+ * titles, or %NULL if @list is not evicted
+ */
+const gchar * const *
+gtd_task_list_get_preview (GtdTaskList *list)
+{
+  g_return_val_if_fail (GTD_IS_TASK_LIST (list), NULL);
+
+  return (const gchar * const *) list->priv->preview;
+}
@@ -47,6 +47,8 @@ void                    gtd_task_list_set_name                  (GtdTaskList
 
 GList*                  gtd_task_list_get_tasks                 (GtdTaskList            *list);
 
+guint                   gtd_task_list_get_n_tasks               (GtdTaskList            *list);
+
 void                    gtd_task_list_save_task                 (GtdTaskList            *list,
                                                                  GtdTask                *task);
 
@@ -60,6 +62,48 @@ ESource*                gtd_task_list_get_source                (GtdTaskList
 
 const gchar*            gtd_task_list_get_origin                (GtdTaskList            *list);
 
+GCancellable*           gtd_task_list_get_cancellable           (GtdTaskList            *list);
+
+void                    gtd_task_list_set_cancellable           (GtdTaskList            *list,
+                                                                 GCancellable           *cancellable);
+
+ECalClient*             gtd_task_list_get_client                (GtdTaskList            *list);
+
+void                    gtd_task_list_set_client                (GtdTaskList            *list,
+                                                                 ECalClient             *client);
+
+GtdLocalStore*          gtd_task_list_get_store                 (GtdTaskList            *list);
+
+void                    gtd_task_list_set_store                 (GtdTaskList            *list,
+                                                                 GtdLocalStore          *store);
+
+void                    gtd_task_list_freeze_task               (GtdTaskList            *list,
+                                                                 GtdTask                *task);
+
+GtdTask*                gtd_task_list_thaw_task                 (GtdTaskList            *list,
+                                                                 const gchar            *uid);
+
+GList*                  gtd_task_list_thaw                      (GtdTaskList            *list);
+
+gboolean                gtd_task_list_remove_frozen_task        (GtdTaskList            *list,
+                                                                 const gchar            *uid);
+
+const gchar*            gtd_task_list_get_frozen_data           (GtdTaskList            *list,
+                                                                 const gchar            *uid);
+
+gchar**                 gtd_task_list_get_frozen_uids           (GtdTaskList            *list);
+
+guint                   gtd_task_list_get_n_frozen              (GtdTaskList            *list);
+
+void                    gtd_task_list_clear_frozen              (GtdTaskList            *list);
+
+gboolean                gtd_task_list_get_evicted               (GtdTaskList            *list);
+
+void                    gtd_task_list_set_evicted               (GtdTaskList            *list,
+                                                                 gboolean                evicted);
+
+const gchar * const *   gtd_task_list_get_preview               (GtdTaskList            *list);
+
 G_END_DECLS
 
 #endif /* GTD_TASK_LIST_H */
@@ -16,6 +16,7 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include "gtd-date.h"
 #include "gtd-task-row.h"
 #include "gtd-task.h"
 #include "gtd-task-list.h"
@@ -114,6 +115,16 @@ gtd_task_row__priority_changed_cb (GtdTaskRow *row,
   gtk_widget_queue_draw (GTK_WIDGET (row));
 }
 
+static void
+gtd_task_row__task_changed_cb (GtdTaskRow *row,
+                               guint       fields,
+                               GObject    *object)
+{
+  /* Only the priority style depends on the task */
+  if (fields & GTD_TASK_FIELD_PRIORITY)
+    gtd_task_row__priority_changed_cb (row, NULL, object);
+}
+
 static gboolean
 gtd_task_row__date_changed_binding (GBinding     *binding,
                                     const GValue *from_value,
@@ -129,40 +140,21 @@ gtd_task_row__date_changed_binding (GBinding     *binding,
 
   if (dt)
     {
-      GDateTime *today = g_date_time_new_now_local ();
-
-      if (g_date_time_get_year (dt) == g_date_time_get_year (today) &&
-          g_date_time_get_month (dt) == g_date_time_get_month (today))
-        {
-          if (g_date_time_get_day_of_month (dt) == g_date_time_get_day_of_month (today))
-            {
-              new_label = g_strdup (_("Today"));
-            }
-          else if (g_date_time_get_day_of_month (dt) == g_date_time_get_day_of_month (today) + 1)
-            {
-              new_label = g_strdup (_("Tomorrow"));
-            }
-          else if (g_date_time_get_day_of_month (dt) == g_date_time_get_day_of_month (today) - 1)
-            {
-              new_label = g_strdup (_("Yesterday"));
-            }
-          else if (g_date_time_get_day_of_year (dt) > g_date_time_get_day_of_month (today) &&
-                   g_date_time_get_day_of_year (dt) < g_date_time_get_day_of_month (today) + 7)
-            {
-              new_label = g_date_time_format (dt, "%A");
-            }
-          else
-            {
-              new_label = g_date_time_format (dt, "%x");
-            }
-        }
+      gint64 offset;
+
+      /* Day numbers don't break at month and year boundaries */
+      offset = (gint64) gtd_date_get_day_from_date_time (dt) - (gint64) gtd_date_get_today ();
+
+      if (offset == 0)
+        new_label = g_strdup (_("Today"));
+      else if (offset == 1)
+        new_label = g_strdup (_("Tomorrow"));
+      else if (offset == -1)
+        new_label = g_strdup (_("Yesterday"));
+      else if (offset > 1 && offset < 7)
+        new_label = g_date_time_format (dt, "%A");
       else
-        {
-          new_label = g_date_time_format (dt, "%x");
-        }
-
-      g_date_time_unref (today);
-
+        new_label = g_date_time_format (dt, "%x");
     }
   else
     {
@@ -587,8 +579,8 @@ gtd_task_row_set_task (GtdTaskRow *row,
            */
           gtd_task_row__priority_changed_cb (row, NULL, G_OBJECT (task));
           g_signal_connect_swapped (task,
-                                    "notify::priority",
-                                    G_CALLBACK (gtd_task_row__priority_changed_cb),
+                                    "changed",
+                                    G_CALLBACK (gtd_task_row__task_changed_cb),
                                     row);
         }
 
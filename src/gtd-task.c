@@ -16,6 +16,7 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include "gtd-date.h"
 #include "gtd-task.h"
 #include "gtd-task-list.h"
 
@@ -26,9 +27,16 @@
 
 typedef struct
 {
+  /* Joined descriptions of the component, built on demand */
   gchar           *description;
+  gboolean         description_valid;
+
   GtdTaskList     *list;
   ECalComponent   *component;
+
+  /* change sets */
+  guint            changes_depth;
+  GtdTaskField     changed_fields;
 } GtdTaskPrivate;
 
 struct _GtdTask
@@ -54,29 +62,115 @@ enum
   LAST_PROP
 };
 
-static GDateTime*
-gtd_task__convert_icaltime (const icaltimetype *date)
+enum
 {
-  GTimeZone *tz;
-  GDateTime *dt;
-  gboolean is_date;
+  CHANGED,
+  NUM_SIGNALS
+};
 
-  if (!date)
-    return NULL;
+static guint signals[NUM_SIGNALS] = { 0, };
+
+/*
+ * Notifies @property, and reports @field either right away or,
+ * inside a change set, when the change set is committed. The
+ * list of @task is moved to a new generation as well, since it
+ * aggregates the changes of its tasks.
+ */
+static void
+gtd_task__notify (GtdTask      *task,
+                  GtdTaskField  field,
+                  const gchar  *property)
+{
+  gtd_object_increment_generation (GTD_OBJECT (task));
+
+  if (task->priv->list)
+    gtd_object_increment_generation (GTD_OBJECT (task->priv->list));
+
+  g_object_notify (G_OBJECT (task), property);
+
+  if (task->priv->changes_depth > 0)
+    {
+      task->priv->changed_fields |= field;
+      return;
+    }
+
+  g_signal_emit (task, signals[CHANGED], 0, field);
+}
+
+/*
+ * Reads the due date straight from the iCalendar component, without
+ * the copies e_cal_component_get_due() makes. @tzid points into the
+ * component, and is only valid until it changes.
+ */
+static gboolean
+gtd_task__get_due (GtdTask       *task,
+                   icaltimetype  *itt,
+                   const gchar  **tzid)
+{
+  icalcomponent *component;
+  icalparameter *param;
+  icalproperty *prop;
+
+  component = e_cal_component_get_icalcomponent (task->priv->component);
+  prop = icalcomponent_get_first_property (component, ICAL_DUE_PROPERTY);
+
+  if (!prop)
+    return FALSE;
 
-  is_date = date->is_date ? TRUE : FALSE;
+  *itt = icalproperty_get_due (prop);
 
-  tz = g_time_zone_new_utc ();
+  param = icalproperty_get_first_parameter (prop, ICAL_TZID_PARAMETER);
+  *tzid = param ? icalparameter_get_tzid (param) : NULL;
 
-  dt = g_date_time_new (tz,
-                        date->year,
-                        date->month,
-                        date->day,
-                        is_date ? date->hour : 0,
-                        is_date ? date->minute : 0,
-                        is_date ? date->second : 0.0);
+  return !icaltime_is_null_time (*itt);
+}
+
+/* The client resolves the TZIDs defined by the calendar of @task */
+static ECalClient*
+gtd_task__get_client (GtdTask *task)
+{
+  GtdTaskList *list;
 
-  return dt;
+  list = gtd_task_get_list (task);
+
+  return list ? gtd_task_list_get_client (list) : NULL;
+}
+
+/* Sets the due date of @task to @itt, or unsets it if @itt is %NULL */
+static void
+gtd_task__set_due (GtdTask            *task,
+                   const icaltimetype *itt)
+{
+  ECalComponentDateTime comp_dt;
+  icaltimetype current;
+  icaltimetype value;
+  const gchar *tzid;
+  gboolean has_current;
+
+  has_current = gtd_task__get_due (task, &current, &tzid);
+
+  if (!itt && !has_current)
+    return;
+
+  if (itt &&
+      has_current &&
+      current.is_date == itt->is_date &&
+      gtd_date_get_time (&current, tzid, gtd_task__get_client (task)) ==
+      gtd_date_get_time (itt, NULL, NULL))
+    {
+      return;
+    }
+
+  /* Dates are floating, and date-times are in UTC, so no TZID is needed */
+  if (itt)
+    value = *itt;
+
+  comp_dt.value = itt ? &value : NULL;
+  comp_dt.tzid = NULL;
+
+  e_cal_component_set_due (task->priv->component, &comp_dt);
+
+  gtd_task__notify (task, GTD_TASK_FIELD_DUE_DATE, "due-date");
 }
 
 static void
@@ -127,6 +221,8 @@ gtd_task__set_uid (GtdObject   *object,
     {
       e_cal_component_set_uid (priv->component, uid);
 
+      gtd_object_increment_generation (object);
+
       g_object_notify (G_OBJECT (object), "uid");
     }
 }
@@ -154,7 +250,7 @@ gtd_task_get_property (GObject    *object,
       break;
 
     case PROP_DUE_DATE:
-      g_value_set_boxed (value, gtd_task_get_due_date (self));
+      g_value_take_boxed (value, gtd_task_get_due_date (self));
       break;
 
     case PROP_LIST:
@@ -342,6 +438,25 @@ gtd_task_class_init (GtdTaskClass *klass)
                              _("The title of the task"),
                              NULL,
                              G_PARAM_READWRITE));
+
+  /**
+   * GtdTask::changed:
+   * @fields: the #GtdTaskField mask of the changed fields
+   *
+   * The ::changed signal is emmited after fields of the task
+   * change. Changes made inside a change set are reported in a
+   * single emission when the change set is committed.
+   */
+  signals[CHANGED] = g_signal_new ("changed",
+                                   GTD_TYPE_TASK,
+                                   G_SIGNAL_RUN_LAST,
+                                   0,
+                                   NULL,
+                                   NULL,
+                                   NULL,
+                                   G_TYPE_NONE,
+                                   1,
+                                   G_TYPE_UINT);
 }
 
 static void
@@ -398,6 +513,73 @@ gtd_task_get_component (GtdTask *task)
   return task->priv->component;
 }
 
+/**
+ * gtd_task_set_component:
+ * @task: a #GtdTask
+ * @component: the new #ECalComponent
+ *
+ * Replaces the backing component of @task with @component, e.g.
+ * when a newer revision of the task is fetched from its source.
+ * Only the properties whose values actually changed are notified,
+ * and GtdTask::changed is emitted once for all of them.
+ *
+ * Returns:
+ */
+void
+gtd_task_set_component (GtdTask       *task,
+                        ECalComponent *component)
+{
+  GDateTime *old_due_date, *new_due_date;
+  gchar *old_description, *old_title;
+  gboolean old_complete;
+  gint old_priority;
+
+  g_return_if_fail (GTD_IS_TASK (task));
+  g_return_if_fail (E_IS_CAL_COMPONENT (component));
+
+  if (task->priv->component == component)
+    return;
+
+  old_complete = gtd_task_get_complete (task);
+  old_description = g_strdup (gtd_task_get_description (task));
+  old_due_date = gtd_task_get_due_date (task);
+  old_priority = gtd_task_get_priority (task);
+  old_title = g_strdup (gtd_task_get_title (task));
+
+  g_set_object (&task->priv->component, component);
+
+  task->priv->description_valid = FALSE;
+
+  gtd_task_begin_changes (task);
+
+  if (old_complete != gtd_task_get_complete (task))
+    gtd_task__notify (task, GTD_TASK_FIELD_COMPLETE, "complete");
+
+  if (g_strcmp0 (old_description, gtd_task_get_description (task)) != 0)
+    gtd_task__notify (task, GTD_TASK_FIELD_DESCRIPTION, "description");
+
+  new_due_date = gtd_task_get_due_date (task);
+
+  if ((old_due_date == NULL) != (new_due_date == NULL) ||
+      (old_due_date && g_date_time_compare (old_due_date, new_due_date) != 0))
+    {
+      gtd_task__notify (task, GTD_TASK_FIELD_DUE_DATE, "due-date");
+    }
+
+  if (old_priority != gtd_task_get_priority (task))
+    gtd_task__notify (task, GTD_TASK_FIELD_PRIORITY, "priority");
+
+  if (g_strcmp0 (old_title, gtd_task_get_title (task)) != 0)
+    gtd_task__notify (task, GTD_TASK_FIELD_TITLE, "title");
+
+  gtd_task_commit_changes (task);
+
+  g_clear_pointer (&old_due_date, g_date_time_unref);
+  g_clear_pointer (&new_due_date, g_date_time_unref);
+  g_free (old_description);
+  g_free (old_title);
+}
+
 /**
  * gtd_task_set_complete:
  * @task: a #GtdTask
@@ -460,7 +642,7 @@ gtd_task_set_complete (GtdTask  *task,
       if (dt)
         e_cal_component_free_icaltimetype (dt);
 
-      g_object_notify (G_OBJECT (task), "complete");
+      gtd_task__notify (task, GTD_TASK_FIELD_COMPLETE, "complete");
     }
 }
 
@@ -468,56 +650,57 @@ gtd_task_set_complete (GtdTask  *task,
  * gtd_task_get_description:
  * @task: a #GtdTask
  *
- * Retrieves the description of the task.
+ * Retrieves the description of the task. Multiple descriptions
+ * are joined by newlines. The result is kept until the component
+ * of @task changes.
  *
  * Returns: (transfer none): the description of @task
  */
 const gchar*
 gtd_task_get_description (GtdTask *task)
 {
+  GtdTaskPrivate *priv;
   GSList *text_list;
   GSList *l;
-  gchar *desc = NULL;
+  GString *desc;
 
   g_return_val_if_fail (GTD_IS_TASK (task), NULL);
 
+  priv = task->priv;
+
+  if (priv->description_valid)
+    return priv->description ? priv->description : "";
+
   /* concatenates the multiple descriptions a task may have */
-  e_cal_component_get_description_list (task->priv->component, &text_list);
+  e_cal_component_get_description_list (priv->component, &text_list);
+
+  desc = NULL;
+
   for (l = text_list; l != NULL; l = l->next)
     {
-      if (l->data != NULL)
+      ECalComponentText *text = l->data;
+
+      if (!text || !text->value)
+        continue;
+
+      if (!desc)
         {
-          ECalComponentText *text;
-          gchar *carrier;
-          text = l->data;
-
-          if (desc != NULL)
-            {
-              carrier = g_strconcat (desc,
-                                     "\n",
-                                     text->value,
-                                     NULL);
-              g_free (desc);
-              desc = carrier;
-            }
-          else
-            {
-              desc = g_strdup (text->value);
-            }
+          desc = g_string_new (text->value);
+          continue;
         }
+
+      g_string_append_c (desc, '\n');
+      g_string_append (desc, text->value);
     }
 
-  if (g_strcmp0 (task->priv->description, desc) != 0)
-    {
-      g_clear_pointer (&task->priv->description, g_free);
+  g_free (priv->description);
 
-      task->priv->description = g_strdup (desc);
-    }
+  priv->description = desc ? g_string_free (desc, FALSE) : NULL;
+  priv->description_valid = TRUE;
 
-  g_free (desc);
   e_cal_component_free_text_list (text_list);
 
-  return task->priv->description ? task->priv->description : "";
+  return priv->description ? priv->description : "";
 }
 
 /**
@@ -537,6 +720,9 @@ gtd_task_set_description (GtdTask     *task,
   g_assert (GTD_IS_TASK (task));
   g_assert (g_utf8_validate (description, -1, NULL));
 
+  /* Compares against the component, not a stale cache */
+  gtd_task_get_description (task);
+
   if (g_strcmp0 (task->priv->description, description) != 0)
     {
       GSList note;
@@ -554,7 +740,7 @@ gtd_task_set_description (GtdTask     *task,
 
       e_cal_component_set_description_list (task->priv->component, &note);
 
-      g_object_notify (G_OBJECT (task), "description");
+      gtd_task__notify (task, GTD_TASK_FIELD_DESCRIPTION, "description");
     }
 }
 
@@ -572,89 +758,121 @@ gtd_task_set_description (GtdTask     *task,
 GDateTime*
 gtd_task_get_due_date (GtdTask *task)
 {
-  ECalComponentDateTime comp_dt;
+  const gchar *tzid;
+  icaltimetype itt;
 
   g_return_val_if_fail (GTD_IS_TASK (task), NULL);
 
-  e_cal_component_get_due (task->priv->component, &comp_dt);
+  if (!gtd_task__get_due (task, &itt, &tzid))
+    return NULL;
 
-  return gtd_task__convert_icaltime (comp_dt.value);
+  return gtd_date_to_date_time (&itt, tzid, gtd_task__get_client (task));
 }
 
 /**
- * gtd_task_set_due_date:
+ * gtd_task_get_due_day:
  * @task: a #GtdTask
- * @dt: a #GDateTime
  *
- * Updates the internal @GtdTask::due-date property.
+ * Retrieves the local day @task is due, as a julian day number.
+ * Unlike gtd_task_get_due_date(), this doesn't allocate anything.
  *
- * Returns:
+ * Returns: the day @task is due, or 0 if no date is set.
  */
-void
-gtd_task_set_due_date (GtdTask   *task,
-                       GDateTime *dt)
+guint32
+gtd_task_get_due_day (GtdTask *task)
 {
-  GDateTime *current_dt;
+  const gchar *tzid;
+  icaltimetype itt;
 
-  g_assert (GTD_IS_TASK (task));
+  g_return_val_if_fail (GTD_IS_TASK (task), 0);
 
-  current_dt = gtd_task_get_due_date (task);
+  if (!gtd_task__get_due (task, &itt, &tzid))
+    return 0;
 
-  if (dt != current_dt)
-    {
-      ECalComponentDateTime comp_dt;
-      icaltimetype *idt;
-      gboolean changed = FALSE;
+  return gtd_date_get_day (&itt, tzid, gtd_task__get_client (task));
+}
 
-      comp_dt.value = NULL;
-      comp_dt.tzid = NULL;
+/**
+ * gtd_task_get_due_is_date:
+ * @task: a #GtdTask
+ *
+ * Retrieves whether the due date of @task is a plain date, without
+ * a time.
+ *
+ * Returns: %TRUE if @task is due on a day, %FALSE if it is due at a
+ * given time or has no due date
+ */
+gboolean
+gtd_task_get_due_is_date (GtdTask *task)
+{
+  const gchar *tzid;
+  icaltimetype itt;
 
-      if (!current_dt ||
-          (current_dt &&
-           dt &&
-           g_date_time_compare (current_dt, dt) != 0))
-        {
-          idt = g_new0 (icaltimetype, 1);
+  g_return_val_if_fail (GTD_IS_TASK (task), FALSE);
 
-          g_date_time_ref (dt);
+  return gtd_task__get_due (task, &itt, &tzid) && itt.is_date;
+}
 
-          /* Copy the given dt */
-          idt->year = g_date_time_get_year (dt);
-          idt->month = g_date_time_get_month (dt);
-          idt->day = g_date_time_get_day_of_month (dt);
-          idt->hour = g_date_time_get_hour (dt);
-          idt->minute = g_date_time_get_minute (dt);
-          idt->second = g_date_time_get_seconds (dt);
-          idt->is_date = (idt->hour == 0 &&
-                          idt->minute == 0 &&
-                          idt->second == 0);
+/**
+ * gtd_task_set_due_date:
+ * @task: a #GtdTask
+ * @dt: (nullable): a #GDateTime
+ *
+ * Updates the internal @GtdTask::due-date property. @dt is a
+ * date with a time, even at midnight; use gtd_task_set_due_day()
+ * for a plain date.
+ *
+ * Returns:
+ */
+void
+gtd_task_set_due_date (GtdTask   *task,
+                       GDateTime *dt)
+{
+  icaltimetype itt;
 
-          comp_dt.tzid = g_strdup ("UTC");
+  g_assert (GTD_IS_TASK (task));
 
-          g_date_time_unref (dt);
+  if (dt)
+    gtd_date_from_date_time (dt, FALSE, &itt);
 
-          changed = TRUE;
-        }
-      else if (!dt)
-        {
-          idt = NULL;
-          comp_dt.tzid = NULL;
+  gtd_task__set_due (task, dt ? &itt : NULL);
+}
 
-          changed = TRUE;
-        }
+/**
+ * gtd_task_set_due_day:
+ * @task: a #GtdTask
+ * @day: a julian day number, or 0
+ *
+ * Makes @task due on @day, without a time, or unsets the due
+ * date if @day is 0.
+ *
+ * Returns:
+ */
+void
+gtd_task_set_due_day (GtdTask *task,
+                      guint32  day)
+{
+  icaltimetype itt;
+  GDate date;
 
-      comp_dt.value = idt;
+  g_assert (GTD_IS_TASK (task));
 
-      e_cal_component_set_due (task->priv->component, &comp_dt);
+  if (day == 0 || !g_date_valid_julian (day))
+    {
+      gtd_task__set_due (task, NULL);
+      return;
+    }
 
-      e_cal_component_free_datetime (&comp_dt);
+  g_date_clear (&date, 1);
+  g_date_set_julian (&date, day);
 
-      if (changed)
-        g_object_notify (G_OBJECT (task), "due-date");
-    }
+  itt = icaltime_null_time ();
+  itt.year = g_date_get_year (&date);
+  itt.month = g_date_get_month (&date);
+  itt.day = g_date_get_day (&date);
+  itt.is_date = 1;
 
-  if (current_dt)
-    g_date_time_unref (current_dt);
+  gtd_task__set_due (task, &itt);
 }
 
 /**
@@ -692,7 +910,7 @@ gtd_task_set_list (GtdTask     *task,
   if (task->priv->list != list)
     {
       task->priv->list = list;
-      g_object_notify (G_OBJECT (task), "list");
+      gtd_task__notify (task, GTD_TASK_FIELD_LIST, "list");
     }
 }
 
@@ -750,7 +968,7 @@ gtd_task_set_priority (GtdTask *task,
   if (priority != current)
     {
       e_cal_component_set_priority (task->priv->component, &priority);
-      g_object_notify (G_OBJECT (task), "priority");
+      gtd_task__notify (task, GTD_TASK_FIELD_PRIORITY, "priority");
     }
 }
 
@@ -806,10 +1024,62 @@ gtd_task_set_title (GtdTask     *task,
 
       e_cal_component_set_summary (task->priv->component, &new_summary);
 
-      g_object_notify (G_OBJECT (task), "title");
+      gtd_task__notify (task, GTD_TASK_FIELD_TITLE, "title");
     }
 }
 
+/**
+ * gtd_task_begin_changes:
+ * @task: a #GtdTask
+ *
+ * Starts a change set on @task. Until the matching call to
+ * gtd_task_commit_changes(), property notifications are held
+ * back and the changed fields are accumulated. Change sets
+ * can be nested.
+ *
+ * Returns:
+ */
+void
+gtd_task_begin_changes (GtdTask *task)
+{
+  g_return_if_fail (GTD_IS_TASK (task));
+
+  task->priv->changes_depth++;
+
+  g_object_freeze_notify (G_OBJECT (task));
+}
+
+/**
+ * gtd_task_commit_changes:
+ * @task: a #GtdTask
+ *
+ * Ends a change set started with gtd_task_begin_changes(). When the
+ * outermost change set ends, the held back notifications are emitted,
+ * followed by a single GtdTask::changed with every changed field.
+ *
+ * Returns:
+ */
+void
+gtd_task_commit_changes (GtdTask *task)
+{
+  GtdTaskField fields;
+
+  g_return_if_fail (GTD_IS_TASK (task));
+  g_return_if_fail (task->priv->changes_depth > 0);
+
+  task->priv->changes_depth--;
+
+  g_object_thaw_notify (G_OBJECT (task));
+
+  if (task->priv->changes_depth > 0 || task->priv->changed_fields == GTD_TASK_FIELD_NONE)
+    return;
+
+  fields = task->priv->changed_fields;
+  task->priv->changed_fields = GTD_TASK_FIELD_NONE;
+
+  g_signal_emit (task, signals[CHANGED], 0, fields);
+}
+
 /**
  * gtd_task_abort:
  * @task: a #GtdTask
@@ -849,8 +1119,9 @@ gint
 gtd_task_compare (GtdTask *t1,
                   GtdTask *t2)
 {
-  GDateTime *dt1;
-  GDateTime *dt2;
+  const gchar *tzid1, *tzid2;
+  icaltimetype itt1, itt2;
+  gboolean has_due1, has_due2;
   gboolean completed1;
   gboolean completed2;
   gint p1;
@@ -888,22 +1159,20 @@ gtd_task_compare (GtdTask *t1,
   /*
    * Third, compare by ::due-date.
    */
-  dt1 = gtd_task_get_due_date (t1);
-  dt2 = gtd_task_get_due_date (t2);
+  has_due1 = gtd_task__get_due (t1, &itt1, &tzid1);
+  has_due2 = gtd_task__get_due (t2, &itt2, &tzid2);
 
-  if (!dt1 && !dt2)
+  if (!has_due1 && !has_due2)
     retval =  0;
-  else if (!dt1)
+  else if (!has_due1)
     retval =  1;
-  else if (!dt2)
+  else if (!has_due2)
     retval = -1;
   else
-    retval = g_date_time_compare (dt1, dt2);
-
-  if (dt1)
-    g_date_time_unref (dt1);
-  if (dt2)
-    g_date_time_unref (dt2);
+    retval = CLAMP (gtd_date_get_time (&itt1, tzid1, gtd_task__get_client (t1)) -
+                    gtd_date_get_time (&itt2, tzid2, gtd_task__get_client (t2)),
+                    -1,
+                    1);
 
   if (retval != 0)
     return retval;
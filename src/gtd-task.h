@@ -39,6 +39,9 @@ void                gtd_task_set_complete             (GtdTask              *tas
 
 ECalComponent*      gtd_task_get_component            (GtdTask              *task);
 
+void                gtd_task_set_component            (GtdTask              *task,
+                                                       ECalComponent        *component);
+
 const gchar*        gtd_task_get_description          (GtdTask              *task);
 
 void                gtd_task_set_description          (GtdTask              *task,
@@ -46,9 +49,16 @@ void                gtd_task_set_description          (GtdTask              *tas
 
 GDateTime*          gtd_task_get_due_date             (GtdTask              *task);
 
+guint32             gtd_task_get_due_day              (GtdTask              *task);
+
+gboolean            gtd_task_get_due_is_date          (GtdTask              *task);
+
 void                gtd_task_set_due_date             (GtdTask              *task,
                                                        GDateTime            *dt);
 
+void                gtd_task_set_due_day              (GtdTask              *task,
+                                                       guint32               day);
+
 GtdTaskList*        gtd_task_get_list                 (GtdTask              *task);
 
 void                gtd_task_set_list                 (GtdTask              *task,
@@ -64,6 +74,10 @@ const gchar*        gtd_task_get_title                (GtdTask              *tas
 void                gtd_task_set_title                (GtdTask              *task,
                                                        const gchar          *title);
 
+void                gtd_task_begin_changes            (GtdTask              *task);
+
+void                gtd_task_commit_changes           (GtdTask              *task);
+
 void                gtd_task_abort                    (GtdTask              *task);
 
 void                gtd_task_save                     (GtdTask              *task);
@@ -25,13 +25,24 @@
 
 G_BEGIN_DECLS
 
+typedef struct _GtdAppendLog            GtdAppendLog;
 typedef struct _GtdApplication          GtdApplication;
+typedef struct _GtdCancellable          GtdCancellable;
+typedef struct _GtdDBusService          GtdDBusService;
+typedef struct _GtdDeletionQueue        GtdDeletionQueue;
+typedef struct _GtdExporter             GtdExporter;
+typedef struct _GtdImporter             GtdImporter;
 typedef struct _GtdInitialSetupWindow   GtdInitialSetupWindow;
+typedef struct _GtdJournal              GtdJournal;
 typedef struct _GtdListView             GtdListView;
+typedef struct _GtdLocalStore           GtdLocalStore;
 typedef struct _GtdManager              GtdManager;
 typedef struct _GtdNotification         GtdNotification;
 typedef struct _GtdNotificationWidget   GtdNotificationWidget;
 typedef struct _GtdObject               GtdObject;
+typedef struct _GtdRuleEngine           GtdRuleEngine;
+typedef struct _GtdSearchIndex          GtdSearchIndex;
+typedef struct _GtdShellSearchProvider  GtdShellSearchProvider;
 typedef struct _GtdStorage              GtdStorage;
 typedef struct _GtdStoragePopover       GtdStoragePopover;
 typedef struct _GtdStorageRow           GtdStorageRow;
@@ -17,6 +17,8 @@
  */
 
 #include "gtd-application.h"
+#include "gtd-exporter.h"
+#include "gtd-importer.h"
 #include "gtd-task-list-view.h"
 #include "gtd-manager.h"
 #include "gtd-notification.h"
@@ -29,6 +31,14 @@
 
 #include <glib/gi18n.h>
 
+typedef struct
+{
+  GtdWindow            *window;
+  GtdExporter          *exporter;
+  GFile                *file;
+  GOutputStream        *stream;
+} ExportData;
+
 typedef struct
 {
   GtkButton                     *back_button;
@@ -51,9 +61,18 @@ typedef struct
   /* mode */
   GtdWindowMode                  mode;
 
+  /* generations of Today and Scheduled when last counted */
+  guint64                        today_generation;
+  guint64                        scheduled_generation;
+
   /* loading notification */
   GtdNotification               *loading_notification;
 
+  /* import */
+  GtdImporter                   *importer;
+  GCancellable                  *import_cancellable;
+  GtdNotification               *import_notification;
+
   GtdManager                    *manager;
 } GtdWindowPrivate;
 
@@ -69,10 +88,20 @@ static void          gtd_window__change_storage_action           (GSimpleAction
                                                                   GVariant              *parameter,
                                                                   gpointer               user_data);
 
+static void          gtd_window__export_action                   (GSimpleAction         *simple,
+                                                                  GVariant              *parameter,
+                                                                  gpointer               user_data);
+
+static void          gtd_window__import_action                   (GSimpleAction         *simple,
+                                                                  GVariant              *parameter,
+                                                                  gpointer               user_data);
+
 G_DEFINE_TYPE_WITH_PRIVATE (GtdWindow, gtd_window, GTK_TYPE_APPLICATION_WINDOW)
 
 static const GActionEntry gtd_window_entries[] = {
-  { "change-storage", gtd_window__change_storage_action }
+  { "change-storage", gtd_window__change_storage_action },
+  { "export",         gtd_window__export_action },
+  { "import",         gtd_window__import_action }
 };
 
 enum {
@@ -81,6 +110,27 @@ enum {
   LAST_PROP
 };
 
+static void
+gtd_window__update_import_action (GtdWindow *window)
+{
+  GtdWindowPrivate *priv;
+  GAction *action;
+
+  priv = window->priv;
+  action = g_action_map_lookup_action (G_ACTION_MAP (window), "import");
+
+  /* Tasks are imported into the open list, one file at a time */
+  g_simple_action_set_enabled (G_SIMPLE_ACTION (action),
+                               !priv->importer &&
+                               g_strcmp0 (gtk_stack_get_visible_child_name (priv->main_stack), "tasks") == 0);
+
+  /* ... and exported from it */
+  action = g_action_map_lookup_action (G_ACTION_MAP (window), "export");
+
+  g_simple_action_set_enabled (G_SIMPLE_ACTION (action),
+                               g_strcmp0 (gtk_stack_get_visible_child_name (priv->main_stack), "tasks") == 0);
+}
+
 static void
 gtd_window__stack_visible_child_cb (GtdWindow *window)
 {
@@ -93,6 +143,7 @@ gtd_window__stack_visible_child_cb (GtdWindow *window)
           g_strcmp0 (gtk_stack_get_visible_child_name (priv->main_stack), "overview") == 0 &&
           g_strcmp0 (gtk_stack_get_visible_child_name (priv->stack), "lists") == 0);
 
+  gtd_window__update_import_action (window);
 }
 
 static void
@@ -103,6 +154,7 @@ gtd_window_update_list_counters (GtdTaskList *list,
   GtdWindowPrivate *priv;
   GtkWidget *container_child;
   gboolean is_today;
+  guint64 *generation;
   GList *tasks;
   GList *l;
   gchar *new_title;
@@ -112,6 +164,14 @@ gtd_window_update_list_counters (GtdTaskList *list,
   g_return_if_fail (GTD_IS_TASK_LIST (list));
 
   priv = window->priv;
+  is_today = list == gtd_manager_get_today_list (priv->manager);
+  generation = is_today ? &priv->today_generation : &priv->scheduled_generation;
+
+  /* The list didn't change since it was counted */
+  if (*generation == gtd_object_get_generation (GTD_OBJECT (list)))
+    return;
+
+  *generation = gtd_object_get_generation (GTD_OBJECT (list));
 
   /* Count the number of incomplete tasks */
   counter = 0;
@@ -124,8 +184,6 @@ gtd_window_update_list_counters (GtdTaskList *list,
     }
 
   /* Update the list title */
-  is_today = list == gtd_manager_get_today_list (priv->manager);
-
   container_child = is_today ? GTK_WIDGET (priv->today_list_view) : GTK_WIDGET (priv->scheduled_list_view);
 
   if (counter == 0)
@@ -163,6 +221,328 @@ gtd_window__change_storage_action (GSimpleAction *simple,
   gtk_dialog_run (GTK_DIALOG (priv->storage_dialog));
 }
 
+static void
+export_data_free (ExportData *data)
+{
+  g_clear_object (&data->exporter);
+  g_clear_object (&data->file);
+  g_clear_object (&data->stream);
+  g_object_unref (data->window);
+  g_free (data);
+}
+
+static void
+gtd_window__export_finished (GObject      *exporter,
+                             GAsyncResult *result,
+                             gpointer      user_data)
+{
+  GtdNotification *notification;
+  ExportData *data;
+  GError *error;
+  gchar *text;
+
+  data = user_data;
+  error = NULL;
+
+  if (gtd_exporter_export_finish (GTD_EXPORTER (exporter), result, &error))
+    g_output_stream_close (data->stream, NULL, &error);
+
+  if (error)
+    {
+      g_warning ("%s: %s: %s",
+                 G_STRFUNC,
+                 _("Error exporting tasks"),
+                 error->message);
+
+      text = g_strdup_printf (_("Error exporting tasks: %s"), error->message);
+
+      /* Don't leave a partial file behind */
+      g_file_delete (data->file, NULL, NULL);
+    }
+  else
+    {
+      guint n_tasks = gtd_exporter_get_n_tasks (GTD_EXPORTER (exporter));
+
+      text = g_strdup_printf (ngettext ("%d task exported",
+                                        "%d tasks exported",
+                                        n_tasks),
+                              n_tasks);
+    }
+
+  notification = gtd_notification_new (text, 7500.0);
+  gtd_window_notify (data->window, notification);
+  g_object_unref (notification);
+
+  g_clear_error (&error);
+  export_data_free (data);
+  g_free (text);
+}
+
+static void
+gtd_window__export_file_opened (GObject      *file,
+                                GAsyncResult *result,
+                                gpointer      user_data)
+{
+  GFileOutputStream *stream;
+  ExportData *data;
+  GError *error;
+
+  data = user_data;
+  error = NULL;
+
+  stream = g_file_replace_finish (G_FILE (file), result, &error);
+
+  if (error)
+    {
+      g_warning ("%s: %s: %s",
+                 G_STRFUNC,
+                 _("Error exporting tasks"),
+                 error->message);
+
+      g_error_free (error);
+      export_data_free (data);
+      return;
+    }
+
+  data->stream = G_OUTPUT_STREAM (stream);
+
+  gtd_exporter_export (data->exporter,
+                       data->stream,
+                       NULL,
+                       (GAsyncReadyCallback) gtd_window__export_finished,
+                       data);
+}
+
+static void
+gtd_window__export_action (GSimpleAction *simple,
+                           GVariant      *parameter,
+                           gpointer       user_data)
+{
+  GtdWindowPrivate *priv;
+  GtkFileFilter *filter;
+  GtdTaskList *list;
+  ExportData *data;
+  GtkWidget *dialog;
+  gchar *filename;
+  gchar *name;
+
+  g_return_if_fail (GTD_IS_WINDOW (user_data));
+
+  priv = GTD_WINDOW (user_data)->priv;
+  list = gtd_task_list_view_get_task_list (priv->list_view);
+
+  if (!list)
+    return;
+
+  dialog = gtk_file_chooser_dialog_new (_("Export Tasks"),
+                                        GTK_WINDOW (user_data),
+                                        GTK_FILE_CHOOSER_ACTION_SAVE,
+                                        _("_Cancel"), GTK_RESPONSE_CANCEL,
+                                        _("_Export"), GTK_RESPONSE_ACCEPT,
+                                        NULL);
+
+  gtk_file_chooser_set_do_overwrite_confirmation (GTK_FILE_CHOOSER (dialog), TRUE);
+
+  name = g_strdup_printf ("%s.ics", gtd_task_list_get_name (list));
+  gtk_file_chooser_set_current_name (GTK_FILE_CHOOSER (dialog), name);
+  g_free (name);
+
+  /* The format is picked from the extension of the file */
+  filter = gtk_file_filter_new ();
+  gtk_file_filter_set_name (filter, _("Calendar files"));
+  gtk_file_filter_add_pattern (filter, "*.ics");
+  gtk_file_chooser_add_filter (GTK_FILE_CHOOSER (dialog), filter);
+
+  filter = gtk_file_filter_new ();
+  gtk_file_filter_set_name (filter, _("JSON Lines files"));
+  gtk_file_filter_add_pattern (filter, "*.jsonl");
+  gtk_file_chooser_add_filter (GTK_FILE_CHOOSER (dialog), filter);
+
+  filter = gtk_file_filter_new ();
+  gtk_file_filter_set_name (filter, _("CSV files"));
+  gtk_file_filter_add_pattern (filter, "*.csv");
+  gtk_file_chooser_add_filter (GTK_FILE_CHOOSER (dialog), filter);
+
+  if (gtk_dialog_run (GTK_DIALOG (dialog)) != GTK_RESPONSE_ACCEPT)
+    {
+      gtk_widget_destroy (dialog);
+      return;
+    }
+
+  data = g_new0 (ExportData, 1);
+  data->window = g_object_ref (user_data);
+  data->file = gtk_file_chooser_get_file (GTK_FILE_CHOOSER (dialog));
+
+  gtk_widget_destroy (dialog);
+
+  /* Take the snapshot now, so later edits don't leak into the file */
+  filename = g_file_get_basename (data->file);
+  data->exporter = gtd_exporter_new (gtd_exporter_get_format_for_filename (filename));
+  gtd_exporter_add_list (data->exporter, list);
+  g_free (filename);
+
+  g_file_replace_async (data->file,
+                        NULL,
+                        FALSE,
+                        G_FILE_CREATE_REPLACE_DESTINATION,
+                        G_PRIORITY_DEFAULT,
+                        NULL,
+                        (GAsyncReadyCallback) gtd_window__export_file_opened,
+                        data);
+}
+
+static void
+gtd_window__import_progress (GtdImporter *importer,
+                             GtdWindow   *window)
+{
+  gchar *text;
+  guint n_imported;
+
+  n_imported = gtd_importer_get_n_imported (importer);
+  text = g_strdup_printf (ngettext ("Importing tasks… %d task imported",
+                                    "Importing tasks… %d tasks imported",
+                                    n_imported),
+                          n_imported);
+
+  gtd_notification_set_text (window->priv->import_notification, text);
+
+  g_free (text);
+}
+
+static void
+gtd_window__import_cancel (GtdNotification *notification,
+                           gpointer         user_data)
+{
+  GtdWindowPrivate *priv = GTD_WINDOW (user_data)->priv;
+
+  g_cancellable_cancel (priv->import_cancellable);
+}
+
+static void
+gtd_window__import_finished (GObject      *importer,
+                             GAsyncResult *result,
+                             gpointer      user_data)
+{
+  GtdWindowPrivate *priv;
+  GtdNotification *notification;
+  GtdWindow *window;
+  GError *error;
+  gchar *text;
+  guint n_imported;
+
+  window = GTD_WINDOW (user_data);
+  priv = window->priv;
+  error = NULL;
+
+  n_imported = gtd_importer_import_finish (GTD_IMPORTER (importer), result, &error);
+
+  gtd_window_cancel_notification (window, priv->import_notification);
+
+  g_signal_handlers_disconnect_by_func (importer,
+                                        gtd_window__import_progress,
+                                        window);
+
+  g_clear_object (&priv->importer);
+  g_clear_object (&priv->import_cancellable);
+
+  if (error && !g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+    {
+      g_warning ("%s: %s: %s",
+                 G_STRFUNC,
+                 _("Error importing tasks"),
+                 error->message);
+
+      text = g_strdup_printf (_("Error importing tasks: %s"), error->message);
+    }
+  else
+    {
+      text = g_strdup_printf (ngettext ("%d task imported",
+                                        "%d tasks imported",
+                                        n_imported),
+                              n_imported);
+    }
+
+  notification = gtd_notification_new (text, 7500.0);
+  gtd_window_notify (window, notification);
+  g_object_unref (notification);
+
+  gtd_window__update_import_action (window);
+
+  g_clear_error (&error);
+  g_free (text);
+  g_object_unref (window);
+}
+
+static void
+gtd_window__import_action (GSimpleAction *simple,
+                           GVariant      *parameter,
+                           gpointer       user_data)
+{
+  GtdWindowPrivate *priv;
+  GtkFileFilter *filter;
+  GtdTaskList *list;
+  GtkWidget *dialog;
+  GFile *file;
+
+  g_return_if_fail (GTD_IS_WINDOW (user_data));
+
+  priv = GTD_WINDOW (user_data)->priv;
+  list = gtd_task_list_view_get_task_list (priv->list_view);
+
+  if (!list || priv->importer)
+    return;
+
+  dialog = gtk_file_chooser_dialog_new (_("Import Tasks"),
+                                        GTK_WINDOW (user_data),
+                                        GTK_FILE_CHOOSER_ACTION_OPEN,
+                                        _("_Cancel"), GTK_RESPONSE_CANCEL,
+                                        _("_Import"), GTK_RESPONSE_ACCEPT,
+                                        NULL);
+
+  filter = gtk_file_filter_new ();
+  gtk_file_filter_set_name (filter, _("Calendar files"));
+  gtk_file_filter_add_mime_type (filter, "text/calendar");
+  gtk_file_filter_add_pattern (filter, "*.ics");
+  gtk_file_chooser_add_filter (GTK_FILE_CHOOSER (dialog), filter);
+
+  if (gtk_dialog_run (GTK_DIALOG (dialog)) != GTK_RESPONSE_ACCEPT)
+    {
+      gtk_widget_destroy (dialog);
+      return;
+    }
+
+  file = gtk_file_chooser_get_file (GTK_FILE_CHOOSER (dialog));
+  gtk_widget_destroy (dialog);
+
+  g_debug ("%s: %s: %s",
+           G_STRFUNC,
+           "Importing tasks into list",
+           gtd_task_list_get_name (list));
+
+  priv->importer = gtd_importer_new (priv->manager, list);
+  priv->import_cancellable = g_cancellable_new ();
+
+  /* Shows the progress until the import finishes */
+  gtd_notification_set_text (priv->import_notification, _("Importing tasks…"));
+
+  g_signal_connect (priv->importer,
+                    "progress",
+                    G_CALLBACK (gtd_window__import_progress),
+                    user_data);
+
+  gtd_window_notify (GTD_WINDOW (user_data), priv->import_notification);
+
+  gtd_importer_import (priv->importer,
+                       file,
+                       priv->import_cancellable,
+                       (GAsyncReadyCallback) gtd_window__import_finished,
+                       g_object_ref (user_data));
+
+  gtd_window__update_import_action (GTD_WINDOW (user_data));
+
+  g_object_unref (file);
+}
+
 static void
 gtd_window__list_color_set (GtkColorChooser *button,
                             gpointer         user_data)
@@ -178,7 +558,7 @@ gtd_window__list_color_set (GtkColorChooser *button,
 
   g_debug ("%s: %s: %s",
            G_STRFUNC,
-           _("Setting new color for task list"),
+           "Setting new color for task list",
            gtd_task_list_get_name (list));
 
   gtk_color_chooser_get_rgba (button, &new_color);
@@ -265,6 +645,29 @@ out:
   return return_value;
 }
 
+static void
+gtd_window__manager_progress_changed (GObject    *source,
+                                      GParamSpec *spec,
+                                      gpointer    user_data)
+{
+  GtdWindowPrivate *priv = GTD_WINDOW (user_data)->priv;
+  guint n_completed;
+  guint n_total;
+  gchar *text;
+
+  gtd_object_get_progress (GTD_OBJECT (source), &n_completed, &n_total);
+
+  /* A single operation has no progress worth showing */
+  if (n_total > 1)
+    text = g_strdup_printf (_("Loading your task lists… %u of %u"), n_completed, n_total);
+  else
+    text = g_strdup (_("Loading your task lists…"));
+
+  gtd_notification_set_text (priv->loading_notification, text);
+
+  g_free (text);
+}
+
 static void
 gtd_window__manager_ready_changed (GObject    *source,
                                    GParamSpec *spec,
@@ -304,37 +707,10 @@ gtd_window__list_selected (GtkFlowBox      *flowbox,
                            GtdTaskListItem *item,
                            gpointer         user_data)
 {
-  GtdWindowPrivate *priv = GTD_WINDOW (user_data)->priv;
-  GtdTaskList *list;
-  GdkRGBA *list_color;
-
   g_return_if_fail (GTD_IS_WINDOW (user_data));
   g_return_if_fail (GTD_IS_TASK_LIST_ITEM (item));
 
-  list = gtd_task_list_item_get_list (item);
-  list_color = gtd_task_list_get_color (list);
-
-  g_signal_handlers_block_by_func (priv->color_button,
-                                   gtd_window__list_color_set,
-                                   user_data);
-
-  gtk_color_chooser_set_rgba (GTK_COLOR_CHOOSER (priv->color_button), list_color);
-
-  gtk_stack_set_visible_child_name (priv->main_stack, "tasks");
-  gtk_header_bar_set_title (priv->headerbar, gtd_task_list_get_name (list));
-  gtk_header_bar_set_subtitle (priv->headerbar, gtd_task_list_get_origin (list));
-  gtk_header_bar_set_custom_title (priv->headerbar, NULL);
-  gtk_search_bar_set_search_mode (priv->search_bar, FALSE);
-  gtd_task_list_view_set_task_list (priv->list_view, list);
-  gtd_task_list_view_set_show_completed (priv->list_view, FALSE);
-  gtk_widget_show (GTK_WIDGET (priv->back_button));
-  gtk_widget_show (GTK_WIDGET (priv->color_button));
-
-  g_signal_handlers_unblock_by_func (priv->color_button,
-                                     gtd_window__list_color_set,
-                                     user_data);
-
-  gdk_rgba_free (list_color);
+  gtd_window_show_list (GTD_WINDOW (user_data), gtd_task_list_item_get_list (item));
 }
 
 static void
@@ -439,6 +815,10 @@ gtd_window_set_property (GObject      *object,
                         "notify::ready",
                         G_CALLBACK (gtd_window__manager_ready_changed),
                         self);
+      g_signal_connect (self->priv->manager,
+                        "notify::progress",
+                        G_CALLBACK (gtd_window__manager_progress_changed),
+                        self);
       g_signal_connect (self->priv->manager,
                         "list-added",
                         G_CALLBACK (gtd_window__list_added),
@@ -549,8 +929,16 @@ gtd_window_init (GtdWindow *self)
 {
   self->priv = gtd_window_get_instance_private (self);
 
+  /* Both notifications show a spinner for as long as they're visible */
   self->priv->loading_notification = gtd_notification_new (_("Loading your task lists…"), 0);
-  gtd_object_set_ready (GTD_OBJECT (self->priv->loading_notification), FALSE);
+  gtd_object_begin_operation (GTD_OBJECT (self->priv->loading_notification));
+
+  self->priv->import_notification = gtd_notification_new (NULL, 0);
+  gtd_object_begin_operation (GTD_OBJECT (self->priv->import_notification));
+  gtd_notification_set_secondary_action (self->priv->import_notification,
+                                         _("Cancel"),
+                                         gtd_window__import_cancel,
+                                         self);
 
   /* add actions */
   g_action_map_add_action_entries (G_ACTION_MAP (self),
@@ -582,7 +970,8 @@ gtd_window_get_manager (GtdWindow *window)
  * @window: a #GtdWindow
  * @notification: a #GtdNotification
  *
- * Shows a notification on the top of the main window.
+ * Shows a notification on the top of the main window. The window
+ * keeps a reference on @notification until it's done.
  *
  * Returns:
  */
@@ -620,3 +1009,48 @@ gtd_window_cancel_notification (GtdWindow       *window,
 
   gtd_notification_widget_cancel (priv->notification_widget, notification);
 }
+
+/**
+ * gtd_window_show_list:
+ * @window: a #GtdWindow
+ * @list: the #GtdTaskList to show
+ *
+ * Shows the tasks of @list in @window.
+ *
+ * Returns:
+ */
+void
+gtd_window_show_list (GtdWindow   *window,
+                      GtdTaskList *list)
+{
+  GtdWindowPrivate *priv;
+  GdkRGBA *list_color;
+
+  g_return_if_fail (GTD_IS_WINDOW (window));
+  g_return_if_fail (GTD_IS_TASK_LIST (list));
+
+  priv = window->priv;
+  list_color = gtd_task_list_get_color (list);
+
+  g_signal_handlers_block_by_func (priv->color_button,
+                                   gtd_window__list_color_set,
+                                   window);
+
+  gtk_color_chooser_set_rgba (GTK_COLOR_CHOOSER (priv->color_button), list_color);
+
+  gtk_stack_set_visible_child_name (priv->main_stack, "tasks");
+  gtk_header_bar_set_title (priv->headerbar, gtd_task_list_get_name (list));
+  gtk_header_bar_set_subtitle (priv->headerbar, gtd_task_list_get_origin (list));
+  gtk_header_bar_set_custom_title (priv->headerbar, NULL);
+  gtk_search_bar_set_search_mode (priv->search_bar, FALSE);
+  gtd_task_list_view_set_task_list (priv->list_view, list);
+  gtd_task_list_view_set_show_completed (priv->list_view, FALSE);
+  gtk_widget_show (GTK_WIDGET (priv->back_button));
+  gtk_widget_show (GTK_WIDGET (priv->color_button));
+
+  g_signal_handlers_unblock_by_func (priv->color_button,
+                                     gtd_window__list_color_set,
+                                     window);
+
+  gdk_rgba_free (list_color);
+}
@@ -40,6 +40,9 @@ void                      gtd_window_notify               (GtdWindow
 void                      gtd_window_cancel_notification  (GtdWindow             *window,
                                                            GtdNotification      *notification);
 
+void                      gtd_window_show_list            (GtdWindow            *window,
+                                                           GtdTaskList          *list);
+
 G_END_DECLS
 
 #endif /* GTD_WINDOW_H */
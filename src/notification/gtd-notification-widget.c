@@ -32,7 +32,7 @@ typedef struct
   GtkSpinner         *spinner;
   GtkLabel           *text_label;
 
-  /* internal data */
+  /* internal data, holding a reference on each notification */
   GQueue             *queue;
   GtdNotification    *current_notification;
   GtdExecutionState   state;
@@ -142,6 +142,40 @@ gtd_notification_widget__notification_executed_cb (GtdNotification       *notifi
   g_signal_handlers_disconnect_by_func (notification,
                                         gtd_notification_widget__notification_executed_cb,
                                         widget);
+
+  g_object_unref (notification);
+}
+
+/*
+ * Finds a notification of the same kind as @notification that
+ * wasn't executed yet, so both can be merged.
+ */
+static GtdNotification*
+gtd_notification_widget__find_kind (GtdNotificationWidget *widget,
+                                    GtdNotification       *notification)
+{
+  GtdNotificationWidgetPrivate *priv = widget->priv;
+  const gchar *kind;
+  GList *l;
+
+  kind = gtd_notification_get_kind (notification);
+
+  if (!kind)
+    return NULL;
+
+  if (priv->current_notification &&
+      g_strcmp0 (gtd_notification_get_kind (priv->current_notification), kind) == 0)
+    {
+      return priv->current_notification;
+    }
+
+  for (l = priv->queue->head; l != NULL; l = l->next)
+    {
+      if (g_strcmp0 (gtd_notification_get_kind (l->data), kind) == 0)
+        return l->data;
+    }
+
+  return NULL;
 }
 
 static void
@@ -192,7 +226,18 @@ gtd_notification_widget_finalize (GObject *object)
   GtdNotificationWidget *self = (GtdNotificationWidget *)object;
   GtdNotificationWidgetPrivate *priv = gtd_notification_widget_get_instance_private (self);
 
-  g_queue_free (priv->queue);
+  gtd_notification_widget_clear_bindings (self);
+
+  if (priv->current_notification)
+    {
+      g_signal_handlers_disconnect_by_func (priv->current_notification,
+                                            gtd_notification_widget__notification_executed_cb,
+                                            self);
+      gtd_notification_stop (priv->current_notification);
+      g_object_unref (priv->current_notification);
+    }
+
+  g_queue_free_full (priv->queue, g_object_unref);
 
   G_OBJECT_CLASS (gtd_notification_widget_parent_class)->finalize (object);
 }
@@ -244,7 +289,9 @@ gtd_notification_widget_new (void)
  * gtd_notification_widget_notify:
  *
  * Adds @notification to the queue of notifications, and eventually
- * consume it.
+ * consume it. If a notification of the same kind is shown or queued,
+ * @notification is merged into it instead, and the timeout of the
+ * shown one restarts.
  *
  * Returns:
  */
@@ -253,14 +300,30 @@ gtd_notification_widget_notify (GtdNotificationWidget *widget,
                                 GtdNotification       *notification)
 {
   GtdNotificationWidgetPrivate *priv;
+  GtdNotification *similar;
 
   g_return_if_fail (GTD_IS_NOTIFICATION_WIDGET (widget));
 
   priv = widget->priv;
 
+  if (notification == priv->current_notification)
+    return;
+
+  similar = gtd_notification_widget__find_kind (widget, notification);
+
+  if (similar)
+    {
+      gtd_notification_merge (similar, notification);
+
+      if (similar == priv->current_notification)
+        gtd_notification_start (similar);
+
+      return;
+    }
+
   if (!g_queue_find (priv->queue, notification))
     {
-      g_queue_push_tail (priv->queue, notification);
+      g_queue_push_tail (priv->queue, g_object_ref (notification));
 
       if (priv->state == STATE_IDLE)
         gtd_notification_widget_stop_or_run (widget);
@@ -287,11 +350,18 @@ gtd_notification_widget_cancel (GtdNotificationWidget *widget,
 
   if (notification == priv->current_notification)
     {
+      g_signal_handlers_disconnect_by_func (notification,
+                                            gtd_notification_widget__notification_executed_cb,
+                                            widget);
+
       gtd_notification_stop (notification);
+      gtd_notification_widget_clear_bindings (widget);
       gtd_notification_widget_stop_or_run (widget);
+
+      g_object_unref (notification);
     }
-  else if (g_queue_find (priv->queue, notification))
+  else if (g_queue_remove (priv->queue, notification))
     {
-      g_queue_remove (priv->queue, notification);
+      g_object_unref (notification);
     }
 }
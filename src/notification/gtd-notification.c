@@ -21,12 +21,30 @@
 
 #include <glib/gi18n.h>
 
+/*
+ * Running notifications aren't given a timeout source each. Their
+ * deadlines are kept in a min-heap shared by every notification, and
+ * a single timeout is armed for the earliest one.
+ */
+
+typedef struct
+{
+  gint64              deadline;
+  GtdNotification    *notification;
+} Deadline;
+
 typedef struct
 {
   gchar              *text;
 
   gdouble             timeout;
-  gint                timeout_id;
+
+  /* Position in the deadline heap, or -1 when not running */
+  gint                heap_index;
+
+  /* Notifications of the same kind are merged */
+  gchar              *kind;
+  GPtrArray          *items;
 
   GtdNotificationActionFunc primary_action;
   gboolean            has_primary_action;
@@ -54,6 +72,7 @@ enum
   PROP_HAS_PRIMARY_ACTION,
   PROP_HAS_SECONDARY_ACTION,
   PROP_SECONDARY_ACTION_NAME,
+  PROP_KIND,
   PROP_TEXT,
   PROP_TIMEOUT,
   LAST_PROP
@@ -62,19 +81,140 @@ enum
 enum
 {
   EXECUTED,
+  MERGED,
   NUM_SIGNALS
 };
 
 static guint signals[NUM_SIGNALS] = { 0, };
 
+static GArray *deadlines = NULL;
+static guint deadlines_timeout_id = 0;
+
+#define DEADLINE(i) (g_array_index (deadlines, Deadline, (i)))
+
+static void
+gtd_notification__heap_swap (guint a,
+                             guint b)
+{
+  Deadline tmp;
+
+  tmp = DEADLINE (a);
+  DEADLINE (a) = DEADLINE (b);
+  DEADLINE (b) = tmp;
+
+  DEADLINE (a).notification->priv->heap_index = a;
+  DEADLINE (b).notification->priv->heap_index = b;
+}
+
+static void
+gtd_notification__heap_sift_up (guint index)
+{
+  while (index > 0)
+    {
+      guint parent = (index - 1) / 2;
+
+      if (DEADLINE (parent).deadline <= DEADLINE (index).deadline)
+        break;
+
+      gtd_notification__heap_swap (parent, index);
+      index = parent;
+    }
+}
+
+static void
+gtd_notification__heap_sift_down (guint index)
+{
+  while (TRUE)
+    {
+      guint smallest = index;
+      guint left = 2 * index + 1;
+      guint right = left + 1;
+
+      if (left < deadlines->len && DEADLINE (left).deadline < DEADLINE (smallest).deadline)
+        smallest = left;
+
+      if (right < deadlines->len && DEADLINE (right).deadline < DEADLINE (smallest).deadline)
+        smallest = right;
+
+      if (smallest == index)
+        break;
+
+      gtd_notification__heap_swap (index, smallest);
+      index = smallest;
+    }
+}
+
+static void
+gtd_notification__heap_remove (GtdNotification *notification)
+{
+  guint index;
+  guint last;
+
+  index = notification->priv->heap_index;
+  last = deadlines->len - 1;
+
+  notification->priv->heap_index = -1;
+
+  if (index != last)
+    {
+      DEADLINE (index) = DEADLINE (last);
+      DEADLINE (index).notification->priv->heap_index = index;
+    }
+
+  g_array_set_size (deadlines, last);
+
+  if (index < deadlines->len)
+    {
+      gtd_notification__heap_sift_up (index);
+      gtd_notification__heap_sift_down (DEADLINE (index).notification->priv->heap_index);
+    }
+}
+
+static gboolean      gtd_notification__dispatch                  (gpointer            user_data);
+
+static void
+gtd_notification__arm_timeout (void)
+{
+  gint64 delay;
+
+  if (deadlines_timeout_id > 0)
+    {
+      g_source_remove (deadlines_timeout_id);
+      deadlines_timeout_id = 0;
+    }
+
+  if (!deadlines || deadlines->len == 0)
+    return;
+
+  /* Round up, so the earliest notification is due when we wake up */
+  delay = MAX (0, DEADLINE (0).deadline - g_get_monotonic_time ());
+
+  deadlines_timeout_id = g_timeout_add ((delay + 999) / 1000,
+                                        gtd_notification__dispatch,
+                                        NULL);
+}
+
 static gboolean
-execute_action_cb (GtdNotification *notification)
+gtd_notification__dispatch (gpointer user_data)
 {
-  GtdNotificationPrivate *priv = notification->priv;
+  gint64 now;
+
+  deadlines_timeout_id = 0;
+  now = g_get_monotonic_time ();
+
+  while (deadlines->len > 0 && DEADLINE (0).deadline <= now)
+    {
+      GtdNotification *notification;
 
-  priv->timeout_id = 0;
+      notification = g_object_ref (DEADLINE (0).notification);
 
-  gtd_notification_execute_primary_action (notification);
+      gtd_notification__heap_remove (notification);
+      gtd_notification_execute_primary_action (notification);
+
+      g_object_unref (notification);
+    }
+
+  gtd_notification__arm_timeout ();
 
   return G_SOURCE_REMOVE;
 }
@@ -85,11 +225,16 @@ gtd_notification_finalize (GObject *object)
   GtdNotification *self = (GtdNotification *)object;
   GtdNotificationPrivate *priv = gtd_notification_get_instance_private (self);
 
-  if (priv->timeout_id > 0)
-    g_source_remove (priv->timeout_id);
+  if (priv->heap_index >= 0)
+    {
+      gtd_notification__heap_remove (self);
+      gtd_notification__arm_timeout ();
+    }
 
   g_clear_pointer (&priv->secondary_action_name, g_free);
   g_clear_pointer (&priv->text, g_free);
+  g_clear_pointer (&priv->kind, g_free);
+  g_clear_pointer (&priv->items, g_ptr_array_unref);
 
   G_OBJECT_CLASS (gtd_notification_parent_class)->finalize (object);
 }
@@ -112,6 +257,10 @@ gtd_notification_get_property (GObject    *object,
       g_value_set_boolean (value, self->priv->has_secondary_action);
       break;
 
+    case PROP_KIND:
+      g_value_set_string (value, gtd_notification_get_kind (self));
+      break;
+
     case PROP_SECONDARY_ACTION_NAME:
       g_value_set_string (value, self->priv->secondary_action_name ? self->priv->secondary_action_name : "");
       break;
@@ -146,6 +295,10 @@ gtd_notification_set_property (GObject      *object,
                                              self->priv->secondary_action_data);
       break;
 
+    case PROP_KIND:
+      gtd_notification_set_kind (self, g_value_get_string (value));
+      break;
+
     case PROP_TEXT:
       gtd_notification_set_text (self, g_value_get_string (value));
       break;
@@ -212,6 +365,22 @@ gtd_notification_class_init (GtdNotificationClass *klass)
                              "",
                              G_PARAM_READWRITE));
 
+  /**
+   * GtdNotification::kind:
+   *
+   * The kind of the notification. Notifications of the same kind are
+   * merged while waiting to be shown, so they must have interchangeable
+   * actions, which run once over the items of every merged notification.
+   */
+  g_object_class_install_property (
+        object_class,
+        PROP_KIND,
+        g_param_spec_string ("kind",
+                             _("Kind of the notification"),
+                             _("The kind of the notification, used to merge similar notifications"),
+                             NULL,
+                             G_PARAM_READWRITE));
+
   /**
    * GtdNotification::text:
    *
@@ -257,6 +426,23 @@ gtd_notification_class_init (GtdNotificationClass *klass)
                                     NULL,
                                     G_TYPE_NONE,
                                     0);
+
+  /**
+   * GtdNotification::merged:
+   *
+   * The ::merged signal is emmited after the items of another
+   * #GtdNotification of the same kind are added to this one, so
+   * that its text can be updated.
+   */
+  signals[MERGED] = g_signal_new ("merged",
+                                  GTD_TYPE_NOTIFICATION,
+                                  G_SIGNAL_RUN_FIRST,
+                                  0,
+                                  NULL,
+                                  NULL,
+                                  NULL,
+                                  G_TYPE_NONE,
+                                  0);
 }
 
 static void
@@ -266,6 +452,8 @@ gtd_notification_init (GtdNotification *self)
   self->priv->secondary_action_name = NULL;
   self->priv->text = NULL;
   self->priv->timeout = 7500.0;
+  self->priv->heap_index = -1;
+  self->priv->items = g_ptr_array_new_with_free_func (g_object_unref);
 }
 
 /**
@@ -457,11 +645,10 @@ gtd_notification_execute_primary_action (GtdNotification *notification)
   priv = notification->priv;
 
   if (priv->primary_action)
-    {
-      priv->primary_action (notification, priv->primary_action_data);
+    priv->primary_action (notification, priv->primary_action_data);
 
-      g_signal_emit (notification, signals[EXECUTED], 0);
-    }
+  /* Notifications without actions are done when dismissed, too */
+  g_signal_emit (notification, signals[EXECUTED], 0);
 }
 
 /**
@@ -491,8 +678,8 @@ gtd_notification_execute_secondary_action (GtdNotification *notification)
 /**
  * gtd_notification_start:
  *
- * Starts the timeout of notification. Use @gtd_notification_stop
- * to stop it.
+ * Starts the timeout of notification, or restarts it if it's already
+ * running. Use @gtd_notification_stop to stop it.
  *
  * Returns:
  */
@@ -500,23 +687,32 @@ void
 gtd_notification_start (GtdNotification *notification)
 {
   GtdNotificationPrivate *priv;
+  Deadline deadline;
 
   g_return_if_fail (GTD_IS_NOTIFICATION (notification));
 
   priv = notification->priv;
 
-  if (priv->timeout != 0)
-    {
-      if (priv->timeout_id > 0)
-        {
-          g_source_remove (priv->timeout_id);
-          priv->timeout_id = 0;
-        }
+  if (priv->timeout == 0)
+    return;
 
-      priv->timeout_id = g_timeout_add (priv->timeout,
-                                        (GSourceFunc) execute_action_cb,
-                                        notification);
-    }
+  if (!deadlines)
+    deadlines = g_array_new (FALSE, FALSE, sizeof (Deadline));
+
+  if (priv->heap_index >= 0)
+    gtd_notification__heap_remove (notification);
+
+  deadline.deadline = g_get_monotonic_time () + priv->timeout * 1000;
+  deadline.notification = notification;
+
+  g_array_append_val (deadlines, deadline);
+  priv->heap_index = deadlines->len - 1;
+
+  gtd_notification__heap_sift_up (priv->heap_index);
+
+  /* Only the earliest deadline has a timeout */
+  if (priv->heap_index == 0)
+    gtd_notification__arm_timeout ();
 }
 
 /**
@@ -529,6 +725,52 @@ gtd_notification_start (GtdNotification *notification)
  */
 void
 gtd_notification_stop (GtdNotification *notification)
+{
+  GtdNotificationPrivate *priv;
+  gboolean was_first;
+
+  g_return_if_fail (GTD_IS_NOTIFICATION (notification));
+
+  priv = notification->priv;
+
+  if (priv->heap_index < 0)
+    return;
+
+  was_first = priv->heap_index == 0;
+
+  gtd_notification__heap_remove (notification);
+
+  if (was_first)
+    gtd_notification__arm_timeout ();
+}
+
+/**
+ * gtd_notification_get_kind:
+ *
+ * Retrieves the kind of @notification.
+ *
+ * Returns: (transfer none) (nullable): the kind of @notification, or
+ * %NULL if it's never merged
+ */
+const gchar*
+gtd_notification_get_kind (GtdNotification *notification)
+{
+  g_return_val_if_fail (GTD_IS_NOTIFICATION (notification), NULL);
+
+  return notification->priv->kind;
+}
+
+/**
+ * gtd_notification_set_kind:
+ *
+ * Sets the kind of @notification. Notifications of the same kind are
+ * merged with gtd_notification_merge() while they wait to be shown.
+ *
+ * Returns:
+ */
+void
+gtd_notification_set_kind (GtdNotification *notification,
+                           const gchar     *kind)
 {
   GtdNotificationPrivate *priv;
 
@@ -536,9 +778,77 @@ gtd_notification_stop (GtdNotification *notification)
 
   priv = notification->priv;
 
-  if (priv->timeout_id != 0)
+  if (g_strcmp0 (priv->kind, kind) != 0)
     {
-      g_source_remove (priv->timeout_id);
-      priv->timeout_id = 0;
+      g_clear_pointer (&priv->kind, g_free);
+      priv->kind = g_strdup (kind);
+
+      g_object_notify (G_OBJECT (notification), "kind");
     }
 }
+
+/**
+ * gtd_notification_add_item:
+ *
+ * Adds @item to the items the actions of @notification work on.
+ * @notification keeps a reference on @item.
+ *
+ * Returns:
+ */
+void
+gtd_notification_add_item (GtdNotification *notification,
+                           GObject         *item)
+{
+  g_return_if_fail (GTD_IS_NOTIFICATION (notification));
+  g_return_if_fail (G_IS_OBJECT (item));
+
+  g_ptr_array_add (notification->priv->items, g_object_ref (item));
+}
+
+/**
+ * gtd_notification_get_items:
+ *
+ * Retrieves the items the actions of @notification work on,
+ * including the ones of the notifications merged into it.
+ *
+ * Returns: (transfer none) (element-type GObject): the items of @notification
+ */
+GPtrArray*
+gtd_notification_get_items (GtdNotification *notification)
+{
+  g_return_val_if_fail (GTD_IS_NOTIFICATION (notification), NULL);
+
+  return notification->priv->items;
+}
+
+/**
+ * gtd_notification_merge:
+ *
+ * Moves the items of @other into @notification, so that they are
+ * handled by a single run of the actions of @notification. @other
+ * must be of the same kind, and is dropped afterwards.
+ *
+ * Returns:
+ */
+void
+gtd_notification_merge (GtdNotification *notification,
+                        GtdNotification *other)
+{
+  GPtrArray *items;
+  guint i;
+
+  g_return_if_fail (GTD_IS_NOTIFICATION (notification));
+  g_return_if_fail (GTD_IS_NOTIFICATION (other));
+  g_return_if_fail (g_strcmp0 (notification->priv->kind, other->priv->kind) == 0);
+
+  items = other->priv->items;
+
+  for (i = 0; i < items->len; i++)
+    g_ptr_array_add (notification->priv->items, g_object_ref (g_ptr_array_index (items, i)));
+
+  g_ptr_array_set_size (items, 0);
+
+  gtd_notification_stop (other);
+
+  g_signal_emit (notification, signals[MERGED], 0);
+}
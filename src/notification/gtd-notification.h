@@ -65,6 +65,19 @@ gdouble              gtd_notification_get_timeout                (GtdNotificatio
 void                 gtd_notification_set_timeout                (GtdNotification    *notification,
                                                                   gdouble             timeout);
 
+const gchar*         gtd_notification_get_kind                   (GtdNotification    *notification);
+
+void                 gtd_notification_set_kind                   (GtdNotification    *notification,
+                                                                  const gchar        *kind);
+
+void                 gtd_notification_add_item                   (GtdNotification    *notification,
+                                                                  GObject            *item);
+
+GPtrArray*           gtd_notification_get_items                  (GtdNotification    *notification);
+
+void                 gtd_notification_merge                      (GtdNotification    *notification,
+                                                                  GtdNotification    *other);
+
 G_END_DECLS
 
 #endif /* GTD_NOTIFICATION_H */